@@ -7,7 +7,9 @@
 */
 
 #include "engine/FlowEngine.h"
+#include "engine/RecordingJournal.h"
 #include "engine/server/WebSocketServer.h"
+#include "engine/state/StreamingJson.h"
 #include <JuceHeader.h>
 
 //==============================================================================
@@ -64,14 +66,35 @@ public:
                             device->getCurrentBufferSizeSamples());
     }
 
+    // Stitch takes left journalled by a crash or by a stitch that failed or
+    // was cut short at quit, then recompress recordings whenever the engine
+    // is idle
+    auto recordingsRoot =
+        flowzone::RecordingJournal::getDefaultRecordingsRoot();
+    flowzone::RecordingJournal::recoverInterrupted(recordingsRoot);
+    engine->startStorageMaintenance(recordingsRoot);
+
     // 3. Initialize Server
     server.reset(new WebSocketServer(50001));
+    server->setVersion(getApplicationVersion().toStdString());
 
     // 4. Connect Broadcaster to Server
-    engine->getBroadcaster().setMessageCallback(
-        [this](const juce::String &msg) {
+    engine->getBroadcaster().setStateMessageCallback(
+        [this](flowzone::StateBroadcaster::StateMessage &msg) {
+          if (server) {
+            server->broadcastState(
+                msg.getType() ==
+                        flowzone::StateBroadcaster::MessageType::Snapshot
+                    ? OutgoingMessage::Kind::StateSnapshot
+                    : OutgoingMessage::Kind::StatePatch,
+                [&] { return msg.toJsonUtf8(); },
+                [&] { return msg.toMsgPack(); });
+          }
+        });
+    engine->getVisualizationStream().setFrameCallback(
+        [this](const void *data, size_t size) {
           if (server) {
-            server->broadcast(msg.toStdString());
+            server->broadcastBinary(data, size);
           }
         });
 
@@ -79,21 +102,60 @@ public:
     server->setInitialStateCallback([this]() -> std::string {
       if (engine) {
         auto state = engine->getSessionManager().getCurrentState();
-        juce::DynamicObject *root = new juce::DynamicObject();
-        root->setProperty("type", "STATE_FULL");
-        root->setProperty("revisionId",
-                          engine->getBroadcaster().getRevisionId());
-        root->setProperty("data", state.toVar());
-        return juce::JSON::toString(juce::var(root)).toStdString();
+        std::string json;
+        flowzone::JsonWriter writer(json);
+        writer.beginObject();
+        writer.key("type");
+        writer.writeString("STATE_FULL");
+        writer.key("epoch");
+        writer.writeString(
+            std::string_view(engine->getBroadcaster().getEpoch()));
+        writer.key("revisionId");
+        writer.writeInt(engine->getBroadcaster().getRevisionId());
+        writer.key("data");
+        state.writeJson(writer);
+        writer.endObject();
+        return json;
       }
       return "{}";
     });
 
+    // Reconnecting clients are caught up from the broadcaster's history;
+    // the callback above only covers connections before the first broadcast
+    server->setReconnectCallback(
+        [this](std::string_view lastEpoch, int64_t lastRevisionId,
+               StateEncoding encoding,
+               const WebSocketServer::DeliverFunction &deliver) {
+          return engine != nullptr &&
+                 engine->getBroadcaster().replyToReconnect(
+                     lastEpoch, lastRevisionId,
+                     [&](flowzone::StateBroadcaster::StateMessage &msg) {
+                       deliver(encoding == StateEncoding::MsgPack
+                                   ? msg.toMsgPack()
+                                   : msg.toJsonUtf8());
+                     });
+        });
+
+    // Broadcasting idles while nobody is connected
+    server->setConnectionCountCallback([this](int count) {
+      if (engine)
+        engine->setConnectionCount(count);
+    });
+
     // 6. Setup Message Handling (Commands from Frontend)
-    server->setOnMessageCallback([this](const std::string &msg) {
-      if (engine) {
-        engine->getCommandQueue().push(juce::String(msg));
-      }
+    // History paging is answered straight to the asking client
+    server->setQueryCallback(
+        [this](std::string_view msg,
+               const WebSocketServer::DeliverFunction &reply) {
+          std::string answer;
+          if (engine == nullptr || !engine->answerQuery(msg, answer))
+            return false;
+          reply(answer);
+          return true;
+        });
+
+    server->setOnMessageCallback([this](std::string_view msg) {
+      return engine != nullptr && engine->submitCommand(msg);
     });
 
     server->start();
@@ -1,20 +1,105 @@
 #include "CommandDispatcher.h"
 #include "FlowEngine.h"
+#include "state/StateSchema.h"
 #include <JuceHeader.h>
 #include <string>
 
 namespace flowzone {
 
+namespace schema {
+
+template <> struct Schema<Command> {
+  static constexpr auto fields = std::make_tuple(
+      field("cmd", &Command::cmd), field("bpm", &Command::bpm),
+      field("category", &Command::category),
+      field("preset", &Command::preset), field("riffId", &Command::riffId),
+      field("pad", &Command::pad), field("val", &Command::val),
+      field("x", &Command::x), field("y", &Command::y),
+      field("bars", &Command::bars), field("index", &Command::index),
+      field("slot", &Command::slot), field("volume", &Command::volume),
+      field("sessionId", &Command::sessionId), field("name", &Command::name),
+      field("emoji", &Command::emoji), field("offset", &Command::offset),
+      field("limit", &Command::limit),
+      field("requestId", &Command::requestId),
+      field("target", &Command::target), field("t0", &Command::t0));
+};
+
+} // namespace schema
+
 CommandDispatcher::CommandDispatcher() {}
 CommandDispatcher::~CommandDispatcher() {}
 
+namespace {
+bool readPoints(JsonReader &reader, GesturePoints &points) {
+  points.size = 0;
+  if (!reader.beginArray())
+    return false;
+  while (reader.nextElement()) {
+    double value = 0.0;
+    if (!reader.readNumber(value))
+      return false;
+    if (points.size < GesturePoints::kCapacity)
+      points.values[(size_t)points.size++] = (float)value;
+  }
+  return !reader.failed();
+}
+
+bool readCommand(JsonReader &reader, Command &command) {
+  if (reader.peek() != JsonReader::Token::Object)
+    return false;
+
+  // points is read by hand into its fixed array
+  bool pointsOk = true;
+  bool ok = schema::readObject(reader, command, [&](std::string_view key) {
+    if (key != "points" || reader.peek() != JsonReader::Token::Array)
+      return false;
+    pointsOk = readPoints(reader, command.points);
+    return true;
+  });
+  return ok && pointsOk;
+}
+} // namespace
+
+bool CommandDispatcher::parse(const char *json, size_t size,
+                              Command &command) {
+  JsonReader reader(json, size);
+  return readCommand(reader, command);
+}
+
+bool CommandDispatcher::parse(const juce::String &jsonCommand,
+                              Command &command) {
+  JsonReader reader(jsonCommand);
+  return readCommand(reader, command);
+}
+
 void CommandDispatcher::dispatch(const juce::String &jsonCommand,
                                  FlowEngine &engine) {
-  auto jsonVar = juce::JSON::parse(jsonCommand);
-  if (!jsonVar.isObject())
+  dispatch(jsonCommand.toRawUTF8(), jsonCommand.getNumBytesAsUTF8(), engine);
+}
+
+void CommandDispatcher::dispatch(const char *json, size_t size,
+                                 FlowEngine &engine) {
+  JsonReader reader(json, size);
+  if (reader.peek() != JsonReader::Token::Array) {
+    Command c;
+    if (readCommand(reader, c))
+      execute(c, engine);
+    return;
+  }
+
+  // Batch frame: everything up to the first malformed element runs
+  if (!reader.beginArray())
     return;
+  while (reader.nextElement()) {
+    Command c;
+    if (!readCommand(reader, c))
+      return;
+    execute(c, engine);
+  }
+}
 
-  auto cmdType = jsonVar["cmd"].toString();
+void CommandDispatcher::execute(const Command &c, FlowEngine &engine) {
+  const auto &cmdType = c.cmd;
 
   if (cmdType == "PLAY") {
     handlePlay(engine);
@@ -26,34 +111,35 @@ void CommandDispatcher::dispatch(const juce::String &jsonCommand,
     handleToggleMetronome(engine);
   } else if (cmdType == "SET_TEMPO") {
     // Check if bpm exists
-    if (jsonVar.hasProperty("bpm")) {
-      handleSetBpm(engine, (double)jsonVar["bpm"]);
+    if (c.bpm) {
+      handleSetBpm(engine, *c.bpm);
     }
   } else if (cmdType == "SET_PRESET") {
-    handleSetPreset(engine, jsonVar["category"].toString(),
-                    jsonVar["preset"].toString());
+    handleSetPreset(engine, c.category, c.preset);
   } else if (cmdType == "SET_MODE") {
-    handleSetMode(engine, jsonVar["category"].toString());
+    handleSetMode(engine, c.category);
   } else if (cmdType == "LOAD_RIFF") {
-    handleLoadRiff(engine, jsonVar["riffId"].toString());
+    handleLoadRiff(engine, c.riffId);
   } else if (cmdType == "NOTE_ON") {
-    handleNoteOn(engine, (int)jsonVar["pad"], (float)jsonVar["val"]);
+    handleNoteOn(engine, c.pad, c.val);
   } else if (cmdType == "NOTE_OFF") {
-    handleNoteOff(engine, (int)jsonVar["pad"]);
+    handleNoteOff(engine, c.pad);
   } else if (cmdType == "XY_CHANGE") {
-    handleXYChange(engine, (float)jsonVar["x"], (float)jsonVar["y"]);
+    handleXYChange(engine, c.x, c.y);
+  } else if (cmdType == "GESTURE") {
+    handleGesture(engine, c);
   } else if (cmdType == "SET_LOOP_LENGTH") {
-    handleSetLoopLength(engine, (int)jsonVar["bars"]);
+    handleSetLoopLength(engine, c.bars);
   } else if (cmdType == "MUTE_SLOT") {
-    handleSetSlotMuted(engine, (int)jsonVar["index"], true);
+    handleSetSlotMuted(engine, c.index, true);
   } else if (cmdType == "UNMUTE_SLOT") {
-    handleSetSlotMuted(engine, (int)jsonVar["index"], false);
+    handleSetSlotMuted(engine, c.index, false);
   } else if (cmdType == "SET_VOL") {
-    handleSetSlotVolume(engine, (int)jsonVar["index"], (float)jsonVar["val"]);
+    handleSetSlotVolume(engine, c.index, c.val);
   } else if (cmdType == "SET_SLOT_VOLUME") {
-    handleSetSlotVolume(engine, (int)jsonVar["slot"], (float)jsonVar["volume"]);
+    handleSetSlotVolume(engine, c.slot, c.volume);
   } else if (cmdType == "SET_INPUT_GAIN") {
-    handleSetInputGain(engine, (float)jsonVar["val"]);
+    handleSetInputGain(engine, c.val);
   } else if (cmdType == "TOGGLE_MONITOR_INPUT") {
     handleToggleMonitorInput(engine);
   } else if (cmdType == "TOGGLE_MONITOR_UNTIL_LOOPED") {
@@ -63,13 +149,11 @@ void CommandDispatcher::dispatch(const juce::String &jsonCommand,
   } else if (cmdType == "NEW_JAM") {
     handleNewJam(engine);
   } else if (cmdType == "LOAD_JAM") {
-    handleLoadJam(engine, jsonVar["sessionId"].toString());
+    handleLoadJam(engine, c.sessionId);
   } else if (cmdType == "RENAME_JAM") {
-    handleRenameJam(
-        engine, jsonVar["sessionId"].toString(), jsonVar["name"].toString(),
-        jsonVar.hasProperty("emoji") ? jsonVar["emoji"].toString() : "");
+    handleRenameJam(engine, c.sessionId, c.name, c.emoji);
   } else if (cmdType == "DELETE_JAM") {
-    handleDeleteJam(engine, jsonVar["sessionId"].toString());
+    handleDeleteJam(engine, c.sessionId);
   } else if (cmdType == "COMMIT") {
     handleCommit(engine);
   }
@@ -135,6 +219,19 @@ void CommandDispatcher::handleXYChange(FlowEngine &engine, float x, float y) {
   engine.updateXY(x, y);
 }
 
+void CommandDispatcher::handleGesture(FlowEngine &engine,
+                                      const Command &command) {
+  const auto &points = command.points;
+  if (command.target == "XY") {
+    engine.addXYGesture(command.t0, points.values.data(), points.size);
+  } else if (command.target == "SLOT_VOLUME") {
+    engine.addSlotVolumeGesture(command.slot, command.t0, points.values.data(),
+                                points.size);
+  } else if (command.target == "INPUT_GAIN") {
+    engine.addInputGainGesture(command.t0, points.values.data(), points.size);
+  }
+}
+
 void CommandDispatcher::handleSetLoopLength(FlowEngine &engine, int bars) {
   engine.setLoopLength(bars);
 }
@@ -1,21 +1,72 @@
 #pragma once
 #include "../shared/protocol/schema.h"
 #include <JuceHeader.h>
+#include <array>
+#include <optional>
 
 namespace flowzone {
 
 class FlowEngine; // Forward declaration
 
+/**
+ * The flat numbers of a GESTURE command's points: [dtMs, value] pairs, or
+ * [dtMs, x, y] triples for the XY pad. Held inline so that parsing one on
+ * the audio thread doesn't allocate; values past kCapacity are dropped.
+ */
+struct GesturePoints {
+  static constexpr int kCapacity = 192; // Whole pairs and triples
+  std::array<float, kCapacity> values{};
+  int size = 0;
+};
+
+/**
+ * One client command with every parameter any command takes. Parsed in a
+ * single pass against the schema in CommandDispatcher.cpp; parameters the
+ * command didn't send keep their defaults.
+ */
+struct Command {
+  juce::String cmd;
+  std::optional<double> bpm;
+  juce::String category;
+  juce::String preset;
+  juce::String riffId;
+  int pad = 0;
+  float val = 0.0f;
+  float x = 0.0f;
+  float y = 0.0f;
+  int bars = 0;
+  int index = 0;
+  int slot = 0;
+  float volume = 0.0f;
+  juce::String sessionId;
+  juce::String name;
+  juce::String emoji;
+  int offset = 0;
+  int limit = 0;
+  std::optional<int64_t> requestId;
+  juce::String target;
+  double t0 = 0.0;
+  GesturePoints points;
+};
+
 // bd-14c: Command Dispatcher
 class CommandDispatcher {
 public:
   CommandDispatcher();
   ~CommandDispatcher();
 
-  // Parse JSON command and dispatch to Engine
+  // Parse a JSON command, or a batch frame (an array of commands, run in
+  // order), and dispatch it to the engine
+  void dispatch(const char *json, size_t size, FlowEngine &engine);
   void dispatch(const juce::String &jsonCommand, FlowEngine &engine);
 
+  // Returns false if jsonCommand isn't a JSON object
+  static bool parse(const char *json, size_t size, Command &command);
+  static bool parse(const juce::String &jsonCommand, Command &command);
+
 private:
+  void execute(const Command &command, FlowEngine &engine);
+
   void handlePlay(FlowEngine &engine);
   void handlePause(FlowEngine &engine);
   void handleTogglePlay(FlowEngine &engine);
@@ -28,6 +79,7 @@ private:
   void handleNoteOn(FlowEngine &engine, int pad, float velocity);
   void handleNoteOff(FlowEngine &engine, int pad);
   void handleXYChange(FlowEngine &engine, float x, float y);
+  void handleGesture(FlowEngine &engine, const Command &command);
   void handleSetLoopLength(FlowEngine &engine, int bars);
   void handleSetSlotMuted(FlowEngine &engine, int index, bool muted);
   void handleSetSlotVolume(FlowEngine &engine, int index, float volume);
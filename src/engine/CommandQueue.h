@@ -1,68 +1,110 @@
 #pragma once
 #include <JuceHeader.h>
-#include <array>
+#include <atomic>
+#include <cstring>
+#include <string_view>
+#include <vector>
 
 namespace flowzone {
 
-// Fixed size command structure for lock-free queue
-struct QueuedCommand {
-  static constexpr size_t kMaxCmdSize = 512;
-  std::array<char, kMaxCmdSize> payload;
+/**
+ * Client commands on their way to the audio thread, stored as
+ * variable-length records ([uint32 size][bytes]) in one byte ring. A batch
+ * frame of many commands is a single push of its actual size, and nothing
+ * is truncated.
+ *
+ * Every client socket has its own network thread, so producers serialise
+ * on a spin lock around the copy; the consumer (the audio thread) never
+ * waits on it.
+ */
+class CommandQueue {
+public:
+  static constexpr int kCapacityBytes = 256 * 1024;
+  static constexpr int kMaxCommandBytes = 16 * 1024;
 
-  void set(const juce::String &str) {
-    // Copy string to buffer, truncating if necessary
-    size_t len = std::min(static_cast<size_t>(str.length()), kMaxCmdSize - 1);
-    std::memcpy(payload.data(), str.toRawUTF8(), len);
-    payload[len] = '\0';
-  }
+  CommandQueue() : fifo(kCapacityBytes), buffer((size_t)kCapacityBytes) {}
 
-  juce::String get() const { return juce::String::fromUTF8(payload.data()); }
-};
+  // Any non-audio thread. False if the ring is full or the command larger
+  // than kMaxCommandBytes.
+  bool push(const char *data, size_t size) {
+    if (size > (size_t)kMaxCommandBytes)
+      return false;
 
-class CommandQueue {
-public:
-  CommandQueue() : fifo(1024) { // Increased buffer size
-    // Initialize buffer
-    for (auto &cmd : buffer) {
-      cmd.payload[0] = '\0';
-    }
+    auto length = (uint32_t)size;
+    int total = (int)(sizeof(length) + size);
+    const juce::SpinLock::ScopedLockType lock(pushLock);
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(total, start1, size1, start2, size2);
+    if (size1 + size2 < total)
+      return false; // Full
+
+    copyIn(start1, &length, (int)sizeof(length));
+    copyIn(wrap(start1 + (int)sizeof(length)), data, (int)size);
+    numReady.fetch_add(1, std::memory_order_relaxed); // Before it can be popped
+    fifo.finishedWrite(total);
+    return true;
+  }
+
+  bool push(std::string_view command) {
+    return push(command.data(), command.size());
   }
 
-  // Single Producer (Message Thread / Network Thread)
   bool push(const juce::String &command) {
+    return push(command.toRawUTF8(), command.getNumBytesAsUTF8());
+  }
+
+  // Audio thread. Copies the next command into dest, which must hold
+  // kMaxCommandBytes; returns its size, or -1 if the queue is empty.
+  int pop(char *dest) {
+    uint32_t length = 0;
     int start1, size1, start2, size2;
-    fifo.prepareToWrite(1, start1, size1, start2, size2);
-    if (size1 + size2 > 0) {
-      if (size1 > 0)
-        buffer[start1].set(command);
-      else
-        buffer[start2].set(command);
-
-      fifo.finishedWrite(1);
-      return true;
-    }
-    return false; // Full
+    fifo.prepareToRead((int)sizeof(length), start1, size1, start2, size2);
+    if (size1 + size2 < (int)sizeof(length))
+      return -1; // Empty
+
+    // Records are published whole, so the payload is there too
+    copyOut(start1, &length, (int)sizeof(length));
+    copyOut(wrap(start1 + (int)sizeof(length)), dest, (int)length);
+    fifo.finishedRead((int)(sizeof(length) + length));
+    numReady.fetch_sub(1, std::memory_order_relaxed);
+    return (int)length;
   }
 
-  // Single Consumer (Audio Thread)
   bool pop(juce::String &command) {
-    int start1, size1, start2, size2;
-    fifo.prepareToRead(1, start1, size1, start2, size2);
-    if (size1 + size2 > 0) {
-      if (size1 > 0)
-        command = buffer[start1].get();
-      else
-        command = buffer[start2].get();
-
-      fifo.finishedRead(1);
-      return true;
-    }
-    return false; // Empty
+    std::vector<char> scratch((size_t)kMaxCommandBytes);
+    int size = pop(scratch.data());
+    if (size < 0)
+      return false;
+    command = juce::String::fromUTF8(scratch.data(), size);
+    return true;
   }
 
+  // Commands waiting; any thread
+  int getNumReady() const { return numReady.load(std::memory_order_relaxed); }
+
 private:
   juce::AbstractFifo fifo;
-  std::array<QueuedCommand, 1024> buffer;
+  std::vector<char> buffer;
+  juce::SpinLock pushLock;
+  std::atomic<int> numReady{0};
+
+  static int wrap(int index) { return index % kCapacityBytes; }
+
+  // Ring copies starting at index, continuing at the front when they
+  // reach the end
+  void copyIn(int index, const void *source, int size) {
+    int first = std::min(size, kCapacityBytes - index);
+    std::memcpy(buffer.data() + index, source, (size_t)first);
+    std::memcpy(buffer.data(), static_cast<const char *>(source) + first,
+                (size_t)(size - first));
+  }
+
+  void copyOut(int index, void *dest, int size) const {
+    int first = std::min(size, kCapacityBytes - index);
+    std::memcpy(dest, buffer.data() + index, (size_t)first);
+    std::memcpy(static_cast<char *>(dest) + first, buffer.data(),
+                (size_t)(size - first));
+  }
 };
 
 } // namespace flowzone
@@ -1,4 +1,5 @@
 #include "DiskWriter.h"
+#include "Metrics.h"
 
 namespace flowzone {
 
@@ -9,25 +10,58 @@ DiskWriter::DiskWriter() : juce::Thread("DiskWriterThread"), fifo(48000 * 10) {
 DiskWriter::~DiskWriter() {
   stopRecording();
   stopThread(4000);
+
+  // Thread may exit before it notices the stop; write out what's buffered,
+  // as run() would have, and don't leave a bare journal
+  {
+    const juce::ScopedLock sl(writerLock);
+    if (writer || journal.isActive()) {
+      drainFifo();
+      flushOverflowBlocks();
+      finishRecording();
+    }
+  }
+
+  // Quitting doesn't wait for a long take to copy: a stitch still running
+  // after this is abandoned between segments, and it and any queued ones
+  // are left journalled for recoverInterrupted() on the next launch
+  if (!stitcher.removeAllJobs(true, kStitchWaitOnQuitMs))
+    DBG("DiskWriter: Stitches left to recovery");
 }
 
 void DiskWriter::prepareToPlay(double sr, int samplesPerBlock) {
   sampleRate = sr;
   // Resize FIFO buffer to handle max channels (stereo) + duration
-  fifoBuffer.setSize(2, 48000 * 10);
-  fifo.setTotalSize(48000 * 10);
+  fifoBuffer.setSize(2, fifoSamples);
+  fifo.setTotalSize(fifoSamples);
   fifo.reset();
 }
 
+void DiskWriter::setBudgets(int newFifoSamples, size_t newMaxOverflowBytes) {
+  const juce::ScopedLock sl(writerLock);
+  fifoSamples = juce::jmax(1024, newFifoSamples);
+  maxOverflowBytes = newMaxOverflowBytes;
+}
+
+void DiskWriter::setStreamFactory(RecordingJournal::StreamFactory factory) {
+  const juce::ScopedLock sl(writerLock);
+  streamFactory = factory;
+  journal.setStreamFactory(std::move(factory));
+}
+
 bool DiskWriter::startRecording(const juce::File &file) {
   const juce::ScopedLock sl(writerLock);
   
   stopRecording();
 
   // Reset tier system
+  emergencyPending.store(false);
   currentTier.store(Tier::Normal);
   fillPercent.store(0.0f);
   overflowBytesUsed.store(0);
+  Metrics::instance().set(Metrics::Gauge::DiskTier, (double)Tier::Normal);
+  Metrics::instance().set(Metrics::Gauge::DiskBufferFill, 0.0);
+  Metrics::instance().set(Metrics::Gauge::DiskOverflowBytes, 0.0);
   {
     const juce::ScopedLock osl(overflowLock);
     overflowBlocks.clear();
@@ -36,13 +70,31 @@ bool DiskWriter::startRecording(const juce::File &file) {
   // Create directory
   file.getParentDirectory().createDirectory();
 
+  // Close out a take the disk thread hasn't finished yet
+  if (writer || journal.isActive()) {
+    drainFifo();
+    flushOverflowBlocks();
+    finishRecording();
+  }
+  fifo.reset();
+
+  // A take still stitching into the same file has its segments where this
+  // one's go. Only reusing a file name waits here.
+  while (isStitching(file))
+    juce::Thread::sleep(10);
+
   // Delete if exists
   if (file.existsAsFile())
     file.deleteFile();
 
-  juce::WavAudioFormat wavFormat;
-  writer.reset(wavFormat.createWriterFor(new juce::FileOutputStream(file),
-                                         sampleRate, 2, 24, {}, 0));
+  if (!journal.begin(file, sampleRate, 2, 24))
+    return false;
+
+  segmentIndex = 0;
+  samplesInSegment = 0;
+  samplesPerSegment = std::max<juce::int64>(
+      1, (juce::int64)(sampleRate * RecordingJournal::kSegmentSeconds));
+  writer = journal.createSegmentWriter(segmentIndex);
 
   if (writer) {
     currentFile = file;
@@ -104,13 +156,21 @@ void DiskWriter::updateTierStatus() {
   float percent = (float)numReady / (float)totalSize * 100.0f;
   
   fillPercent.store(percent);
+  Metrics::instance().set(Metrics::Gauge::DiskBufferFill, percent / 100.0f);
   
   Tier oldTier = currentTier.load();
   Tier newTier = oldTier;
+
+  // Critical ends the take; only startRecording() clears it
+  if (oldTier == Tier::Critical)
+    return;
   
   size_t overflow = overflowBytesUsed.load();
+  Metrics::instance().set(Metrics::Gauge::DiskOverflowBytes, (double)overflow);
   
-  if (overflow > MAX_OVERFLOW_BYTES) {
+  recordStats(percent, overflow);
+
+  if (overflow > maxOverflowBytes) {
     // Tier 4: Critical - emergency stop
     newTier = Tier::Critical;
   } else if (overflow > 0) {
@@ -130,7 +190,20 @@ void DiskWriter::updateTierStatus() {
 }
 
 void DiskWriter::transitionToTier(Tier newTier, const juce::String& reason) {
-  currentTier.store(newTier);
+  Tier oldTier = currentTier.exchange(newTier);
+  Metrics::instance().set(Metrics::Gauge::DiskTier, (double)newTier);
+
+  // Recovery time: how long each excursion above Tier 1 lasted
+  auto nowMs = juce::Time::getMillisecondCounterHiRes();
+  if (oldTier == Tier::Normal && newTier != Tier::Normal) {
+    leftNormalAtMs.store(nowMs);
+    excursions.fetch_add(1);
+  } else if (oldTier != Tier::Normal && newTier == Tier::Normal) {
+    auto recoveryMs = nowMs - leftNormalAtMs.load();
+    lastRecoveryMs.store(recoveryMs);
+    if (recoveryMs > maxRecoveryMs.load())
+      maxRecoveryMs.store(recoveryMs);
+  }
   logTierTransition(newTier, fillPercent.load(), reason);
   
   // Trigger callback on message thread
@@ -142,9 +215,12 @@ void DiskWriter::transitionToTier(Tier newTier, const juce::String& reason) {
     });
   }
   
-  // Handle critical tier
+  // Handle critical tier: stop taking audio now, but leave the flush to the
+  // disk thread so the audio thread never waits on I/O
   if (newTier == Tier::Critical) {
-    emergencyFlushAndStop();
+    recording.store(false);
+    emergencyPending.store(true);
+    notify();
   }
 }
 
@@ -183,20 +259,24 @@ void DiskWriter::allocateOverflowBlock(const juce::AudioBuffer<float> &buffer) {
 }
 
 void DiskWriter::flushOverflowBlocks() {
-  const juce::ScopedLock sl(overflowLock);
-  
-  if (!writer || overflowBlocks.empty())
-    return;
-  
-  while (!overflowBlocks.empty()) {
-    auto& block = overflowBlocks.front();
-    
-    writer->writeFromAudioSampleBuffer(block, 0, block.getNumSamples());
-    
+  while (writer && !emergencyPending.load()) {
+    juce::AudioBuffer<float> block;
+
+    // Only hold the lock to take a block: writeBlock() needs it to append,
+    // and the audio thread must never wait on disk I/O
+    {
+      const juce::ScopedLock sl(overflowLock);
+      if (overflowBlocks.empty())
+        return;
+
+      block = std::move(overflowBlocks.front());
+      overflowBlocks.pop_front();
+    }
+
+    writeToSegment(block, 0, block.getNumSamples());
+
     size_t bytes = block.getNumChannels() * block.getNumSamples() * sizeof(float);
     overflowBytesUsed.fetch_sub(bytes);
-    
-    overflowBlocks.pop_front();
   }
 }
 
@@ -207,17 +287,24 @@ void DiskWriter::emergencyFlushAndStop() {
   try {
     const juce::ScopedLock sl(writerLock);
     
-    if (writer) {
-      // Close current writer
-      writer.reset();
+    if (writer || journal.isActive()) {
+      // Close current segment and stitch what made it to disk
+      finishRecording();
       
       // Create emergency FLAC writer for remaining data
       juce::File emergencyFile = currentFile.withFileExtension(".emergency.flac");
       
       juce::FlacAudioFormat flacFormat;
+      std::unique_ptr<juce::OutputStream> stream;
+      if (streamFactory)
+        stream = streamFactory(emergencyFile);
+      else
+        stream = std::make_unique<juce::FileOutputStream>(emergencyFile);
+
       auto flacWriter = std::unique_ptr<juce::AudioFormatWriter>(
-          flacFormat.createWriterFor(new juce::FileOutputStream(emergencyFile),
-                                    sampleRate, 2, 24, {}, 0));
+          flacFormat.createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+      if (flacWriter)
+        stream.release(); // Writer owns the stream now
       
       if (flacWriter) {
         // Flush overflow blocks to FLAC
@@ -239,6 +326,38 @@ void DiskWriter::emergencyFlushAndStop() {
   recording.store(false);
 }
 
+void DiskWriter::recordStats(float percent, size_t overflow) {
+  float prevFill = maxFillPercent.load();
+  while (percent > prevFill &&
+         !maxFillPercent.compare_exchange_weak(prevFill, percent)) {
+  }
+
+  size_t prevOverflow = peakOverflowBytes.load();
+  while (overflow > prevOverflow &&
+         !peakOverflowBytes.compare_exchange_weak(prevOverflow, overflow)) {
+  }
+}
+
+DiskWriter::Stats DiskWriter::getStats() const {
+  Stats stats;
+  stats.maxFillPercent = maxFillPercent.load();
+  stats.peakOverflowBytes = peakOverflowBytes.load();
+  stats.excursions = excursions.load();
+  stats.lastRecoveryMs = lastRecoveryMs.load();
+  stats.maxRecoveryMs = maxRecoveryMs.load();
+  stats.writeFailures = writeFailures.load();
+  return stats;
+}
+
+void DiskWriter::resetStats() {
+  maxFillPercent.store(0.0f);
+  peakOverflowBytes.store(0);
+  excursions.store(0);
+  lastRecoveryMs.store(0.0);
+  maxRecoveryMs.store(0.0);
+  writeFailures.store(0);
+}
+
 DiskWriter::TierStatus DiskWriter::getTierStatus() const {
   TierStatus status;
   status.currentTier = currentTier.load();
@@ -266,6 +385,13 @@ DiskWriter::TierStatus DiskWriter::getTierStatus() const {
 
 void DiskWriter::run() {
   while (!threadShouldExit()) {
+    if (emergencyPending.load()) {
+      const juce::ScopedLock sl(writerLock);
+      emergencyFlushAndStop();
+      emergencyPending.store(false);
+      continue;
+    }
+
     if (recording.load() && writer) {
       const juce::ScopedLock sl(writerLock);
       
@@ -275,19 +401,7 @@ void DiskWriter::run() {
       }
       
       // Then process ring buffer
-      int numReady = fifo.getNumReady();
-      if (numReady > 0) {
-        int start1, block1, start2, block2;
-        fifo.prepareToRead(numReady, start1, block1, start2, block2);
-
-        if (block1 > 0) {
-          writer->writeFromAudioSampleBuffer(fifoBuffer, start1, block1);
-        }
-        if (block2 > 0) {
-          writer->writeFromAudioSampleBuffer(fifoBuffer, start2, block2);
-        }
-
-        fifo.finishedRead(block1 + block2);
+      if (drainFifo() > 0) {
         updateTierStatus();
       } else {
         wait(10); // Sleep if no data
@@ -295,14 +409,113 @@ void DiskWriter::run() {
     } else {
       wait(100);
 
-      // If we stopped recording, close writer
-      if (!recording.load() && writer) {
+      // If we stopped recording, write out what's buffered and close
+      if (!recording.load() && writer && !emergencyPending.load()) {
         const juce::ScopedLock sl(writerLock);
-        writer.reset(); // Close file
+        drainFifo();
+        flushOverflowBlocks();
+        finishRecording(); // Close last segment, queue the stitch
         logTierTransition(Tier::Normal, 0.0f, "Recording stopped");
       }
     }
   }
 }
 
+int DiskWriter::drainFifo() {
+  int numReady = fifo.getNumReady();
+  if (numReady <= 0)
+    return 0;
+
+  int start1, block1, start2, block2;
+  fifo.prepareToRead(numReady, start1, block1, start2, block2);
+
+  if (block1 > 0) {
+    writeToSegment(fifoBuffer, start1, block1);
+  }
+  if (block2 > 0) {
+    writeToSegment(fifoBuffer, start2, block2);
+  }
+
+  fifo.finishedRead(block1 + block2);
+  return block1 + block2;
+}
+
+void DiskWriter::writeToSegment(const juce::AudioBuffer<float> &source,
+                                int startSample, int numSamples) {
+  // Split exactly at segment boundaries so every segment is kSegmentSeconds
+  while (numSamples > 0 && writer && !emergencyPending.load()) {
+    int chunk = (int)std::min<juce::int64>(
+        numSamples, samplesPerSegment - samplesInSegment);
+
+    if (!writer->writeFromAudioSampleBuffer(source, startSample, chunk)) {
+      // Disk full or device gone: nothing more will land, so go critical
+      writeFailures.fetch_add(1);
+      Metrics::instance().add(Metrics::Counter::DiskWriteFailures);
+      transitionToTier(Tier::Critical, "Disk write failed");
+      return;
+    }
+
+    samplesInSegment += chunk;
+    startSample += chunk;
+    numSamples -= chunk;
+
+    if (samplesInSegment >= samplesPerSegment) {
+      commitCurrentSegment();
+      writer = journal.createSegmentWriter(++segmentIndex);
+
+      if (!writer) {
+        writeFailures.fetch_add(1);
+        Metrics::instance().add(Metrics::Counter::DiskWriteFailures);
+        transitionToTier(Tier::Critical, "Could not open next segment");
+        return;
+      }
+    }
+  }
+}
+
+void DiskWriter::commitCurrentSegment() {
+  if (!writer)
+    return;
+
+  writer.reset(); // Header fixup happens here, off the audio thread
+
+  if (samplesInSegment > 0)
+    journal.commitSegment(segmentIndex, samplesInSegment);
+
+  samplesInSegment = 0;
+}
+
+void DiskWriter::finishRecording() {
+  commitCurrentSegment();
+
+  if (journal.isActive())
+    stitchInBackground(journal.close());
+}
+
+void DiskWriter::stitchInBackground(RecordingJournal::ClosedTake take) {
+  {
+    const juce::ScopedLock sl(stitchLock);
+    stitchingTargets.add(take.targetFile);
+  }
+
+  stitcher.addJob([this, take = std::move(take)] {
+    auto result = take.stitch([] {
+      auto *job = juce::ThreadPoolJob::getCurrentThreadPoolJob();
+      return job != nullptr && job->shouldExit();
+    });
+    if (result.failed()) {
+      DBG("DiskWriter: Failed to stitch segments | "
+          << result.getErrorMessage());
+    }
+
+    const juce::ScopedLock sl(stitchLock);
+    stitchingTargets.removeFirstMatchingValue(take.targetFile);
+  });
+}
+
+bool DiskWriter::isStitching(const juce::File &target) const {
+  const juce::ScopedLock sl(stitchLock);
+  return stitchingTargets.contains(target);
+}
+
 } // namespace flowzone
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "RecordingJournal.h"
 #include <JuceHeader.h>
 #include <atomic>
 #include <deque>
@@ -16,6 +17,12 @@ namespace flowzone {
  * Tier 4: Critical (>1GB overflow) - Flush partial FLAC + stop recording + ERR_DISK_CRITICAL
  * 
  * Audio playback never stops, even during disk failure
+ *
+ * Files are written as rolling 10s segments with an append-only journal
+ * (see RecordingJournal), so a crash loses at most the open segment.
+ * Stitching a finished take's segments into one file reads and writes the
+ * whole take, so it runs on a job of its own, outside writerLock: the next
+ * take can start, and the disk thread keep draining, while it runs.
  */
 class DiskWriter : public juce::Thread {
 public:
@@ -33,11 +40,28 @@ public:
     juce::String statusMessage;
   };
 
+  // Worst-case figures since the last resetStats(), for sizing budgets
+  struct Stats {
+    float maxFillPercent = 0.0f;
+    size_t peakOverflowBytes = 0;
+    int excursions = 0;         // Times recording left Tier 1
+    double lastRecoveryMs = 0.0; // Leaving Tier 1 → back to Tier 1
+    double maxRecoveryMs = 0.0;
+    juce::int64 writeFailures = 0;
+  };
+
   DiskWriter();
   ~DiskWriter() override;
 
   void prepareToPlay(double sampleRate, int samplesPerBlock);
 
+  // Ring buffer size and Tier 3 RAM budget. Call before prepareToPlay().
+  void setBudgets(int fifoSamples, size_t maxOverflowBytes);
+
+  // Route segment output through something other than the real disk
+  // (e.g. SimulatedDisk). Call before startRecording().
+  void setStreamFactory(RecordingJournal::StreamFactory factory);
+
   // Start recording to a specific file
   bool startRecording(const juce::File &file);
 
@@ -52,6 +76,9 @@ public:
   // Get current tier status
   TierStatus getTierStatus() const;
 
+  Stats getStats() const;
+  void resetStats();
+
   // Thread run loop
   void run() override;
 
@@ -60,36 +87,77 @@ public:
 
 private:
   std::atomic<bool> recording{false};
+  std::atomic<bool> emergencyPending{false}; // Tier 4 hand-off to disk thread
   std::unique_ptr<juce::AudioFormatWriter> writer;
   juce::File currentFile;
 
+  // Segmented journal (disk thread only once recording has started)
+  RecordingJournal journal;
+  int segmentIndex = 0;
+  juce::int64 samplesInSegment = 0;
+  juce::int64 samplesPerSegment = 0;
+
   // Tier tracking
   std::atomic<Tier> currentTier{Tier::Normal};
   std::atomic<float> fillPercent{0.0f};
   
   // Ring Buffer (Tier 1)
-  juce::AbstractFifo fifo{48000 * 10}; // 10 seconds buffer
+  int fifoSamples = 48000 * 10;        // 10 seconds buffer
+  juce::AbstractFifo fifo{48000 * 10};
   juce::AudioBuffer<float> fifoBuffer; // Circular buffer
 
   // Overflow RAM blocks (Tier 3)
   static constexpr size_t MAX_OVERFLOW_BYTES = 1024 * 1024 * 1024; // 1GB
+  size_t maxOverflowBytes = MAX_OVERFLOW_BYTES;
   std::deque<juce::AudioBuffer<float>> overflowBlocks;
   std::atomic<size_t> overflowBytesUsed{0};
   juce::CriticalSection overflowLock;
 
   double sampleRate = 44100.0;
   juce::CriticalSection writerLock;
+  RecordingJournal::StreamFactory streamFactory;
+
+  // Stats (lock-free: updated from the audio thread too)
+  std::atomic<float> maxFillPercent{0.0f};
+  std::atomic<size_t> peakOverflowBytes{0};
+  std::atomic<int> excursions{0};
+  std::atomic<double> leftNormalAtMs{0.0};
+  std::atomic<double> lastRecoveryMs{0.0};
+  std::atomic<double> maxRecoveryMs{0.0};
+  std::atomic<juce::int64> writeFailures{0};
 
   // Tier management
   void updateTierStatus();
   void transitionToTier(Tier newTier, const juce::String& reason);
   void logTierTransition(Tier tier, float fillPercent, const juce::String& reason);
+  void recordStats(float percent, size_t overflow);
   
   // Overflow handling
   void allocateOverflowBlock(const juce::AudioBuffer<float> &buffer);
   void flushOverflowBlocks();
   void emergencyFlushAndStop();
 
+  // Segment handling
+  int drainFifo();
+  void writeToSegment(const juce::AudioBuffer<float> &source, int startSample,
+                      int numSamples);
+  void commitCurrentSegment();
+  void finishRecording();
+
+  // Stitching of closed takes (see finishRecording())
+  static constexpr int kStitchWaitOnQuitMs = 2000;
+  juce::CriticalSection stitchLock;
+  juce::Array<juce::File> stitchingTargets;
+  void stitchInBackground(RecordingJournal::ClosedTake take);
+  bool isStitching(const juce::File &target) const;
+
+  // Last, so it goes first: its jobs use the members above
+  juce::ThreadPool stitcher{juce::ThreadPoolOptions{}
+                                .withThreadName("RecordingStitcher")
+                                .withNumberOfThreads(1)
+                                .withDesiredThreadPriority(
+                                    juce::Thread::Priority::background)};
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiskWriter)
 };
 
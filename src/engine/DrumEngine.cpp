@@ -3,42 +3,101 @@
 namespace flowzone {
 namespace engine {
 
-DrumEngine::DrumEngine() {
-  setupVoices();
+DrumEngine::DrumEngine()
+    : voices(kNumPads * kVoicesPerPad), startedAt(voices.size()),
+      voiceKits(voices.size()) {
+  activeVoices.reserve(voices.size());
+  setChokeGroup(2, 1); // The closed hi-hat cuts the open one, and back
+  setChokeGroup(3, 1);
   setKit("synthetic");
 }
 
-void DrumEngine::prepare(double sampleRate, int samplesPerBlock) {
+void DrumEngine::prepare(double newSampleRate, int samplesPerBlock) {
+  sampleRate = newSampleRate;
   for (auto &voice : voices) {
-    voice->prepare(sampleRate, samplesPerBlock);
+    voice.prepare(sampleRate, samplesPerBlock);
   }
+  cache.request(padTypes, sampleRate);
 }
 
 void DrumEngine::process(juce::AudioBuffer<float> &buffer,
                          juce::MidiBuffer &midiMessages) {
+  // Render up to each hit, then start it, so flams keep their spacing
+  const int numSamples = buffer.getNumSamples();
+  const auto *kit = cache.getKit();
+  int rendered = 0;
   for (const auto metadata : midiMessages) {
     auto msg = metadata.getMessage();
-    if (msg.isNoteOn()) {
-      int note = msg.getNoteNumber();
-      // Map MIDI notes 36-51 (Standard GM Drum notes for pad controllers) to
-      // pads 0-15
-      if (note >= 36 && note <= 51) {
-        triggerPad(note - 36, msg.getFloatVelocity());
-      }
+    if (!msg.isNoteOn())
+      continue;
+
+    int position = juce::jlimit(rendered, numSamples, metadata.samplePosition);
+    if (position > rendered) {
+      render(buffer, rendered, position - rendered);
+      rendered = position;
+    }
+
+    int note = msg.getNoteNumber();
+    // Map MIDI notes 36-51 (Standard GM Drum notes for pad controllers) to
+    // pads 0-15
+    if (note >= 36 && note <= 51) {
+      triggerPad(note - 36, msg.getFloatVelocity(), kit);
     }
   }
+  if (rendered < numSamples)
+    render(buffer, rendered, numSamples - rendered);
 
-  for (auto &voice : voices) {
-    if (voice->isActive()) {
-      voice->process(buffer, 0, buffer.getNumSamples());
+  // Let the cache free kits nothing plays from any more
+  uint64_t oldest = kit != nullptr ? kit->generation : 0;
+  for (int index : activeVoices)
+    if (uint64_t generation = voiceKits[(size_t)index]; generation > 0)
+      oldest = juce::jmin(oldest, generation);
+  cache.setOldestInUse(oldest);
+}
+
+void DrumEngine::render(juce::AudioBuffer<float> &buffer, int startSample,
+                        int numSamples) {
+  for (size_t i = 0; i < activeVoices.size();) {
+    auto &voice = voices[(size_t)activeVoices[i]];
+    voice.process(buffer, startSample, numSamples);
+
+    if (voice.isActive()) {
+      ++i;
+      continue;
     }
+    // Finished: the last one takes its place
+    activeVoices[i] = activeVoices.back();
+    activeVoices.pop_back();
   }
 }
 
 void DrumEngine::reset() {
-  for (auto &voice : voices) {
-    // No stopNote for one-shots, but we could clear active state
-  }
+  for (int index : activeVoices)
+    voices[(size_t)index].stop();
+  activeVoices.clear();
+}
+
+void DrumEngine::setPadLive(int padIndex, bool live) {
+  if (padIndex >= 0 && padIndex < kNumPads)
+    livePads[(size_t)padIndex].store(live, std::memory_order_relaxed);
+}
+
+bool DrumEngine::playsCached(const DrumHitCache::Kit *kit,
+                             int padIndex) const {
+  return kit != nullptr && kit->sampleRate == sampleRate &&
+         kit->types[(size_t)padIndex] == padTypes[(size_t)padIndex] &&
+         !livePads[(size_t)padIndex].load(std::memory_order_relaxed);
+}
+
+bool DrumEngine::isKitCached() const {
+  const auto *kit = cache.getKit();
+  return kit != nullptr && kit->sampleRate == sampleRate &&
+         kit->types == padTypes;
+}
+
+void DrumEngine::setChokeGroup(int padIndex, int group) {
+  if (padIndex >= 0 && padIndex < kNumPads)
+    chokeGroups[(size_t)padIndex] = juce::jmax(0, group);
 }
 
 void DrumEngine::setKit(const juce::String &kitName) {
@@ -62,19 +121,57 @@ void DrumEngine::setKit(const juce::String &kitName) {
   padTypes[15] = DrumVoice::Type::Perc;       // Pad 15: Perc 5
 
   juce::ignoreUnused(kitName);
+
+  if (sampleRate > 0.0)
+    cache.request(padTypes, sampleRate);
 }
 
-void DrumEngine::setupVoices() {
-  voices.clear();
-  for (int i = 0; i < numPads; ++i) {
-    voices.push_back(std::make_unique<DrumVoice>());
+void DrumEngine::triggerPad(int padIndex, float velocity,
+                            const DrumHitCache::Kit *kit) {
+  if (padIndex < 0 || padIndex >= kNumPads)
+    return;
+
+  if (int group = chokeGroups[(size_t)padIndex]; group > 0) {
+    for (int index : activeVoices) {
+      int pad = index / kVoicesPerPad;
+      if (pad != padIndex && chokeGroups[(size_t)pad] == group)
+        voices[(size_t)index].choke();
+    }
   }
-}
 
-void DrumEngine::triggerPad(int padIndex, float velocity) {
-  if (padIndex >= 0 && padIndex < numPads) {
-    voices[padIndex]->trigger(velocity, padTypes[padIndex]);
+  // The pad's voices in turn, skipping sounding ones; with none idle, the
+  // one that started first
+  const int first = padIndex * kVoicesPerPad;
+  int &next = nextVoice[(size_t)padIndex];
+  int chosen = -1, oldest = first;
+  for (int k = 0; k < kVoicesPerPad; ++k) {
+    int index = first + (next + k) % kVoicesPerPad;
+    if (!voices[(size_t)index].isActive()) {
+      chosen = index;
+      break;
+    }
+    if (startedAt[(size_t)index] < startedAt[(size_t)oldest])
+      oldest = index;
+  }
+  bool reused = chosen < 0;
+  if (reused)
+    chosen = oldest;
+
+  next = (chosen - first + 1) % kVoicesPerPad;
+  auto &voice = voices[(size_t)chosen];
+  if (playsCached(kit, padIndex)) {
+    int &take = nextTake[(size_t)padIndex];
+    take = (take + 1) % kit->numTakes[(size_t)padIndex];
+    const auto &cached = kit->takes[(size_t)padIndex][(size_t)take];
+    voice.play(kit->getSamples(cached), cached.length, velocity);
+    voiceKits[(size_t)chosen] = kit->generation;
+  } else {
+    voice.trigger(velocity, padTypes[(size_t)padIndex]);
+    voiceKits[(size_t)chosen] = 0;
   }
+  startedAt[(size_t)chosen] = ++hits;
+  if (!reused)
+    activeVoices.push_back(chosen);
 }
 
 } // namespace engine
@@ -1,18 +1,38 @@
 #pragma once
 
+#include "DrumHitCache.h"
 #include "DrumVoice.h"
 #include <JuceHeader.h>
-#include <memory>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 
 namespace flowzone {
 namespace engine {
 
 /**
- * @brief Drum Engine managing 16 voices (pads).
+ * @brief Drum Engine playing 16 pads from a preallocated pool of voices.
+ *
+ * Each pad owns kVoicesPerPad voices and takes them in turn, so a
+ * re-triggered pad rings on under the new hit; with all of them sounding
+ * the oldest (and, with linear decays, quietest) one restarts. Rolls and
+ * flams overlap naturally, but a pad never holds more than its share.
+ *
+ * Pads in the same choke group cut each other off with a short fade, as
+ * a closed hi-hat does an open one. Only the sounding voices are visited,
+ * from a compact array, and hits land at their sample position within the
+ * block.
+ *
+ * Hits normally play from a DrumHitCache of the kit, rendered in the
+ * background whenever the kit or sample rate changes; until it lands, and
+ * for pads whose synthesis is being modulated, voices synthesise live.
  */
 class DrumEngine {
 public:
+  static constexpr int kNumPads = DrumHitCache::kNumPads;
+  static constexpr int kVoicesPerPad = 4;
+
   DrumEngine();
 
   void prepare(double sampleRate, int samplesPerBlock);
@@ -20,16 +40,42 @@ public:
                juce::MidiBuffer &midiMessages);
   void reset();
 
+  // Called from the audio thread when a command changes the kit; the new
+  // kit renders in the background
   void setKit(const juce::String &kitName);
 
+  // Group 0 is no group. Pads 2 and 3 (closed and open hi-hat) share
+  // group 1 by default.
+  void setChokeGroup(int padIndex, int group);
+
+  // While a pad's sound is being modulated its cached hits are stale, so
+  // it synthesises live. Safe from any thread.
+  void setPadLive(int padIndex, bool live);
+
+  // Whether hits play from the cache yet (not counting live pads)
+  bool isKitCached() const;
+
+  int getNumActiveVoices() const { return (int)activeVoices.size(); }
+
 private:
-  std::vector<std::unique_ptr<DrumVoice>> voices;
-  int numPads = 16;
+  std::vector<DrumVoice> voices; // Pad-major: kVoicesPerPad per pad
+  std::vector<uint64_t> startedAt; // By voice, for oldest-first reuse
+  std::vector<int> activeVoices;   // Sounding voice indices, unordered
+  std::vector<uint64_t> voiceKits; // By voice: cached kit played, 0 if live
+  uint64_t hits = 0;
 
-  DrumVoice::Type padTypes[16];
+  double sampleRate = 0.0;
+  DrumHitCache::PadTypes padTypes;
+  DrumHitCache cache;
+  std::array<int, kNumPads> nextVoice{}; // Round-robin position per pad
+  std::array<int, kNumPads> nextTake{};
+  std::array<int, kNumPads> chokeGroups{};
+  std::array<std::atomic<bool>, kNumPads> livePads{};
 
-  void setupVoices();
-  void triggerPad(int padIndex, float velocity);
+  bool playsCached(const DrumHitCache::Kit *kit, int padIndex) const;
+  void triggerPad(int padIndex, float velocity, const DrumHitCache::Kit *kit);
+  void render(juce::AudioBuffer<float> &buffer, int startSample,
+              int numSamples);
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DrumEngine)
 };
@@ -0,0 +1,151 @@
+#include "DrumHitCache.h"
+#include <algorithm>
+#include <utility>
+
+namespace flowzone {
+namespace engine {
+
+namespace {
+constexpr int kRenderBlockSize = 512;
+
+static_assert((int)DrumVoice::Type::Clave < 16,
+              "pad types are packed 4 bits each");
+
+uint64_t packTypes(const DrumHitCache::PadTypes &types) {
+  uint64_t packed = 0;
+  for (size_t pad = 0; pad < types.size(); ++pad)
+    packed |= (uint64_t)types[pad] << (pad * 4);
+  return packed;
+}
+
+DrumHitCache::PadTypes unpackTypes(uint64_t packed) {
+  DrumHitCache::PadTypes types;
+  for (size_t pad = 0; pad < types.size(); ++pad)
+    types[pad] = (DrumVoice::Type)((packed >> (pad * 4)) & 0xf);
+  return types;
+}
+} // namespace
+
+// Running from the start, so request() never has to start it
+DrumHitCache::DrumHitCache() : juce::Thread("DrumHitCache") {
+  startThread(juce::Thread::Priority::background);
+}
+
+DrumHitCache::~DrumHitCache() { stopThread(4000); }
+
+bool DrumHitCache::isNoisy(DrumVoice::Type type) {
+  return type != DrumVoice::Type::Kick && type != DrumVoice::Type::Cowbell &&
+         type != DrumVoice::Type::Clave;
+}
+
+void DrumHitCache::request(const PadTypes &types, double sampleRate) {
+  const uint64_t packed = packTypes(types);
+  const uint64_t serial = requestSerial.load();
+  if (serial > 0 && requestedTypes.load() == packed &&
+      requestedRate.load() == sampleRate)
+    return;
+
+  requestSerial.store(serial + 1);
+  requestedTypes.store(packed);
+  requestedRate.store(sampleRate);
+  requestSerial.store(serial + 2);
+  notify();
+}
+
+// The serial of the request read, 0 if there hasn't been one
+uint64_t DrumHitCache::readRequest(PadTypes &types, double &sampleRate) const {
+  for (;;) {
+    const uint64_t serial = requestSerial.load();
+    if (serial & 1) {
+      juce::Thread::yield(); // request() is part way through
+      continue;
+    }
+    const uint64_t packed = requestedTypes.load();
+    sampleRate = requestedRate.load();
+    if (requestSerial.load() == serial) {
+      types = unpackTypes(packed);
+      return serial;
+    }
+  }
+}
+
+void DrumHitCache::run() {
+  while (!threadShouldExit()) {
+    PadTypes types;
+    double sampleRate;
+    const uint64_t serial = readRequest(types, sampleRate);
+    if (serial == renderingSerial) {
+      wait(-1);
+      continue;
+    }
+
+    renderingSerial = serial;
+    if (auto newKit = render(types, sampleRate))
+      publish(std::move(newKit));
+  }
+}
+
+std::unique_ptr<DrumHitCache::Kit>
+DrumHitCache::render(const PadTypes &types, double sampleRate) {
+  auto newKit = std::make_unique<Kit>();
+  newKit->sampleRate = sampleRate;
+  newKit->types = types;
+
+  for (int pad = 0; pad < kNumPads; ++pad) {
+    // Give up on it as soon as it's out of date
+    if (requestSerial.load() != renderingSerial || threadShouldExit())
+      return nullptr;
+
+    auto type = types[(size_t)pad];
+    int numTakes = isNoisy(type) ? kNoiseTakes : 1;
+    newKit->numTakes[(size_t)pad] = numTakes;
+    for (int t = 0; t < numTakes; ++t) {
+      auto &take = newKit->takes[(size_t)pad][(size_t)t];
+      take.offset = (int)newKit->samples.size();
+      renderTake(type, sampleRate, newKit->samples);
+      take.length = (int)newKit->samples.size() - take.offset;
+    }
+  }
+  return newKit;
+}
+
+void DrumHitCache::renderTake(DrumVoice::Type type, double sampleRate,
+                              std::vector<float> &samples) {
+  DrumVoice voice;
+  voice.prepare(sampleRate, kRenderBlockSize);
+  voice.trigger(1.0f, type);
+
+  const size_t start = samples.size();
+  juce::AudioBuffer<float> block(1, kRenderBlockSize);
+  while (voice.isActive()) {
+    block.clear();
+    voice.process(block, 0, kRenderBlockSize);
+    const float *rendered = block.getReadPointer(0);
+    samples.insert(samples.end(), rendered, rendered + kRenderBlockSize);
+  }
+
+  // The last block runs on past the hit's end
+  while (samples.size() > start && samples.back() == 0.0f)
+    samples.pop_back();
+}
+
+void DrumHitCache::publish(std::unique_ptr<Kit> newKit) {
+  newKit->generation = ++generations;
+  const Kit *published = newKit.get();
+  kits.push_back(std::move(newKit));
+  kit.store(published, std::memory_order_release);
+
+  // Free what the audio thread has moved past. It reports after each
+  // block, so anything older than its last report is out of reach: it only
+  // ever picks up newer kits.
+  const uint64_t oldest = oldestInUse.load(std::memory_order_acquire);
+  kits.erase(std::remove_if(kits.begin(), kits.end(),
+                            [&](const std::unique_ptr<Kit> &k) {
+                              return k->generation < oldest &&
+                                     k.get() != published;
+                            }),
+             kits.end());
+}
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "DrumVoice.h"
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief Pre-rendered hits for every pad of a kit, so playing one is a copy.
+ *
+ * A synthetic kit's hits are the same every time but for their level:
+ * DrumVoice applies velocity as a gain on an otherwise fixed sound. So each
+ * pad is rendered once, at full velocity and the engine's sample rate, and
+ * played back scaled. Pads with noise in them get a few takes, each with
+ * its own noise, played in turn so repeated hits don't sound identical.
+ * Every take of every pad lies end to end in one block of samples.
+ *
+ * Kits render on a background thread and are published with one atomic
+ * pointer store, as TuningManager does its tables. Requests come the other
+ * way through atomics, since kit changes arrive as commands on the audio
+ * thread. The audio thread reports the oldest kit its voices still read
+ * (setOldestInUse()), and older ones are freed on the next publish.
+ */
+class DrumHitCache : private juce::Thread {
+public:
+  static constexpr int kNumPads = 16;
+  static constexpr int kNoiseTakes = 4;
+
+  using PadTypes = std::array<DrumVoice::Type, kNumPads>;
+
+  struct Take {
+    int offset = 0, length = 0; // Into Kit::samples
+  };
+
+  struct Kit {
+    uint64_t generation = 0;
+    double sampleRate = 0.0;
+    PadTypes types{};
+    std::array<int, kNumPads> numTakes{};
+    std::array<std::array<Take, kNoiseTakes>, kNumPads> takes{};
+    std::vector<float> samples;
+
+    const float *getSamples(const Take &take) const {
+      return samples.data() + take.offset;
+    }
+  };
+
+  DrumHitCache();
+  ~DrumHitCache() override;
+
+  // Renders types at sampleRate in the background, unless that's the kit
+  // last asked for. Doesn't lock or allocate, so the audio thread can call
+  // it; calls must not overlap (the audio thread, or another while that
+  // isn't running).
+  void request(const PadTypes &types, double sampleRate);
+
+  // The latest kit, or null before the first is ready. Audio thread.
+  const Kit *getKit() const { return kit.load(std::memory_order_acquire); }
+
+  // Audio thread: no voice reads a kit older than generation any more
+  void setOldestInUse(uint64_t generation) {
+    oldestInUse.store(generation, std::memory_order_release);
+  }
+
+  static bool isNoisy(DrumVoice::Type type);
+
+private:
+  // The latest request, pad types packed 4 bits each. requestSerial is odd
+  // while request() writes them and moves on by 2 per request, so the
+  // render thread can tell a torn read and a newer request.
+  std::atomic<uint64_t> requestedTypes{0};
+  std::atomic<double> requestedRate{0.0};
+  std::atomic<uint64_t> requestSerial{0};
+
+  // Background thread only
+  uint64_t renderingSerial = 0;
+  std::vector<std::unique_ptr<Kit>> kits;
+  uint64_t generations = 0;
+
+  std::atomic<const Kit *> kit{nullptr};
+  std::atomic<uint64_t> oldestInUse{0};
+
+  void run() override;
+  uint64_t readRequest(PadTypes &types, double &sampleRate) const;
+
+  // Null if a newer request came in while it rendered
+  std::unique_ptr<Kit> render(const PadTypes &types, double sampleRate);
+  void renderTake(DrumVoice::Type type, double sampleRate,
+                  std::vector<float> &samples);
+  void publish(std::unique_ptr<Kit> newKit);
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DrumHitCache)
+};
+
+} // namespace engine
+} // namespace flowzone
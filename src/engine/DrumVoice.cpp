@@ -1,4 +1,5 @@
 #include "DrumVoice.h"
+#include <algorithm>
 #include <cmath>
 
 namespace flowzone {
@@ -13,6 +14,7 @@ void DrumVoice::prepare(double sampleRate, int samplesPerBlock) {
 
 void DrumVoice::trigger(float velocity, Type type) {
   active = true;
+  cached = nullptr;
   currentType = type;
   level = velocity;
   phase = 0.0f;
@@ -78,11 +80,33 @@ void DrumVoice::trigger(float velocity, Type type) {
   }
 }
 
+void DrumVoice::play(const float *samples, int length, float velocity) {
+  active = length > 0;
+  cached = samples;
+  cachedLength = length;
+  cachedPosition = 0;
+  level = velocity;
+  envValue = 1.0f; // The hit's own envelope is in the samples; this fades
+  envDelta = 0.0f; // it out if choked
+}
+
+void DrumVoice::choke() {
+  if (!active)
+    return;
+  envDelta = std::max(envDelta,
+                      envValue / (float)(currentSampleRate * kChokeSeconds));
+}
+
 void DrumVoice::process(juce::AudioBuffer<float> &buffer, int startSample,
                         int numSamples) {
   if (!active)
     return;
 
+  if (cached != nullptr) {
+    processCached(buffer, startSample, numSamples);
+    return;
+  }
+
   switch (currentType) {
   case Type::Kick:
     processKick(buffer, startSample, numSamples);
@@ -123,6 +147,34 @@ void DrumVoice::process(juce::AudioBuffer<float> &buffer, int startSample,
     active = false;
 }
 
+void DrumVoice::processCached(juce::AudioBuffer<float> &buffer, int start,
+                              int n) {
+  n = std::min(n, cachedLength - cachedPosition);
+  const float *samples = cached + cachedPosition;
+  cachedPosition += n;
+
+  if (envDelta == 0.0f) {
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+      juce::FloatVectorOperations::addWithMultiply(
+          buffer.getWritePointer(ch, start), samples, level, n);
+  } else {
+    // Choked
+    for (int i = 0; i < n; ++i) {
+      float s = samples[i] * envValue * level;
+
+      for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        buffer.addSample(ch, start + i, s);
+
+      envValue -= envDelta;
+      if (envValue <= 0)
+        break;
+    }
+  }
+
+  if (cachedPosition >= cachedLength || envValue <= 0.0f)
+    active = false;
+}
+
 void DrumVoice::processKick(juce::AudioBuffer<float> &buffer, int start,
                             int n) {
   for (int i = 0; i < n; ++i) {
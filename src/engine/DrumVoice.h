@@ -17,10 +17,20 @@ public:
 
   void prepare(double sampleRate, int samplesPerBlock);
   void trigger(float velocity, Type type);
+
+  // Plays a hit rendered ahead of time (DrumHitCache) at velocity's gain
+  // instead of synthesising one. samples must outlive the hit.
+  void play(const float *samples, int length, float velocity);
   void process(juce::AudioBuffer<float> &buffer, int startSample,
                int numSamples);
   bool isActive() const { return active; }
 
+  // Fades out over kChokeSeconds (or sooner if it was ending anyway)
+  void choke();
+  void stop() { active = false; }
+
+  static constexpr float kChokeSeconds = 0.005f;
+
 private:
   double currentSampleRate = 44100.0;
   bool active = false;
@@ -38,6 +48,12 @@ private:
 
   juce::Random random;
 
+  // Pre-rendered hit being played, or null when synthesising
+  const float *cached = nullptr;
+  int cachedLength = 0;
+  int cachedPosition = 0;
+
+  void processCached(juce::AudioBuffer<float> &buffer, int start, int n);
   void processKick(juce::AudioBuffer<float> &buffer, int start, int n);
   void processSnare(juce::AudioBuffer<float> &buffer, int start, int n);
   void processHihat(juce::AudioBuffer<float> &buffer, int start, int n);
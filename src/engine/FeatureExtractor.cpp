@@ -17,7 +17,27 @@ void FeatureExtractor::prepare(double sampleRate, int samplesPerBlock) {
   ringBuffer.setSize(2, ringBufferSize);
   ringBuffer.clear();
   writePos = 0;
-  
+
+  // Hann window and log-spaced band edges (40 Hz .. 16 kHz) in FFT bins
+  for (int i = 0; i < kFftSize; ++i)
+    fftWindow[(size_t)i] =
+        0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float)i /
+                               (float)(kFftSize - 1));
+
+  const float binHz = (float)sampleRate / (float)kFftSize;
+  const float lowHz = 40.0f;
+  const float highHz = std::min(16000.0f, (float)sampleRate * 0.5f);
+  int lastBin = 0;
+  for (int b = 0; b <= kSpectrumBands; ++b) {
+    float hz = lowHz * std::pow(highHz / lowHz, (float)b / kSpectrumBands);
+    int bin = juce::jlimit(lastBin + 1, kFftSize / 2,
+                           (int)std::round(hz / binHz));
+    bandEdges[(size_t)b] = bin;
+    lastBin = bin;
+  }
+
+  fftFill = 0;
+
   juce::ignoreUnused(samplesPerBlock);
 }
 
@@ -87,6 +107,75 @@ std::vector<float> FeatureExtractor::getDownsampledWaveform(int targetSize) {
   return result;
 }
 
+void FeatureExtractor::pushMasterBlock(const juce::AudioBuffer<float> &master,
+                                       const float *slotRms, int numSlots) {
+  const int numSamples = master.getNumSamples();
+  const int numChannels = master.getNumChannels();
+
+  if (numChannels > 0 && numSamples > 0) {
+    pending.masterRms[0] = master.getRMSLevel(0, 0, numSamples);
+    pending.masterRms[1] = numChannels > 1
+                               ? master.getRMSLevel(1, 0, numSamples)
+                               : pending.masterRms[0];
+  } else {
+    pending.masterRms.fill(0.0f);
+  }
+
+  for (int i = 0; i < kMaxSlots; ++i)
+    pending.slotRms[(size_t)i] =
+        (slotRms != nullptr && i < numSlots) ? slotRms[i] : 0.0f;
+
+  // Mono mix into the FFT window; analyse whenever it fills up
+  const float channelGain = numChannels > 0 ? 1.0f / (float)numChannels : 0.0f;
+  for (int i = 0; i < numSamples; ++i) {
+    float sample = 0.0f;
+    for (int ch = 0; ch < numChannels; ++ch)
+      sample += master.getSample(ch, i);
+
+    fftData[(size_t)fftFill++] = sample * channelGain;
+    if (fftFill == kFftSize) {
+      analyseSpectrum();
+      fftFill = 0;
+    }
+  }
+
+  publish();
+}
+
+FeatureExtractor::Features FeatureExtractor::getLatestFeatures() {
+  if (sharedIndex.load(std::memory_order_acquire) & kFreshBit)
+    readIndex = sharedIndex.exchange(readIndex, std::memory_order_acq_rel) &
+                (kFreshBit - 1);
+  return snapshots[(size_t)readIndex];
+}
+
+void FeatureExtractor::analyseSpectrum() {
+  for (int i = 0; i < kFftSize; ++i)
+    fftData[(size_t)i] *= fftWindow[(size_t)i];
+
+  fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+  // Full-scale sine → 0 dB (Hann coherent gain 0.5, one-sided spectrum)
+  const float scale = 4.0f / (float)kFftSize;
+
+  for (int b = 0; b < kSpectrumBands; ++b) {
+    float peak = 0.0f;
+    for (int bin = bandEdges[(size_t)b]; bin < bandEdges[(size_t)b + 1]; ++bin)
+      peak = std::max(peak, fftData[(size_t)bin]);
+
+    float db = juce::Decibels::gainToDecibels(peak * scale, -80.0f);
+    pending.spectrum[(size_t)b] =
+        juce::jlimit(0.0f, 1.0f, juce::jmap(db, -80.0f, 0.0f, 0.0f, 1.0f));
+  }
+}
+
+void FeatureExtractor::publish() {
+  snapshots[(size_t)writeIndex] = pending;
+  writeIndex = sharedIndex.exchange(writeIndex | kFreshBit,
+                                    std::memory_order_acq_rel) &
+               (kFreshBit - 1);
+}
+
 void FeatureExtractor::downsampleToBuffer(std::vector<float> &dest, int targetSize) {
   dest = getDownsampledWaveform(targetSize);
 }
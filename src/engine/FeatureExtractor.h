@@ -1,6 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
 #include <atomic>
 #include <vector>
 
@@ -11,9 +12,24 @@ namespace flowzone {
  * 
  * Uses double-buffered atomic exchange for lock-free access
  * Target: 30fps update rate
+ *
+ * The master output is also analysed on the audio thread (RMS per channel,
+ * per-slot RMS and a 16-band spectrum) and published through a lock-free
+ * triple buffer, so the message thread can build visualization frames
+ * without ever blocking the audio callback.
  */
 class FeatureExtractor {
 public:
+  static constexpr int kMaxSlots = 12;
+  static constexpr int kSpectrumBands = 16;
+
+  /** One published snapshot of the audio-side visual features. */
+  struct Features {
+    std::array<float, 2> masterRms{};
+    std::array<float, kMaxSlots> slotRms{};
+    std::array<float, kSpectrumBands> spectrum{}; // 0..1, log-spaced bands
+  };
+
   FeatureExtractor();
   ~FeatureExtractor();
 
@@ -28,6 +44,13 @@ public:
   // Get downsampled waveform (256 points for UI display)
   std::vector<float> getDownsampledWaveform(int targetSize = 256);
 
+  // Called from audio thread with the final output and the per-slot levels
+  void pushMasterBlock(const juce::AudioBuffer<float> &master,
+                       const float *slotRms, int numSlots);
+
+  // Called from the message thread (single reader) for the newest snapshot
+  Features getLatestFeatures();
+
 private:
   static constexpr int kBufferSeconds = 97; // Match retro buffer size
   static constexpr int kDownsamplePoints = 256;
@@ -44,7 +67,28 @@ private:
   std::atomic<std::vector<float>*> displayBuffer{&bufferB};
   
   juce::CriticalSection lock;
-  
+
+  // Spectrum analysis (audio thread only)
+  static constexpr int kFftOrder = 10;
+  static constexpr int kFftSize = 1 << kFftOrder;
+  juce::dsp::FFT fft{kFftOrder};
+  std::array<float, kFftSize> fftWindow{};
+  std::array<float, kFftSize * 2> fftData{};
+  std::array<int, kSpectrumBands + 1> bandEdges{};
+  int fftFill = 0;
+
+  // Triple buffer: the writer fills its private slot and swaps it with the
+  // shared one; the reader swaps the shared slot out when it is fresh.
+  static constexpr int kFreshBit = 4;
+  std::array<Features, 3> snapshots;
+  Features pending;
+  int writeIndex = 0;
+  int readIndex = 1;
+  std::atomic<int> sharedIndex{2};
+
+  void analyseSpectrum();
+  void publish();
+
   void downsampleToBuffer(std::vector<float> &dest, int targetSize);
   
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FeatureExtractor)
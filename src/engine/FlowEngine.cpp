@@ -1,5 +1,7 @@
 #include "FlowEngine.h"
 #include "FileLogger.h"
+#include "Metrics.h"
+#include "state/StateSchema.h"
 #include <cmath>
 
 namespace flowzone {
@@ -16,10 +18,18 @@ FlowEngine::FlowEngine()
     auto slot = std::make_unique<Slot>(i);
     slots.push_back(std::move(slot));
   }
+  slotVolumeGestures.resize(slots.size());
+
+  // Broadcasts are change-driven; the timer only runs while clients are
+  // connected (see setConnectionCount)
+  sessionManager.setChangeCallback(
+      [this] { broadcastScheduler.markDirty(BroadcastScheduler::State); });
+
+  Metrics::instance().set(Metrics::Gauge::SafeMode,
+                          (double)crashGuard.getSafeModeLevel());
 
   createNewJam();
   transport.play(); // Auto-play when opening a jam
-  startTimerHz(60); // Broadcast state at 60Hz
 
   FileLogger::instance().log(FileLogger::Category::Startup,
                              "FlowEngine constructor DONE, transport playing");
@@ -28,6 +38,7 @@ FlowEngine::FlowEngine()
 FlowEngine::~FlowEngine() {
   FileLogger::instance().log(FileLogger::Category::Startup,
                              "FlowEngine SHUTDOWN");
+  storageCompactor.stopThread(4000);
   stopThread(2000);
 }
 
@@ -38,6 +49,7 @@ void FlowEngine::prepareToPlay(double sampleRate, int samplesPerBlock) {
                              "prepareToPlay sr=" + std::to_string(sampleRate) +
                                  " block=" + std::to_string(samplesPerBlock));
 
+  loadMeasurer.reset(sampleRate, samplesPerBlock);
   transport.prepareToPlay(sampleRate, samplesPerBlock);
   drumEngine.prepare(sampleRate, samplesPerBlock);
   synthEngine.prepare(sampleRate, samplesPerBlock);
@@ -56,13 +68,34 @@ void FlowEngine::prepareToPlay(double sampleRate, int samplesPerBlock) {
   for (auto &slot : slots) {
     slot->prepareToPlay(sampleRate, samplesPerBlock);
   }
+
+  gestureRamp.assign((size_t)samplesPerBlock, 0.0f);
+  for (auto &gesture : slotVolumeGestures)
+    gesture.prepare(sampleRate);
+  inputGainGesture.prepare(sampleRate);
+  for (size_t axis = 0; axis < xyGestures.size(); ++axis) {
+    xyRamps[axis].assign((size_t)samplesPerBlock, 0.0f);
+    xyGestures[axis].prepare(sampleRate);
+  }
 }
 
 void FlowEngine::processBlock(juce::AudioBuffer<float> &buffer,
                               juce::MidiBuffer &midiMessages) {
-  processCommands();
-
   int numSamples = buffer.getNumSamples();
+  juce::AudioProcessLoadMeasurer::ScopedTimer loadTimer(loadMeasurer,
+                                                        numSamples);
+
+  // Load and xruns as of the previous block; this one is still being timed
+  auto &metrics = Metrics::instance();
+  metrics.add(Metrics::Counter::AudioCallbacks);
+  metrics.set(Metrics::Gauge::AudioCallbackLoad,
+              loadMeasurer.getLoadAsProportion());
+  metrics.setTotal(Metrics::Counter::AudioXruns,
+                   (uint64_t)loadMeasurer.getXRunCount());
+
+  if (processCommands())
+    broadcastScheduler.markDirty(BroadcastScheduler::State);
+
   engineBuffer.clear();
   retroCaptureBuffer.clear();
 
@@ -75,13 +108,18 @@ void FlowEngine::processBlock(juce::AudioBuffer<float> &buffer,
   combinedMidi.addEvents(activeMidi, 0, numSamples, 0);
   activeMidi.clear();
 
+  // XY plays on the same clock as every other gesture, whatever the mode
+  const float *xRamp = renderGesture(xyGestures[0], numSamples, xyRamps[0]);
+  const float *yRamp = renderGesture(xyGestures[1], numSamples, xyRamps[1]);
+
   static int flowLogCounter = 0;
   bool shouldLog = (++flowLogCounter >= 86); // ~1/sec
   if (shouldLog)
     flowLogCounter = 0;
 
   if (state.activeMode.category == "mic") {
-    micProcessor.process(buffer, engineBuffer);
+    micProcessor.process(buffer, engineBuffer,
+                         renderGesture(inputGainGesture, numSamples));
 
     // After processing mic, clear the main buffer to remove raw input/noise
     buffer.clear();
@@ -113,7 +151,11 @@ void FlowEngine::processBlock(juce::AudioBuffer<float> &buffer,
       }
     } else if (state.activeMode.category == "notes" ||
                state.activeMode.category == "bass") {
-      synthEngine.process(engineBuffer, combinedMidi);
+      synthEngine.setCallbackLoad(loadMeasurer.getLoadAsProportion());
+      synthEngine.process(engineBuffer, combinedMidi, xRamp, yRamp);
+      metrics.set(Metrics::Gauge::SynthVoices,
+                  synthEngine.getNumActiveVoices());
+      metrics.set(Metrics::Gauge::SynthVoiceCap, synthEngine.getVoiceCap());
       for (int ch = 0; ch < retroCaptureBuffer.getNumChannels() &&
                        ch < engineBuffer.getNumChannels();
            ++ch) {
@@ -129,16 +171,37 @@ void FlowEngine::processBlock(juce::AudioBuffer<float> &buffer,
     }
   }
 
-  // 2. Process Slots (Looped Riffs)
-  for (auto &slot : slots) {
-    slot->processBlock(buffer, numSamples);
+  // The pad ends the block where its gesture does, whether or not the
+  // synth played
+  if (xRamp != nullptr || yRamp != nullptr) {
+    const auto &xy = synthEngine.getXY();
+    synthEngine.setXY(xRamp != nullptr ? xRamp[numSamples - 1] : xy.x,
+                      yRamp != nullptr ? yRamp[numSamples - 1] : xy.y);
   }
 
+  // 2. Process Slots (Looped Riffs); volume gestures ramp per sample
+  for (size_t i = 0; i < slots.size(); ++i)
+    slots[i]->processBlock(buffer, numSamples,
+                           renderGesture(slotVolumeGestures[i], numSamples));
+
   // 3. Update Visuals & Retrospective
   updatePeakLevel(retroCaptureBuffer);
   retroBuffer.pushBlock(retroCaptureBuffer);
   featureExtractor.pushAudioBlock(retroCaptureBuffer);
 
+  int numSlotLevels = std::min((int)slots.size(), (int)slotLevels.size());
+  for (int i = 0; i < numSlotLevels; ++i)
+    slotLevels[(size_t)i] = slots[(size_t)i]->getLastRms();
+  featureExtractor.pushMasterBlock(buffer, slotLevels.data(), numSlotLevels);
+
+  // Meters decay towards silence: flag them while audible, plus once more
+  // when they drop below the floor so the UI settles at zero
+  bool metersActive = retroBufferPeakLevel.load() > kMeterFloor ||
+                      micProcessor.getPeakLevel() > kMeterFloor;
+  if (metersActive || metersWereActive)
+    broadcastScheduler.markDirty(BroadcastScheduler::Meters);
+  metersWereActive = metersActive;
+
   if (shouldLog) {
     float enginePeak = engineBuffer.getMagnitude(0, 0, numSamples);
     float retroPeak = retroBufferPeakLevel.load();
@@ -146,6 +209,23 @@ void FlowEngine::processBlock(juce::AudioBuffer<float> &buffer,
                                "ENGINE peak=" + std::to_string(enginePeak) +
                                    " RETRO peak=" + std::to_string(retroPeak));
   }
+
+  samplePosition += numSamples;
+}
+
+// A gesture's values for this block, or null while it is idle. Blocks
+// larger than prepared skip it; the next one catches up to the right point.
+const float *FlowEngine::renderGesture(GestureStream &gesture,
+                                       int numSamples) {
+  return renderGesture(gesture, numSamples, gestureRamp);
+}
+
+const float *FlowEngine::renderGesture(GestureStream &gesture, int numSamples,
+                                       std::vector<float> &ramp) {
+  if (numSamples > (int)ramp.size() ||
+      !gesture.render(samplePosition, numSamples, ramp.data()))
+    return nullptr;
+  return ramp.data();
 }
 
 void FlowEngine::loadPreset(const juce::String &category,
@@ -209,12 +289,70 @@ void FlowEngine::releasePad(int padIndex) {
 }
 
 void FlowEngine::updateXY(float x, float y) {
+  for (auto &gesture : xyGestures)
+    gesture.cancel();
+  synthEngine.setXY(x, y);
+  sessionManager.updateState([&](AppState &s) {
+    s.activeFX.xyPosition.x = x;
+    s.activeFX.xyPosition.y = y;
+  });
+}
+
+void FlowEngine::addXYGesture(double t0, const float *points,
+                              int numValues) {
+  if (numValues < 3)
+    return;
+
+  // [dtMs, x, y] triples; both axes ramp from where the synth has the pad
+  const auto &current = synthEngine.getXY();
+  for (int i = 0; i + 2 < numValues; i += 3) {
+    xyGestures[0].add(samplePosition, t0 + points[i], points[i + 1],
+                      current.x);
+    xyGestures[1].add(samplePosition, t0 + points[i], points[i + 2],
+                      current.y);
+  }
+
+  // The state follows the last point, once per message
+  int last = numValues - numValues % 3 - 3;
+  float x = points[last + 1], y = points[last + 2];
   sessionManager.updateState([&](AppState &s) {
     s.activeFX.xyPosition.x = x;
     s.activeFX.xyPosition.y = y;
   });
 }
 
+void FlowEngine::addSlotVolumeGesture(int slotIndex, double t0,
+                                      const float *points, int numValues) {
+  if (slotIndex < 0 || slotIndex >= (int)slots.size() || numValues < 2)
+    return;
+
+  auto &gesture = slotVolumeGestures[(size_t)slotIndex];
+  float current = slots[(size_t)slotIndex]->getState().volume;
+  for (int i = 0; i + 1 < numValues; i += 2)
+    gesture.add(samplePosition, t0 + points[i], points[i + 1], current);
+
+  float volume = points[numValues - numValues % 2 - 1];
+  sessionManager.updateState([&](AppState &s) {
+    if (slotIndex < s.slots.size())
+      s.slots[slotIndex].volume = volume;
+  });
+}
+
+void FlowEngine::addInputGainGesture(double t0, const float *points,
+                                     int numValues) {
+  if (numValues < 2)
+    return;
+
+  float current = micProcessor.getInputGain();
+  for (int i = 0; i + 1 < numValues; i += 2)
+    inputGainGesture.add(samplePosition, t0 + points[i],
+                         std::pow(10.0f, points[i + 1] / 20.0f), current);
+
+  float gainDb = points[numValues - numValues % 2 - 1];
+  sessionManager.updateState(
+      [&](AppState &s) { s.mic.inputGain = (gainDb + 60.0f) / 100.0f; });
+}
+
 void FlowEngine::setLoopLength(int bars) {
   transport.setLoopLengthBars(bars);
   sessionManager.updateState(
@@ -223,6 +361,7 @@ void FlowEngine::setLoopLength(int bars) {
 
 void FlowEngine::setSlotVolume(int slotIndex, float volume) {
   if (slotIndex >= 0 && slotIndex < slots.size()) {
+    slotVolumeGestures[(size_t)slotIndex].cancel();
     slots[slotIndex]->setVolume(volume);
     sessionManager.updateState([&](AppState &s) {
       if (slotIndex < s.slots.size())
@@ -242,6 +381,7 @@ void FlowEngine::setSlotMuted(int slotIndex, bool muted) {
 }
 
 void FlowEngine::setInputGain(float gainDb) {
+  inputGainGesture.cancel();
   micProcessor.setInputGain(gainDb);
   sessionManager.updateState(
       [&](AppState &s) { s.mic.inputGain = (gainDb + 60.0f) / 100.0f; });
@@ -298,9 +438,6 @@ void FlowEngine::commitLooper() {
 }
 
 void FlowEngine::createNewJam() {
-  // Preserve existing sessions list
-  auto existingState = sessionManager.getCurrentState();
-
   AppState newState;
   newState.session.id = juce::Uuid().toString();
   newState.session.name = "New Jam";
@@ -309,15 +446,8 @@ void FlowEngine::createNewJam() {
   for (int i = 0; i < 12; ++i)
     newState.slots.push_back({});
 
-  // Copy existing sessions and add the new one
-  newState.sessions = existingState.sessions;
-  AppState::Session sessionEntry;
-  sessionEntry.id = newState.session.id;
-  sessionEntry.name = newState.session.name;
-  sessionEntry.createdAt = newState.session.createdAt;
-  newState.sessions.push_back(sessionEntry);
-
-  sessionManager.setState(newState);
+  // The jam list lives in the history store; nothing else carries over
+  sessionManager.startSession(newState);
   transport.play(); // Auto-play new jams
 }
 
@@ -328,42 +458,147 @@ void FlowEngine::renameJam(const juce::String &sessionId,
 void FlowEngine::deleteJam(const juce::String &sessionId) {}
 void FlowEngine::run() {}
 
+void FlowEngine::startStorageMaintenance(const juce::File &recordingsRoot) {
+  storageCompactor.setRoot(recordingsRoot);
+  storageCompactor.setIdleProbe([this] { return isIdleForMaintenance(); });
+  storageCompactor.start();
+}
+
+bool FlowEngine::isIdleForMaintenance() const {
+  auto load = loadMeasurer.getLoadAsProportion();
+
+  // Stopped transport leaves plenty of headroom; while jamming only use
+  // genuinely spare cycles so the audio callback never competes for CPU
+  if (!transport.isPlaying())
+    return load < 0.5;
+
+  return load < 0.2;
+}
+
+bool FlowEngine::submitCommand(std::string_view command) {
+  auto &metrics = Metrics::instance();
+  bool queued = commandQueue.push(command);
+  metrics.add(queued ? Metrics::Counter::CommandsQueued
+                     : Metrics::Counter::CommandsDropped);
+  metrics.set(Metrics::Gauge::CommandQueueDepth, commandQueue.getNumReady());
+  broadcastScheduler.markDirty(BroadcastScheduler::Command);
+
+  // Leave a running fast timer alone: restarting it on every command of a
+  // gesture stream would keep pushing the next tick back
+  int fastMs = broadcastScheduler.getConfig().minIntervalMs;
+  if (getTimerInterval() != fastMs)
+    startTimer(fastMs);
+  return queued;
+}
+
+bool FlowEngine::answerQuery(std::string_view command,
+                             std::string &reply) const {
+  // Cheap reject for the common case: every other command, in place
+  if (command.find("\"LIST_") == std::string_view::npos)
+    return false;
+
+  Command query;
+  if (!CommandDispatcher::parse(command.data(), command.size(), query))
+    return false;
+  if (query.cmd != "LIST_RIFFS" && query.cmd != "LIST_SESSIONS")
+    return false;
+
+  reply.clear();
+  JsonWriter writer(reply);
+  auto write = [&](const char *type, const auto &page) {
+    writer.beginObject();
+    writer.key("type");
+    writer.writeString(type);
+    writer.key("offset");
+    writer.writeInt(page.offset);
+    writer.key("total");
+    writer.writeInt(page.total);
+    writer.key("version");
+    writer.writeInt(page.version);
+    writer.key("items");
+    schema::write(writer, page.items);
+    if (query.requestId) {
+      writer.key("requestId");
+      writer.writeInt(*query.requestId);
+    }
+    writer.endObject();
+  };
+
+  const auto &history = sessionManager.getHistory();
+  if (query.cmd == "LIST_RIFFS")
+    write("RIFF_PAGE", history.getRiffs(query.offset, query.limit));
+  else
+    write("SESSION_PAGE", history.getSessions(query.offset, query.limit));
+  return true;
+}
+
+void FlowEngine::setConnectionCount(int count) {
+  if (broadcastScheduler.setConnectionCount(count))
+    startTimer(broadcastScheduler.getConfig().minIntervalMs);
+}
+
+void FlowEngine::timerCallback() {
+  auto decision = broadcastScheduler.onTick(
+      juce::Time::getMillisecondCounterHiRes(), transport.isPlaying());
+
+  if (decision.sendState)
+    broadcastState();
+
+  // Bar phase, meters and waveform go out on the binary stream (Spec §3.7)
+  if (decision.sendVisual)
+    broadcastVisualFrame();
+
+  if (decision.nextTickMs == 0) {
+    stopTimer();
+    // A client may have connected between onTick() and stopTimer()
+    if (broadcastScheduler.getConnectionCount() > 0)
+      startTimer(broadcastScheduler.getConfig().minIntervalMs);
+  } else if (decision.nextTickMs != getTimerInterval()) {
+    startTimer(decision.nextTickMs);
+  }
+}
+
 void FlowEngine::broadcastState() {
+  auto meter = [](float level) { return level > kMeterFloor ? level : 0.0f; };
+
   auto state = sessionManager.getCurrentState();
-  state.mic.inputLevel = micProcessor.getPeakLevel();
-  state.looper.inputLevel = retroBufferPeakLevel.load();
-  state.looper.waveformData = retroBuffer.getWaveformData(256);
+  state.mic.inputLevel = meter(micProcessor.getPeakLevel());
+  state.looper.inputLevel = meter(retroBufferPeakLevel.load());
   state.transport.isPlaying = transport.isPlaying();
   state.transport.bpm = transport.getBpm();
-  state.transport.barPhase = transport.getBarPhase();
   state.transport.metronomeEnabled = transport.isMetronomeEnabled();
   state.transport.loopLengthBars = transport.getLoopLengthBars();
+  state.system.cpuLoad = std::round(getCpuLoad() * 100.0f) / 100.0f;
   broadcaster.broadcastStateUpdate(state);
 
-  // Sampled logging for state broadcast debugging (~1/sec at 60Hz)
+  Metrics::instance().set(Metrics::Gauge::ActivePluginHosts,
+                          state.system.activePluginHosts);
+
+  // Sampled logging for state broadcast debugging (every 60 broadcasts)
   static int broadcastLogCounter = 0;
   if (++broadcastLogCounter >= 60) {
     broadcastLogCounter = 0;
     float retroPeak = retroBufferPeakLevel.load();
     float micPeak = micProcessor.getPeakLevel();
-    bool hasWaveform = false;
-    for (float v : state.looper.waveformData) {
-      if (v > 0.001f) {
-        hasWaveform = true;
-        break;
-      }
-    }
     FileLogger::instance().log(
         FileLogger::Category::StateBroadcast,
         "BROADCAST retroPeak=" + std::to_string(retroPeak) +
             " micPeak=" + std::to_string(micPeak) +
             " playing=" + std::string(state.transport.isPlaying ? "Y" : "N") +
             " mode=" + state.activeMode.category.toStdString() +
-            " waveform=" + std::string(hasWaveform ? "HAS_DATA" : "EMPTY") +
-            " sessions=" + std::to_string(state.sessions.size()));
+            " visualFrame=" +
+            std::to_string(visualStream.getLastFrameId()) +
+            " sessions=" + std::to_string(state.library.sessionCount) +
+            " riffs=" + std::to_string(state.library.riffCount));
   }
 }
 
+void FlowEngine::broadcastVisualFrame() {
+  visualStream.sendFrame(
+      (float)transport.getBarPhase(), featureExtractor.getLatestFeatures(),
+      retroBuffer.getWaveformData(VisualizationStream::WAVEFORM_POINTS));
+}
+
 void FlowEngine::updatePeakLevel(const juce::AudioBuffer<float> &buffer) {
   float peak = 0.0f;
   for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
@@ -376,11 +611,17 @@ void FlowEngine::updatePeakLevel(const juce::AudioBuffer<float> &buffer) {
     retroBufferPeakLevel.store(cur * 0.95f);
 }
 
-void FlowEngine::processCommands() {
-  juce::String cmd;
-  while (commandQueue.pop(cmd)) {
-    dispatcher.dispatch(cmd, *this);
+bool FlowEngine::processCommands() {
+  bool any = false;
+  int size;
+  while ((size = commandQueue.pop(commandScratch.data())) >= 0) {
+    dispatcher.dispatch(commandScratch.data(), (size_t)size, *this);
+    any = true;
   }
+  if (any)
+    Metrics::instance().set(Metrics::Gauge::CommandQueueDepth,
+                            commandQueue.getNumReady());
+  return any;
 }
 
 } // namespace flowzone
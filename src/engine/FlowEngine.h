@@ -3,18 +3,24 @@
 #include "CrashGuard.h"
 #include "DrumEngine.h"
 #include "FeatureExtractor.h"
+#include "GestureStream.h"
 #include "MicProcessor.h"
 #include "RetrospectiveBuffer.h"
 #include "Slot.h"
+#include "StorageCompactor.h"
 #include "SynthEngine.h"
+#include "VisualizationStream.h"
 #include "session/SessionStateManager.h"
+#include "state/BroadcastScheduler.h"
 #include "state/StateBroadcaster.h"
 #include "transport/TransportService.h"
 #include <JuceHeader.h>
+#include <array>
 #include <atomic>
 #include <cerrno>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <wchar.h>
 #include <wctype.h>
@@ -38,6 +44,31 @@ public:
   StateBroadcaster &getBroadcaster() { return broadcaster; }
   SessionStateManager &getSessionManager() { return sessionManager; }
   CommandQueue &getCommandQueue() { return commandQueue; }
+  StorageCompactor &getStorageCompactor() { return storageCompactor; }
+  BroadcastScheduler &getBroadcastScheduler() { return broadcastScheduler; }
+  VisualizationStream &getVisualizationStream() { return visualStream; }
+  const engine::DrumEngine &getDrumEngine() const { return drumEngine; }
+  const engine::SynthEngine &getSynthEngine() const { return synthEngine; }
+
+  // Audio callback load (0..1) measured around processBlock
+  float getCpuLoad() const { return (float)loadMeasurer.getLoadAsProportion(); }
+
+  // Queue a command from a client and make sure its effect is broadcast
+  // promptly. Safe from any non-audio thread. Returns false if the queue
+  // was full and the command was dropped.
+  bool submitCommand(std::string_view command);
+
+  // Answer a read-only query from one client: LIST_RIFFS / LIST_SESSIONS
+  // {offset, limit, requestId} page through the history store, newest
+  // first. Returns false if command isn't a query. Safe from any thread.
+  bool answerQuery(std::string_view command, std::string &reply) const;
+
+  // Number of connected clients. Broadcasting stops entirely at zero.
+  void setConnectionCount(int count);
+
+  // Idle-time recompression of recordings under the session root
+  void startStorageMaintenance(const juce::File &recordingsRoot);
+  bool isIdleForMaintenance() const;
 
   // Command Handlers (called by Dispatcher)
   void loadPreset(const juce::String &category, const juce::String &presetName);
@@ -46,6 +77,13 @@ public:
   void triggerPad(int padIndex, float velocity);
   void releasePad(int padIndex);
   void updateXY(float x, float y);
+  // GESTURE points, t0 + dtMs in the client's clock (Spec §3.2): slot
+  // volume, input gain and the XY pad ramp between them per sample, all
+  // GestureStream::kLatencyMs behind
+  void addXYGesture(double t0, const float *points, int numValues);
+  void addSlotVolumeGesture(int slotIndex, double t0, const float *points,
+                            int numValues);
+  void addInputGainGesture(double t0, const float *points, int numValues);
   void setLoopLength(int bars);
   void setSlotVolume(int slotIndex, float volume);
   void setSlotMuted(int slotIndex, bool muted);
@@ -69,8 +107,9 @@ public:
   // Background Thread for Auto-Merge
   void run() override;
 
-  // Timer callback for message-thread broadcasting
-  void timerCallback() override { broadcastState(); }
+  // Timer callback for message-thread broadcasting; paced by
+  // broadcastScheduler and stopped while no clients are connected
+  void timerCallback() override;
 
 private:
   TransportService transport;
@@ -81,6 +120,10 @@ private:
   RetrospectiveBuffer retroBuffer;
   FeatureExtractor featureExtractor;
   CommandQueue commandQueue;
+  StorageCompactor storageCompactor;
+  VisualizationStream visualStream;
+  BroadcastScheduler broadcastScheduler;
+  juce::AudioProcessLoadMeasurer loadMeasurer;
 
   // Audio engines
   engine::DrumEngine drumEngine;
@@ -96,17 +139,40 @@ private:
 
   std::vector<std::unique_ptr<Slot>> slots;
 
+  // Audio thread: samples processed so far, the clock gestures play on
+  int64_t samplePosition = 0;
+  std::vector<GestureStream> slotVolumeGestures; // One per slot
+  GestureStream inputGainGesture;                // Linear gain
+  std::array<GestureStream, 2> xyGestures;       // X, Y; read by the synth
+  std::vector<float> gestureRamp;                // One block of values
+  std::array<std::vector<float>, 2> xyRamps;
+  const float *renderGesture(GestureStream &gesture, int numSamples);
+  const float *renderGesture(GestureStream &gesture, int numSamples,
+                             std::vector<float> &ramp);
+
+  // processCommands() copies each command out of the queue into this
+  std::vector<char> commandScratch =
+      std::vector<char>((size_t)CommandQueue::kMaxCommandBytes);
+
   // Pre-allocated buffers for audio thread to avoid heap allocation
   juce::AudioBuffer<float> engineBuffer;
   juce::AudioBuffer<float> retroCaptureBuffer;
+  std::array<float, FeatureExtractor::kMaxSlots> slotLevels{};
+
+  // Meter levels below this (-80 dB) count as silence and are sent as 0
+  static constexpr float kMeterFloor = 1.0e-4f;
+
+  // Audio thread: meters were above the floor last block
+  bool metersWereActive = false;
 
   // Merge logic
   juce::CriticalSection mergeLock;
   std::atomic<bool> mergePending{false};
   int nextCaptureBars = 0;
 
-  void processCommands();
+  bool processCommands();
   void broadcastState();
+  void broadcastVisualFrame();
   void performMergeSync();
   void triggerAutoMerge();
 
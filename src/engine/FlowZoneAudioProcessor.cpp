@@ -1,5 +1,7 @@
 #include "FlowZoneAudioProcessor.h"
 #include "FlowZoneAudioProcessorEditor.h"
+#include "RecordingJournal.h"
+#include "state/StreamingJson.h"
 
 #ifndef JucePlugin_PreferredChannelConfigurations
 FlowZoneAudioProcessor::FlowZoneAudioProcessor()
@@ -41,18 +43,37 @@ void FlowZoneAudioProcessor::init() {
     }
   }
 
+  // Stitch takes left journalled by a crash or by a stitch that failed or
+  // was cut short at quit. Only *.segments directories are looked at, so a
+  // clean tree costs one scan.
+  flowzone::RecordingJournal::recoverInterrupted(
+      flowzone::RecordingJournal::getDefaultRecordingsRoot());
+
   // Mark application as active (crash detection)
   crashGuard.markActive();
 
+  // Recompress recordings whenever the engine is idle
+  engine.startStorageMaintenance(
+      flowzone::RecordingJournal::getDefaultRecordingsRoot());
+
   // Set up WebSocket -> CommandQueue flow
-  server.setOnMessageCallback([this](const std::string &msg) {
-    juce::String juceMsg(msg);
-    engine.getCommandQueue().push(juceMsg);
-  });
+  server.setOnMessageCallback(
+      [this](std::string_view msg) { return engine.submitCommand(msg); });
 
   // Set up StateBroadcaster -> WebSocket broadcast flow
-  engine.getBroadcaster().setMessageCallback(
-      [this](const juce::String &msg) { server.broadcast(msg.toStdString()); });
+  engine.getBroadcaster().setStateMessageCallback(
+      [this](flowzone::StateBroadcaster::StateMessage &msg) {
+        server.broadcastState(
+            msg.getType() == flowzone::StateBroadcaster::MessageType::Snapshot
+                ? OutgoingMessage::Kind::StateSnapshot
+                : OutgoingMessage::Kind::StatePatch,
+            [&] { return msg.toJsonUtf8(); },
+            [&] { return msg.toMsgPack(); });
+      });
+  engine.getVisualizationStream().setFrameCallback(
+      [this](const void *data, size_t size) {
+        server.broadcastBinary(data, size);
+      });
 
   // Set up initial state callback for new connections
   server.setInitialStateCallback([this]() -> std::string {
@@ -62,17 +83,55 @@ void FlowZoneAudioProcessor::init() {
     state.transport.metronomeEnabled =
         engine.getTransport().isMetronomeEnabled();
     state.transport.loopLengthBars = engine.getTransport().getLoopLengthBars();
-    state.transport.barPhase = engine.getTransport().getBarPhase();
 
-    juce::DynamicObject *root = new juce::DynamicObject();
-    root->setProperty("type", "STATE_FULL");
-    root->setProperty("revisionId",
-                      (juce::int64)engine.getBroadcaster().getRevisionId());
-    root->setProperty("data", state.toVar());
-
-    return juce::JSON::toString(juce::var(root)).toStdString();
+    std::string json;
+    flowzone::JsonWriter writer(json);
+    writer.beginObject();
+    writer.key("type");
+    writer.writeString("STATE_FULL");
+    writer.key("epoch");
+    writer.writeString(std::string_view(engine.getBroadcaster().getEpoch()));
+    writer.key("revisionId");
+    writer.writeInt(engine.getBroadcaster().getRevisionId());
+    writer.key("data");
+    state.writeJson(writer);
+    writer.endObject();
+    return json;
   });
 
+  // Reconnecting clients are caught up from the broadcaster's history; the
+  // callback above only covers connections before the first broadcast
+  server.setReconnectCallback(
+      [this](std::string_view lastEpoch, int64_t lastRevisionId,
+             StateEncoding encoding,
+             const WebSocketServer::DeliverFunction &deliver) {
+        return engine.getBroadcaster().replyToReconnect(
+            lastEpoch, lastRevisionId,
+            [&](flowzone::StateBroadcaster::StateMessage &msg) {
+              deliver(encoding == StateEncoding::MsgPack
+                          ? msg.toMsgPack()
+                          : msg.toJsonUtf8());
+            });
+      });
+
+  // History paging is answered straight to the asking client
+  server.setQueryCallback(
+      [this](std::string_view msg,
+             const WebSocketServer::DeliverFunction &reply) {
+        std::string answer;
+        if (!engine.answerQuery(msg, answer))
+          return false;
+        reply(answer);
+        return true;
+      });
+
+  // Broadcasting idles while nobody is connected
+  server.setConnectionCountCallback(
+      [this](int count) { engine.setConnectionCount(count); });
+
+#ifdef JucePlugin_VersionString
+  server.setVersion(JucePlugin_VersionString);
+#endif
   server.start();
 }
 
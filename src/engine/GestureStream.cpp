@@ -0,0 +1,87 @@
+#include "GestureStream.h"
+#include <algorithm>
+#include <cmath>
+
+namespace flowzone {
+
+void GestureStream::prepare(double newSampleRate) {
+  sampleRate = newSampleRate;
+  cancel();
+}
+
+void GestureStream::add(int64_t now, double timeMs, float newValue,
+                        float current) {
+  double clientSample = timeMs * sampleRate / 1000.0;
+  if (!active) {
+    // New gesture: its first point plays kLatencyMs from now
+    offset = (double)now + kLatencyMs * sampleRate / 1000.0 - clientSample;
+    from = {now, current};
+    head = count = 0;
+    active = true;
+  }
+  if (count == kMaxPoints) {
+    // Not rendered for a while (e.g. the mic isn't in use): the oldest
+    // point goes, the newest (the value the control ends on) stays
+    from = front();
+    head = (head + 1) % kMaxPoints;
+    --count;
+  }
+
+  // Points only move forward in time
+  int64_t last = count > 0 ? back().sample : from.sample;
+  auto sample = std::max(last, (int64_t)std::llround(clientSample + offset));
+  points[(size_t)((head + count) % kMaxPoints)] = {sample, newValue};
+  ++count;
+}
+
+float GestureStream::valueAt(int64_t sample) const {
+  if (count == 0)
+    return from.value;
+  const auto &to = front();
+  float step = (to.value - from.value) / (float)(to.sample - from.sample);
+  return from.value + step * (float)(sample - from.sample);
+}
+
+bool GestureStream::render(int64_t blockStart, int numSamples, float *out) {
+  if (!active)
+    return false;
+
+  int i = 0;
+  while (i < numSamples) {
+    int64_t sample = blockStart + i;
+    while (count > 0 && front().sample <= sample) {
+      from = front();
+      head = (head + 1) % kMaxPoints;
+      --count;
+    }
+
+    if (count == 0) {
+      if (out != nullptr)
+        std::fill(out + i, out + numSamples, from.value);
+      break;
+    }
+
+    // Straight line to the next point, or to the end of the block
+    const auto &to = front();
+    int n = (int)std::min<int64_t>(numSamples - i, to.sample - sample);
+    if (out != nullptr) {
+      // From the ramp's start each time, so block size doesn't matter
+      float step = (to.value - from.value) / (float)(to.sample - from.sample);
+      auto elapsed = (float)(sample - from.sample);
+      for (int k = 0; k < n; ++k)
+        out[i + k] = from.value + step * (elapsed + (float)k);
+    }
+    i += n;
+  }
+
+  value = valueAt(blockStart + numSamples - 1);
+  active = count > 0;
+  return true;
+}
+
+void GestureStream::cancel() {
+  head = count = 0;
+  active = false;
+}
+
+} // namespace flowzone
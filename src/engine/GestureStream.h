@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace flowzone {
+
+/**
+ * GestureStream: one continuous control (a fader, a knob) played back from
+ * the timestamped points of GESTURE commands.
+ *
+ * Clients sample a gesture as it happens and send the points a few at a
+ * time. When a gesture starts, its client clock is mapped onto the engine's
+ * sample clock with kLatencyMs of headroom, so the next point has normally
+ * arrived by the time playback needs it. render() ramps linearly between
+ * points per sample. If the next points come too late the control holds
+ * its last value, and they start a new gesture from there.
+ *
+ * Audio thread only.
+ */
+class GestureStream {
+public:
+  static constexpr int kMaxPoints = 128;
+  // More than the client's send interval (30 ms) plus network jitter
+  static constexpr double kLatencyMs = 50.0;
+
+  void prepare(double sampleRate);
+
+  // now is the sample position of the block being processed; current is
+  // the control's value there, which a new gesture ramps from.
+  void add(int64_t now, double timeMs, float value, float current);
+
+  // Fills out[0, numSamples) from blockStart on and returns true while a
+  // gesture is playing (including the block it ends in). out may be null
+  // to just move on. Returns false and leaves out alone when idle.
+  bool render(int64_t blockStart, int numSamples, float *out);
+
+  bool isActive() const { return active; }
+
+  // Value at the end of the last rendered block
+  float getValue() const { return value; }
+
+  // Drops the gesture; a discrete set of the same control wins over it
+  void cancel();
+
+private:
+  struct Point {
+    int64_t sample = 0;
+    float value = 0.0f;
+  };
+
+  std::array<Point, kMaxPoints> points;
+  int head = 0;
+  int count = 0;
+
+  Point from;             // Last point reached; the ramp starts here
+  double offset = 0.0;    // Client time (in samples) to engine samples
+  double sampleRate = 44100.0;
+  bool active = false;
+  float value = 0.0f;
+
+  const Point &front() const { return points[(size_t)head]; }
+  const Point &back() const {
+    return points[(size_t)((head + count - 1) % kMaxPoints)];
+  }
+  float valueAt(int64_t sample) const;
+};
+
+} // namespace flowzone
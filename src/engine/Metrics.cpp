@@ -0,0 +1,133 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+namespace flowzone {
+
+namespace {
+
+struct Description {
+  const char *name;
+  const char *help;
+};
+
+// Indexed by Metrics::Counter
+const Description kCounters[] = {
+    {"flowzone_audio_callbacks_total", "Audio callbacks processed"},
+    {"flowzone_audio_xruns_total",
+     "Audio callbacks that overran their time budget"},
+    {"flowzone_commands_queued_total", "Client commands queued for the engine"},
+    {"flowzone_commands_dropped_total",
+     "Client commands dropped because the queue was full"},
+    {"flowzone_state_snapshots_total", "STATE_FULL messages broadcast"},
+    {"flowzone_state_patches_total", "STATE_PATCH messages broadcast"},
+    {"flowzone_disk_write_failures_total", "Failed recording segment writes"},
+    {"flowzone_ws_connections_total", "WebSocket connections accepted"},
+    {"flowzone_ws_messages_sent_total", "WebSocket messages sent"},
+    {"flowzone_ws_bytes_sent_total", "WebSocket payload bytes sent"},
+    {"flowzone_ws_messages_superseded_total",
+     "Queued messages dropped because a newer one replaced them"},
+    {"flowzone_ws_frames_skipped_total",
+     "Visual frames skipped for unacknowledged backlog"},
+    {"flowzone_ws_clients_dropped_total",
+     "Clients disconnected for exceeding their send queue limits"},
+};
+
+// Indexed by Metrics::Gauge
+const Description kGauges[] = {
+    {"flowzone_audio_callback_load",
+     "Audio callback time as a proportion of the block duration"},
+    {"flowzone_command_queue_depth", "Commands waiting for the audio thread"},
+    {"flowzone_disk_buffer_fill_ratio", "Recording ring buffer fill (0-1)"},
+    {"flowzone_disk_overflow_bytes", "RAM used for recording overflow blocks"},
+    {"flowzone_disk_tier", "DiskWriter tier (1 normal .. 4 critical)"},
+    {"flowzone_ws_clients", "Connected WebSocket clients"},
+    {"flowzone_ws_command_clients", "Open command sockets (/cmd)"},
+    {"flowzone_ws_queued_messages", "Messages waiting in client send queues"},
+    {"flowzone_ws_queued_bytes", "Bytes waiting in client send queues"},
+    {"flowzone_plugin_hosts", "Active plugin host processes"},
+    {"flowzone_synth_voices", "Sounding synth voices"},
+    {"flowzone_synth_voice_cap", "Synth polyphony at the current load"},
+    {"flowzone_safe_mode", "CrashGuard safe mode level (0 = off)"},
+};
+
+static_assert(std::size(kCounters) == (size_t)Metrics::Counter::NumCounters);
+static_assert(std::size(kGauges) == (size_t)Metrics::Gauge::NumGauges);
+
+void appendSample(std::string &out, const Description &description,
+                  const char *type, const char *value) {
+  out += "# HELP ";
+  out += description.name;
+  out += ' ';
+  out += description.help;
+  out += "\n# TYPE ";
+  out += description.name;
+  out += ' ';
+  out += type;
+  out += '\n';
+  out += description.name;
+  out += ' ';
+  out += value;
+  out += '\n';
+}
+
+} // namespace
+
+double Metrics::getUptimeSeconds() const {
+  using Clock = std::chrono::steady_clock;
+  auto started = Clock::time_point(
+      Clock::duration(startTicks.load(std::memory_order_relaxed)));
+  return std::chrono::duration<double>(Clock::now() - started).count();
+}
+
+std::string Metrics::toPrometheus() const {
+  std::string out;
+  out.reserve(4096);
+  char value[32];
+
+  for (size_t i = 0; i < std::size(kCounters); ++i) {
+    std::snprintf(value, sizeof(value), "%llu",
+                  (unsigned long long)get((Counter)i));
+    appendSample(out, kCounters[i], "counter", value);
+  }
+
+  for (size_t i = 0; i < std::size(kGauges); ++i) {
+    std::snprintf(value, sizeof(value), "%.9g", get((Gauge)i));
+    appendSample(out, kGauges[i], "gauge", value);
+  }
+
+  std::snprintf(value, sizeof(value), "%.3f", getUptimeSeconds());
+  appendSample(out, {"flowzone_uptime_seconds", "Seconds since startup"},
+               "gauge", value);
+  return out;
+}
+
+std::string Metrics::toHealthJson(const std::string &version,
+                                  int protocolVersion) const {
+  // Only known-safe characters go into the version string: it comes from
+  // the build, not from clients
+  char json[512];
+  int length = std::snprintf(
+      json, sizeof(json),
+      "{\"status\": \"ok\", \"uptime_s\": %lld, \"cpu_load\": %.3f, "
+      "\"disk_buffer_pct\": %.3f, \"active_plugin_hosts\": %d, "
+      "\"safe_mode\": %s, \"version\": \"%s\", \"protocol_version\": %d}",
+      (long long)getUptimeSeconds(), get(Gauge::AudioCallbackLoad),
+      get(Gauge::DiskBufferFill), (int)get(Gauge::ActivePluginHosts),
+      get(Gauge::SafeMode) > 0.0 ? "true" : "false", version.c_str(),
+      protocolVersion);
+  length = std::clamp(length, 0, (int)sizeof(json) - 1);
+  return std::string(json, (size_t)length);
+}
+
+void Metrics::reset() noexcept {
+  for (auto &counter : counters)
+    counter.store(0, std::memory_order_relaxed);
+  for (auto &gauge : gauges)
+    gauge.store(0.0, std::memory_order_relaxed);
+  startTicks.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                   std::memory_order_relaxed);
+}
+
+} // namespace flowzone
@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace flowzone {
+
+/**
+ * Metrics: process-wide counters and gauges for /metrics and /api/health
+ *
+ * A fixed set of slots known at compile time, each a single relaxed
+ * atomic, so updating one is a lock-free add or store that is safe on the
+ * audio thread and never allocates. Readers (the HTTP handlers) load each
+ * slot independently; a scrape is not a consistent snapshot, which is fine
+ * for monitoring.
+ *
+ * Counters only go up. Components that already keep a running total (the
+ * audio load measurer's xruns) publish it with setTotal() instead of
+ * adding deltas.
+ *
+ * Deliberately free of JUCE so the server code can use it too.
+ */
+class Metrics {
+public:
+  enum class Counter {
+    AudioCallbacks,
+    AudioXruns,
+    CommandsQueued,
+    CommandsDropped, // Command queue was full
+    StateSnapshots,
+    StatePatches,
+    DiskWriteFailures,
+    WsConnections,
+    WsMessagesSent,
+    WsBytesSent,
+    WsMessagesSuperseded,
+    WsFramesSkipped,
+    WsClientsDropped, // Disconnected for staying over the queue limit
+    NumCounters
+  };
+
+  enum class Gauge {
+    AudioCallbackLoad, // 0..1 of the block's time budget
+    CommandQueueDepth,
+    DiskBufferFill, // 0..1 of the recording ring buffer
+    DiskOverflowBytes,
+    DiskTier,
+    WsClients,
+    WsCommandClients, // Connections to the /cmd command socket
+    WsQueuedMessages, // Across all client send queues
+    WsQueuedBytes,
+    ActivePluginHosts,
+    SynthVoices,   // Sounding, including ones fading out after a steal
+    SynthVoiceCap, // Polyphony allowed at the current callback load
+    SafeMode, // CrashGuard level, 0 = off
+    NumGauges
+  };
+
+  static Metrics &instance() {
+    static Metrics metrics;
+    return metrics;
+  }
+
+  void add(Counter counter, uint64_t amount = 1) noexcept {
+    slot(counter).fetch_add(amount, std::memory_order_relaxed);
+  }
+  void setTotal(Counter counter, uint64_t total) noexcept {
+    slot(counter).store(total, std::memory_order_relaxed);
+  }
+  void set(Gauge gauge, double value) noexcept {
+    slot(gauge).store(value, std::memory_order_relaxed);
+  }
+  void adjust(Gauge gauge, double delta) noexcept {
+    auto &value = slot(gauge);
+    double current = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(current, current + delta,
+                                        std::memory_order_relaxed))
+      ;
+  }
+
+  uint64_t get(Counter counter) const noexcept {
+    return counters[(size_t)counter].load(std::memory_order_relaxed);
+  }
+  double get(Gauge gauge) const noexcept {
+    return gauges[(size_t)gauge].load(std::memory_order_relaxed);
+  }
+
+  double getUptimeSeconds() const;
+
+  // Prometheus text exposition format (version 0.0.4)
+  std::string toPrometheus() const;
+
+  // Spec §5.4 health document
+  std::string toHealthJson(const std::string &version,
+                           int protocolVersion) const;
+
+  // Zeroes every slot and restarts the uptime clock. For tests.
+  void reset() noexcept;
+
+private:
+  Metrics() = default;
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+  static_assert(std::atomic<double>::is_always_lock_free);
+
+  std::array<std::atomic<uint64_t>, (size_t)Counter::NumCounters> counters{};
+  std::array<std::atomic<double>, (size_t)Gauge::NumGauges> gauges{};
+  std::atomic<std::chrono::steady_clock::rep> startTicks{
+      std::chrono::steady_clock::now().time_since_epoch().count()};
+
+  std::atomic<uint64_t> &slot(Counter c) noexcept {
+    return counters[(size_t)c];
+  }
+  std::atomic<double> &slot(Gauge g) noexcept { return gauges[(size_t)g]; }
+};
+
+} // namespace flowzone
@@ -20,7 +20,8 @@ void MicProcessor::prepare(double sampleRate, int samplesPerBlock) {
 }
 
 void MicProcessor::process(const juce::AudioBuffer<float> &inputBuffer,
-                           juce::AudioBuffer<float> &outputBuffer) {
+                           juce::AudioBuffer<float> &outputBuffer,
+                           const float *gainRamp) {
   static int micLogCounter = 0;
   bool shouldLog = (++micLogCounter >= 86); // ~1/sec at 44100/512
   if (shouldLog)
@@ -48,7 +49,7 @@ void MicProcessor::process(const juce::AudioBuffer<float> &inputBuffer,
   }
 
   // Apply Input Gain
-  applyGain(internalBuffer);
+  applyGain(internalBuffer, gainRamp);
 
   // Apply Reverb (before retrospective capture - as per Spec)
   if (reverbLevel > 0.0f) {
@@ -104,8 +105,15 @@ void MicProcessor::setMonitorUntilLooped(bool enabled) {
   monitorUntilLooped = enabled;
 }
 
-void MicProcessor::applyGain(juce::AudioBuffer<float> &buffer) {
-  if (std::abs(inputGain - 1.0f) > 0.001f) {
+void MicProcessor::applyGain(juce::AudioBuffer<float> &buffer,
+                             const float *gainRamp) {
+  int numSamples = buffer.getNumSamples();
+  if (gainRamp != nullptr && numSamples > 0) {
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+      juce::FloatVectorOperations::multiply(buffer.getWritePointer(ch),
+                                            gainRamp, numSamples);
+    inputGain = gainRamp[numSamples - 1];
+  } else if (std::abs(inputGain - 1.0f) > 0.001f) {
     buffer.applyGain(inputGain);
   }
 }
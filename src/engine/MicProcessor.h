@@ -13,12 +13,16 @@ public:
   MicProcessor();
 
   void prepare(double sampleRate, int samplesPerBlock);
+  // gainRamp, if given, is a per-sample linear input gain for this block
+  // (a knob gesture); the gain stays at its last value
   void process(const juce::AudioBuffer<float> &inputBuffer,
-               juce::AudioBuffer<float> &outputBuffer);
+               juce::AudioBuffer<float> &outputBuffer,
+               const float *gainRamp = nullptr);
   void reset();
 
   // Parameters
   void setInputGain(float gainDb); // -60 to +40
+  float getInputGain() const { return inputGain; } // Linear
   void setMonitorEnabled(bool enabled);
   void setReverbLevel(float level); // 0 to 1
   void setMonitorUntilLooped(bool enabled);
@@ -38,7 +42,7 @@ private:
   juce::AudioBuffer<float> internalBuffer;
   std::atomic<float> peakLevel{0.0f};
 
-  void applyGain(juce::AudioBuffer<float> &buffer);
+  void applyGain(juce::AudioBuffer<float> &buffer, const float *gainRamp);
   void updatePeakLevel(const juce::AudioBuffer<float> &buffer);
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MicProcessor)
@@ -0,0 +1,323 @@
+#include "RecordingJournal.h"
+
+#include <cstdio>
+
+#if !JUCE_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace flowzone {
+
+namespace {
+const char *const kJournalFileName = "journal.txt";
+const char *const kJournalMagic = "FLOWZONE_JOURNAL 1";
+const char *const kCompleteMarker = "COMPLETE";
+const char *const kStitchSuffix = ".stitching";
+
+std::unique_ptr<juce::OutputStream>
+openStream(const juce::File &file,
+           const RecordingJournal::StreamFactory &streamFactory) {
+  if (streamFactory)
+    return streamFactory(file);
+
+  auto fileStream = std::make_unique<juce::FileOutputStream>(file);
+  if (fileStream->failedToOpen())
+    return nullptr;
+  return fileStream;
+}
+
+bool appendLineTo(const juce::File &journalFile, const juce::String &line) {
+  juce::FileOutputStream out(journalFile); // Appends to existing content
+  if (out.failedToOpen())
+    return false;
+
+  out.writeText(line + "\n", false, false, nullptr);
+  out.flush();
+  return out.getStatus().wasOk();
+}
+} // namespace
+
+juce::File RecordingJournal::getSegmentDirectoryFor(const juce::File &target) {
+  return target.getSiblingFile(target.getFileName() + ".segments");
+}
+
+juce::File RecordingJournal::getDefaultRecordingsRoot() {
+  return juce::File::getSpecialLocation(
+             juce::File::userApplicationDataDirectory)
+      .getChildFile("FlowZone")
+      .getChildFile("sessions");
+}
+
+bool RecordingJournal::begin(const juce::File &target, double sr,
+                             int channels, int bits) {
+  targetFile = target;
+  segmentDir = getSegmentDirectoryFor(target);
+  journalFile = segmentDir.getChildFile(kJournalFileName);
+  sampleRate = sr;
+  numChannels = channels;
+  bitsPerSample = bits;
+  committedSegments.clear();
+  active = false;
+
+  // A stale directory for the same target belongs to an older take
+  if (segmentDir.exists())
+    segmentDir.deleteRecursively();
+
+  if (!segmentDir.createDirectory())
+    return false;
+
+  active = appendLine(kJournalMagic) &&
+           appendLine("TARGET " + targetFile.getFileName()) &&
+           appendLine("FORMAT " + juce::String(sampleRate) + " " +
+                      juce::String(numChannels) + " " +
+                      juce::String(bitsPerSample));
+
+  syncToDisk(journalFile);
+  return active;
+}
+
+juce::File RecordingJournal::getSegmentFile(int segmentIndex) const {
+  return segmentDir.getChildFile(
+      "seg_" + juce::String(segmentIndex).paddedLeft('0', 5) + ".wav");
+}
+
+std::unique_ptr<juce::AudioFormatWriter>
+RecordingJournal::createSegmentWriter(int segmentIndex) {
+  auto file = getSegmentFile(segmentIndex);
+  if (file.existsAsFile())
+    file.deleteFile();
+
+  auto stream = openStream(file, streamFactory);
+  if (!stream)
+    return nullptr;
+
+  juce::WavAudioFormat wavFormat;
+  std::unique_ptr<juce::AudioFormatWriter> segmentWriter(
+      wavFormat.createWriterFor(stream.get(), sampleRate,
+                                (unsigned int)numChannels, bitsPerSample, {},
+                                0));
+  if (segmentWriter)
+    stream.release(); // Writer owns the stream now
+
+  return segmentWriter;
+}
+
+bool RecordingJournal::commitSegment(int segmentIndex,
+                                     juce::int64 numSamples) {
+  if (!active)
+    return false;
+
+  auto file = getSegmentFile(segmentIndex);
+
+  // Segment header is final once its writer is destroyed; make it durable
+  // before the journal claims it exists.
+  syncToDisk(file);
+
+  if (!appendLine("SEGMENT " + juce::String(segmentIndex) + " " +
+                  file.getFileName() + " " + juce::String(numSamples)))
+    return false;
+
+  syncToDisk(journalFile);
+
+  committedSegments.add({segmentIndex, file.getFileName(), numSamples});
+  return true;
+}
+
+RecordingJournal::ClosedTake RecordingJournal::close() {
+  if (!active)
+    return {};
+
+  active = false;
+  return {targetFile,    segmentDir,    committedSegments, sampleRate,
+          numChannels,   bitsPerSample, streamFactory};
+}
+
+juce::Result RecordingJournal::finalise() {
+  if (!active)
+    return juce::Result::fail("Journal not active");
+
+  return close().stitch();
+}
+
+juce::Array<juce::File>
+RecordingJournal::recoverInterrupted(const juce::File &searchRoot,
+                                     const StreamFactory &streamFactory) {
+  juce::Array<juce::File> recovered;
+
+  if (!searchRoot.isDirectory())
+    return recovered;
+
+  auto dirs = searchRoot.findChildFiles(juce::File::findDirectories, true,
+                                        "*.segments");
+
+  for (const auto &dir : dirs) {
+    auto journal = dir.getChildFile(kJournalFileName);
+    if (!journal.existsAsFile())
+      continue;
+
+    juce::StringArray lines;
+    journal.readLines(lines);
+    lines.removeEmptyStrings();
+
+    if (lines.isEmpty() || lines[0] != kJournalMagic)
+      continue;
+
+    if (lines.contains(kCompleteMarker)) {
+      // Stitch finished but cleanup did not
+      dir.deleteRecursively();
+      continue;
+    }
+
+    juce::String targetName;
+    double sr = 44100.0;
+    int channels = 2;
+    int bits = 24;
+    juce::Array<Segment> segments;
+
+    for (const auto &line : lines) {
+      auto tokens = juce::StringArray::fromTokens(line, " ", "");
+
+      if (tokens[0] == "TARGET") {
+        targetName = line.fromFirstOccurrenceOf("TARGET ", false, false);
+      } else if (tokens[0] == "FORMAT" && tokens.size() == 4) {
+        sr = tokens[1].getDoubleValue();
+        channels = tokens[2].getIntValue();
+        bits = tokens[3].getIntValue();
+      } else if (tokens[0] == "SEGMENT" && tokens.size() == 4) {
+        segments.add({tokens[1].getIntValue(), tokens[2],
+                      tokens[3].getLargeIntValue()});
+      }
+    }
+
+    if (targetName.isEmpty() || segments.isEmpty()) {
+      DBG("RecordingJournal: Nothing recoverable in " << dir.getFullPathName());
+      dir.deleteRecursively();
+      continue;
+    }
+
+    // Stitches are renamed into place whole, so whatever is at the target
+    // is this take's own (a finished stitch not yet marked complete)
+    ClosedTake take{dir.getSiblingFile(targetName), dir, segments, sr,
+                    channels, bits, streamFactory};
+    auto result = take.stitch();
+
+    if (result.wasOk()) {
+      DBG("RecordingJournal: Recovered " << segments.size() << " segments to "
+                                         << take.targetFile.getFullPathName());
+      recovered.add(take.targetFile);
+    } else {
+      DBG("RecordingJournal: Recovery failed for "
+          << dir.getFullPathName() << " | " << result.getErrorMessage());
+    }
+  }
+
+  return recovered;
+}
+
+juce::Result RecordingJournal::ClosedTake::stitch(
+    const std::function<bool()> &shouldAbandon) const {
+  if (!isValid())
+    return juce::Result::fail("Journal not active");
+
+  // Written beside the target and renamed over it once synced, so a crash
+  // part way never leaves a truncated take where the finished one goes
+  auto tempFile = targetFile.getSiblingFile(targetFile.getFileName() +
+                                            kStitchSuffix);
+  tempFile.deleteFile();
+
+  auto result = writeStitched(tempFile, shouldAbandon);
+  if (result.wasOk()) {
+    syncToDisk(tempFile);
+    if (!replaceAtomically(tempFile, targetFile))
+      result = juce::Result::fail("Could not move stitched take to " +
+                                  targetFile.getFullPathName());
+  }
+  if (result.failed()) {
+    tempFile.deleteFile();
+    return result;
+  }
+
+  appendLineTo(segmentDir.getChildFile(kJournalFileName), kCompleteMarker);
+  segmentDir.deleteRecursively();
+  return juce::Result::ok();
+}
+
+juce::Result RecordingJournal::ClosedTake::writeStitched(
+    const juce::File &file, const std::function<bool()> &shouldAbandon) const {
+  auto stream = openStream(file, streamFactory);
+  if (!stream)
+    return juce::Result::fail("Could not open " + file.getFullPathName());
+
+  juce::WavAudioFormat wavFormat;
+  std::unique_ptr<juce::AudioFormatWriter> out(wavFormat.createWriterFor(
+      stream.get(), sampleRate, (unsigned int)numChannels, bitsPerSample, {},
+      0));
+  if (!out)
+    return juce::Result::fail("Could not create writer for " +
+                              file.getFullPathName());
+  stream.release();
+
+  for (const auto &segment : segments) {
+    if (shouldAbandon && shouldAbandon())
+      return juce::Result::fail("Stitch abandoned");
+
+    auto segmentFile = segmentDir.getChildFile(segment.fileName);
+    if (!segmentFile.existsAsFile())
+      return juce::Result::fail("Missing segment " + segment.fileName);
+
+    std::unique_ptr<juce::AudioFormatReader> reader(
+        wavFormat.createReaderFor(new juce::FileInputStream(segmentFile),
+                                  true));
+
+    if (!reader)
+      return juce::Result::fail("Unreadable segment " + segment.fileName);
+
+    // Journalled length is authoritative; never read past it
+    auto numSamples = std::min(reader->lengthInSamples, segment.numSamples);
+    if (!out->writeFromAudioReader(*reader, 0, numSamples))
+      return juce::Result::fail("Failed writing segment " + segment.fileName);
+  }
+
+  return juce::Result::ok(); // The header is fixed up as out goes
+}
+
+bool RecordingJournal::appendLine(const juce::String &line) {
+  return appendLineTo(journalFile, line);
+}
+
+bool RecordingJournal::syncToDisk(const juce::File &file) {
+#if JUCE_WINDOWS
+  // FileOutputStream::flush() already issues FlushFileBuffers on Windows
+  juce::ignoreUnused(file);
+  return true;
+#else
+  int fd = ::open(file.getFullPathName().toRawUTF8(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+#if JUCE_MAC
+  // fsync() on macOS does not reach the platter; F_FULLFSYNC does
+  bool ok = ::fcntl(fd, F_FULLFSYNC) == 0 || ::fsync(fd) == 0;
+#else
+  bool ok = ::fsync(fd) == 0;
+#endif
+
+  ::close(fd);
+  return ok;
+#endif
+}
+
+// File::moveFileTo() deletes the target first; rename(2) swaps in one step
+// so a crash leaves either the old or the new file, never neither.
+bool RecordingJournal::replaceAtomically(const juce::File &source,
+                                         const juce::File &target) {
+#if JUCE_WINDOWS
+  return source.moveFileTo(target);
+#else
+  return std::rename(source.getFullPathName().toRawUTF8(),
+                     target.getFullPathName().toRawUTF8()) == 0;
+#endif
+}
+
+} // namespace flowzone
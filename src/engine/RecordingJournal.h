@@ -0,0 +1,137 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+
+namespace flowzone {
+
+/**
+ * RecordingJournal: Crash-consistent segmented recording
+ *
+ * A recording to `take.wav` is written as fixed-length segments inside
+ * `take.wav.segments/`, plus an append-only `journal.txt` that lists every
+ * segment whose header has been finalised and synced to disk.
+ *
+ * Segment lifecycle (DiskWriter background thread only):
+ *   open seg_N → write → close (header fixup) → fsync → journal entry → fsync
+ *
+ * On a clean stop the journalled segments are stitched into the target file
+ * and the segment directory is removed. After a crash, or a stitch that
+ * failed or was abandoned, recoverInterrupted() stitches whatever the
+ * journal lists on the next launch, so at most the one open segment is
+ * lost. No fsync ever happens on the audio thread.
+ *
+ * Stitching writes a temp sibling of the target, syncs it and renames it
+ * into place, so the target is either absent or complete; a crash while
+ * stitching leaves the journal to stitch again on the next launch.
+ */
+class RecordingJournal {
+public:
+  static constexpr double kSegmentSeconds = 10.0;
+
+  // Opens the byte stream a segment is written to. Defaults to a
+  // FileOutputStream; tests and benchmarks substitute a SimulatedDisk.
+  using StreamFactory =
+      std::function<std::unique_ptr<juce::OutputStream>(const juce::File &)>;
+
+  struct Segment {
+    int index = 0;
+    juce::String fileName;
+    juce::int64 numSamples = 0;
+  };
+
+  // A take with every segment committed, ready to stitch. It carries all
+  // stitching needs, so it can run on another thread while the journal
+  // begins the next take.
+  struct ClosedTake {
+    juce::File targetFile;
+    juce::File segmentDir;
+    juce::Array<Segment> segments;
+    double sampleRate = 44100.0;
+    int numChannels = 2;
+    int bitsPerSample = 24;
+    StreamFactory streamFactory;
+
+    bool isValid() const { return segmentDir != juce::File(); }
+
+    // Stitch the segments into the target file and clean up. shouldAbandon
+    // is asked between segments; an abandoned stitch leaves the journal for
+    // recoverInterrupted().
+    juce::Result stitch(const std::function<bool()> &shouldAbandon = {}) const;
+
+  private:
+    juce::Result
+    writeStitched(const juce::File &file,
+                  const std::function<bool()> &shouldAbandon) const;
+  };
+
+  RecordingJournal() = default;
+
+  void setStreamFactory(StreamFactory factory) {
+    streamFactory = std::move(factory);
+  }
+
+  // Create the segment directory and write the journal header.
+  bool begin(const juce::File &targetFile, double sampleRate, int numChannels,
+             int bitsPerSample);
+
+  bool isActive() const { return active; }
+
+  // File the given segment should be written to.
+  juce::File getSegmentFile(int segmentIndex) const;
+
+  // Writer for a new segment (WAV, journal format). Caller owns it.
+  std::unique_ptr<juce::AudioFormatWriter> createSegmentWriter(int segmentIndex);
+
+  // Record a segment whose writer has been closed. Syncs the segment and the
+  // journal to disk before returning.
+  bool commitSegment(int segmentIndex, juce::int64 numSamples);
+
+  // End the take; stitching is left to the returned ClosedTake.
+  ClosedTake close();
+
+  // close() and stitch on the calling thread.
+  juce::Result finalise();
+
+  const juce::File &getTargetFile() const { return targetFile; }
+  int getNumCommittedSegments() const { return committedSegments.size(); }
+
+  /**
+   * Scan a directory tree for segment directories left behind by a crash or
+   * an unfinished stitch and stitch each one into its target file,
+   * replacing any there. Returns the recovered files. Run at every startup,
+   * before anything records.
+   */
+  static juce::Array<juce::File>
+  recoverInterrupted(const juce::File &searchRoot,
+                     const StreamFactory &streamFactory = {});
+
+  // Default location scanned on startup (matches the session storage root).
+  static juce::File getDefaultRecordingsRoot();
+
+  static juce::File getSegmentDirectoryFor(const juce::File &targetFile);
+
+  // Flush OS buffers for a file to stable storage.
+  static bool syncToDisk(const juce::File &file);
+
+  // Rename source over target in one step (POSIX rename semantics).
+  static bool replaceAtomically(const juce::File &source,
+                                const juce::File &target);
+
+private:
+  juce::File targetFile;
+  juce::File segmentDir;
+  juce::File journalFile;
+  double sampleRate = 44100.0;
+  int numChannels = 2;
+  int bitsPerSample = 24;
+  bool active = false;
+  juce::Array<Segment> committedSegments;
+  StreamFactory streamFactory;
+
+  bool appendLine(const juce::String &line);
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RecordingJournal)
+};
+
+} // namespace flowzone
@@ -0,0 +1,101 @@
+#include "SimulatedDisk.h"
+
+namespace flowzone {
+
+class SimulatedDisk::Stream : public juce::OutputStream {
+public:
+  explicit Stream(SimulatedDisk &d) : disk(d) {}
+
+  void flush() override {}
+
+  bool setPosition(juce::int64 newPosition) override {
+    position = newPosition; // Header fixups seek back; nothing to move
+    return true;
+  }
+
+  juce::int64 getPosition() override { return position; }
+
+  bool write(const void *, size_t numBytes) override {
+    if (!disk.consume(numBytes))
+      return false;
+
+    position += (juce::int64)numBytes;
+    return true;
+  }
+
+private:
+  SimulatedDisk &disk;
+  juce::int64 position = 0;
+};
+
+void SimulatedDisk::setProfile(const Profile &p) {
+  const juce::ScopedLock sl(lock);
+  profile = p;
+}
+
+SimulatedDisk::Profile SimulatedDisk::getProfile() const {
+  const juce::ScopedLock sl(lock);
+  return profile;
+}
+
+std::unique_ptr<juce::OutputStream>
+SimulatedDisk::createStream(const juce::File &) {
+  streamsOpened.fetch_add(1);
+  return std::make_unique<Stream>(*this);
+}
+
+SimulatedDisk::Stats SimulatedDisk::getStats() const {
+  Stats stats;
+  stats.bytesWritten = bytesWritten.load();
+  stats.failedWrites = failedWrites.load();
+  stats.streamsOpened = streamsOpened.load();
+  stats.stalledMs = (double)stalledMicros.load() / 1000.0;
+  return stats;
+}
+
+bool SimulatedDisk::consume(size_t numBytes) {
+  const auto startMs = juce::Time::getMillisecondCounterHiRes();
+
+  while (stalled.load())
+    juce::Thread::sleep(1);
+
+  double waitUntilMs;
+  {
+    const juce::ScopedLock sl(lock);
+
+    if (profile.capacityBytes > 0 &&
+        bytesWritten.load() + (juce::int64)numBytes > profile.capacityBytes) {
+      failedWrites.fetch_add(1);
+      return false; // ENOSPC
+    }
+
+    const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+    const auto scale = juce::jmax(1.0e-6, profile.timeScale);
+    waitUntilMs = juce::jmax(nowMs, nextFreeMs);
+
+    if (profile.bytesPerSecond > 0.0)
+      waitUntilMs += (double)numBytes / profile.bytesPerSecond * 1000.0 / scale;
+
+    if (profile.spikeIntervalBytes > 0) {
+      bytesSinceSpike += (juce::int64)numBytes;
+      if (bytesSinceSpike >= profile.spikeIntervalBytes) {
+        bytesSinceSpike %= profile.spikeIntervalBytes;
+        waitUntilMs += profile.spikeMs / scale;
+      }
+    }
+
+    nextFreeMs = waitUntilMs;
+    bytesWritten.fetch_add((juce::int64)numBytes);
+  }
+
+  // Sub-millisecond debt is carried in nextFreeMs and paid by a later write
+  auto remainingMs = waitUntilMs - juce::Time::getMillisecondCounterHiRes();
+  if (remainingMs >= 1.0)
+    juce::Thread::sleep((int)remainingMs);
+
+  stalledMicros.fetch_add((juce::int64)(
+      (juce::Time::getMillisecondCounterHiRes() - startMs) * 1000.0));
+  return true;
+}
+
+} // namespace flowzone
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+namespace flowzone {
+
+/**
+ * SimulatedDisk: Fault-injecting stand-in for the recording disk
+ *
+ * Hands out OutputStreams that discard their data but behave like a real
+ * (bad) disk from the writer's point of view:
+ *   - Bandwidth cap: writes block so sustained throughput never exceeds it
+ *   - Latency spikes: a write stalls for spikeMs every spikeIntervalBytes
+ *   - Stall: setStalled(true) blocks every write until released
+ *   - ENOSPC: writes fail once capacityBytes have been written
+ *
+ * All timings are in simulated time and divided by timeScale, so a benchmark
+ * can push hours of audio through in minutes with the same disk profile.
+ *
+ * Plug into DiskWriter with:
+ *   writer.setStreamFactory([&disk](const juce::File &f) {
+ *     return disk.createStream(f);
+ *   });
+ */
+class SimulatedDisk {
+public:
+  struct Profile {
+    double bytesPerSecond = 0.0;       // 0 = unlimited
+    double spikeMs = 0.0;              // Stall length of each latency spike
+    juce::int64 spikeIntervalBytes = 0; // 0 = no spikes
+    juce::int64 capacityBytes = 0;     // 0 = unlimited
+    double timeScale = 1.0;            // >1 runs faster than real time
+  };
+
+  struct Stats {
+    juce::int64 bytesWritten = 0;
+    juce::int64 failedWrites = 0;
+    int streamsOpened = 0;
+    double stalledMs = 0.0; // Real time spent blocked inside write()
+  };
+
+  SimulatedDisk() = default;
+  explicit SimulatedDisk(const Profile &p) : profile(p) {}
+
+  void setProfile(const Profile &p);
+  Profile getProfile() const;
+
+  // Block all writes until released (simulates a hung device)
+  void setStalled(bool shouldStall) { stalled.store(shouldStall); }
+
+  // Streams must not outlive the disk that created them
+  std::unique_ptr<juce::OutputStream> createStream(const juce::File &file);
+
+  Stats getStats() const;
+
+private:
+  class Stream;
+
+  mutable juce::CriticalSection lock;
+  Profile profile;
+  double nextFreeMs = 0.0; // Bandwidth pacing (shared by all streams)
+  juce::int64 bytesSinceSpike = 0;
+
+  std::atomic<bool> stalled{false};
+  std::atomic<juce::int64> bytesWritten{0};
+  std::atomic<juce::int64> failedWrites{0};
+  std::atomic<int> streamsOpened{0};
+  std::atomic<juce::int64> stalledMicros{0};
+
+  // Called by Stream::write; returns false for ENOSPC
+  bool consume(size_t numBytes);
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SimulatedDisk)
+};
+
+} // namespace flowzone
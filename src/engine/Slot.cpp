@@ -1,6 +1,7 @@
 #include "Slot.h"
 #include <JuceHeader.h>
 #include <algorithm>
+#include <cmath>
 
 namespace flowzone {
 
@@ -16,7 +17,11 @@ void Slot::prepareToPlay(double sampleRate, int samplesPerBlock) {
 }
 
 void Slot::processBlock(juce::AudioBuffer<float> &outputBuffer,
-                        int numSamples) {
+                        int numSamples, const float *volumeRamp) {
+  lastRms = 0.0f;
+  if (volumeRamp != nullptr && numSamples > 0)
+    state.volume = volumeRamp[numSamples - 1];
+
   if (state.state != "PLAYING" || state.muted || audioData.getNumSamples() == 0)
     return;
 
@@ -26,14 +31,23 @@ void Slot::processBlock(juce::AudioBuffer<float> &outputBuffer,
 
   int samplesToRead = numSamples;
   int outOffset = 0;
+  float sumSquares = 0.0f;
 
   while (samplesToRead > 0) {
     int remainingInSource = sourceSamples - playhead;
     int chunk = std::min(samplesToRead, remainingInSource);
 
     for (int ch = 0; ch < numChannels; ++ch) {
-      outputBuffer.addFrom(ch, outOffset, audioData, ch, playhead, chunk,
-                           state.volume);
+      if (volumeRamp != nullptr)
+        juce::FloatVectorOperations::addWithMultiply(
+            outputBuffer.getWritePointer(ch, outOffset),
+            audioData.getReadPointer(ch, playhead), volumeRamp + outOffset,
+            chunk);
+      else
+        outputBuffer.addFrom(ch, outOffset, audioData, ch, playhead, chunk,
+                             state.volume);
+      float rms = audioData.getRMSLevel(ch, playhead, chunk);
+      sumSquares += rms * rms * (float)chunk;
     }
 
     playhead += chunk;
@@ -44,6 +58,10 @@ void Slot::processBlock(juce::AudioBuffer<float> &outputBuffer,
     outOffset += chunk;
     samplesToRead -= chunk;
   }
+
+  if (numChannels > 0 && numSamples > 0)
+    lastRms = state.volume *
+              std::sqrt(sumSquares / (float)(numChannels * numSamples));
 }
 
 void Slot::setAudioData(const juce::AudioBuffer<float> &source) {
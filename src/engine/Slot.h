@@ -20,10 +20,13 @@ public:
   /**
    * Processes a block of audio.
    * If state is PLAYING, sums its buffer into the provided output buffer.
+   * volumeRamp, if given, is a per-sample volume for this block (a fader
+   * gesture) and leaves the volume at its last value.
    * If state is RECORDING, captures input into its buffer (handled by
    * FlowEngine/RetroBuffer).
    */
-  void processBlock(juce::AudioBuffer<float> &outputBuffer, int numSamples);
+  void processBlock(juce::AudioBuffer<float> &outputBuffer, int numSamples,
+                    const float *volumeRamp = nullptr);
 
   /**
    * Sets the audio data for this slot.
@@ -47,11 +50,15 @@ public:
   bool isFull() const { return state.state != "EMPTY"; }
   int getLengthInBars() const { return state.loopLengthBars; }
 
+  // RMS of what the last processBlock contributed (audio thread only)
+  float getLastRms() const { return lastRms; }
+
 private:
   int index;
   SlotState state;
   juce::AudioBuffer<float> audioData;
   int playhead = 0;
+  float lastRms = 0.0f;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Slot)
 };
@@ -0,0 +1,270 @@
+#include "StorageCompactor.h"
+#include "RecordingJournal.h"
+
+namespace flowzone {
+
+namespace {
+const char *const kTempSuffix = ".compact.tmp";
+} // namespace
+
+StorageCompactor::StorageCompactor() : juce::Thread("StorageCompactor") {
+  formatManager.registerBasicFormats();
+}
+
+StorageCompactor::~StorageCompactor() { stopThread(4000); }
+
+void StorageCompactor::setRoot(const juce::File &rootDirectory) {
+  const juce::ScopedLock sl(configLock);
+  root = rootDirectory;
+}
+
+void StorageCompactor::setIdleProbe(IdleProbe probe) {
+  const juce::ScopedLock sl(configLock);
+  idleProbe = std::move(probe);
+}
+
+void StorageCompactor::setOptions(const Options &newOptions) {
+  const juce::ScopedLock sl(configLock);
+  options = newOptions;
+}
+
+void StorageCompactor::start() {
+  if (!isThreadRunning())
+    startThread(juce::Thread::Priority::background);
+}
+
+void StorageCompactor::run() {
+  juce::uint32 idleSince = 0;
+  bool wasIdle = false;
+
+  while (!threadShouldExit()) {
+    wait(500);
+    if (threadShouldExit())
+      break;
+
+    if (shouldYield()) {
+      wasIdle = false;
+      continue;
+    }
+
+    auto now = juce::Time::getMillisecondCounter();
+    if (!wasIdle) {
+      wasIdle = true;
+      idleSince = now;
+      continue;
+    }
+
+    int holdMs;
+    {
+      const juce::ScopedLock sl(configLock);
+      holdMs = options.idleHoldMs;
+    }
+
+    if ((int)(now - idleSince) < holdMs)
+      continue;
+
+    auto result = compactNow();
+
+    if (result.filesCompacted > 0)
+      DBG("StorageCompactor: Compacted " << result.filesCompacted
+                                         << " files, saved "
+                                         << result.bytesSaved << " bytes");
+
+    // Nothing left (or we were interrupted): wait for a fresh idle period
+    wasIdle = false;
+  }
+}
+
+bool StorageCompactor::shouldYield() {
+  if (threadShouldExit())
+    return true;
+
+  const juce::ScopedLock sl(configLock);
+  return idleProbe && !idleProbe();
+}
+
+StorageCompactor::PassResult StorageCompactor::compactNow() {
+  PassResult result;
+
+  juce::File scanRoot;
+  juce::int64 minAge;
+  {
+    const juce::ScopedLock sl(configLock);
+    scanRoot = root;
+    minAge = options.minFileAgeMs;
+  }
+
+  if (!scanRoot.isDirectory())
+    return result;
+
+  auto manifestFile = scanRoot.getChildFile(kManifestName);
+  juce::StringArray manifest;
+  if (manifestFile.existsAsFile())
+    manifestFile.readLines(manifest);
+
+  for (const auto &file : findCandidates(manifest, scanRoot, minAge)) {
+    if (shouldYield()) {
+      result.interrupted = true;
+      break;
+    }
+
+    juce::int64 saved = 0;
+    auto outcome = compactFile(file, saved);
+
+    if (outcome == Outcome::Interrupted) {
+      result.interrupted = true;
+      break;
+    }
+
+    // A .wav that was transcoded now lives on as .flac
+    auto finalFile = file;
+    if (outcome == Outcome::Compacted && !file.existsAsFile())
+      finalFile = file.withFileExtension("flac");
+
+    auto entry = manifestEntryFor(scanRoot, finalFile);
+    manifest.add(entry);
+    manifestFile.appendText(entry + "\n", false, false, "\n");
+
+    if (outcome == Outcome::Compacted) {
+      ++result.filesCompacted;
+      result.bytesSaved += saved;
+      totalBytesSaved.fetch_add(saved);
+      totalFilesCompacted.fetch_add(1);
+    }
+  }
+
+  return result;
+}
+
+juce::Array<juce::File>
+StorageCompactor::findCandidates(const juce::StringArray &manifest,
+                                 const juce::File &scanRoot,
+                                 juce::int64 minFileAgeMs) const {
+  juce::Array<juce::File> candidates;
+  auto now = juce::Time::getCurrentTime();
+
+  for (const auto &entry : juce::RangedDirectoryIterator(
+           scanRoot, true, "*.wav;*.flac", juce::File::findFiles)) {
+    auto file = entry.getFile();
+
+    // Live takes and their journals belong to the DiskWriter
+    if (file.getFullPathName().contains(".segments"))
+      continue;
+
+    if ((now - entry.getModificationTime()).inMilliseconds() < minFileAgeMs)
+      continue;
+
+    if (manifest.contains(manifestEntryFor(scanRoot, file)))
+      continue;
+
+    // Don't clobber a FLAC that already shares the WAV's name
+    if (file.hasFileExtension("wav") &&
+        file.withFileExtension("flac").exists())
+      continue;
+
+    candidates.add(file);
+  }
+
+  return candidates;
+}
+
+StorageCompactor::Outcome
+StorageCompactor::compactFile(const juce::File &file,
+                              juce::int64 &bytesSaved) {
+  int level, chunk;
+  {
+    const juce::ScopedLock sl(configLock);
+    level = options.targetFlacLevel;
+    chunk = options.chunkSamples;
+  }
+
+  std::unique_ptr<juce::AudioFormatReader> reader(
+      formatManager.createReaderFor(file));
+
+  // FLAC is integer-only at 16/24 bit; anything else would not be lossless
+  if (!reader || reader->usesFloatingPointData ||
+      (reader->bitsPerSample != 16 && reader->bitsPerSample != 24))
+    return Outcome::Skipped;
+
+  const auto originalSize = file.getSize();
+  const auto numSamples = reader->lengthInSamples;
+  const auto numChannels = (int)reader->numChannels;
+
+  auto tempFile = file.getSiblingFile(file.getFileNameWithoutExtension() +
+                                      kTempSuffix);
+  tempFile.deleteFile();
+
+  {
+    auto stream = std::make_unique<juce::FileOutputStream>(tempFile);
+    if (stream->failedToOpen())
+      return Outcome::Skipped;
+
+    juce::FlacAudioFormat flacFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(flacFormat.createWriterFor(
+        stream.get(), reader->sampleRate, (unsigned int)numChannels,
+        (int)reader->bitsPerSample, {},
+        juce::jlimit(0, flacFormat.getQualityOptions().size() - 1, level)));
+    if (!writer)
+      return Outcome::Skipped;
+    stream.release(); // Writer owns the stream now
+
+    juce::AudioBuffer<float> buffer(numChannels, chunk);
+
+    for (juce::int64 pos = 0; pos < numSamples; pos += chunk) {
+      if (shouldYield()) {
+        writer.reset();
+        tempFile.deleteFile();
+        return Outcome::Interrupted;
+      }
+
+      auto n = (int)std::min<juce::int64>(chunk, numSamples - pos);
+      reader->read(&buffer, 0, n, pos, true, true);
+
+      if (!writer->writeFromAudioSampleBuffer(buffer, 0, n)) {
+        writer.reset();
+        tempFile.deleteFile();
+        return Outcome::Skipped;
+      }
+    }
+  }
+
+  reader.reset();
+
+  // Verify before touching the original
+  juce::FlacAudioFormat flacFormat;
+  std::unique_ptr<juce::AudioFormatReader> check(flacFormat.createReaderFor(
+      new juce::FileInputStream(tempFile), true));
+  bool valid = check != nullptr && check->lengthInSamples == numSamples &&
+               (int)check->numChannels == numChannels;
+  check.reset();
+
+  const auto newSize = tempFile.getSize();
+
+  if (!valid || newSize >= originalSize) {
+    tempFile.deleteFile();
+    return Outcome::Skipped;
+  }
+
+  RecordingJournal::syncToDisk(tempFile);
+
+  auto destination = file.withFileExtension("flac");
+  if (!RecordingJournal::replaceAtomically(tempFile, destination)) {
+    tempFile.deleteFile();
+    return Outcome::Skipped;
+  }
+
+  if (destination != file)
+    file.deleteFile();
+
+  bytesSaved = originalSize - newSize;
+  return Outcome::Compacted;
+}
+
+juce::String StorageCompactor::manifestEntryFor(const juce::File &scanRoot,
+                                                const juce::File &file) {
+  return file.getRelativePathFrom(scanRoot) + "|" +
+         juce::String(file.getSize()) + "|" +
+         juce::String(file.getLastModificationTime().toMilliseconds());
+}
+
+} // namespace flowzone
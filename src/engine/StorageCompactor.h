@@ -0,0 +1,91 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+
+namespace flowzone {
+
+/**
+ * StorageCompactor: Idle-time recompression service (Spec §4.1)
+ *
+ * Recordings are written fast (WAV / FLAC level 0) so the disk thread never
+ * falls behind. When the engine is idle this background thread re-encodes
+ * them at a higher FLAC level:
+ *   - *.flac → *.flac at targetFlacLevel (in place)
+ *   - *.wav  → *.flac at targetFlacLevel (16/24-bit integer WAV only)
+ *
+ * Each file is encoded to a temp sibling, verified by reading it back, synced
+ * and then atomically renamed over the original. The idle probe is polled
+ * between every chunk; as soon as it reports load the current file is
+ * abandoned (temp deleted, original untouched) and the service waits for the
+ * next idle period.
+ *
+ * Files that have been processed are listed in a manifest in the root so
+ * they are not re-encoded on every pass.
+ */
+class StorageCompactor : public juce::Thread {
+public:
+  // Returns true while it is safe to spend CPU and disk bandwidth
+  using IdleProbe = std::function<bool()>;
+
+  struct Options {
+    int targetFlacLevel = 8;
+    int idleHoldMs = 30000;       // Idle must persist this long before work
+    juce::int64 minFileAgeMs = 60000; // Never touch files still being written
+    int chunkSamples = 16384;
+  };
+
+  struct PassResult {
+    int filesCompacted = 0;
+    juce::int64 bytesSaved = 0;
+    bool interrupted = false;
+  };
+
+  StorageCompactor();
+  ~StorageCompactor() override;
+
+  void setRoot(const juce::File &rootDirectory);
+  void setIdleProbe(IdleProbe probe);
+  void setOptions(const Options &newOptions);
+
+  // Start the background service (background thread priority)
+  void start();
+
+  // Run one synchronous pass on the calling thread. The idle probe is still
+  // honoured between chunks.
+  PassResult compactNow();
+
+  juce::int64 getTotalBytesSaved() const { return totalBytesSaved.load(); }
+  int getTotalFilesCompacted() const { return totalFilesCompacted.load(); }
+
+  static constexpr const char *kManifestName = ".compaction_manifest";
+
+  void run() override;
+
+private:
+  enum class Outcome { Compacted, Skipped, Interrupted };
+
+  juce::CriticalSection configLock;
+  juce::File root;
+  IdleProbe idleProbe;
+  Options options;
+
+  std::atomic<juce::int64> totalBytesSaved{0};
+  std::atomic<int> totalFilesCompacted{0};
+
+  juce::AudioFormatManager formatManager;
+
+  bool shouldYield();
+  juce::Array<juce::File> findCandidates(const juce::StringArray &manifest,
+                                         const juce::File &scanRoot,
+                                         juce::int64 minFileAgeMs) const;
+  Outcome compactFile(const juce::File &file, juce::int64 &bytesSaved);
+
+  static juce::String manifestEntryFor(const juce::File &scanRoot,
+                                       const juce::File &file);
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StorageCompactor)
+};
+
+} // namespace flowzone
@@ -1,31 +1,69 @@
 #include "SynthEngine.h"
+#include <cmath>
 
 namespace flowzone {
 namespace engine {
 
 SynthEngine::SynthEngine() {
-  setupVoices();
-  synth.addSound(new SynthSound());
+  wavetables.loadOrBuild(WavetableBank::getDefaultCacheFile());
+  voices.forEachVoice([this](SynthVoice &voice) {
+    voice.setTuningManager(&tuningManager);
+    voice.setSharedModInputs(&modInputs);
+  });
 }
 
 void SynthEngine::prepare(double sampleRate, int samplesPerBlock) {
-  synth.setCurrentPlaybackSampleRate(sampleRate);
+  voices.setSampleRate(sampleRate);
   juce::ignoreUnused(samplesPerBlock);
 }
 
 void SynthEngine::process(juce::AudioBuffer<float> &buffer,
-                          juce::MidiBuffer &midiMessages) {
-  synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
-}
+                          juce::MidiBuffer &midiMessages, const float *xRamp,
+                          const float *yRamp) {
+  const int numSamples = buffer.getNumSamples();
+  voices.updateLoad(callbackLoad, numSamples);
 
-void SynthEngine::reset() {
-  for (int i = 0; i < synth.getNumVoices(); ++i) {
-    if (auto *voice = dynamic_cast<SynthVoice *>(synth.getVoice(i))) {
-      voice->stopNote(0, false);
+  int rendered = 0;
+  auto renderTo = [&](int end) {
+    while (rendered < end) {
+      int n = end - rendered;
+      // A moving pad is picked up once per control interval, which is as
+      // often as any voice reads it
+      if (xRamp != nullptr || yRamp != nullptr) {
+        n = juce::jmin(n, modulation.controlInterval);
+        setXY(xRamp != nullptr ? xRamp[rendered] : modInputs.x,
+              yRamp != nullptr ? yRamp[rendered] : modInputs.y);
+      }
+      voices.render(buffer, rendered, n);
+      rendered += n;
     }
+  };
+
+  for (const auto metadata : midiMessages) {
+    renderTo(juce::jlimit(rendered, numSamples, metadata.samplePosition));
+    handleMidiEvent(metadata.getMessage());
+  }
+  renderTo(numSamples);
+}
+
+void SynthEngine::handleMidiEvent(const juce::MidiMessage &message) {
+  if (message.isNoteOn()) {
+    // Keys the keyboard mapping leaves out stay silent
+    if (tuningManager.isNoteMapped(message.getNoteNumber()))
+      voices.noteOn(message.getNoteNumber(), message.getFloatVelocity());
   }
+  else if (message.isNoteOff())
+    voices.noteOff(message.getNoteNumber(), true);
+  else if (message.isAllNotesOff() || message.isAllSoundOff())
+    voices.allNotesOff(message.isAllNotesOff());
+  else if (message.isSustainPedalOn())
+    voices.setSustainPedal(true);
+  else if (message.isSustainPedalOff())
+    voices.setSustainPedal(false);
 }
 
+void SynthEngine::reset() { voices.allNotesOff(false); }
+
 void SynthEngine::setPreset(const juce::String &category,
                             const juce::String &presetId) {
   if (category == "bass") {
@@ -33,21 +71,23 @@ void SynthEngine::setPreset(const juce::String &category,
     if (presetId == "sub")
       applyPreset(0, 0.05f, 0.2f, 0.8f, 0.2f); // Sine, slow attack
     else if (presetId == "growl" || presetId == "gritty")
-      applyPreset(1, 0.01f, 0.1f, 1.0f, 0.05f); // Saw, fast attack
+      applyWavetablePreset("growl", 0.5f, 0.01f, 0.1f, 1.0f, 0.05f); // Driven
     else if (presetId == "deep")
       applyPreset(0, 0.1f, 0.3f, 0.7f, 0.3f); // Sine, deeper envelope
     else if (presetId == "wobble")
-      applyPreset(1, 0.001f, 0.05f, 0.9f, 0.1f); // Saw, very fast
+      applyWavetablePreset("growl", 0.2f, 0.001f, 0.05f, 0.9f, 0.1f); // Fast
     else if (presetId == "punch" || presetId == "808")
       applyPreset(2, 0.001f, 0.1f, 0.5f, 0.15f); // Square, punchy
-    else if (presetId == "fuzz" || presetId == "reese")
+    else if (presetId == "fuzz")
+      applyWavetablePreset("growl", 1.0f, 0.01f, 0.2f, 0.8f, 0.2f); // Hardest
+    else if (presetId == "reese")
       applyPreset(1, 0.01f, 0.2f, 0.8f, 0.2f); // Saw
     else if (presetId == "smooth" || presetId == "rumble")
       applyPreset(0, 0.2f, 0.4f, 0.7f, 0.3f); // Sine, smooth
     else if (presetId == "pluck-bass")
       applyPreset(1, 0.001f, 0.05f, 0.0f, 0.05f); // Saw, pluck
     else if (presetId == "acid")
-      applyPreset(2, 0.001f, 0.1f, 0.3f, 0.1f); // Square, acid
+      applyWavetablePreset("pulse", 0.3f, 0.001f, 0.1f, 0.3f, 0.1f); // Pulse
     else
       applyPreset(0, 0.05f, 0.2f, 0.8f, 0.2f); // Default: Sub
   } else {
@@ -67,57 +107,199 @@ void SynthEngine::setPreset(const juce::String &category,
     else if (presetId == "bright-lead")
       applyPreset(1, 0.001f, 0.05f, 0.8f, 0.1f); // Saw, bright
     else if (presetId == "soft-keys")
-      applyPreset(0, 0.01f, 0.2f, 0.6f, 0.3f); // Sine, soft
+      applyWavetablePreset("keys", 0.8f, 0.01f, 0.2f, 0.6f, 0.3f); // Mellow
     else if (presetId == "organ")
-      applyPreset(1, 0.001f, 0.0f, 1.0f, 0.05f); // Saw, no decay
+      applyWavetablePreset("organ", 0.0f, 0.001f, 0.0f, 1.0f, 0.05f); // 888
     else if (presetId == "ep")
-      applyPreset(0, 0.001f, 0.3f, 0.5f, 0.4f); // Sine, EP-like
+      applyWavetablePreset("keys", 0.2f, 0.001f, 0.3f, 0.5f, 0.4f); // Tine
     else if (presetId == "choir")
-      applyPreset(3, 0.6f, 1.0f, 0.9f, 1.2f); // Triangle, choir
+      applyWavetablePreset("vocal", 0.0f, 0.6f, 1.0f, 0.9f, 1.2f); // "Ah"
     else if (presetId == "arp")
-      applyPreset(2, 0.001f, 0.1f, 0.3f, 0.1f); // Square, arp
+      applyWavetablePreset("pulse", 0.5f, 0.001f, 0.1f, 0.3f, 0.1f); // Pulse
     else if (presetId == "pad")
       applyPreset(0, 0.5f, 1.0f, 0.8f, 1.0f); // Sine, pad
     else if (presetId == "lead")
       applyPreset(1, 0.01f, 0.2f, 0.5f, 0.1f); // Saw, lead
+    else if (presetId == "supersaw")
+      applyPreset(1, 0.005f, 0.3f, 0.8f, 0.3f); // Saw, full unison
     else
       applyPreset(0, 0.01f, 0.2f, 0.8f, 0.2f); // Default: Sine
   }
+
+  applyModulationPreset(category, presetId);
+  applyUnisonPreset(category, presetId);
+}
+
+void SynthEngine::applyUnisonPreset(const juce::String &category,
+                                    const juce::String &presetId) {
+  // Oscillators per note, detune in cents, stereo spread
+  int count = 1;
+  float detune = 0.0f, spread = 0.0f;
+
+  if (category == "bass") {
+    if (presetId == "reese") {
+      count = 4; // Slow beating, kept near mono for the low end
+      detune = 18.0f;
+      spread = 0.2f;
+    }
+  } else {
+    if (presetId == "supersaw") {
+      count = SynthVoice::kMaxUnison;
+      detune = 35.0f;
+      spread = 1.0f;
+    } else if (presetId == "saw-lead" || presetId == "bright-lead") {
+      count = 7;
+      detune = presetId == "bright-lead" ? 30.0f : 22.0f;
+      spread = 0.8f;
+    } else if (presetId == "lead") {
+      count = 3;
+      detune = 12.0f;
+      spread = 0.5f;
+    }
+  }
+
+  voices.forEachVoice([&](SynthVoice &voice) {
+    voice.setUnison(count, detune, spread);
+  });
 }
 
+void SynthEngine::applyModulationPreset(const juce::String &category,
+                                        const juce::String &presetId) {
+  using Source = SynthModMatrix::Source;
+  using Destination = SynthModMatrix::Destination;
+  using LfoShape = SynthModMatrix::Lfo::Shape;
+
+  // Presets without routes or a filter render as plain oscillators
+  auto interval = modulation.controlInterval;
+  modulation = {};
+  modulation.controlInterval = interval;
+  filterCutoff = 20000.0f;
+  filterResonance = 0.707f;
+  auto &m = modulation;
+
+  if (category == "bass") {
+    if (presetId == "wobble") {
+      m.lfos[0] = {LfoShape::Sine, 2.0f}; // Filter wobble
+      m.addRoute(Source::Lfo1, Destination::Cutoff, 2.5f);
+      m.addRoute(Source::X, Destination::WavetablePosition, 0.3f);
+      m.addRoute(Source::Y, Destination::Cutoff, 1.5f);
+      filterCutoff = 350.0f;
+      filterResonance = 4.0f;
+    } else if (presetId == "acid") {
+      m.modEnvelope = {0.001f, 0.25f, 0.0f, 0.1f}; // Filter sweep per note
+      m.addRoute(Source::ModEnvelope, Destination::Cutoff, 4.0f);
+      m.addRoute(Source::Velocity, Destination::Cutoff, 1.5f);
+      m.addRoute(Source::Y, Destination::Cutoff, 1.5f);
+      m.addRoute(Source::X, Destination::WavetablePosition, 0.3f);
+      filterCutoff = 250.0f;
+      filterResonance = 7.0f;
+    } else if (presetId == "growl" || presetId == "gritty" ||
+               presetId == "fuzz") {
+      m.addRoute(Source::X, Destination::WavetablePosition, 0.5f); // Drive
+      m.addRoute(Source::Y, Destination::Cutoff, 2.0f);
+      filterCutoff = 2500.0f;
+    }
+  } else {
+    if (presetId == "choir") {
+      m.lfos[0] = {LfoShape::Sine, 5.0f}; // Vibrato
+      m.addRoute(Source::Lfo1, Destination::Pitch, 0.15f);
+      m.addRoute(Source::X, Destination::WavetablePosition, 0.5f); // Vowel
+      m.addRoute(Source::Y, Destination::Amp, 0.3f);
+    } else if (presetId == "soft-keys" || presetId == "ep") {
+      m.addRoute(Source::Velocity, Destination::Cutoff, 3.0f);
+      m.addRoute(Source::X, Destination::WavetablePosition, 0.4f);
+      m.lfos[0] = {LfoShape::Sine, 4.0f}; // Gentle tremolo
+      m.addRoute(Source::Lfo1, Destination::Amp, 0.2f);
+      filterCutoff = 1200.0f;
+    } else if (presetId == "arp") {
+      m.lfos[0] = {LfoShape::Triangle, 0.25f}; // Pulse width
+      m.addRoute(Source::Lfo1, Destination::WavetablePosition, 0.4f);
+      m.addRoute(Source::Y, Destination::Cutoff, 2.0f);
+      filterCutoff = 3000.0f;
+    } else if (presetId == "warm-pad") {
+      m.lfos[0] = {LfoShape::Triangle, 0.2f}; // Slow swell
+      m.addRoute(Source::Lfo1, Destination::Amp, 0.15f);
+      m.lfos[1] = {LfoShape::Sine, 4.5f}; // Slight drift
+      m.addRoute(Source::Lfo2, Destination::Pitch, 0.05f);
+    } else if (presetId == "saw-lead" || presetId == "lead" ||
+               presetId == "bright-lead" || presetId == "supersaw") {
+      m.lfos[0] = {LfoShape::Sine, 5.5f}; // Vibrato
+      m.addRoute(Source::Lfo1, Destination::Pitch, 0.1f);
+      m.addRoute(Source::Y, Destination::Cutoff, 2.0f);
+      m.addRoute(Source::X, Destination::Pitch, 0.5f); // Bend
+      filterCutoff = 5000.0f;
+      filterResonance = 1.5f;
+    }
+  }
+
+  applyModulation();
+  applyFilter();
+}
 void SynthEngine::setTuning(const juce::String &sclContent) {
   tuningManager.loadScl(sclContent);
 }
 
+bool SynthEngine::setKeyboardMapping(const juce::String &kbmContent) {
+  return tuningManager.loadKbm(kbmContent);
+}
+
 void SynthEngine::setGlobalPitchRatio(float ratio) {
-  for (int i = 0; i < synth.getNumVoices(); ++i) {
-    if (auto *voice = dynamic_cast<SynthVoice *>(synth.getVoice(i))) {
-      voice->setPitchRatio(ratio);
-    }
-  }
+  voices.forEachVoice([&](SynthVoice &voice) {
+    voice.setPitchRatio(ratio);
+  });
 }
 
 void SynthEngine::setParameter(int index, float value) {
-  juce::ignoreUnused(index, value);
+  // Same mappings as dsp::StateVariableFilter::setParameter
+  if (index == 0)
+    filterCutoff = 20.0f * std::pow(1000.0f, juce::jlimit(0.0f, 1.0f, value));
+  else if (index == 1)
+    filterResonance = 0.5f + juce::jlimit(0.0f, 1.0f, value) * 9.5f;
+  else
+    return;
+  applyFilter();
 }
 
-void SynthEngine::setupVoices() {
-  synth.clearVoices();
-  for (int i = 0; i < maxVoices; ++i) {
-    auto *voice = new SynthVoice();
-    voice->setTuningManager(&tuningManager);
-    synth.addVoice(voice);
-  }
+void SynthEngine::setXY(float x, float y) {
+  modInputs.x = juce::jlimit(0.0f, 1.0f, x);
+  modInputs.y = juce::jlimit(0.0f, 1.0f, y);
+}
+
+void SynthEngine::setControlInterval(int samples) {
+  modulation.controlInterval = juce::jlimit(1, 64, samples);
+  applyModulation();
+}
+
+void SynthEngine::applyModulation() {
+  voices.forEachVoice([&](SynthVoice &voice) {
+    voice.setModulation(modulation);
+  });
+}
+
+void SynthEngine::applyFilter() {
+  voices.forEachVoice([&](SynthVoice &voice) {
+    voice.setFilter(filterCutoff, filterResonance);
+  });
 }
 
 void SynthEngine::applyPreset(int oscType, float attack, float decay,
                               float sustain, float release) {
-  for (int i = 0; i < synth.getNumVoices(); ++i) {
-    if (auto *voice = dynamic_cast<SynthVoice *>(synth.getVoice(i))) {
-      voice->setOscillatorType(oscType);
-      voice->setADSR(attack, decay, sustain, release);
-    }
-  }
+  voices.forEachVoice([&](SynthVoice &voice) {
+    voice.setOscillatorType(oscType);
+    voice.setADSR(attack, decay, sustain, release);
+  });
+}
+
+void SynthEngine::applyWavetablePreset(const char *wavetable, float position,
+                                       float attack, float decay,
+                                       float sustain, float release) {
+  const auto *table = wavetables.find(wavetable);
+  jassert(table != nullptr);
+  voices.forEachVoice([&](SynthVoice &voice) {
+    voice.setWavetable(table, position);
+    voice.setOscillatorType(table != nullptr ? 4 : 1);
+    voice.setADSR(attack, decay, sustain, release);
+  });
 }
 
 } // namespace engine
@@ -1,7 +1,7 @@
 #pragma once
 
-#include "SynthSound.h"
-#include "SynthVoice.h"
+#include "SynthVoiceAllocator.h"
+#include "WavetableBank.h"
 #include <JuceHeader.h>
 
 namespace flowzone {
@@ -9,29 +9,73 @@ namespace engine {
 
 /**
  * @brief Main Synth Engine managing polyphony and presets.
+ *
+ * MIDI is applied at its sample position within the block: the voices are
+ * rendered up to each event, then the event is handled. An XY gesture
+ * passed to process() is read at control rate, as the voices read the pad.
  */
 class SynthEngine {
 public:
   SynthEngine();
 
   void prepare(double sampleRate, int samplesPerBlock);
+
+  // xRamp and yRamp, if set, hold the XY pad's position per sample of the
+  // block (a GestureStream's output)
   void process(juce::AudioBuffer<float> &buffer,
-               juce::MidiBuffer &midiMessages);
+               juce::MidiBuffer &midiMessages, const float *xRamp = nullptr,
+               const float *yRamp = nullptr);
   void reset();
 
   void setPreset(const juce::String &category, const juce::String &presetId);
+
+  // index 0: filter cutoff, 1: resonance (both normalised 0-1)
   void setParameter(int index, float value);
+
+  // XY pad position, [0, 1] each; a modulation source for every voice
+  void setXY(float x, float y);
+  const SynthModMatrix::SharedInputs &getXY() const { return modInputs; }
+
+  // Samples between modulation updates (1-64, 32 by default)
+  void setControlInterval(int samples);
+
+  // The audio callback's measured load (0..1 of its time budget), once per
+  // block before process(); the voice cap follows it
+  void setCallbackLoad(double proportion) { callbackLoad = proportion; }
+
+  int getNumActiveVoices() const { return voices.getNumActive(); }
+  int getVoiceCap() const { return voices.getVoiceCap(); }
   void setGlobalPitchRatio(float ratio);
+
+  // Scala scale and keyboard mapping. Safe while audio runs: the next
+  // note-ons read the new tuning; sounding notes keep theirs.
   void setTuning(const juce::String &sclContent);
+  bool setKeyboardMapping(const juce::String &kbmContent);
 
 private:
-  juce::Synthesiser synth;
+  SynthVoiceAllocator voices;
   TuningManager tuningManager;
-  int maxVoices = 16;
+  WavetableBank wavetables; // Loaded once; voices read it concurrently
+  double callbackLoad = 0.0;
+
+  // The current preset's modulation and filter, copied into every voice
+  SynthModMatrix::Settings modulation;
+  SynthModMatrix::SharedInputs modInputs;
+  float filterCutoff = 20000.0f;
+  float filterResonance = 0.707f;
 
-  void setupVoices();
+  void handleMidiEvent(const juce::MidiMessage &message);
   void applyPreset(int oscType, float attack, float decay, float sustain,
                    float release);
+  void applyWavetablePreset(const char *wavetable, float position,
+                            float attack, float decay, float sustain,
+                            float release);
+  void applyModulationPreset(const juce::String &category,
+                             const juce::String &presetId);
+  void applyUnisonPreset(const juce::String &category,
+                         const juce::String &presetId);
+  void applyModulation();
+  void applyFilter();
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthEngine)
 };
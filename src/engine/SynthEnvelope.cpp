@@ -0,0 +1,177 @@
+#include "SynthEnvelope.h"
+#include <cmath>
+#include <limits>
+
+namespace flowzone {
+namespace engine {
+
+namespace {
+
+// Per-sample step covering distance in timeSeconds; 0 for an instant stage
+float rateFor(float distance, float timeSeconds, double sampleRate) {
+  return timeSeconds > 0.0f ? (float)(distance / (timeSeconds * sampleRate))
+                            : 0.0f;
+}
+
+// Samples a ramp of rate takes to cover distance, counting the one that
+// lands on the target
+int samplesToCover(float distance, float rate) {
+  if (distance <= 0.0f)
+    return 1;
+  auto samples = std::ceil(distance / rate);
+  return samples < 1.0e9f ? juce::jmax(1, (int)samples) : 1000000000;
+}
+
+// out[i] = start + step * (i + 1)
+void ramp(float *out, int numSamples, float start, float step) {
+  for (int i = 0; i < numSamples; ++i)
+    out[i] = start + step * (float)(i + 1);
+}
+
+} // namespace
+
+void SynthEnvelope::setSampleRate(double newSampleRate) {
+  jassert(newSampleRate > 0.0);
+  sampleRate = newSampleRate;
+  updateRates();
+}
+
+void SynthEnvelope::setParameters(const juce::ADSR::Parameters &newParameters) {
+  parameters = newParameters;
+  updateRates();
+}
+
+void SynthEnvelope::updateRates() {
+  attackRate = rateFor(1.0f, parameters.attack, sampleRate);
+  decayRate = rateFor(1.0f - parameters.sustain, parameters.decay, sampleRate);
+  releaseRate = rateFor(parameters.sustain, parameters.release, sampleRate);
+
+  // Stages whose time went to zero end now
+  if (stage == Stage::Attack && attackRate <= 0.0f) {
+    value = 1.0f;
+    startDecayOrSustain();
+  } else if (stage == Stage::Decay &&
+             (decayRate <= 0.0f || value <= parameters.sustain)) {
+    value = parameters.sustain;
+    stage = Stage::Sustain;
+  } else if (stage == Stage::Sustain) {
+    value = parameters.sustain;
+  } else if (stage == Stage::Release && releaseRate <= 0.0f) {
+    reset();
+  }
+}
+
+void SynthEnvelope::startDecayOrSustain() {
+  if (decayRate > 0.0f && value > parameters.sustain) {
+    stage = Stage::Decay;
+  } else {
+    value = parameters.sustain;
+    stage = Stage::Sustain;
+  }
+}
+
+void SynthEnvelope::noteOn() {
+  // Retriggers ramp up from wherever the envelope is
+  if (attackRate > 0.0f) {
+    stage = Stage::Attack;
+  } else {
+    value = 1.0f;
+    startDecayOrSustain();
+  }
+}
+
+void SynthEnvelope::noteOff() {
+  if (stage == Stage::Idle)
+    return;
+
+  if (parameters.release > 0.0f) {
+    releaseRate = (float)(value / (parameters.release * sampleRate));
+    stage = Stage::Release;
+  } else {
+    reset();
+  }
+}
+
+void SynthEnvelope::reset() {
+  value = 0.0f;
+  stage = Stage::Idle;
+}
+
+float SynthEnvelope::getSlope() const {
+  switch (stage) {
+  case Stage::Attack:
+    return attackRate;
+  case Stage::Decay:
+    return -decayRate;
+  case Stage::Release:
+    return -releaseRate;
+  default:
+    return 0.0f;
+  }
+}
+
+float SynthEnvelope::getTarget() const {
+  switch (stage) {
+  case Stage::Attack:
+    return 1.0f;
+  case Stage::Decay:
+    return parameters.sustain;
+  case Stage::Release:
+    return 0.0f;
+  default:
+    return value;
+  }
+}
+
+int SynthEnvelope::getSamplesInStage() const {
+  switch (stage) {
+  case Stage::Attack:
+    return samplesToCover(1.0f - value, attackRate);
+  case Stage::Decay:
+    return samplesToCover(value - parameters.sustain, decayRate);
+  case Stage::Release:
+    return samplesToCover(value, releaseRate);
+  default:
+    return std::numeric_limits<int>::max();
+  }
+}
+
+void SynthEnvelope::render(float *out, int numSamples) {
+  int done = 0;
+  while (done < numSamples) {
+    int remaining = numSamples - done;
+    float *dest = out != nullptr ? out + done : nullptr;
+
+    if (stage == Stage::Idle || stage == Stage::Sustain) {
+      if (dest != nullptr)
+        juce::FloatVectorOperations::fill(dest, value, remaining);
+      return;
+    }
+
+    // The ramp's end can fall inside the block
+    int toEnd = getSamplesInStage();
+    int n = juce::jmin(remaining, toEnd);
+    float slope = getSlope();
+    if (dest != nullptr)
+      ramp(dest, n, value, slope);
+    value += slope * (float)n;
+
+    if (n == toEnd) {
+      // Land exactly on the stage's target, then move on
+      float target = getTarget();
+      if (dest != nullptr)
+        dest[n - 1] = target;
+      value = target;
+      if (stage == Stage::Attack)
+        startDecayOrSustain();
+      else if (stage == Stage::Decay)
+        stage = Stage::Sustain;
+      else
+        reset();
+    }
+    done += n;
+  }
+}
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief Linear ADSR rendered a block at a time.
+ *
+ * Same stages and timing as juce::ADSR, but render() writes each stage's
+ * stretch of the block as one ramp instead of stepping a state machine per
+ * sample. Held notes sit in sustain, where the envelope is a constant and
+ * callers can skip the buffer altogether (isConstant()).
+ */
+class SynthEnvelope {
+public:
+  void setSampleRate(double newSampleRate);
+  void setParameters(const juce::ADSR::Parameters &newParameters);
+
+  void noteOn();
+  void noteOff();
+  void reset();
+
+  bool isActive() const { return stage != Stage::Idle; }
+
+  // True in sustain: every sample of the next block is getValue()
+  bool isConstant() const { return stage == Stage::Sustain; }
+  float getValue() const { return value; }
+
+  // Change per sample through the current stage, the value it ends on,
+  // and the samples left in it counting the one that lands on that (very
+  // many while held or idle): for callers that ramp the envelope
+  // themselves (SynthVoicePack). The last step can overshoot the target.
+  float getSlope() const;
+  float getTarget() const;
+  int getSamplesInStage() const;
+
+  // Writes the next numSamples envelope values to out; zeros once idle.
+  // With out null it only advances.
+  void render(float *out, int numSamples);
+
+private:
+  enum class Stage { Idle, Attack, Decay, Sustain, Release };
+
+  juce::ADSR::Parameters parameters;
+  double sampleRate = 44100.0;
+  Stage stage = Stage::Idle;
+  float value = 0.0f;
+  float attackRate = 0.0f, decayRate = 0.0f, releaseRate = 0.0f;
+
+  void updateRates();
+  void startDecayOrSustain();
+};
+
+} // namespace engine
+} // namespace flowzone
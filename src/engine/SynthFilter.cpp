@@ -0,0 +1,108 @@
+#include "SynthFilter.h"
+#include <cmath>
+
+namespace flowzone {
+namespace engine {
+
+void SynthFilter::setSampleRate(double newSampleRate) {
+  jassert(newSampleRate > 0.0);
+  sampleRate = newSampleRate;
+}
+
+void SynthFilter::setResonance(float q) {
+  k = 1.0f / juce::jlimit(0.5f, 10.0f, q);
+  setCutoff(cutoff);
+}
+
+SynthFilter::Coefficients
+SynthFilter::coefficientsFor(float frequencyHz) const {
+  auto maxHz = juce::jmin(20000.0f, (float)(0.45 * sampleRate));
+  auto hz = juce::jlimit(20.0f, maxHz, frequencyHz);
+  auto g = (float)std::tan(juce::MathConstants<double>::pi * hz / sampleRate);
+
+  Coefficients c;
+  c.a1 = 1.0f / (1.0f + g * (g + k));
+  c.a2 = g * c.a1;
+  c.a3 = g * c.a2;
+  return c;
+}
+
+void SynthFilter::setCutoff(float frequencyHz) {
+  cutoff = frequencyHz;
+  current = target = coefficientsFor(frequencyHz);
+  rampRemaining = 0;
+}
+
+void SynthFilter::rampCutoff(float frequencyHz, int numSamples) {
+  if (numSamples <= 0) {
+    setCutoff(frequencyHz);
+    return;
+  }
+  cutoff = frequencyHz;
+  target = coefficientsFor(frequencyHz);
+  auto n = (float)numSamples;
+  step = {(target.a1 - current.a1) / n, (target.a2 - current.a2) / n,
+          (target.a3 - current.a3) / n};
+  rampRemaining = numSamples;
+}
+
+void SynthFilter::reset() { ic1 = ic2 = 0.0f; }
+
+void SynthFilter::process(float *samples, int numSamples) {
+  // The ramp's end can fall inside the block
+  if (rampRemaining > 0) {
+    int n = juce::jmin(numSamples, rampRemaining);
+    processRamp(samples, n, true);
+    rampRemaining -= n;
+    if (rampRemaining == 0)
+      current = target; // No drift from summing the steps
+    samples += n;
+    numSamples -= n;
+  }
+  if (numSamples > 0)
+    processRamp(samples, numSamples, false);
+}
+
+SynthFilter::State SynthFilter::getState() const {
+  return {ic1, ic2, current, rampRemaining > 0 ? step : Coefficients{0, 0, 0}};
+}
+
+void SynthFilter::setState(const State &state, int numSamples) {
+  jassert(rampRemaining == 0 || numSamples <= rampRemaining);
+  ic1 = state.s1;
+  ic2 = state.s2;
+  current = state.coefficients;
+  if (rampRemaining > 0) {
+    rampRemaining = juce::jmax(0, rampRemaining - numSamples);
+    if (rampRemaining == 0)
+      current = target;
+  }
+}
+
+void SynthFilter::processRamp(float *samples, int numSamples, bool ramping) {
+  // The usual form (v3 = x - ic2, v1 = a1 ic1 + a2 v3, v2 = ic2 + a2 ic1 +
+  // a3 v3, then ic = 2 v - ic) expanded so each new state is a weighted
+  // sum of the old ones and the input
+  float s1 = ic1, s2 = ic2;
+  Coefficients c = current;
+  for (int i = 0; i < numSamples; ++i) {
+    if (ramping) {
+      c.a1 += step.a1;
+      c.a2 += step.a2;
+      c.a3 += step.a3;
+    }
+    float x = samples[i];
+    float twoA2 = c.a2 + c.a2, twoA3 = c.a3 + c.a3;
+    float lp = c.a2 * s1 + (1.0f - c.a3) * s2 + c.a3 * x;
+    float next1 = (c.a1 + c.a1 - 1.0f) * s1 + twoA2 * (x - s2);
+    s2 = twoA2 * s1 + (1.0f - twoA3) * s2 + twoA3 * x;
+    s1 = next1;
+    samples[i] = lp;
+  }
+  ic1 = s1;
+  ic2 = s2;
+  current = c;
+}
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief Per-voice resonant lowpass: a topology-preserving (TPT) state
+ * variable filter, as in juce::dsp::StateVariableTPTFilter but mono and
+ * with a cutoff that can glide.
+ *
+ * The update is rearranged so each state variable is one multiply-add of
+ * the previous two, which keeps the per-sample dependency chain short.
+ * rampCutoff() moves the coefficients linearly to those of the new cutoff
+ * over the next numSamples samples, which is how SynthVoice applies
+ * control-rate cutoff modulation without zipper noise or a tan() per
+ * sample.
+ */
+class SynthFilter {
+public:
+  void setSampleRate(double newSampleRate);
+
+  // Q, clamped to [0.5, 10]; applies at once
+  void setResonance(float q);
+
+  // Jumps to frequencyHz, clamped to [20 Hz, 0.45 * sample rate]
+  void setCutoff(float frequencyHz);
+
+  // Glides to frequencyHz over the next numSamples processed samples
+  void rampCutoff(float frequencyHz, int numSamples);
+
+  void reset();
+
+  // Filters numSamples samples in place
+  void process(float *samples, int numSamples);
+
+  struct Coefficients {
+    float a1 = 1.0f, a2 = 0.0f, a3 = 0.0f;
+  };
+
+  // Everything process() reads and writes, so SynthVoicePack can run
+  // several voices' filters side by side: step is zero unless ramping, and
+  // the ramp's end (getRampRemaining()) mustn't fall inside the block
+  struct State {
+    float s1 = 0.0f, s2 = 0.0f;
+    Coefficients coefficients, step;
+  };
+
+  State getState() const;
+  int getRampRemaining() const { return rampRemaining; }
+
+  // Takes back the state after numSamples processed outside
+  void setState(const State &state, int numSamples);
+
+private:
+
+  double sampleRate = 44100.0;
+  float k = 1.0f / 0.707f; // 1 / Q
+  float cutoff = 20000.0f;
+  Coefficients current, target, step; // step: change per sample
+  int rampRemaining = 0;
+  float ic1 = 0.0f, ic2 = 0.0f;
+
+  Coefficients coefficientsFor(float frequencyHz) const;
+  void processRamp(float *samples, int numSamples, bool ramping);
+};
+
+} // namespace engine
+} // namespace flowzone
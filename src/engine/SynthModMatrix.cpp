@@ -0,0 +1,96 @@
+#include "SynthModMatrix.h"
+#include <cmath>
+
+namespace flowzone {
+namespace engine {
+
+namespace {
+
+// Bipolar, [-1, 1], phase in cycles
+float lfoValue(SynthModMatrix::Lfo::Shape shape, float phase) {
+  using Shape = SynthModMatrix::Lfo::Shape;
+  switch (shape) {
+  case Shape::Sine:
+    return std::sin(juce::MathConstants<float>::twoPi * phase);
+  case Shape::Triangle:
+    return 1.0f - 4.0f * std::abs(phase - 0.5f);
+  case Shape::Saw:
+    return phase + phase - 1.0f;
+  case Shape::Square:
+    return phase < 0.5f ? 1.0f : -1.0f;
+  }
+  return 0.0f;
+}
+
+} // namespace
+
+bool SynthModMatrix::Settings::addRoute(Source source, Destination destination,
+                                        float amount) {
+  if (numRoutes >= kMaxRoutes)
+    return false;
+  routes[(size_t)numRoutes++] = {source, destination, amount};
+  return true;
+}
+
+bool SynthModMatrix::Settings::targets(Destination destination) const {
+  for (int i = 0; i < numRoutes; ++i)
+    if (routes[(size_t)i].destination == destination)
+      return true;
+  return false;
+}
+
+void SynthModMatrix::setSettings(const Settings &newSettings) {
+  settings = newSettings;
+  settings.controlInterval = juce::jlimit(1, 64, settings.controlInterval);
+  modEnvelope.setParameters(settings.modEnvelope);
+  updateRates();
+}
+
+void SynthModMatrix::setSampleRate(double newSampleRate) {
+  jassert(newSampleRate > 0.0);
+  sampleRate = newSampleRate;
+  updateRates();
+}
+
+void SynthModMatrix::updateRates() {
+  double controlRate = sampleRate / settings.controlInterval;
+  for (size_t i = 0; i < lfoIncrements.size(); ++i)
+    lfoIncrements[i] = (float)(settings.lfos[i].rateHz / controlRate);
+  modEnvelope.setSampleRate(controlRate);
+}
+
+void SynthModMatrix::noteOn(float newVelocity) {
+  velocity = newVelocity;
+  lfoPhases.fill(0.0f);
+  modEnvelope.reset();
+  modEnvelope.noteOn();
+}
+
+void SynthModMatrix::noteOff() { modEnvelope.noteOff(); }
+
+void SynthModMatrix::evaluate(float ampEnvelope, const SharedInputs &shared,
+                              float (&out)[kNumDestinations]) {
+  float sources[] = {lfoValue(settings.lfos[0].shape, lfoPhases[0]),
+                     lfoValue(settings.lfos[1].shape, lfoPhases[1]),
+                     ampEnvelope,
+                     modEnvelope.getValue(),
+                     velocity,
+                     shared.x * 2.0f - 1.0f,
+                     shared.y * 2.0f - 1.0f};
+
+  std::fill(out, out + kNumDestinations, 0.0f);
+  for (int i = 0; i < settings.numRoutes; ++i) {
+    const auto &route = settings.routes[(size_t)i];
+    out[(int)route.destination] += route.amount * sources[(int)route.source];
+  }
+
+  for (size_t i = 0; i < lfoPhases.size(); ++i) {
+    lfoPhases[i] += lfoIncrements[i];
+    lfoPhases[i] -= std::floor(lfoPhases[i]);
+  }
+  float next;
+  modEnvelope.render(&next, 1);
+}
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "SynthEnvelope.h"
+#include <JuceHeader.h>
+#include <array>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief Per-voice modulation: a few sources routed to a few destinations
+ * with an amount each.
+ *
+ * Sources are evaluated at control rate, once every controlInterval
+ * samples, and the voice interpolates each destination linearly to the new
+ * value over the following interval. So an LFO or envelope sweep costs a
+ * handful of operations per 16 or 32 samples instead of per sample, and
+ * the destinations still move smoothly.
+ *
+ * LFOs and the XY pad are bipolar (-1 to 1, the pad 0 at its centre), the
+ * envelopes and velocity 0 to 1. Destination units: Pitch in semitones,
+ * Cutoff in octaves, Amp as a gain offset from 1, WavetablePosition as an
+ * offset on the preset's position.
+ */
+class SynthModMatrix {
+public:
+  enum class Source { Lfo1, Lfo2, AmpEnvelope, ModEnvelope, Velocity, X, Y };
+  enum class Destination { Pitch, Cutoff, Amp, WavetablePosition };
+  static constexpr int kNumDestinations = 4;
+  static constexpr int kMaxRoutes = 8;
+
+  struct Route {
+    Source source = Source::Lfo1;
+    Destination destination = Destination::Pitch;
+    float amount = 0.0f;
+  };
+
+  struct Lfo {
+    enum class Shape { Sine, Triangle, Saw, Square };
+    Shape shape = Shape::Sine;
+    float rateHz = 1.0f;
+  };
+
+  // What a preset sets; every voice keeps a copy
+  struct Settings {
+    int controlInterval = 32; // Samples between source evaluations
+    std::array<Lfo, 2> lfos;
+    juce::ADSR::Parameters modEnvelope{0.0f, 0.5f, 0.0f, 0.5f};
+    std::array<Route, kMaxRoutes> routes;
+    int numRoutes = 0;
+
+    // False if the routes are full
+    bool addRoute(Source source, Destination destination, float amount);
+    bool targets(Destination destination) const;
+  };
+
+  // Sources every voice shares, written by the engine on the audio thread.
+  // The pad's raw position, [0, 1] on each axis.
+  struct SharedInputs {
+    float x = 0.5f;
+    float y = 0.5f;
+  };
+
+  void setSettings(const Settings &newSettings);
+  const Settings &getSettings() const { return settings; }
+  void setSampleRate(double newSampleRate);
+
+  // True if any route is set; voices skip the matrix entirely otherwise
+  bool isActive() const { return settings.numRoutes > 0; }
+
+  // LFOs restart with the note, the mod envelope follows the amp envelope
+  void noteOn(float velocity);
+  void noteOff();
+
+  /**
+   * @brief Evaluates every source and sums the routes into out, indexed by
+   * Destination, then advances the LFOs and mod envelope by one control
+   * interval.
+   */
+  void evaluate(float ampEnvelope, const SharedInputs &shared,
+                float (&out)[kNumDestinations]);
+
+private:
+  Settings settings;
+  double sampleRate = 44100.0;
+  std::array<float, 2> lfoPhases{};
+  std::array<float, 2> lfoIncrements{}; // Cycles per control interval
+  SynthEnvelope modEnvelope;            // Runs at control rate
+  float velocity = 0.0f;
+
+  void updateRates();
+};
+
+} // namespace engine
+} // namespace flowzone
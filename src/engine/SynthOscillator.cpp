@@ -0,0 +1,344 @@
+#include "SynthOscillator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace flowzone {
+namespace engine {
+
+namespace {
+
+using Vec = juce::dsp::SIMDRegister<float>;
+constexpr int kLanes = (int)Vec::SIMDNumElements;
+
+// 0, 1, 2, ... for building per-lane offsets
+alignas(Vec::SIMDRegisterSize) constexpr float kLaneIndex[] = {
+    0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+    8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f};
+static_assert(kLanes <= 16);
+
+inline Vec wrap(Vec p) { return p - Vec::truncate(p); } // p >= 0
+
+// sin(2 pi p) for p in [0, 1), without branches or selects:
+// sin(2 pi p) = sin(2 pi x) with x = 0.25 - |wrap(p + 0.25) - 0.5|, which
+// is in [-0.25, 0.25], where Taylor to x^9 is within 4e-6 (-108 dB)
+inline Vec sinCycles(Vec p) {
+  Vec x = Vec::expand(0.25f) - Vec::abs(wrap(p + 0.25f) - 0.5f);
+  Vec y = x * juce::MathConstants<float>::twoPi;
+  Vec y2 = y * y;
+  Vec s = Vec::expand(2.7557319e-6f);
+  s = s * y2 - 1.9841270e-4f;
+  s = s * y2 + 8.3333333e-3f;
+  s = s * y2 - 1.6666667e-1f;
+  s = s * y2 + 1.0f;
+  return y * s;
+}
+
+// Polynomial residuals for a step of 2 (BLEP) and its integral (BLAMP) at
+// phase 0, spread over the sample either side of it. Zero elsewhere.
+float polyBlep(float t, float dt) {
+  if (t < dt) {
+    t /= dt; // [0, 1) in the first sample
+    return t + t - t * t - 1.0f;
+  }
+  if (t > 1.0f - dt) {
+    t = (t - 1.0f) / dt; // (-1, 0] in the last sample
+    return t * t + t + t + 1.0f;
+  }
+  return 0.0f;
+}
+
+float polyBlamp(float t, float dt) {
+  if (t < dt) {
+    t = t / dt - 1.0f;
+    return -t * t * t * (1.0f / 3.0f);
+  }
+  if (t > 1.0f - dt) {
+    t = (t - 1.0f) / dt + 1.0f;
+    return t * t * t * (1.0f / 3.0f);
+  }
+  return 0.0f;
+}
+
+// The triangle's corners turn by a slope proportional to dt
+float scaledBlamp(float t, float dt) { return dt * polyBlamp(t, dt); }
+
+/*
+  Adds scale * residual to the samples around each point in the block
+  where the phase passes edge. There are at most a few of these per block,
+  so this is scalar and only touches those samples: the shape itself was
+  rendered naively, in SIMD, over the whole block.
+
+  Starts from the edge before the block, whose residual reaches into its
+  first sample. Each sample is corrected once, with the residual for its
+  own phase and increment, so windows that overlap at high notes don't
+  double up.
+
+  While gliding (incrementStep per sample) the edges are located with the
+  block's mean increment. The phase strays from that line by at most
+  incrementStep * n^2 / 8, and each window is widened to cover it.
+*/
+template <typename Residual>
+void addResiduals(float *block, const float *phases, int numSamples,
+                  float startPhase, float increment, float incrementStep,
+                  float edge, float scale, Residual residual) {
+  float meanIncrement = increment;
+  int slack = 0;
+  if (incrementStep != 0.0f) {
+    auto n = (float)numSamples;
+    meanIncrement += incrementStep * (n + 1.0f) * 0.5f;
+    if (meanIncrement > 0.0f)
+      slack = (int)std::ceil(std::abs(incrementStep) * n * n * 0.125f /
+                             meanIncrement);
+  }
+  if (meanIncrement <= 0.0f)
+    return;
+
+  const float period = 1.0f / meanIncrement;
+  float untilEdge = edge - startPhase;
+  if (untilEdge < 0.0f)
+    untilEdge += 1.0f;
+
+  int corrected = 0;
+  for (float at = untilEdge * period - period; at < (float)numSamples + 1.0f;
+       at += period) {
+    auto sample = (int)std::floor(at);
+    int end = juce::jmin(numSamples, sample + 3 + slack);
+    for (int i = juce::jmax(corrected, sample - 1 - slack); i < end; ++i) {
+      float t = phases[i] - edge;
+      float dt = increment + incrementStep * ((float)i + 0.5f);
+      block[i] += scale * residual(t < 0.0f ? t + 1.0f : t, dt);
+    }
+    corrected = juce::jmax(corrected, end);
+  }
+}
+
+} // namespace
+
+void SynthOscillator::setFrequency(double frequencyHz, double sampleRate) {
+  auto cycles = sampleRate > 0.0 ? frequencyHz / sampleRate : 0.0;
+  increment = targetIncrement = (float)juce::jlimit(0.0, 0.49, cycles);
+  mip = Wavetable::mipFor(increment);
+  glideRemaining = 0;
+  incrementStep = positionStep = 0.0f;
+}
+
+void SynthOscillator::setPosition(float newPosition) {
+  position = targetPosition = juce::jlimit(0.0f, 1.0f, newPosition);
+  glideRemaining = 0;
+  incrementStep = positionStep = 0.0f;
+}
+
+void SynthOscillator::glide(double frequencyHz, double sampleRate,
+                            float newPosition, int numSamples) {
+  if (numSamples <= 0) {
+    setFrequency(frequencyHz, sampleRate);
+    setPosition(newPosition);
+    return;
+  }
+
+  auto cycles = sampleRate > 0.0 ? frequencyHz / sampleRate : 0.0;
+  targetIncrement = (float)juce::jlimit(0.0, 0.49, cycles);
+  targetPosition = juce::jlimit(0.0f, 1.0f, newPosition);
+
+  // Unmodulated, nothing moves: keep the cheaper constant render
+  if (targetIncrement == increment && targetPosition == position) {
+    glideRemaining = 0;
+    incrementStep = positionStep = 0.0f;
+    return;
+  }
+
+  incrementStep = (targetIncrement - increment) / (float)numSamples;
+  positionStep = (targetPosition - position) / (float)numSamples;
+  glideRemaining = numSamples;
+
+  // The fuller mip of the two ends would alias at the higher one
+  mip = Wavetable::mipFor(juce::jmax(increment, targetIncrement));
+}
+
+void SynthOscillator::render(float *out, int numSamples) {
+  jassert(numSamples <= kMaxBlockSize);
+  static_assert(kMaxBlockSize % kLanes == 0);
+
+  // A glide that ends inside the block: render either side of its end
+  if (glideRemaining > 0 && numSamples > glideRemaining) {
+    int first = glideRemaining;
+    render(out, first);
+    render(out + first, numSamples - first);
+    return;
+  }
+  const bool gliding = glideRemaining > 0;
+
+  // Each phase from the block's start: no carried error, no dependency
+  // between samples, kLanes samples per instruction. Gliding, sample i is
+  // a further incrementStep * i * (i + 1) / 2 along.
+  const Vec laneIndex = Vec::fromRawArray(kLaneIndex);
+  const Vec start = laneIndex * increment + phase;
+  const float halfStep = 0.5f * incrementStep;
+
+  alignas(Vec::SIMDRegisterSize) float phases[kMaxBlockSize];
+  alignas(Vec::SIMDRegisterSize) float block[kMaxBlockSize];
+  auto run = [&](auto &&shapeAt) {
+    for (int i = 0; i < numSamples; i += kLanes) {
+      Vec p = start + increment * (float)i;
+      if (gliding) {
+        Vec at = laneIndex + (float)i;
+        p = p + at * (at + 1.0f) * halfStep;
+      }
+      p = wrap(p);
+      p.copyToRawArray(phases + i);
+      shapeAt(p).copyToRawArray(block + i);
+    }
+  };
+  auto correct = [&](float edge, float scale, auto residual) {
+    addResiduals(block, phases, numSamples, phase, increment, incrementStep,
+                 edge, scale, residual);
+  };
+
+  switch (shape) {
+  case Shape::Sine:
+    run([](Vec p) { return sinCycles(p); });
+    break;
+
+  case Shape::Saw:
+    run([](Vec p) { return p + p - 1.0f; });
+    correct(0.0f, -1.0f, polyBlep);
+    break;
+
+  case Shape::Square:
+    // 1 for the first half of the cycle, -1 for the second
+    run([](Vec p) {
+      auto secondHalf = Vec::greaterThanOrEqual(p, Vec::expand(0.5f));
+      return Vec::expand(1.0f) - (Vec::expand(2.0f) & secondHalf);
+    });
+    correct(0.0f, 1.0f, polyBlep);
+    correct(0.5f, -1.0f, polyBlep);
+    break;
+
+  case Shape::Triangle:
+    // -1 at phase 0, 1 at 0.5: the slope changes by 8 per cycle (8 * dt
+    // per sample) at each corner, and the residuals are scaled for 2
+    run([](Vec p) { return Vec::expand(1.0f) - Vec::abs(p - 0.5f) * 4.0f; });
+    correct(0.0f, 4.0f, scaledBlamp);
+    correct(0.5f, -4.0f, scaledBlamp);
+    break;
+
+  case Shape::Wavetable:
+    if (table == nullptr) {
+      std::fill(block, block + numSamples, 0.0f);
+      break;
+    }
+    run([](Vec p) { return p; });
+    renderWavetable(block, phases, numSamples);
+    break;
+  }
+
+  std::copy(block, block + numSamples, out);
+  auto n = (float)numSamples;
+  phase += increment * n + halfStep * n * (n + 1.0f);
+  phase -= (float)(int)phase;
+
+  if (gliding) {
+    glideRemaining -= numSamples;
+    increment += incrementStep * n;
+    position += positionStep * n;
+    if (glideRemaining == 0) {
+      increment = targetIncrement; // No drift from summing the steps
+      position = targetPosition;
+      incrementStep = positionStep = 0.0f;
+      mip = Wavetable::mipFor(increment);
+    }
+  }
+}
+
+void SynthOscillator::renderWavetable(float *block, const float *phases,
+                                      int numSamples) {
+  if (positionStep != 0.0f && table->numFrames > 1) {
+    renderWavetableGlide(block, phases, numSamples);
+    return;
+  }
+
+  // The two frames either side of the position, and how far between them
+  float framePosition = position * (float)(table->numFrames - 1);
+  int frame = juce::jmin((int)framePosition, table->numFrames - 1);
+  int nextFrame = juce::jmin(frame + 1, table->numFrames - 1);
+  const float blend = framePosition - (float)frame;
+  const float *a = table->getMip(frame, mip);
+  const float *b = table->getMip(nextFrame, mip);
+  const bool morphing = blend > 0.0f && nextFrame != frame;
+
+  // Gathers are scalar (SSE has none); the index maths and both linear
+  // interpolations are a register at a time
+  alignas(Vec::SIMDRegisterSize) float index[kLanes];
+  alignas(Vec::SIMDRegisterSize) float a0[kLanes], a1[kLanes];
+  alignas(Vec::SIMDRegisterSize) float b0[kLanes], b1[kLanes];
+  for (int i = 0; i < numSamples; i += kLanes) {
+    Vec at = Vec::fromRawArray(phases + i) * (float)Wavetable::kSize;
+    Vec whole = Vec::truncate(at);
+    Vec fraction = at - whole;
+    whole.copyToRawArray(index);
+
+    for (int k = 0; k < kLanes; ++k) {
+      auto n = (size_t)index[k];
+      a0[k] = a[n];
+      a1[k] = a[n + 1];
+    }
+    Vec va = Vec::fromRawArray(a0);
+    Vec out = va + (Vec::fromRawArray(a1) - va) * fraction;
+
+    if (morphing) {
+      for (int k = 0; k < kLanes; ++k) {
+        auto n = (size_t)index[k];
+        b0[k] = b[n];
+        b1[k] = b[n + 1];
+      }
+      Vec vb = Vec::fromRawArray(b0);
+      vb = vb + (Vec::fromRawArray(b1) - vb) * fraction;
+      out = out + (vb - out) * blend;
+    }
+    out.copyToRawArray(block + i);
+  }
+}
+
+void SynthOscillator::renderWavetableGlide(float *block, const float *phases,
+                                           int numSamples) {
+  // As renderWavetable(), but each lane has its own position, so its own
+  // pair of frames to read and blend
+  const float last = (float)(table->numFrames - 1);
+  const Vec laneStep = Vec::fromRawArray(kLaneIndex) * positionStep;
+
+  alignas(Vec::SIMDRegisterSize) float index[kLanes], frames[kLanes];
+  alignas(Vec::SIMDRegisterSize) float a0[kLanes], a1[kLanes];
+  alignas(Vec::SIMDRegisterSize) float b0[kLanes], b1[kLanes];
+  for (int i = 0; i < numSamples; i += kLanes) {
+    Vec at = Vec::fromRawArray(phases + i) * (float)Wavetable::kSize;
+    Vec whole = Vec::truncate(at);
+    Vec fraction = at - whole;
+    whole.copyToRawArray(index);
+
+    Vec framePosition = (laneStep + (position + positionStep * (float)i)) *
+                        last;
+    framePosition = Vec::max(Vec::expand(0.0f),
+                             Vec::min(framePosition, Vec::expand(last)));
+    Vec frame = Vec::truncate(Vec::min(framePosition, Vec::expand(last - 1)));
+    Vec blend = framePosition - frame;
+    frame.copyToRawArray(frames);
+
+    for (int k = 0; k < kLanes; ++k) {
+      const float *a = table->getMip((int)frames[k], mip);
+      const float *b = a + Wavetable::kNumMips * Wavetable::kStride;
+      auto n = (size_t)index[k];
+      a0[k] = a[n];
+      a1[k] = a[n + 1];
+      b0[k] = b[n];
+      b1[k] = b[n + 1];
+    }
+    Vec va = Vec::fromRawArray(a0);
+    va = va + (Vec::fromRawArray(a1) - va) * fraction;
+    Vec vb = Vec::fromRawArray(b0);
+    vb = vb + (Vec::fromRawArray(b1) - vb) * fraction;
+    (va + (vb - va) * blend).copyToRawArray(block + i);
+  }
+}
+
+} // namespace engine
+} // namespace flowzone
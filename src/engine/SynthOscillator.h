@@ -0,0 +1,75 @@
+#pragma once
+
+#include "WavetableBank.h"
+#include <JuceHeader.h>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief Band-limited oscillator rendered a block at a time.
+ *
+ * Phases for the whole block are computed up front from the block's start
+ * phase (no per-sample carry), and the shape is evaluated on them a
+ * juce::dsp::SIMDRegister at a time. The sine is a polynomial. Saw and
+ * square are rendered naively and then have polyBLEP residuals added at
+ * the few samples around each edge, the triangle polyBLAMP residuals at its
+ * corners, so the anti-aliasing costs per edge rather than per sample.
+ * Wavetables are read from the mip chosen for the note's pitch, with the
+ * gathered pairs interpolated in SIMD. While gliding (glide()), the phase
+ * follows the quadratic that a linearly rising increment traces, still
+ * computed per sample from the block's start.
+ */
+class SynthOscillator {
+public:
+  enum class Shape { Sine, Saw, Square, Triangle, Wavetable };
+
+  // Largest block render() takes; SynthVoice renders in chunks of this
+  static constexpr int kMaxBlockSize = 64;
+
+  void setShape(Shape newShape) { shape = newShape; }
+  Shape getShape() const { return shape; }
+
+  // Frequencies at or above Nyquist are clamped just below it
+  void setFrequency(double frequencyHz, double sampleRate);
+
+  // Phase in cycles, [0, 1)
+  void setPhase(float newPhase) { phase = newPhase; }
+
+  // Table read by Shape::Wavetable (owned by the WavetableBank), and where
+  // between its first (0) and last (1) frame to read
+  void setWavetable(const Wavetable *newTable) { table = newTable; }
+  void setPosition(float newPosition);
+
+  /**
+   * @brief Moves the frequency and wavetable position linearly to these
+   * values over the next numSamples rendered samples, one step per sample.
+   * setFrequency() and setPosition() jump instead, and cancel a glide.
+   */
+  void glide(double frequencyHz, double sampleRate, float newPosition,
+             int numSamples);
+
+  // Writes numSamples (at most kMaxBlockSize) samples in [-1, 1] to out
+  void render(float *out, int numSamples);
+
+private:
+  Shape shape = Shape::Saw;
+  float phase = 0.0f;
+  float increment = 0.0f; // Cycles per sample
+
+  const Wavetable *table = nullptr;
+  float position = 0.0f;
+  int mip = 0;
+
+  // Per-sample steps while gliding, and the values they end on
+  int glideRemaining = 0;
+  float incrementStep = 0.0f, positionStep = 0.0f;
+  float targetIncrement = 0.0f, targetPosition = 0.0f;
+
+  void renderWavetable(float *block, const float *phases, int numSamples);
+  void renderWavetableGlide(float *block, const float *phases,
+                            int numSamples);
+};
+
+} // namespace engine
+} // namespace flowzone
@@ -1,5 +1,4 @@
 #include "SynthVoice.h"
-#include "SynthSound.h"
 #include <cmath>
 
 namespace flowzone {
@@ -10,18 +9,16 @@ SynthVoice::SynthVoice() {
   adsrParams.decay = 0.1f;
   adsrParams.sustain = 1.0f;
   adsrParams.release = 0.1f;
-  adsr.setParameters(adsrParams);
+  envelope.setParameters(adsrParams);
+  for (auto &oscillator : oscillators)
+    oscillator.setShape(SynthOscillator::Shape::Saw);
+  setUnison(1, 0.0f, 0.0f);
 }
 
-bool SynthVoice::canPlaySound(juce::SynthesiserSound *sound) {
-  return dynamic_cast<SynthSound *>(sound) != nullptr;
-}
-
-void SynthVoice::startNote(int midiNoteNumber, float velocity,
-                           juce::SynthesiserSound *sound,
-                           int currentPitchWheelPosition) {
-  juce::ignoreUnused(sound, currentPitchWheelPosition);
+void SynthVoice::startNote(int midiNoteNumber, float velocity) {
+  note = midiNoteNumber;
   level = velocity * 0.5f;
+  fadeRemaining = 0;
 
   double cyclesPerSecond;
   if (tuningManager) {
@@ -32,95 +29,326 @@ void SynthVoice::startNote(int midiNoteNumber, float velocity,
         juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber) * pitchRatio;
   }
 
-  auto cyclesPerSample = cyclesPerSecond / currentSampleRate;
-  angleDelta = (float)(cyclesPerSample * 2.0 * juce::MathConstants<double>::pi);
+  baseFrequency = cyclesPerSecond;
+  setFrequency(cyclesPerSecond);
+  for (int i = 0; i < unisonVoices; ++i) {
+    oscillators[(size_t)i].setPosition(basePosition);
+    // Unison oscillators in step would just sum to one louder one
+    if (unisonVoices > 1)
+      oscillators[(size_t)i].setPhase(random.nextFloat());
+  }
+  envelope.noteOn();
 
-  adsr.noteOn();
+  for (auto *f : {&filter, &rightFilter}) {
+    f->reset();
+    f->setCutoff(cutoff);
+  }
+  if (modMatrix.isActive()) {
+    // The first tick's values apply from the first sample; later ones glide
+    modMatrix.noteOn(velocity);
+    updateModulation(true);
+  }
 }
 
-void SynthVoice::stopNote(float velocity, bool allowTailOff) {
-  juce::ignoreUnused(velocity);
+void SynthVoice::stopNote(bool allowTailOff) {
   if (allowTailOff) {
-    adsr.noteOff();
+    envelope.noteOff();
+    modMatrix.noteOff();
+  } else {
+    envelope.reset();
+    fadeRemaining = 0;
+  }
+}
+
+void SynthVoice::syncControlTicks(const SynthVoice &other) {
+  if (modMatrix.isActive())
+    untilTick = other.untilTick;
+}
+
+void SynthVoice::steal() {
+  if (!envelope.isActive() || fadeRemaining > 0)
+    return;
+  fadeRemaining = juce::jmax(1, (int)(kStealFadeSeconds * sampleRate));
+  fadeStep = 1.0f / (float)fadeRemaining;
+}
+
+void SynthVoice::setSampleRate(double newRate) {
+  jassert(newRate > 0.0);
+  sampleRate = newRate;
+  envelope.setSampleRate(newRate);
+  modMatrix.setSampleRate(newRate);
+  for (auto *f : {&filter, &rightFilter}) {
+    f->setSampleRate(newRate);
+    f->setCutoff(cutoff);
+  }
+}
+
+void SynthVoice::setFrequency(double frequencyHz) {
+  for (int i = 0; i < unisonVoices; ++i)
+    oscillators[(size_t)i].setFrequency(frequencyHz * detuneRatios[(size_t)i],
+                                        sampleRate);
+}
+
+void SynthVoice::glide(double frequencyHz, float position, int numSamples) {
+  for (int i = 0; i < unisonVoices; ++i)
+    oscillators[(size_t)i].glide(frequencyHz * detuneRatios[(size_t)i],
+                                 sampleRate, position, numSamples);
+}
+
+void SynthVoice::updateModulation(bool jump) {
+  using Destination = SynthModMatrix::Destination;
+  static const SynthModMatrix::SharedInputs centred;
+
+  float mod[SynthModMatrix::kNumDestinations];
+  modMatrix.evaluate(envelope.getValue(),
+                     sharedModInputs != nullptr ? *sharedModInputs : centred,
+                     mod);
+  int interval = modMatrix.getSettings().controlInterval;
+
+  double frequency = baseFrequency;
+  if (float semitones = mod[(int)Destination::Pitch]; semitones != 0.0f)
+    frequency *= std::exp2(semitones * (1.0f / 12.0f));
+  float position = basePosition + mod[(int)Destination::WavetablePosition];
+  float amp = juce::jmax(0.0f, 1.0f + mod[(int)Destination::Amp]);
+
+  if (jump) {
+    setFrequency(frequency);
+    for (int i = 0; i < unisonVoices; ++i)
+      oscillators[(size_t)i].setPosition(position);
+    ampFrom = amp;
   } else {
-    adsr.reset();
-    clearCurrentNote();
+    glide(frequency, position, interval);
+    ampFrom = ampTo;
+  }
+  ampTo = amp;
+
+  if (filterOn) {
+    float hz = cutoff * std::exp2(mod[(int)Destination::Cutoff]);
+    for (auto *f : {&filter, &rightFilter}) {
+      if (jump)
+        f->setCutoff(hz);
+      else
+        f->rampCutoff(hz, interval);
+    }
   }
+
+  untilTick = interval;
 }
 
-void SynthVoice::pitchWheelMoved(int newPitchWheelValue) {
-  juce::ignoreUnused(newPitchWheelValue);
+int SynthVoice::beginChunk(int maxSamples) {
+  int n = juce::jmin(maxSamples, kBlockSize);
+  if (modMatrix.isActive()) {
+    if (untilTick <= 0)
+      updateModulation(false);
+    n = juce::jmin(n, untilTick);
+  }
+  if (fadeRemaining > 0)
+    n = juce::jmin(n, fadeRemaining);
+  return n;
 }
-void SynthVoice::controllerMoved(int controllerNumber, int newControllerValue) {
-  juce::ignoreUnused(controllerNumber, newControllerValue);
+
+void SynthVoice::endChunk(int numSamples) {
+  untilTick -= numSamples;
+  if (fadeRemaining > 0) {
+    fadeRemaining -= numSamples;
+    if (fadeRemaining == 0)
+      envelope.reset(); // Faded out: free for the allocator
+  }
 }
 
-void SynthVoice::renderNextBlock(juce::AudioBuffer<float> &outputBuffer,
-                                 int startSample, int numSamples) {
-  if (!adsr.isActive()) {
-    clearCurrentNote();
+void SynthVoice::getAmpRamp(float &start, float &step) const {
+  start = 1.0f;
+  step = 0.0f;
+  if (!modMatrix.isActive())
     return;
+
+  int interval = modMatrix.getSettings().controlInterval;
+  if (ampFrom != ampTo)
+    step = (ampTo - ampFrom) / (float)interval;
+  start = ampFrom + step * (float)(interval - untilTick);
+}
+
+void SynthVoice::getFadeRamp(float &start, float &step) const {
+  start = fadeRemaining > 0 ? fadeStep * (float)fadeRemaining : 1.0f;
+  step = fadeRemaining > 0 ? -fadeStep : 0.0f;
+}
+
+void SynthVoice::render(juce::AudioBuffer<float> &outputBuffer,
+                        int startSample, int numSamples) {
+  while (numSamples > 0 && envelope.isActive()) {
+    int n = beginChunk(numSamples);
+
+    bool constant = envelope.isConstant();
+    float gain = level;
+    if (constant)
+      gain *= envelope.getValue(); // Sustain: no envelope buffer
+    else
+      envelope.render(envBuffer, n);
+
+    // Amp modulation and steal fades ride on the envelope: ramps through
+    // the chunk, or part of the gain while they hold still
+    float amp, ampStep, fade, fadeStep;
+    getAmpRamp(amp, ampStep);
+    getFadeRamp(fade, fadeStep);
+    bool ampRamp = ampStep != 0.0f, fading = fadeStep != 0.0f;
+    if (!ampRamp)
+      gain *= amp;
+    bool ramps = !constant || ampRamp || fading;
+
+    // Held at a sustain of zero (plucks) there's nothing to render
+    if (ramps || gain != 0.0f) {
+      bool stereo = isStereo();
+      renderOscillators(n);
+      if (filterOn) {
+        filter.process(oscBuffer, n);
+        if (stereo)
+          rightFilter.process(rightBuffer, n);
+      }
+
+      if (constant && ramps)
+        juce::FloatVectorOperations::fill(envBuffer, 1.0f, n);
+      if (ampRamp)
+        for (int i = 0; i < n; ++i)
+          envBuffer[i] *= amp + ampStep * (float)(i + 1);
+      if (fading)
+        for (int i = 0; i < n; ++i)
+          envBuffer[i] *= fade + fadeStep * (float)(i + 1);
+      if (ramps) {
+        juce::FloatVectorOperations::multiply(oscBuffer, envBuffer, n);
+        if (stereo)
+          juce::FloatVectorOperations::multiply(rightBuffer, envBuffer, n);
+      }
+
+      // Stereo voices alternate left and right; a mono output gets both
+      int numChannels = outputBuffer.getNumChannels();
+      if (stereo && numChannels == 1) {
+        gain *= 0.5f;
+        juce::FloatVectorOperations::add(oscBuffer, rightBuffer, n);
+      }
+      for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::addWithMultiply(
+            outputBuffer.getWritePointer(channel, startSample),
+            stereo && channel % 2 == 1 ? rightBuffer : oscBuffer, gain, n);
+    }
+
+    startSample += n;
+    numSamples -= n;
+    endChunk(n);
   }
+}
 
-  for (int sample = 0; sample < numSamples; ++sample) {
-    float adsrVal = adsr.getNextSample();
-    float currentSample = getNextSample() * level * adsrVal;
+void SynthVoice::renderOscillators(int numSamples) {
+  if (unisonVoices == 1) {
+    oscillators[0].render(oscBuffer, numSamples);
+    return;
+  }
 
-    for (int channel = 0; channel < outputBuffer.getNumChannels(); ++channel) {
-      outputBuffer.addSample(channel, startSample + sample, currentSample);
+  // Each oscillator renders a block SIMD across samples (edges fixed up
+  // only where they fall), then adds in at its pan
+  bool stereo = isStereo();
+  for (int i = 0; i < unisonVoices; ++i) {
+    oscillators[(size_t)i].render(unisonBuffer, numSamples);
+    auto left = leftGains[(size_t)i], right = rightGains[(size_t)i];
+    if (i == 0) {
+      juce::FloatVectorOperations::multiply(oscBuffer, unisonBuffer, left,
+                                            numSamples);
+      if (stereo)
+        juce::FloatVectorOperations::multiply(rightBuffer, unisonBuffer, right,
+                                              numSamples);
+    } else {
+      juce::FloatVectorOperations::addWithMultiply(oscBuffer, unisonBuffer,
+                                                   left, numSamples);
+      if (stereo)
+        juce::FloatVectorOperations::addWithMultiply(rightBuffer, unisonBuffer,
+                                                     right, numSamples);
     }
   }
+}
+
+void SynthVoice::setOscillatorType(int type) {
+  for (auto &oscillator : oscillators)
+    oscillator.setShape(
+        (SynthOscillator::Shape)juce::jlimit(0, 4, type)); // Same order
+}
 
-  if (!adsr.isActive()) {
-    clearCurrentNote();
+void SynthVoice::setWavetable(const Wavetable *table, float position) {
+  for (auto &oscillator : oscillators) {
+    oscillator.setWavetable(table);
+    oscillator.setPosition(position);
   }
+  basePosition = position;
 }
 
-void SynthVoice::setOscillatorType(int type) { oscType = type; }
+void SynthVoice::setUnison(int numOscillators, float detuneCents,
+                           float spread) {
+  int previous = unisonVoices;
+  unisonVoices = juce::jlimit(1, kMaxUnison, numOscillators);
+  unisonSpread = unisonVoices > 1 ? juce::jlimit(0.0f, 1.0f, spread) : 0.0f;
+
+  // Evenly from -1 to 1 across the oscillators: the detune and the pan.
+  // Summed uncorrelated oscillators grow by the square root of their count.
+  auto norm = 1.0f / std::sqrt((float)unisonVoices);
+  for (int i = 0; i < unisonVoices; ++i) {
+    float offset =
+        unisonVoices > 1 ? 2.0f * (float)i / (float)(unisonVoices - 1) - 1.0f
+                         : 0.0f;
+    detuneRatios[(size_t)i] = std::exp2(detuneCents * offset / 1200.0f);
+    float pan = unisonSpread * offset;
+    leftGains[(size_t)i] = norm * juce::jmin(1.0f, 1.0f - pan);
+    rightGains[(size_t)i] = norm * juce::jmin(1.0f, 1.0f + pan);
+  }
+
+  // A sounding note picks the new layout up at once
+  if (isActive()) {
+    setFrequency(baseFrequency);
+    for (int i = previous; i < unisonVoices; ++i) {
+      oscillators[(size_t)i].setPosition(basePosition);
+      oscillators[(size_t)i].setPhase(random.nextFloat());
+    }
+  }
+}
+
+void SynthVoice::setRandomSeed(juce::int64 seed) { random.setSeed(seed); }
 
 void SynthVoice::setADSR(float a, float d, float s, float r) {
   adsrParams.attack = a;
   adsrParams.decay = d;
   adsrParams.sustain = s;
   adsrParams.release = r;
-  adsr.setParameters(adsrParams);
+  envelope.setParameters(adsrParams);
 }
 
-void SynthVoice::setPitchRatio(float ratio) { pitchRatio = ratio; }
+void SynthVoice::setFilter(float cutoffHz, float resonance) {
+  cutoff = cutoffHz;
+  for (auto *f : {&filter, &rightFilter}) {
+    f->setResonance(resonance);
+    f->setCutoff(cutoff);
+  }
+  updateFilterOn();
+}
 
-void SynthVoice::setTuningManager(const TuningManager *tm) {
-  tuningManager = tm;
+void SynthVoice::setModulation(const SynthModMatrix::Settings &settings) {
+  modMatrix.setSettings(settings);
+  untilTick = juce::jmin(untilTick, modMatrix.getSettings().controlInterval);
+  ampFrom = ampTo = 1.0f;
+  updateFilterOn();
 }
 
-float SynthVoice::getNextSample() {
-  float out = 0.0f;
-
-  switch (oscType) {
-  case 0: // Sine
-    out = std::sin(currentAngle);
-    break;
-  case 1: // Saw
-    out = (float)(2.0 * currentAngle / (2.0 * juce::MathConstants<double>::pi) -
-                  1.0);
-    break;
-  case 2: // Square
-    out = (currentAngle < juce::MathConstants<double>::pi) ? 1.0f : -1.0f;
-    break;
-  case 3: // Triangle
-    out = (float)(4.0 * currentAngle / (2.0 * juce::MathConstants<double>::pi));
-    if (out < 2.0f)
-      out -= 1.0f;
-    else
-      out = 3.0f - out;
-    break;
-  }
+void SynthVoice::setSharedModInputs(
+    const SynthModMatrix::SharedInputs *inputs) {
+  sharedModInputs = inputs;
+}
 
-  currentAngle += angleDelta;
-  if (currentAngle >= 2.0 * juce::MathConstants<double>::pi) {
-    currentAngle -= (float)(2.0 * juce::MathConstants<double>::pi);
-  }
+void SynthVoice::updateFilterOn() {
+  using Destination = SynthModMatrix::Destination;
+  filterOn = cutoff < 20000.0f ||
+             modMatrix.getSettings().targets(Destination::Cutoff);
+}
 
-  return out;
+void SynthVoice::setPitchRatio(float ratio) { pitchRatio = ratio; }
+
+void SynthVoice::setTuningManager(const TuningManager *tm) {
+  tuningManager = tm;
 }
 
 } // namespace engine
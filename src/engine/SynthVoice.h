@@ -1,47 +1,155 @@
+#pragma once
+
+#include "SynthEnvelope.h"
+#include "SynthFilter.h"
+#include "SynthModMatrix.h"
+#include "SynthOscillator.h"
 #include "TuningManager.h"
 #include <JuceHeader.h>
+#include <array>
 
 namespace flowzone {
 namespace engine {
 
 /**
  * @brief Polyphonic Synth Voice logic.
+ *
+ * Renders in chunks of up to SynthOscillator::kMaxBlockSize samples: the
+ * oscillator fills a voice-local buffer, the filter runs over it if the
+ * preset uses one, the envelope is applied as one multiply (or folded into
+ * the gain while it's constant), and the result is mixed into each output
+ * channel.
+ *
+ * With unison (setUnison()) the voice runs up to kMaxUnison oscillators,
+ * detuned evenly across the detune amount and started at random phases,
+ * and sums them into the buffer. Given a stereo spread they're panned
+ * across it too, and the voice renders a left and a right buffer, each
+ * with its own filter, to even and odd channels.
+ *
+ * With modulation routes set, chunks also end on control ticks: every
+ * controlInterval samples the matrix is evaluated and pitch, cutoff, amp
+ * and wavetable position glide to their new values over the next interval.
+ *
+ * Voices live in SynthVoiceAllocator's pool and are driven directly by it:
+ * no virtual calls, and no per-voice sound lookup. Several sounding voices
+ * are usually rendered together by SynthVoicePack rather than by render();
+ * both share the chunking and modulation here.
  */
-class SynthVoice : public juce::SynthesiserVoice {
+class SynthVoice {
 public:
   SynthVoice();
 
-  bool canPlaySound(juce::SynthesiserSound *sound) override;
-  void startNote(int midiNoteNumber, float velocity,
-                 juce::SynthesiserSound *sound,
-                 int currentPitchWheelPosition) override;
-  void stopNote(float velocity, bool allowTailOff) override;
-  void pitchWheelMoved(int newPitchWheelValue) override;
-  void controllerMoved(int controllerNumber, int newControllerValue) override;
+  void setSampleRate(double newRate);
+
+  void startNote(int midiNoteNumber, float velocity);
+  void stopNote(bool allowTailOff);
+
+  // Moves this voice's control ticks onto other's, so voices rendered
+  // together tick on the same samples (call after startNote())
+  void syncControlTicks(const SynthVoice &other);
+
+  // Fades out over kStealFadeSeconds and then goes idle, whatever the
+  // envelope is doing; for when the allocator needs the voice back
+  void steal();
+
+  // Adds numSamples of the voice to every channel of outputBuffer
+  void render(juce::AudioBuffer<float> &outputBuffer, int startSample,
+              int numSamples);
+
+  bool isActive() const { return envelope.isActive(); }
 
-  void renderNextBlock(juce::AudioBuffer<float> &outputBuffer, int startSample,
-                       int numSamples) override;
+  // Unison with spread: separate left and right output, so never in a
+  // SynthVoicePack
+  bool isStereo() const { return unisonVoices > 1 && unisonSpread > 0.0f; }
+  bool isStolen() const { return fadeRemaining > 0; }
+  int getNote() const { return note; }
+
+  // Current output gain, before the oscillator: how loud the voice is now
+  float getLoudness() const { return level * envelope.getValue(); }
 
   // Parameter access
-  void setOscillatorType(int type); // 0: sine, 1: saw, 2: square, 3: tri
+  // 0: sine, 1: saw, 2: square, 3: tri, 4: wavetable (see setWavetable)
+  void setOscillatorType(int type);
+  void setWavetable(const Wavetable *table, float position);
   void setADSR(float a, float d, float s, float r);
+
+  // Lowpass before the amp envelope; at 20 kHz and unmodulated it's skipped
+  void setFilter(float cutoffHz, float resonance);
+
+  // Oscillators per note (1 to kMaxUnison), spread over +-detuneCents and,
+  // with spread above 0, panned up to fully left and right
+  void setUnison(int numOscillators, float detuneCents, float spread);
+
+  // Seeds the unison start phases, so renders are repeatable
+  void setRandomSeed(juce::int64 seed);
+  void setModulation(const SynthModMatrix::Settings &settings);
+  void setSharedModInputs(const SynthModMatrix::SharedInputs *inputs);
   void setPitchRatio(float ratio);
   void setTuningManager(const TuningManager *tm);
 
+  static constexpr float kStealFadeSeconds = 0.003f;
+  static constexpr int kMaxUnison = 16;
+
 private:
+  friend class SynthVoicePack;
+
+  static constexpr int kBlockSize = SynthOscillator::kMaxBlockSize;
+
   const TuningManager *tuningManager = nullptr;
-  double currentSampleRate = 44100.0;
+  double sampleRate = 44100.0;
+  int note = -1;
   float level = 0.0f;
-  float angleDelta = 0.0f;
-  float currentAngle = 0.0f;
-  int oscType = 1; // Default to Saw
   float pitchRatio = 1.0f;
 
-  juce::ADSR adsr;
+  int fadeRemaining = 0; // Samples of steal fade left
+  float fadeStep = 0.0f;
+
+  // oscillators[0] plays alone without unison
+  std::array<SynthOscillator, kMaxUnison> oscillators;
+  int unisonVoices = 1;
+  float unisonSpread = 0.0f;
+  std::array<double, kMaxUnison> detuneRatios;
+  std::array<float, kMaxUnison> leftGains, rightGains;
+  juce::Random random;
+
+  SynthEnvelope envelope;
   juce::ADSR::Parameters adsrParams;
+  SynthFilter filter, rightFilter; // rightFilter only runs when stereo
+  SynthModMatrix modMatrix;
+  const SynthModMatrix::SharedInputs *sharedModInputs = nullptr;
+
+  // Unmodulated values, which the matrix's outputs offset
+  double baseFrequency = 440.0;
+  float basePosition = 0.0f;
+  float cutoff = 20000.0f;
+  bool filterOn = false;
+
+  int untilTick = 0;     // Samples left in the current control interval
+  float ampFrom = 1.0f;  // Amp modulation at the last tick...
+  float ampTo = 1.0f;    // ...and at the end of this interval
+
+  float oscBuffer[kBlockSize]; // Left when stereo
+  float rightBuffer[kBlockSize];
+  float unisonBuffer[kBlockSize];
+  float envBuffer[kBlockSize];
+
+  void updateFilterOn();
+  void updateModulation(bool jump);
+
+  // Every unison oscillator at its detuned share of frequencyHz
+  void setFrequency(double frequencyHz);
+  void glide(double frequencyHz, float position, int numSamples);
+  void renderOscillators(int numSamples);
+
+  // Runs a control tick if one is due and returns how much of maxSamples
+  // can be rendered before the next tick or the end of a steal fade
+  int beginChunk(int maxSamples);
+  void endChunk(int numSamples);
 
-  // Temporary: simple Sine/Saw implementation
-  float getNextSample();
+  // Amp modulation and steal fade at the chunk's start (1 when off), and
+  // their change per sample
+  void getAmpRamp(float &start, float &step) const;
+  void getFadeRamp(float &start, float &step) const;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthVoice)
 };
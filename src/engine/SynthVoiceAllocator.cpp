@@ -0,0 +1,202 @@
+#include "SynthVoiceAllocator.h"
+#include <algorithm>
+
+namespace flowzone {
+namespace engine {
+
+SynthVoiceAllocator::SynthVoiceAllocator()
+    : voices(kMaxVoices), slots(kMaxVoices) {
+  freeVoices.reserve(kMaxVoices);
+  activeVoices.reserve(kMaxVoices);
+  for (int i = kMaxVoices - 1; i >= 0; --i)
+    freeVoices.push_back(i);
+
+  // Different unison phases per voice, the same from run to run
+  for (int i = 0; i < kMaxVoices; ++i)
+    voices[(size_t)i].setRandomSeed(i + 1);
+}
+
+void SynthVoiceAllocator::setSampleRate(double newSampleRate) {
+  sampleRate = newSampleRate;
+  for (auto &voice : voices)
+    voice.setSampleRate(newSampleRate);
+}
+
+void SynthVoiceAllocator::noteOn(int note, float velocity) {
+  // The same note again: release the one playing, as juce::Synthesiser did
+  for (int index : activeVoices) {
+    const auto &slot = slots[(size_t)index];
+    if (voices[(size_t)index].getNote() == note &&
+        (slot.keyDown || slot.sustained))
+      release(index, true);
+  }
+
+  enforceCap(1);
+
+  int index;
+  if (!freeVoices.empty()) {
+    index = freeVoices.back();
+    freeVoices.pop_back();
+  } else {
+    // Every slot is busy, fades included: cut one short and reuse it
+    index = chooseVictim(true);
+    voices[(size_t)index].stopNote(false);
+    activeVoices.erase(
+        std::find(activeVoices.begin(), activeVoices.end(), index));
+  }
+
+  auto &voice = voices[(size_t)index];
+  voice.startNote(note, velocity);
+  if (!activeVoices.empty())
+    voice.syncControlTicks(voices[(size_t)activeVoices.front()]);
+  slots[(size_t)index] = {++notesStarted, true, false};
+  activeVoices.push_back(index);
+}
+
+void SynthVoiceAllocator::noteOff(int note, bool allowTailOff) {
+  for (int index : activeVoices) {
+    auto &slot = slots[(size_t)index];
+    if (!slot.keyDown || voices[(size_t)index].getNote() != note)
+      continue;
+    if (sustainPedalDown) {
+      slot.keyDown = false;
+      slot.sustained = true;
+    } else {
+      release(index, allowTailOff);
+    }
+  }
+}
+
+void SynthVoiceAllocator::allNotesOff(bool allowTailOff) {
+  for (int index : activeVoices)
+    release(index, allowTailOff);
+
+  if (!allowTailOff) {
+    freeVoices.insert(freeVoices.end(), activeVoices.begin(),
+                      activeVoices.end());
+    activeVoices.clear();
+  }
+}
+
+void SynthVoiceAllocator::setSustainPedal(bool isDown) {
+  sustainPedalDown = isDown;
+  if (isDown)
+    return;
+
+  for (int index : activeVoices)
+    if (slots[(size_t)index].sustained)
+      release(index, true);
+}
+
+void SynthVoiceAllocator::release(int index, bool allowTailOff) {
+  auto &slot = slots[(size_t)index];
+  slot.keyDown = false;
+  slot.sustained = false;
+  voices[(size_t)index].stopNote(allowTailOff);
+}
+
+void SynthVoiceAllocator::render(juce::AudioBuffer<float> &outputBuffer,
+                                 int startSample, int numSamples) {
+  // Mono voices go through the pack, a lone one left over and stereo
+  // (spread unison) ones render by themselves
+  SynthVoice *group[SynthVoicePack::kLanes];
+  int grouped = 0;
+  for (int index : activeVoices) {
+    auto &voice = voices[(size_t)index];
+    if (voice.isStereo()) {
+      voice.render(outputBuffer, startSample, numSamples);
+      continue;
+    }
+    group[grouped++] = &voice;
+    if (grouped == SynthVoicePack::kLanes) {
+      pack.render(group, grouped, outputBuffer, startSample, numSamples);
+      grouped = 0;
+    }
+  }
+  if (grouped == 1)
+    group[0]->render(outputBuffer, startSample, numSamples);
+  else if (grouped > 1)
+    pack.render(group, grouped, outputBuffer, startSample, numSamples);
+
+  for (size_t i = 0; i < activeVoices.size();) {
+    if (voices[(size_t)activeVoices[i]].isActive()) {
+      ++i;
+      continue;
+    }
+    // Finished: back on the free list, and the last one takes its place
+    freeVoices.push_back(activeVoices[i]);
+    activeVoices[i] = activeVoices.back();
+    activeVoices.pop_back();
+  }
+}
+
+int SynthVoiceAllocator::countHeld() const {
+  int held = 0;
+  for (int index : activeVoices)
+    held += voices[(size_t)index].isStolen() ? 0 : 1;
+  return held;
+}
+
+int SynthVoiceAllocator::chooseVictim(bool includeStolen) const {
+  // Voices already fading out go first, then released notes, quietest
+  // first, then the oldest held note
+  int victim = -1, victimRank = 3;
+  float victimLoudness = 0.0f;
+  uint64_t victimStart = 0;
+
+  for (int index : activeVoices) {
+    const auto &voice = voices[(size_t)index];
+    const auto &slot = slots[(size_t)index];
+    if (voice.isStolen() && !includeStolen)
+      continue;
+
+    int rank = voice.isStolen()                     ? 0
+               : !(slot.keyDown || slot.sustained) ? 1
+                                                   : 2;
+    float loudness = voice.getLoudness();
+    bool better = rank < victimRank ||
+                  (rank == victimRank &&
+                   (rank == 2 ? slot.startedAt < victimStart
+                              : loudness < victimLoudness));
+    if (better) {
+      victim = index;
+      victimRank = rank;
+      victimLoudness = loudness;
+      victimStart = slot.startedAt;
+    }
+  }
+  return victim;
+}
+
+void SynthVoiceAllocator::enforceCap(int reserve) {
+  // Steal until there's room for reserve more notes under the cap
+  for (int held = countHeld(); held + reserve > voiceCap; --held) {
+    int victim = chooseVictim(false);
+    if (victim < 0)
+      break;
+    voices[(size_t)victim].steal();
+  }
+}
+
+void SynthVoiceAllocator::setVoiceCap(int newCap) {
+  voiceCap = juce::jlimit(kMinVoiceCap, kMaxVoices, newCap);
+  enforceCap(0);
+}
+
+void SynthVoiceAllocator::updateLoad(double load, int numSamples) {
+  samplesSinceAdjust += numSamples;
+  if (samplesSinceAdjust < (int)(kAdjustSeconds * sampleRate))
+    return;
+  samplesSinceAdjust = 0;
+
+  if (load > kHighLoad) {
+    // Shed an eighth of what's sounding, and cap there
+    int held = countHeld();
+    setVoiceCap(juce::jmin(voiceCap, held) - juce::jmax(1, held / 8));
+  } else if (load < kLowLoad && voiceCap < kMaxVoices) {
+    setVoiceCap(voiceCap + 4);
+  }
+}
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "SynthVoice.h"
+#include "SynthVoicePack.h"
+#include <JuceHeader.h>
+#include <cstdint>
+#include <vector>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief The synth's voices and which notes they play.
+ *
+ * A pool of kMaxVoices voices allocated once, side by side, with a free
+ * list (a stack of indices) so starting a note is O(1), and a compact
+ * array of the sounding ones so rendering only visits those.
+ *
+ * Polyphony is the voice cap, not the pool size. A note that would go over
+ * the cap steals a voice: a released one, quietest first, else the oldest
+ * held one. The stolen voice fades out over a few milliseconds in a slot
+ * of its own while the new note starts in a free one, so steals don't
+ * click; only with every slot busy is a voice cut short and reused.
+ *
+ * The cap follows the audio callback's measured load (updateLoad()): it
+ * drops by an eighth of the sounding voices whenever the callback runs
+ * hot, stealing the excess, and creeps back up once there's headroom. Dense
+ * chords thin out instead of overrunning the callback.
+ *
+ * Sounding voices render SynthVoicePack::kLanes at a time, one per SIMD
+ * lane; only a lone voice left over, or a stereo unison voice, renders by
+ * itself. New notes take the
+ * control-tick phase of the voices already sounding so packs don't split
+ * their chunks on every voice's ticks.
+ *
+ * Audio thread only.
+ */
+class SynthVoiceAllocator {
+public:
+  static constexpr int kMaxVoices = 128;
+  static constexpr int kMinVoiceCap = 8;
+
+  // Load (proportion of the block's time budget) above which voices are
+  // shed, and below which the cap grows back
+  static constexpr double kHighLoad = 0.8;
+  static constexpr double kLowLoad = 0.6;
+  static constexpr double kAdjustSeconds = 0.05; // Between cap changes
+
+  SynthVoiceAllocator();
+
+  void setSampleRate(double newSampleRate);
+
+  // Every voice in the pool, sounding or not: for settings all notes share
+  template <typename Function> void forEachVoice(Function &&function) {
+    for (auto &voice : voices)
+      function(voice);
+  }
+
+  void noteOn(int note, float velocity);
+  void noteOff(int note, bool allowTailOff);
+  void allNotesOff(bool allowTailOff);
+
+  // Notes released while the pedal is down sound on until it's lifted
+  void setSustainPedal(bool isDown);
+
+  // Adds the sounding voices to outputBuffer and frees the finished ones
+  void render(juce::AudioBuffer<float> &outputBuffer, int startSample,
+              int numSamples);
+
+  // Sounding voices, counting ones fading out after a steal
+  int getNumActive() const { return (int)activeVoices.size(); }
+  int getVoiceCap() const { return voiceCap; }
+  void setVoiceCap(int newCap);
+
+  /**
+   * @brief Adapts the voice cap to the callback's load, given once per
+   * block along with the block's length. Changes are spaced
+   * kAdjustSeconds apart so each one shows in the (smoothed) load before
+   * the next.
+   */
+  void updateLoad(double load, int numSamples);
+
+private:
+  struct Slot {
+    uint64_t startedAt = 0; // Note-on order, for oldest-first stealing
+    bool keyDown = false;
+    bool sustained = false; // Released under the sustain pedal
+  };
+
+  std::vector<SynthVoice> voices;
+  std::vector<Slot> slots;       // By voice index
+  std::vector<int> freeVoices;   // Stack of idle voice indices
+  std::vector<int> activeVoices; // Sounding voice indices, unordered
+  SynthVoicePack pack;
+  uint64_t notesStarted = 0;
+  int voiceCap = kMaxVoices;
+  bool sustainPedalDown = false;
+  double sampleRate = 44100.0;
+  int samplesSinceAdjust = 0;
+
+  int countHeld() const; // Active and not being stolen
+  int chooseVictim(bool includeStolen) const;
+  void enforceCap(int reserve);
+  void release(int index, bool allowTailOff);
+};
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,192 @@
+#include "SynthVoicePack.h"
+
+namespace flowzone {
+namespace engine {
+
+void SynthVoicePack::render(SynthVoice *const *voices, int numVoices,
+                            juce::AudioBuffer<float> &outputBuffer,
+                            int startSample, int numSamples) {
+  jassert(numVoices > 0 && numVoices <= kLanes);
+
+  while (numSamples > 0) {
+    int n = beginChunk(voices, numVoices, numSamples);
+    if (n == 0)
+      return; // Every voice has finished
+
+    bool filtering = false, ramping = false;
+    for (int lane = 0; lane < kLanes; ++lane) {
+      if (lane < numVoices && voices[lane]->isActive())
+        gather(*voices[lane], lane, n, filtering, ramping);
+      else
+        silence(lane, n);
+    }
+
+    if (filtering && ramping)
+      process<true, true>(n);
+    else if (filtering)
+      process<true, false>(n);
+    else
+      process<false, false>(n);
+
+    for (int lane = 0; lane < numVoices; ++lane) {
+      auto &voice = *voices[lane];
+      if (!voice.isActive())
+        continue;
+      if (voice.filterOn) {
+        SynthFilter::State state;
+        state.s1 = lanes.s1[lane];
+        state.s2 = lanes.s2[lane];
+        state.coefficients = {lanes.a1[lane], lanes.a2[lane], lanes.a3[lane]};
+        voice.filter.setState(state, n);
+      }
+      voice.envelope.render(nullptr, n);
+      voice.endChunk(n);
+    }
+
+    for (int channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+      juce::FloatVectorOperations::add(
+          outputBuffer.getWritePointer(channel, startSample), mix, n);
+
+    startSample += n;
+    numSamples -= n;
+  }
+}
+
+int SynthVoicePack::beginChunk(SynthVoice *const *voices, int numVoices,
+                               int maxSamples) {
+  // The chunk runs to the first point any lane needs a decision made
+  int n = juce::jmin(maxSamples, kBlockSize);
+  bool anyActive = false;
+  for (int lane = 0; lane < numVoices; ++lane) {
+    auto &voice = *voices[lane];
+    if (!voice.isActive())
+      continue;
+    anyActive = true;
+    n = voice.beginChunk(n);
+    n = juce::jmin(n, voice.envelope.getSamplesInStage());
+    if (voice.filterOn && voice.filter.getRampRemaining() > 0)
+      n = juce::jmin(n, voice.filter.getRampRemaining());
+  }
+  return anyActive ? n : 0;
+}
+
+void SynthVoicePack::gather(SynthVoice &voice, int lane, int numSamples,
+                            bool &filtering, bool &ramping) {
+  float env = voice.envelope.getValue();
+  float envStep = voice.envelope.getSlope();
+  float amp, ampStep, fade, fadeStep;
+  voice.getAmpRamp(amp, ampStep);
+  voice.getFadeRamp(fade, fadeStep);
+
+  lanes.level[lane] = voice.level;
+  lanes.envelope[lane] = env;
+  lanes.envelopeStep[lane] = envStep;
+  float target = voice.envelope.getTarget();
+  lanes.envelopeMin[lane] = juce::jmin(env, target);
+  lanes.envelopeMax[lane] = juce::jmax(env, target);
+  lanes.amp[lane] = amp;
+  lanes.ampStep[lane] = ampStep;
+  lanes.fade[lane] = fade;
+  lanes.fadeStep[lane] = fadeStep;
+
+  // Held at a sustain of zero (plucks) there's nothing to render
+  bool silent = envStep == 0.0f && ampStep == 0.0f && fadeStep == 0.0f &&
+                voice.level * env * amp == 0.0f;
+  if (silent) {
+    for (int i = 0; i < numSamples; ++i)
+      interleaved[i * kLanes + lane] = 0.0f;
+  } else {
+    voice.renderOscillators(numSamples);
+    for (int i = 0; i < numSamples; ++i)
+      interleaved[i * kLanes + lane] = voice.oscBuffer[i];
+  }
+
+  SynthFilter::State filter;
+  if (voice.filterOn) {
+    filter = voice.filter.getState();
+    filtering = true;
+    ramping = ramping || voice.filter.getRampRemaining() > 0;
+  }
+  lanes.filtered[lane] = voice.filterOn ? 0xffffffffu : 0u;
+  lanes.s1[lane] = filter.s1;
+  lanes.s2[lane] = filter.s2;
+  lanes.a1[lane] = filter.coefficients.a1;
+  lanes.a2[lane] = filter.coefficients.a2;
+  lanes.a3[lane] = filter.coefficients.a3;
+  lanes.a1Step[lane] = filter.step.a1;
+  lanes.a2Step[lane] = filter.step.a2;
+  lanes.a3Step[lane] = filter.step.a3;
+}
+
+void SynthVoicePack::silence(int lane, int numSamples) {
+  for (int i = 0; i < numSamples; ++i)
+    interleaved[i * kLanes + lane] = 0.0f;
+
+  lanes.level[lane] = 0.0f;
+  lanes.envelope[lane] = lanes.envelopeStep[lane] = 0.0f;
+  lanes.envelopeMin[lane] = lanes.envelopeMax[lane] = 0.0f;
+  lanes.amp[lane] = lanes.ampStep[lane] = 0.0f;
+  lanes.fade[lane] = lanes.fadeStep[lane] = 0.0f;
+  lanes.filtered[lane] = 0u;
+  lanes.s1[lane] = lanes.s2[lane] = 0.0f;
+  lanes.a1[lane] = lanes.a2[lane] = lanes.a3[lane] = 0.0f;
+  lanes.a1Step[lane] = lanes.a2Step[lane] = lanes.a3Step[lane] = 0.0f;
+}
+
+template <bool Filtering, bool Ramping>
+void SynthVoicePack::process(int numSamples) {
+  const Vec one = Vec::expand(1.0f);
+  const Vec level = Vec::fromRawArray(lanes.level);
+  const Vec envStep = Vec::fromRawArray(lanes.envelopeStep);
+  const Vec envMin = Vec::fromRawArray(lanes.envelopeMin);
+  const Vec envMax = Vec::fromRawArray(lanes.envelopeMax);
+  const Vec ampStep = Vec::fromRawArray(lanes.ampStep);
+  const Vec fadeStep = Vec::fromRawArray(lanes.fadeStep);
+  Vec env = Vec::fromRawArray(lanes.envelope);
+  Vec amp = Vec::fromRawArray(lanes.amp);
+  Vec fade = Vec::fromRawArray(lanes.fade);
+
+  const auto filtered = Vec::vMaskType::fromRawArray(lanes.filtered);
+  const Vec a1Step = Vec::fromRawArray(lanes.a1Step);
+  const Vec a2Step = Vec::fromRawArray(lanes.a2Step);
+  const Vec a3Step = Vec::fromRawArray(lanes.a3Step);
+  Vec s1 = Vec::fromRawArray(lanes.s1), s2 = Vec::fromRawArray(lanes.s2);
+  Vec a1 = Vec::fromRawArray(lanes.a1), a2 = Vec::fromRawArray(lanes.a2);
+  Vec a3 = Vec::fromRawArray(lanes.a3);
+
+  for (int i = 0; i < numSamples; ++i) {
+    Vec x = Vec::fromRawArray(interleaved + i * kLanes);
+
+    if constexpr (Filtering) {
+      // SynthFilter::processRamp()'s update, a voice per lane
+      if constexpr (Ramping) {
+        a1 += a1Step;
+        a2 += a2Step;
+        a3 += a3Step;
+      }
+      Vec twoA2 = a2 + a2, twoA3 = a3 + a3;
+      Vec lp = a2 * s1 + (one - a3) * s2 + a3 * x;
+      Vec next1 = (a1 + a1 - one) * s1 + twoA2 * (x - s2);
+      s2 = twoA2 * s1 + (one - twoA3) * s2 + twoA3 * x;
+      s1 = next1;
+      x = (lp & filtered) + (x & ~filtered);
+    }
+
+    // The stage's last step lands on its target, not past it
+    env = Vec::max(envMin, Vec::min(env + envStep, envMax));
+    amp += ampStep;
+    fade += fadeStep;
+    mix[i] = (x * (level * env * amp * fade)).sum();
+  }
+
+  if constexpr (Filtering) {
+    s1.copyToRawArray(lanes.s1);
+    s2.copyToRawArray(lanes.s2);
+    a1.copyToRawArray(lanes.a1);
+    a2.copyToRawArray(lanes.a2);
+    a3.copyToRawArray(lanes.a3);
+  }
+}
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "SynthVoice.h"
+#include <JuceHeader.h>
+#include <cstdint>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief Renders several voices at once, one per juce::dsp::SIMDRegister
+ * lane.
+ *
+ * Each voice's oscillator still renders its own chunk (already SIMD across
+ * samples, with anti-aliasing only around edges), and the chunks are
+ * interleaved so sample i of every voice sits in one register. From there
+ * the filter, envelope, amp modulation and steal fade of all the voices
+ * advance together, one instruction per step for kLanes voices, and the
+ * lanes are summed into a single mono mix that's added to each channel
+ * once per pack. The filter's recursion is the longest per-sample chain a
+ * voice has, so this is where voices side by side pay off.
+ *
+ * Voice state stays in the voices: it's read into registers at the start
+ * of a chunk and written back at its end. Chunks end wherever any lane
+ * needs a scalar decision (a control tick, an envelope stage or filter
+ * ramp ending, a steal fade running out), so the loop over samples is
+ * straight-line arithmetic. SynthVoiceAllocator keeps the voices' control
+ * ticks in step (SynthVoice::syncControlTicks()) so those chunks line up.
+ *
+ * Holds no state between calls; one pack serves every group of voices.
+ */
+class SynthVoicePack {
+public:
+  using Vec = juce::dsp::SIMDRegister<float>;
+  static constexpr int kLanes = (int)Vec::SIMDNumElements;
+
+  // Adds numSamples of each of numVoices (at most kLanes) voices to every
+  // channel of outputBuffer, as SynthVoice::render() would one at a time
+  void render(SynthVoice *const *voices, int numVoices,
+              juce::AudioBuffer<float> &outputBuffer, int startSample,
+              int numSamples);
+
+private:
+  static constexpr int kBlockSize = SynthOscillator::kMaxBlockSize;
+
+  // Per-lane values gathered at the start of a chunk
+  struct alignas(Vec::SIMDRegisterSize) Lanes {
+    float level[kLanes], envelope[kLanes], envelopeStep[kLanes];
+    float envelopeMin[kLanes], envelopeMax[kLanes]; // Where the stage ends
+    float amp[kLanes], ampStep[kLanes], fade[kLanes], fadeStep[kLanes];
+    float s1[kLanes], s2[kLanes];
+    float a1[kLanes], a2[kLanes], a3[kLanes];
+    float a1Step[kLanes], a2Step[kLanes], a3Step[kLanes];
+    uint32_t filtered[kLanes]; // All ones where the voice's filter is on
+  };
+
+  Lanes lanes;
+
+  // Oscillator output, sample-major: kLanes floats per sample
+  alignas(Vec::SIMDRegisterSize) float interleaved[kBlockSize * kLanes];
+  float mix[kBlockSize];
+
+  int beginChunk(SynthVoice *const *voices, int numVoices, int maxSamples);
+  void gather(SynthVoice &voice, int lane, int numSamples, bool &filtering,
+              bool &ramping);
+  void silence(int lane, int numSamples); // A lane with no voice
+
+  template <bool Filtering, bool Ramping> void process(int numSamples);
+};
+
+} // namespace engine
+} // namespace flowzone
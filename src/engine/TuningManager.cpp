@@ -6,27 +6,99 @@ namespace engine {
 
 TuningManager::TuningManager() { setTo12TET(); }
 
-void TuningManager::loadScl(const juce::String &content) { parseScl(content); }
+void TuningManager::loadScl(const juce::String &content) {
+  parseScl(content);
+  rebuildTable();
+}
+
+bool TuningManager::loadKbm(const juce::String &content) {
+  // Seven header values, then one entry per key of the map: a degree, or
+  // x for a key left silent
+  std::vector<juce::String> values;
+  for (auto line : juce::StringArray::fromLines(content)) {
+    line = line.trim();
+    if (line.isEmpty() || line.startsWith("!"))
+      continue;
+    values.push_back(line.upToFirstOccurrenceOf("!", false, false).trim());
+  }
+  if (values.size() < 7)
+    return false;
+
+  KeyboardMapping parsed;
+  parsed.size = juce::jmax(0, values[0].getIntValue());
+  parsed.firstNote = juce::jlimit(0, kNumNotes - 1, values[1].getIntValue());
+  parsed.lastNote = juce::jlimit(0, kNumNotes - 1, values[2].getIntValue());
+  parsed.middleNote = values[3].getIntValue();
+  parsed.referenceNote =
+      juce::jlimit(0, kNumNotes - 1, values[4].getIntValue());
+  parsed.referenceFrequency = values[5].getDoubleValue();
+  parsed.octaveDegree = juce::jmax(0, values[6].getIntValue());
+  if (parsed.referenceFrequency <= 0.0)
+    return false;
+
+  // Entries missing from the end of the map are unmapped
+  parsed.degrees.assign((size_t)parsed.size, -1);
+  for (size_t i = 0; i < (size_t)parsed.size && 7 + i < values.size(); ++i) {
+    const auto &entry = values[7 + i];
+    if (!entry.startsWithIgnoreCase("x"))
+      parsed.degrees[i] = juce::jmax(0, entry.getIntValue());
+  }
+
+  mapping = std::move(parsed);
+  rebuildTable();
+  return true;
+}
+
+void TuningManager::resetKeyboardMapping() {
+  mapping = {};
+  rebuildTable();
+}
+
+bool TuningManager::degreeForNote(int note, int &degree) const {
+  int offset = note - mapping.middleNote;
+  if (mapping.size == 0) {
+    degree = offset;
+    return true;
+  }
+
+  // Each repeat of the map moves up by the formal octave
+  int repeats = (int)std::floor((double)offset / mapping.size);
+  int key = offset - repeats * mapping.size;
+  int entry = mapping.degrees[(size_t)key];
+  if (entry < 0)
+    return false;
 
-void TuningManager::loadKbm(const juce::String &content) {
-  juce::ignoreUnused(content);
-  // Placeholder for .kbm parsing
+  int octave = mapping.octaveDegree > 0 ? mapping.octaveDegree : notesInOctave;
+  degree = entry + repeats * octave;
+  return true;
 }
 
-double TuningManager::getFrequencyForMidiNote(int midiNoteNumber,
-                                              double rootFreq,
-                                              int rootMidiNote) const {
-  if (ratios.empty())
-    return rootFreq * std::pow(2.0, (midiNoteNumber - rootMidiNote) / 12.0);
+double TuningManager::ratioForDegree(int degree) const {
+  int octave = (int)std::floor((double)degree / notesInOctave);
+  int step = degree - octave * notesInOctave;
+  double ratio = step == 0 ? 1.0 : ratios[(size_t)step - 1];
+  return ratio * std::pow(octaveRatio, octave);
+}
 
-  int diff = midiNoteNumber - kbmReferenceNote;
-  int octave = (int)std::floor((double)diff / notesInOctave);
-  int degree = diff % notesInOctave;
-  if (degree < 0)
-    degree += notesInOctave;
+void TuningManager::rebuildTable() {
+  auto next = std::make_unique<Table>();
+
+  // The reference key sounds at the reference frequency; unmapped, it
+  // still anchors the tuning at the degree it would have played
+  int referenceDegree;
+  if (!degreeForNote(mapping.referenceNote, referenceDegree))
+    referenceDegree = mapping.referenceNote - mapping.middleNote;
+  double scale = mapping.referenceFrequency / ratioForDegree(referenceDegree);
+
+  for (int note = 0; note < kNumNotes; ++note) {
+    int degree;
+    if (note >= mapping.firstNote && note <= mapping.lastNote &&
+        degreeForNote(note, degree))
+      next->frequencies[(size_t)note] = scale * ratioForDegree(degree);
+  }
 
-  double ratio = (degree == 0) ? 1.0 : ratios[degree - 1];
-  return kbmReferenceFreq * std::pow(octaveRatio, octave) * ratio;
+  table.store(next.get(), std::memory_order_release);
+  tables.push_back(std::move(next));
 }
 
 void TuningManager::setTo12TET() {
@@ -36,6 +108,7 @@ void TuningManager::setTo12TET() {
   }
   notesInOctave = 12;
   octaveRatio = 2.0;
+  rebuildTable();
 }
 
 void TuningManager::setToJustIntonation() {
@@ -44,6 +117,7 @@ void TuningManager::setToJustIntonation() {
             5.0 / 3.0,   9.0 / 5.0,   15.0 / 8.0};
   notesInOctave = 12;
   octaveRatio = 2.0;
+  rebuildTable();
 }
 
 void TuningManager::setToPythagorean() {
@@ -53,6 +127,7 @@ void TuningManager::setToPythagorean() {
             27.0 / 16.0,   16.0 / 9.0,    243.0 / 128.0};
   notesInOctave = 12;
   octaveRatio = 2.0;
+  rebuildTable();
 }
 
 void TuningManager::parseScl(const juce::String &content) {
@@ -75,11 +150,13 @@ void TuningManager::parseScl(const juce::String &content) {
     }
   }
 
-  if (!ratios.empty()) {
-    octaveRatio = ratios.back();
-    ratios.pop_back(); // The last one is the octave ratio
-    notesInOctave = (int)ratios.size() + 1;
+  if (ratios.empty()) {
+    setTo12TET(); // Nothing usable: back to the default
+    return;
   }
+  octaveRatio = ratios.back();
+  ratios.pop_back(); // The last one is the octave ratio
+  notesInOctave = (int)ratios.size() + 1;
 }
 
 double TuningManager::parseSclLine(const juce::String &line) {
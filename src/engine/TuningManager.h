@@ -1,6 +1,9 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 namespace flowzone {
@@ -8,35 +11,77 @@ namespace engine {
 
 /**
  * @brief Manages Microtuning / Scala (.scl) and Keyboard Mapping (.kbm).
+ *
+ * Every change to the scale or the mapping rebuilds a table of all 128
+ * notes' frequencies and publishes it with one atomic pointer store, so a
+ * note-on is a lookup and the tuning can change mid-performance without
+ * locks. Changes come from one (non-audio) thread; lookups from any.
+ *
+ * Without a .kbm the scale's root sits on A4 (69) at 440 Hz and every key
+ * plays the next degree.
  */
 class TuningManager {
 public:
+  static constexpr int kNumNotes = 128;
+
   TuningManager();
 
   void loadScl(const juce::String &content);
-  void loadKbm(const juce::String &content);
 
-  double getFrequencyForMidiNote(int midiNoteNumber, double rootFreq = 440.0,
-                                 int rootMidiNote = 69) const;
+  // Scala keyboard mapping; returns false (leaving the mapping as it was)
+  // if the header is incomplete
+  bool loadKbm(const juce::String &content);
+  void resetKeyboardMapping();
+
+  // 0 for keys the mapping leaves out, which shouldn't sound
+  double getFrequencyForMidiNote(int midiNoteNumber) const {
+    if (midiNoteNumber < 0 || midiNoteNumber >= kNumNotes)
+      return 0.0;
+    return table.load(std::memory_order_acquire)
+        ->frequencies[(size_t)midiNoteNumber];
+  }
+
+  bool isNoteMapped(int midiNoteNumber) const {
+    return getFrequencyForMidiNote(midiNoteNumber) > 0.0;
+  }
 
   void setTo12TET();
   void setToJustIntonation();
   void setToPythagorean();
 
 private:
+  struct Table {
+    std::array<double, kNumNotes> frequencies{};
+  };
+
+  struct KeyboardMapping {
+    int size = 0; // 0: keys map linearly onto degrees
+    int firstNote = 0, lastNote = kNumNotes - 1;
+    int middleNote = 69; // Plays degree 0
+    int referenceNote = 69;
+    double referenceFrequency = 440.0;
+    int octaveDegree = 0; // Degrees per repeat of the mapping; 0: scale size
+    std::vector<int> degrees; // By key offset; -1 unmapped
+  };
+
   std::vector<double> ratios; // Ratios relative to root
   int notesInOctave = 12;
   double octaveRatio = 2.0;
+  KeyboardMapping mapping;
 
-  // KBM basics
-  int kbmMiddleNote = 69;
-  int kbmReferenceNote = 69;
-  double kbmReferenceFreq = 440.0;
-  int kbmOctaveDegree = 0;
+  // The audio thread may still be reading a replaced table, so they're
+  // kept until the manager goes: a kilobyte per (manual) tuning change
+  std::vector<std::unique_ptr<Table>> tables;
+  std::atomic<const Table *> table{nullptr};
 
   void parseScl(const juce::String &content);
   double parseSclLine(const juce::String &line);
 
+  // Scale degree a key plays, false if unmapped
+  bool degreeForNote(int note, int &degree) const;
+  double ratioForDegree(int degree) const;
+  void rebuildTable();
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TuningManager)
 };
 
@@ -0,0 +1,70 @@
+#include "VisualizationStream.h"
+#include <cstring>
+
+namespace flowzone {
+
+namespace {
+uint8_t *writeU32(uint8_t *dest, uint32_t value) {
+  value = juce::ByteOrder::swapIfBigEndian(value);
+  std::memcpy(dest, &value, sizeof(value));
+  return dest + sizeof(value);
+}
+
+uint8_t *writeF32(uint8_t *dest, float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return writeU32(dest, bits);
+}
+
+uint8_t *writeF64(uint8_t *dest, double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  bits = juce::ByteOrder::swapIfBigEndian(bits);
+  std::memcpy(dest, &bits, sizeof(bits));
+  return dest + sizeof(bits);
+}
+} // namespace
+
+VisualizationStream::VisualizationStream() : frame(FRAME_BYTES, 0) {}
+
+VisualizationStream::~VisualizationStream() {}
+
+void VisualizationStream::setFrameCallback(FrameCallback callback) {
+  sendBinary = callback;
+}
+
+void VisualizationStream::sendFrame(float barPhase,
+                                    const FeatureExtractor::Features &features,
+                                    const std::vector<float> &waveform) {
+  if (!sendBinary)
+    return;
+
+  ++frameId;
+  encodeFrame(frame.data(), frameId, (double)juce::Time::currentTimeMillis(),
+              barPhase, features, waveform);
+  sendBinary(frame.data(), frame.size());
+}
+
+void VisualizationStream::encodeFrame(
+    uint8_t *dest, uint32_t frameId, double timestampMs, float barPhase,
+    const FeatureExtractor::Features &features,
+    const std::vector<float> &waveform) {
+  dest = writeU32(dest, MAGIC);
+  dest = writeU32(dest, frameId);
+  dest = writeF64(dest, timestampMs);
+
+  dest = writeF32(dest, barPhase);
+  dest = writeF32(dest, features.masterRms[0]);
+  dest = writeF32(dest, features.masterRms[1]);
+
+  for (float rms : features.slotRms)
+    dest = writeF32(dest, rms);
+
+  for (float band : features.spectrum)
+    dest = writeF32(dest, band);
+
+  for (size_t i = 0; i < (size_t)WAVEFORM_POINTS; ++i)
+    dest = writeF32(dest, i < waveform.size() ? waveform[i] : 0.0f);
+}
+
+} // namespace flowzone
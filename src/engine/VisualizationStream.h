@@ -0,0 +1,73 @@
+#pragma once
+
+#include "FeatureExtractor.h"
+#include <JuceHeader.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace flowzone {
+
+/**
+ * VisualizationStream: binary visualization frames (Spec §3.7)
+ *
+ * Frames are encoded on the message thread from FeatureExtractor snapshots
+ * and handed to the transport as one binary WebSocket message. All values
+ * are little endian:
+ *
+ *   Header   [Magic:u32 "FZV1"][FrameId:u32][Timestamp:f64 ms since epoch]
+ *   Payload  Float32 x PAYLOAD_FLOATS
+ *            [BarPhase][MasterRMS_L][MasterRMS_R]
+ *            [Slot1_RMS .. Slot12_RMS]
+ *            [Spectrum_1 .. Spectrum_16]    master output, 0..1
+ *            [Waveform_1 .. Waveform_256]   retrospective buffer overview
+ *
+ * The spec lists a spectrum per slot; one master spectrum is sent instead,
+ * and the waveform overview that used to ride in the JSON state is carried
+ * here so high-churn data never reaches STATE_PATCH.
+ */
+class VisualizationStream {
+public:
+  using FrameCallback = std::function<void(const void *data, size_t size)>;
+
+  static constexpr uint32_t MAGIC = 0x31565A46; // "FZV1"
+  static constexpr int HEADER_BYTES = 16;
+  static constexpr int NUM_SLOTS = FeatureExtractor::kMaxSlots;
+  static constexpr int NUM_BANDS = FeatureExtractor::kSpectrumBands;
+  static constexpr int WAVEFORM_POINTS = 256;
+  static constexpr int PAYLOAD_FLOATS =
+      3 + NUM_SLOTS + NUM_BANDS + WAVEFORM_POINTS;
+  static constexpr size_t FRAME_BYTES =
+      HEADER_BYTES + PAYLOAD_FLOATS * sizeof(float);
+
+  // Spec §3.7: ~30fps; per-client ACK backpressure lives in the server
+  static constexpr int FRAME_RATE_HZ = 30;
+
+  VisualizationStream();
+  ~VisualizationStream();
+
+  // Setup the callback for sending binary frames to clients
+  void setFrameCallback(FrameCallback callback);
+
+  // Encode and send one frame (message thread). waveform may be shorter
+  // than WAVEFORM_POINTS; missing points are sent as 0.
+  void sendFrame(float barPhase, const FeatureExtractor::Features &features,
+                 const std::vector<float> &waveform);
+
+  uint32_t getLastFrameId() const { return frameId; }
+
+  // Writes exactly FRAME_BYTES into dest
+  static void encodeFrame(uint8_t *dest, uint32_t frameId, double timestampMs,
+                          float barPhase,
+                          const FeatureExtractor::Features &features,
+                          const std::vector<float> &waveform);
+
+private:
+  FrameCallback sendBinary;
+  uint32_t frameId = 0;
+  std::vector<uint8_t> frame; // Reused for every frame
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VisualizationStream)
+};
+
+} // namespace flowzone
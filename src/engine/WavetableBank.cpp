@@ -0,0 +1,315 @@
+#include "WavetableBank.h"
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <iterator>
+
+namespace flowzone {
+namespace engine {
+
+namespace {
+
+constexpr int kFftOrder = 11;
+static_assert(1 << kFftOrder == Wavetable::kSize);
+constexpr int kHarmonics = Wavetable::kSize / 2;
+
+constexpr juce::int32 kCacheMagic = 0x54575a46; // "FZWT"
+// Bump when a definition below changes, so stale caches are rebuilt
+constexpr juce::int32 kCacheVersion = 1;
+
+constexpr float kPi = juce::MathConstants<float>::pi;
+
+// Harmonic k's amplitude as (cos, sin); index 0 (DC) is ignored
+using Spectrum = std::vector<std::complex<float>>;
+
+struct Definition {
+  const char *name;
+  int numFrames;
+  void (*fill)(int frame, int numFrames, Spectrum &spectrum);
+  // Optional, applied to the full-band cycle (peak 1) before the mips
+  float (*shaper)(float x, int frame, int numFrames);
+};
+
+float morph(int frame, int numFrames) {
+  return numFrames > 1 ? (float)frame / (float)(numFrames - 1) : 0.0f;
+}
+
+// Sine, triangle, saw, square
+void fillBasic(int frame, int, Spectrum &spectrum) {
+  for (int k = 1; k <= kHarmonics; ++k) {
+    float sign = ((k - 1) / 2) % 2 == 0 ? 1.0f : -1.0f; // +, -, + on odd k
+    float amp = 0.0f;
+    if (frame == 0)
+      amp = k == 1 ? 1.0f : 0.0f;
+    else if (frame == 1)
+      amp = k % 2 == 1 ? sign * 8.0f / (kPi * kPi * (float)(k * k)) : 0.0f;
+    else if (frame == 2)
+      amp = (k % 2 == 1 ? 2.0f : -2.0f) / (kPi * (float)k);
+    else
+      amp = k % 2 == 1 ? 4.0f / (kPi * (float)k) : 0.0f;
+    spectrum[(size_t)k] = {0.0f, amp};
+  }
+}
+
+// Pulse narrowing from 50% to 6%
+void fillPulse(int frame, int numFrames, Spectrum &spectrum) {
+  float width = 0.5f - 0.44f * morph(frame, numFrames);
+  for (int k = 1; k <= kHarmonics; ++k)
+    spectrum[(size_t)k] = {
+        2.0f / (kPi * (float)k) * std::sin(kPi * (float)k * width), 0.0f};
+}
+
+// Drawbar registrations over the 8', 4', 2 2/3', 2', 1 3/5', 1 1/3' and 1'
+// footages
+void fillOrgan(int frame, int, Spectrum &spectrum) {
+  static constexpr int harmonics[] = {1, 2, 3, 4, 5, 6, 8};
+  static constexpr int registrations[][7] = {{8, 8, 8, 0, 0, 0, 0},
+                                             {8, 0, 8, 8, 0, 0, 8},
+                                             {6, 8, 4, 6, 0, 0, 3},
+                                             {8, 8, 8, 8, 8, 8, 8}};
+  for (int i = 0; i < 7; ++i)
+    spectrum[(size_t)harmonics[i]] = {0.0f,
+                                      (float)registrations[frame][i] / 8.0f};
+}
+
+// A saw through the formants of a, e, i, o and u, sung at about 130 Hz
+void fillVocal(int frame, int, Spectrum &spectrum) {
+  static constexpr float formants[][3] = {{800.0f, 1150.0f, 2900.0f},
+                                          {350.0f, 2000.0f, 2800.0f},
+                                          {270.0f, 2140.0f, 2950.0f},
+                                          {450.0f, 800.0f, 2830.0f},
+                                          {325.0f, 700.0f, 2700.0f}};
+  static constexpr float gains[] = {1.0f, 0.5f, 0.25f};
+  static constexpr float bandwidths[] = {80.0f, 90.0f, 120.0f};
+  for (int k = 1; k <= kHarmonics; ++k) {
+    float hz = 130.0f * (float)k, gain = 0.02f;
+    for (int f = 0; f < 3; ++f) {
+      float distance = (hz - formants[frame][f]) / bandwidths[f];
+      gain += gains[f] / (1.0f + distance * distance);
+    }
+    spectrum[(size_t)k] = {0.0f, gain / (float)k};
+  }
+}
+
+// Electric piano tine, from struck to mellow
+void fillKeys(int frame, int numFrames, Spectrum &spectrum) {
+  float bright = 1.0f - 0.9f * morph(frame, numFrames);
+  spectrum[1] = {0.0f, 1.0f};
+  spectrum[2] = {0.0f, 0.35f * bright};
+  spectrum[3] = {0.0f, 0.12f * bright};
+  spectrum[4] = {0.0f, 0.18f * bright * bright};
+  spectrum[7] = {0.0f, 0.22f * bright * bright};
+  spectrum[10] = {0.0f, 0.08f * bright * bright * bright};
+}
+
+// A saw driven harder into tanh frame by frame
+void fillSaw(int, int, Spectrum &spectrum) { fillBasic(2, 4, spectrum); }
+
+float driveShaper(float x, int frame, int numFrames) {
+  float drive = 1.0f + 10.0f * morph(frame, numFrames);
+  return std::tanh(drive * x) / std::tanh(drive);
+}
+
+const Definition definitions[] = {
+    {"basic", 4, fillBasic, nullptr}, {"pulse", 8, fillPulse, nullptr},
+    {"organ", 4, fillOrgan, nullptr}, {"vocal", 5, fillVocal, nullptr},
+    {"keys", 4, fillKeys, nullptr},   {"growl", 8, fillSaw, driveShaper}};
+
+/*
+  The real-only FFT's layout: kHarmonics + 1 interleaved complex bins in an
+  array of 2 * kSize floats. A harmonic of amplitude (c, s), meaning
+  c cos + s sin, is the bin (kSize / 2) * (c, -s), since the inverse
+  transform scales by 1 / kSize.
+*/
+void synthesise(juce::dsp::FFT &fft, const Spectrum &spectrum, int top,
+                std::vector<float> &work) {
+  std::fill(work.begin(), work.end(), 0.0f);
+  const float scale = (float)Wavetable::kSize / 2.0f;
+  for (int k = 1; k <= top; ++k) {
+    work[(size_t)(2 * k)] = scale * spectrum[(size_t)k].real();
+    work[(size_t)(2 * k + 1)] = -scale * spectrum[(size_t)k].imag();
+  }
+  fft.performRealOnlyInverseTransform(work.data());
+}
+
+void analyse(juce::dsp::FFT &fft, std::vector<float> &work,
+             Spectrum &spectrum) {
+  fft.performRealOnlyForwardTransform(work.data());
+  const float scale = 2.0f / (float)Wavetable::kSize;
+  for (int k = 1; k <= kHarmonics; ++k)
+    spectrum[(size_t)k] = {scale * work[(size_t)(2 * k)],
+                           -scale * work[(size_t)(2 * k + 1)]};
+}
+
+float peakOf(const float *samples) {
+  float peak = 0.0f;
+  for (int i = 0; i < Wavetable::kSize; ++i)
+    peak = std::max(peak, std::abs(samples[i]));
+  return peak;
+}
+
+Wavetable buildTable(const Definition &definition, juce::dsp::FFT &fft) {
+  Wavetable table;
+  table.name = definition.name;
+  table.numFrames = definition.numFrames;
+  table.samples.resize((size_t)definition.numFrames * Wavetable::kNumMips *
+                       Wavetable::kStride);
+
+  std::vector<float> work((size_t)(2 * Wavetable::kSize));
+  for (int frame = 0; frame < definition.numFrames; ++frame) {
+    Spectrum spectrum((size_t)kHarmonics + 1);
+    definition.fill(frame, definition.numFrames, spectrum);
+
+    if (definition.shaper != nullptr) {
+      synthesise(fft, spectrum, kHarmonics - 1, work);
+      float gain = 1.0f / juce::jmax(1.0e-6f, peakOf(work.data()));
+      for (int i = 0; i < Wavetable::kSize; ++i)
+        work[(size_t)i] = definition.shaper(work[(size_t)i] * gain, frame,
+                                            definition.numFrames);
+      analyse(fft, work, spectrum);
+    }
+
+    // Mip m stops at harmonic kHarmonics >> m (below Nyquist for mip 0)
+    for (int mip = 0; mip < Wavetable::kNumMips; ++mip) {
+      int top = juce::jmin(kHarmonics - 1, kHarmonics >> mip);
+      synthesise(fft, spectrum, top, work);
+      float *dest = table.samples.data() + Wavetable::offsetOf(frame, mip);
+      std::copy(work.begin(), work.begin() + Wavetable::kSize, dest);
+      dest[Wavetable::kSize] = dest[0];
+    }
+
+    // Same peak level for every frame; the mips keep their relative level
+    float gain = 1.0f / juce::jmax(1.0e-6f, peakOf(table.getMip(frame, 0)));
+    juce::FloatVectorOperations::multiply(
+        table.samples.data() + Wavetable::offsetOf(frame, 0), gain,
+        Wavetable::kNumMips * Wavetable::kStride);
+  }
+  return table;
+}
+
+} // namespace
+
+int Wavetable::mipFor(float increment) {
+  // The top harmonic, (kSize / 2 >> mip) * increment, must stay below 0.5
+  float harmonics = (float)kSize * increment;
+  if (harmonics <= 1.0f)
+    return 0;
+
+  // ceil(log2(harmonics)) without the log: harmonics = mantissa * 2^exponent
+  // with mantissa in [0.5, 1), so it's exponent, less one at a power of two
+  int exponent;
+  float mantissa = std::frexp(harmonics, &exponent);
+  int mip = mantissa == 0.5f ? exponent - 1 : exponent;
+  return juce::jlimit(0, kNumMips - 1, mip);
+}
+
+void WavetableBank::build() {
+  juce::dsp::FFT fft(kFftOrder);
+  tables.clear();
+  for (const auto &definition : definitions)
+    tables.push_back(buildTable(definition, fft));
+}
+
+bool WavetableBank::loadOrBuild(const juce::File &cacheFile) {
+  if (readCache(cacheFile))
+    return true;
+
+  build();
+  if (!writeCache(cacheFile))
+    DBG("WavetableBank: couldn't write " << cacheFile.getFullPathName());
+  return false;
+}
+
+const Wavetable *WavetableBank::find(const juce::String &name) const {
+  for (const auto &table : tables)
+    if (table.name == name)
+      return &table;
+  return nullptr;
+}
+
+juce::File WavetableBank::getDefaultCacheFile() {
+  return juce::File::getSpecialLocation(
+             juce::File::userApplicationDataDirectory)
+      .getChildFile("FlowZone")
+      .getChildFile("cache")
+      .getChildFile("wavetables.bin");
+}
+
+/*
+  Cache layout, little-endian:
+    int32 magic, version, kSize, kNumMips, table count
+    per table: name (UTF-8, null-terminated), int32 frame count, then
+    frames * kNumMips * kStride float32 samples
+*/
+bool WavetableBank::readCache(const juce::File &cacheFile) {
+  juce::FileInputStream in(cacheFile);
+  if (!in.openedOk())
+    return false;
+
+  constexpr int numDefinitions = (int)std::size(definitions);
+  if (in.readInt() != kCacheMagic || in.readInt() != kCacheVersion ||
+      in.readInt() != Wavetable::kSize ||
+      in.readInt() != Wavetable::kNumMips || in.readInt() != numDefinitions)
+    return false;
+
+  std::vector<Wavetable> loaded((size_t)numDefinitions);
+  for (int t = 0; t < numDefinitions; ++t) {
+    auto &table = loaded[(size_t)t];
+    table.name = in.readString();
+    table.numFrames = in.readInt();
+    if (table.name != definitions[t].name ||
+        table.numFrames != definitions[t].numFrames)
+      return false;
+
+    table.samples.resize((size_t)table.numFrames * Wavetable::kNumMips *
+                         Wavetable::kStride);
+    auto bytes = (int)(table.samples.size() * sizeof(float));
+    if (in.read(table.samples.data(), bytes) != bytes)
+      return false;
+
+    if (juce::ByteOrder::isBigEndian())
+      for (auto &sample : table.samples) {
+        auto bits = juce::ByteOrder::swap(std::bit_cast<juce::uint32>(sample));
+        sample = std::bit_cast<float>(bits);
+      }
+  }
+
+  tables = std::move(loaded);
+  return true;
+}
+
+bool WavetableBank::writeCache(const juce::File &cacheFile) const {
+  if (!cacheFile.getParentDirectory().createDirectory())
+    return false;
+
+  // Written aside and moved over the old file, so a reader never sees half
+  juce::TemporaryFile temp(cacheFile);
+  {
+    juce::FileOutputStream out(temp.getFile());
+    if (!out.openedOk())
+      return false;
+
+    out.writeInt(kCacheMagic);
+    out.writeInt(kCacheVersion);
+    out.writeInt(Wavetable::kSize);
+    out.writeInt(Wavetable::kNumMips);
+    out.writeInt(getNumTables());
+    for (const auto &table : tables) {
+      out.writeString(table.name);
+      out.writeInt(table.numFrames);
+      if (juce::ByteOrder::isBigEndian()) {
+        for (auto sample : table.samples)
+          out.writeFloat(sample);
+      } else {
+        out.write(table.samples.data(), table.samples.size() * sizeof(float));
+      }
+    }
+    out.flush();
+    if (out.getStatus().failed())
+      return false;
+  }
+  return temp.overwriteTargetFileWithTemporary();
+}
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+namespace flowzone {
+namespace engine {
+
+/**
+ * @brief A single-cycle wavetable: a few frames to morph between, each kept
+ * as kNumMips band-limited copies (mips), one per octave of pitch.
+ *
+ * Mip m holds harmonics up to kSize / 2 >> m, so a note reads the mip whose
+ * top harmonic stays below Nyquist (mipFor()). Every mip has a copy of its
+ * first sample at the end, so interpolation never wraps.
+ */
+struct Wavetable {
+  static constexpr int kSize = 2048; // Samples per cycle
+  static constexpr int kNumMips = 11;
+  static constexpr int kStride = kSize + 1;
+
+  juce::String name;
+  int numFrames = 0;
+  std::vector<float> samples; // [frame][mip][kStride]
+
+  static size_t offsetOf(int frame, int mip) {
+    return ((size_t)frame * kNumMips + (size_t)mip) * (size_t)kStride;
+  }
+  const float *getMip(int frame, int mip) const {
+    return samples.data() + offsetOf(frame, mip);
+  }
+
+  // The mip to read at increment cycles per sample
+  static int mipFor(float increment);
+};
+
+/**
+ * @brief The synth's wavetables, shared read-only by every voice.
+ *
+ * The tables are defined in WavetableBank.cpp as harmonic spectra, and each
+ * mip is one inverse FFT of a spectrum cut off at its top harmonic. Doing
+ * that for every frame and mip takes a noticeable moment at startup, so the
+ * result is kept on disk in a compact binary cache (raw floats behind a
+ * short header) and reused while the definitions haven't changed.
+ *
+ * Built before audio starts and never modified afterwards, so voices hold
+ * plain pointers to its tables.
+ */
+class WavetableBank {
+public:
+  // Reads cacheFile if it matches the current definitions, else builds the
+  // tables and rewrites it. Returns true if the cache was used.
+  bool loadOrBuild(const juce::File &cacheFile);
+
+  // Builds the tables without touching the disk
+  void build();
+
+  // Nullptr if there is no table of that name
+  const Wavetable *find(const juce::String &name) const;
+
+  int getNumTables() const { return (int)tables.size(); }
+  const Wavetable &getTable(int index) const {
+    return tables[(size_t)index];
+  }
+
+  static juce::File getDefaultCacheFile();
+
+private:
+  std::vector<Wavetable> tables;
+
+  bool readCache(const juce::File &cacheFile);
+  bool writeCache(const juce::File &cacheFile) const;
+};
+
+} // namespace engine
+} // namespace flowzone
@@ -0,0 +1,201 @@
+#include "ClientSendQueue.h"
+#include "../Metrics.h"
+
+using flowzone::Metrics;
+
+ClientSendQueue::ClientSendQueue(WriteFunction w, CloseFunction c)
+    : ClientSendQueue(std::move(w), std::move(c), Limits()) {}
+
+ClientSendQueue::ClientSendQueue(WriteFunction w, CloseFunction c, Limits l)
+    : write(std::move(w)), close(std::move(c)), limits(l) {}
+
+ClientSendQueue::~ClientSendQueue() { stop(); }
+
+void ClientSendQueue::start() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!sender.joinable() && !stopping)
+    sender = std::thread([this] { run(); });
+}
+
+void ClientSendQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    clearQueue();
+  }
+  wake.notify_all();
+
+  if (sender.joinable() && sender.get_id() != std::this_thread::get_id())
+    sender.join();
+}
+
+bool ClientSendQueue::push(SharedMessage message) {
+  bool accepted;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping || stats.disconnecting)
+      return false;
+
+    using Kind = OutgoingMessage::Kind;
+    switch (message->kind) {
+    case Kind::StateSnapshot:
+      dropQueued([](const OutgoingMessage &m) {
+        return m.kind == Kind::StateSnapshot || m.kind == Kind::StatePatch;
+      });
+      break;
+
+    case Kind::Visual:
+      if (stats.pendingFrames > limits.maxPendingFrames) {
+        ++stats.skippedFrames;
+        Metrics::instance().add(Metrics::Counter::WsFramesSkipped);
+        return true;
+      }
+      dropQueued(
+          [](const OutgoingMessage &m) { return m.kind == Kind::Visual; });
+      break;
+
+    default:
+      break;
+    }
+
+    queue.push_back(message);
+    stats.queuedBytes += message->payload.size();
+    ++stats.queuedMessages;
+    accountQueued(*message, 1);
+
+    checkLimits();
+    accepted = !stats.disconnecting;
+  }
+
+  wake.notify_one();
+  return accepted;
+}
+
+void ClientSendQueue::onFrameAck() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (stats.pendingFrames > 0)
+    --stats.pendingFrames;
+}
+
+bool ClientSendQueue::isDisconnecting() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stats.disconnecting;
+}
+
+ClientSendQueue::Stats ClientSendQueue::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stats;
+}
+
+void ClientSendQueue::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (!stopping) {
+    wake.wait(lock, [this] {
+      return stopping || stats.disconnecting || !queue.empty();
+    });
+
+    if (stopping)
+      break;
+
+    if (stats.disconnecting) {
+      clearQueue();
+      lock.unlock();
+      if (close)
+        close();
+      lock.lock();
+
+      // Nothing more to send; wait for the server to stop us
+      wake.wait(lock, [this] { return stopping; });
+      break;
+    }
+
+    SharedMessage message = queue.front();
+    queue.pop_front();
+    stats.queuedBytes -= message->payload.size();
+    --stats.queuedMessages;
+    accountQueued(*message, -1);
+    checkLimits();
+
+    lock.unlock();
+    bool ok = write(*message);
+    lock.lock();
+
+    if (!ok) {
+      stats.disconnecting = true;
+      continue;
+    }
+
+    ++stats.sentMessages;
+    Metrics::instance().add(Metrics::Counter::WsMessagesSent);
+    Metrics::instance().add(Metrics::Counter::WsBytesSent,
+                            message->payload.size());
+    if (message->kind == OutgoingMessage::Kind::Visual)
+      ++stats.pendingFrames;
+  }
+}
+
+void ClientSendQueue::dropQueued(
+    std::function<bool(const OutgoingMessage &)> predicate) {
+  for (auto it = queue.begin(); it != queue.end();) {
+    if (predicate(**it)) {
+      stats.queuedBytes -= (*it)->payload.size();
+      --stats.queuedMessages;
+      ++stats.supersededMessages;
+      accountQueued(**it, -1);
+      Metrics::instance().add(Metrics::Counter::WsMessagesSuperseded);
+      it = queue.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ClientSendQueue::clearQueue() {
+  auto &metrics = Metrics::instance();
+  metrics.adjust(Metrics::Gauge::WsQueuedBytes, -(double)stats.queuedBytes);
+  metrics.adjust(Metrics::Gauge::WsQueuedMessages,
+                 -(double)stats.queuedMessages);
+
+  queue.clear();
+  stats.queuedBytes = 0;
+  stats.queuedMessages = 0;
+}
+
+void ClientSendQueue::accountQueued(const OutgoingMessage &message,
+                                    int direction) {
+  auto &metrics = Metrics::instance();
+  metrics.adjust(Metrics::Gauge::WsQueuedBytes,
+                 (double)direction * (double)message.payload.size());
+  metrics.adjust(Metrics::Gauge::WsQueuedMessages, direction);
+}
+
+void ClientSendQueue::disconnectLaggard() {
+  stats.disconnecting = true;
+  Metrics::instance().add(Metrics::Counter::WsClientsDropped);
+}
+
+void ClientSendQueue::checkLimits() {
+  if (stats.queuedBytes > limits.hardLimitBytes) {
+    disconnectLaggard();
+    return;
+  }
+
+  if (stats.queuedBytes <= limits.maxQueuedBytes) {
+    overLimit = false;
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!overLimit) {
+    overLimit = true;
+    overLimitSince = now;
+    return;
+  }
+
+  auto overMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - overLimitSince)
+                    .count();
+  if (overMs > limits.maxOverLimitMs)
+    disconnectLaggard();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * One outgoing WebSocket message. Encoded once per broadcast and shared
+ * (immutable, refcounted) by every client queue it is pushed to.
+ */
+struct OutgoingMessage {
+  enum class Kind {
+    Event,         // Never dropped
+    StateSnapshot, // Supersedes every queued state message
+    StatePatch,    // Only valid on top of the previous state message
+    Visual         // Binary frame; a newer one supersedes a queued one
+  };
+
+  Kind kind = Kind::Event;
+  bool binary = false;
+  std::string payload;
+
+  static std::shared_ptr<const OutgoingMessage>
+  make(Kind kind, bool binary, std::string payload) {
+    return std::make_shared<const OutgoingMessage>(
+        OutgoingMessage{kind, binary, std::move(payload)});
+  }
+};
+
+using SharedMessage = std::shared_ptr<const OutgoingMessage>;
+
+/**
+ * ClientSendQueue: bounded per-connection send queue with its own sender
+ * thread, so a slow client only ever blocks itself.
+ *
+ * Policies:
+ * - A STATE_FULL drops any state snapshot/patches still queued before it.
+ * - A visual frame replaces a queued, unsent one, and is skipped while more
+ *   than maxPendingFrames sent frames are unacknowledged (Spec §3.7).
+ * - A client that stays over maxQueuedBytes for longer than maxOverLimitMs,
+ *   or exceeds hardLimitBytes at all, is disconnected.
+ */
+class ClientSendQueue {
+public:
+  // Returns false when the connection is broken
+  using WriteFunction = std::function<bool(const OutgoingMessage &)>;
+  using CloseFunction = std::function<void()>;
+
+  struct Limits {
+    size_t maxQueuedBytes = 1024 * 1024;
+    size_t hardLimitBytes = 8 * 1024 * 1024;
+    int maxOverLimitMs = 2000;
+    int maxPendingFrames = 3;
+  };
+
+  struct Stats {
+    size_t queuedBytes = 0;
+    int queuedMessages = 0;
+    int pendingFrames = 0;
+    uint64_t sentMessages = 0;
+    uint64_t supersededMessages = 0; // Dropped because a newer one replaced it
+    uint64_t skippedFrames = 0;      // Visual frames skipped for backpressure
+    bool disconnecting = false;
+  };
+
+  ClientSendQueue(WriteFunction write, CloseFunction close);
+  ClientSendQueue(WriteFunction write, CloseFunction close, Limits limits);
+  ~ClientSendQueue();
+
+  void start();
+
+  // Stops and joins the sender thread. Unsent messages are discarded.
+  void stop();
+
+  // Never blocks on the network. Returns false once the client is being
+  // disconnected; the message is then discarded.
+  bool push(SharedMessage message);
+
+  // Binary ACK from the client for one visual frame
+  void onFrameAck();
+
+  bool isDisconnecting() const;
+  Stats getStats() const;
+
+private:
+  WriteFunction write;
+  CloseFunction close;
+  const Limits limits;
+
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<SharedMessage> queue;
+  Stats stats;
+  bool stopping = false;
+  std::chrono::steady_clock::time_point overLimitSince;
+  bool overLimit = false;
+
+  std::thread sender;
+
+  void run();
+  void dropQueued(std::function<bool(const OutgoingMessage &)> predicate);
+
+  // Keep the process-wide queue gauges (Metrics) in step with stats
+  void clearQueue();
+  void accountQueued(const OutgoingMessage &message, int direction);
+  void disconnectLaggard();
+  void checkLimits();
+};
@@ -0,0 +1,243 @@
+#include "StaticAssets.h"
+#include <cstdio>
+#include <cstring>
+
+namespace {
+const char *const kImmutable = "public, max-age=31536000, immutable";
+const char *const kRevalidate = "no-cache";
+
+struct ContentType {
+  const char *extension;
+  const char *type;
+  bool compressible;
+};
+
+const ContentType kContentTypes[] = {
+    {".html", "text/html; charset=utf-8", true},
+    {".js", "text/javascript; charset=utf-8", true},
+    {".mjs", "text/javascript; charset=utf-8", true},
+    {".css", "text/css; charset=utf-8", true},
+    {".json", "application/json", true},
+    {".map", "application/json", true},
+    {".webmanifest", "application/manifest+json", true},
+    {".svg", "image/svg+xml", true},
+    {".txt", "text/plain; charset=utf-8", true},
+    {".wasm", "application/wasm", true},
+    {".ico", "image/x-icon", true},
+    {".png", "image/png", false},
+    {".jpg", "image/jpeg", false},
+    {".jpeg", "image/jpeg", false},
+    {".gif", "image/gif", false},
+    {".webp", "image/webp", false},
+    {".woff", "font/woff", false},
+    {".woff2", "font/woff2", false},
+    {".ttf", "font/ttf", true},
+};
+
+const ContentType *findContentType(const juce::String &path) {
+  auto extension = path.fromLastOccurrenceOf(".", true, false).toLowerCase();
+  for (const auto &entry : kContentTypes)
+    if (extension == entry.extension)
+      return &entry;
+  return nullptr;
+}
+
+// Strong validator of the content: 64-bit FNV-1a, quoted
+std::string makeEtag(const std::string &data) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  char etag[32];
+  std::snprintf(etag, sizeof(etag), "\"%016llx-%zx\"",
+                (unsigned long long)hash, data.size());
+  return etag;
+}
+
+std::string variantEtag(const std::string &etag,
+                        StaticAssets::Encoding encoding) {
+  if (encoding == StaticAssets::Encoding::Identity)
+    return etag;
+  return etag.substr(0, etag.size() - 1) +
+         (encoding == StaticAssets::Encoding::Gzip ? "-gz\"" : "-br\"");
+}
+
+std::string toString(const juce::MemoryBlock &block) {
+  return std::string(static_cast<const char *>(block.getData()),
+                     block.getSize());
+}
+
+std::string gzipCompress(const std::string &data) {
+  juce::MemoryOutputStream compressed;
+  {
+    juce::GZIPCompressorOutputStream gzip(
+        compressed, 9, juce::GZIPCompressorOutputStream::windowBitsGZIP);
+    gzip.write(data.data(), data.size());
+    gzip.flush();
+  }
+  return toString(compressed.getMemoryBlock());
+}
+
+bool gunzipsTo(const std::string &compressed, const std::string &expected) {
+  juce::MemoryInputStream source(compressed.data(), compressed.size(), false);
+  juce::GZIPDecompressorInputStream gunzip(
+      &source, false, juce::GZIPDecompressorInputStream::gzipFormat);
+  juce::MemoryOutputStream out;
+  out.writeFromInputStream(gunzip, -1);
+  return out.getDataSize() == expected.size() &&
+         std::memcmp(out.getData(), expected.data(), expected.size()) == 0;
+}
+
+// The build's precompressed sibling of file (file.js.br), if it is at
+// least as new as file
+std::string readSibling(const juce::File &file, const char *suffix) {
+  auto sibling = file.getSiblingFile(file.getFileName() + suffix);
+  juce::MemoryBlock data;
+  if (!sibling.existsAsFile() ||
+      sibling.getLastModificationTime() < file.getLastModificationTime() ||
+      !sibling.loadFileAsData(data))
+    return {};
+  return toString(data);
+}
+
+// Weak comparison, as If-None-Match requires (RFC 9110 §13.1.2)
+bool etagListMatches(const char *header, const std::string &etag) {
+  juce::StringArray tags;
+  tags.addTokens(juce::String(header), ",", "\"");
+  for (auto tag : tags) {
+    tag = tag.trim();
+    if (tag == "*")
+      return true;
+    if (tag.startsWith("W/"))
+      tag = tag.substring(2);
+    if (tag.toStdString() == etag)
+      return true;
+  }
+  return false;
+}
+} // namespace
+
+int StaticAssets::load(const juce::File &root) {
+  assets.clear();
+  totalBytes = 0;
+  if (!root.isDirectory())
+    return 0;
+
+  for (const auto &entry : juce::RangedDirectoryIterator(
+           root, true, "*", juce::File::findFiles)) {
+    auto file = entry.getFile();
+    if (file.hasFileExtension("gz;br"))
+      continue; // Picked up with the file they compress
+
+    juce::MemoryBlock data;
+    if (!file.loadFileAsData(data))
+      continue;
+
+    auto relative = file.getRelativePathFrom(root).replaceCharacter('\\', '/');
+    const auto *type = findContentType(relative);
+
+    auto asset = std::make_unique<Asset>();
+    asset->identity = toString(data);
+    asset->contentType = type ? type->type : "application/octet-stream";
+    asset->etag = makeEtag(asset->identity);
+    // Vite puts hashed build output under assets/; a new build means new
+    // names, so these never change under a URL
+    asset->cacheControl =
+        relative.startsWith("assets/") ? kImmutable : kRevalidate;
+
+    if (type != nullptr && type->compressible) {
+      asset->gzip = readSibling(file, ".gz");
+      if (asset->gzip.empty() || !gunzipsTo(asset->gzip, asset->identity))
+        asset->gzip = gzipCompress(asset->identity);
+      if (asset->gzip.size() >= asset->identity.size())
+        asset->gzip.clear();
+
+      asset->brotli = readSibling(file, ".br");
+      if (asset->brotli.size() >= asset->identity.size())
+        asset->brotli.clear();
+    }
+
+    totalBytes +=
+        asset->identity.size() + asset->gzip.size() + asset->brotli.size();
+    assets["/" + relative.toStdString()] = std::move(asset);
+  }
+  return (int)assets.size();
+}
+
+StaticAssets::Response StaticAssets::respond(const std::string &path,
+                                             const char *acceptEncoding,
+                                             const char *ifNoneMatch) const {
+  Response response;
+  auto it = assets.find(!path.empty() && path.back() == '/'
+                            ? path + "index.html"
+                            : path);
+  if (it == assets.end())
+    return response;
+
+  const Asset &asset = *it->second;
+  response.asset = &asset;
+  response.encoding = chooseEncoding(acceptEncoding, asset);
+  response.etag = variantEtag(asset.etag, response.encoding);
+
+  if (ifNoneMatch != nullptr && etagListMatches(ifNoneMatch, response.etag)) {
+    response.status = 304;
+    return response;
+  }
+
+  response.status = 200;
+  switch (response.encoding) {
+  case Encoding::Brotli:
+    response.body = &asset.brotli;
+    break;
+  case Encoding::Gzip:
+    response.body = &asset.gzip;
+    break;
+  case Encoding::Identity:
+    response.body = &asset.identity;
+    break;
+  }
+  return response;
+}
+
+StaticAssets::Encoding StaticAssets::chooseEncoding(const char *acceptEncoding,
+                                                    const Asset &asset) {
+  if (acceptEncoding == nullptr)
+    return Encoding::Identity;
+
+  // Only whether each coding is acceptable (q > 0) matters: brotli is
+  // smaller, so it wins whenever both are
+  bool brotli = false, gzip = false;
+  juce::StringArray codings;
+  codings.addTokens(juce::String(acceptEncoding), ",", "");
+  for (const auto &item : codings) {
+    auto name = item.upToFirstOccurrenceOf(";", false, false).trim();
+    auto params = item.fromFirstOccurrenceOf(";", false, false).trim();
+    bool acceptable =
+        !params.startsWithIgnoreCase("q=") ||
+        params.fromFirstOccurrenceOf("=", false, false).getDoubleValue() > 0.0;
+
+    if (name.equalsIgnoreCase("br") || name == "*")
+      brotli = brotli || acceptable;
+    if (name.equalsIgnoreCase("gzip") || name == "*")
+      gzip = gzip || acceptable;
+  }
+
+  if (brotli && !asset.brotli.empty())
+    return Encoding::Brotli;
+  if (gzip && !asset.gzip.empty())
+    return Encoding::Gzip;
+  return Encoding::Identity;
+}
+
+const char *StaticAssets::getEncodingName(Encoding encoding) {
+  switch (encoding) {
+  case Encoding::Brotli:
+    return "br";
+  case Encoding::Gzip:
+    return "gzip";
+  case Encoding::Identity:
+    break;
+  }
+  return "identity";
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * StaticAssets: the built web client, held in memory.
+ *
+ * load() reads every file under the dist directory once at startup. For
+ * compressible types it keeps the gzip and brotli variants next to the
+ * identity bytes: the .gz / .br siblings written by the Vite build when
+ * they exist, otherwise gzip compressed here (brotli needs the build's
+ * files, there is no encoder in the engine). A variant is only kept if it
+ * is smaller.
+ *
+ * Each response carries a strong ETag (per encoding) and Vary:
+ * Accept-Encoding. Hashed build output under assets/ is immutable and
+ * cached for a year; everything else (index.html) must be revalidated,
+ * which costs a 304 and no body. Nothing touches the disk after load().
+ */
+class StaticAssets {
+public:
+  enum class Encoding { Identity, Gzip, Brotli };
+
+  struct Asset {
+    std::string contentType;
+    std::string cacheControl;
+    std::string etag; // Quoted, of the identity bytes
+    std::string identity;
+    std::string gzip;   // Empty if not worth it
+    std::string brotli; // Empty if the build didn't provide one
+  };
+
+  struct Response {
+    int status = 404;
+    const Asset *asset = nullptr;
+    Encoding encoding = Encoding::Identity;
+    std::string etag;               // Of the variant served
+    const std::string *body = nullptr; // Null for 304 / 404
+  };
+
+  // Replaces the current contents. Returns the number of files loaded.
+  int load(const juce::File &root);
+
+  bool isEmpty() const { return assets.empty(); }
+  size_t getTotalBytes() const { return totalBytes; }
+
+  // path is the request's decoded URI ("/" is index.html). acceptEncoding
+  // and ifNoneMatch are the request headers, or null if absent.
+  Response respond(const std::string &path, const char *acceptEncoding,
+                   const char *ifNoneMatch) const;
+
+  static Encoding chooseEncoding(const char *acceptEncoding,
+                                 const Asset &asset);
+  static const char *getEncodingName(Encoding encoding);
+
+private:
+  std::map<std::string, std::unique_ptr<Asset>> assets; // By "/path"
+  size_t totalBytes = 0;
+};
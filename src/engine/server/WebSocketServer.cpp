@@ -1,5 +1,9 @@
 #include "WebSocketServer.h"
 #include "../FileLogger.h"
+#include "../Metrics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 WebSocketServer::WebSocketServer(int p) : port(p) {}
 
@@ -10,13 +14,23 @@ void WebSocketServer::start() {
     return;
 
   std::string portStr = std::to_string(port);
+  std::string threadsStr = std::to_string(kWorkerThreads);
   std::vector<const char *> options;
   options.push_back("listening_ports");
   options.push_back(portStr.c_str());
+  options.push_back("num_threads");
+  options.push_back(threadsStr.c_str());
+  // civetweb sets this per server, so state sockets get it as well; they
+  // always write whole messages, so Nagle had nothing to coalesce there
+  options.push_back("tcp_nodelay");
+  options.push_back("1");
   options.push_back("websocket_timeout_ms");
   options.push_back("3600000");
+  // The client's index.html, scripts and styles come over one connection
+  options.push_back("enable_keep_alive");
+  options.push_back("yes");
 
-  if (!documentRoot.empty()) {
+  if (!documentRoot.empty() && staticAssets.isEmpty()) {
     options.push_back("document_root");
     options.push_back(documentRoot.c_str());
   }
@@ -32,6 +46,20 @@ void WebSocketServer::start() {
   mg_set_websocket_handler(ctx, "/", websocket_connect_handler,
                            websocket_ready_handler, websocket_data_handler,
                            websocket_close_handler, this);
+
+  // Command socket; exact matches win over "/"
+  mg_set_websocket_handler(ctx, "/cmd", websocket_connect_handler,
+                           command_ready_handler, command_data_handler,
+                           command_close_handler, this);
+
+  // Monitoring endpoints (Spec §5.4)
+  mg_set_request_handler(ctx, "/api/health$", health_handler, this);
+  mg_set_request_handler(ctx, "/metrics$", metrics_handler, this);
+
+  // Everything else is the web client, from memory; the exact matches
+  // above still win over "/"
+  if (!staticAssets.isEmpty())
+    mg_set_request_handler(ctx, "/", static_handler, this);
 }
 
 void WebSocketServer::stop() {
@@ -41,22 +69,108 @@ void WebSocketServer::stop() {
   }
 }
 
-void WebSocketServer::broadcast(const std::string &message) {
+void WebSocketServer::broadcast(const std::string &message,
+                                OutgoingMessage::Kind kind) {
   static int broadcastCounter = 0;
-  std::lock_guard<std::mutex> lock(connectionsMutex);
+  auto clients = getConnections();
+  auto shared = OutgoingMessage::make(kind, false, message);
+  for (const auto &client : *clients)
+    pushTo(client, shared);
+
+  flowzone::FileLogger::instance().logSampled(
+      flowzone::FileLogger::Category::WebSocket,
+      "BROADCAST to " + std::to_string(clients->size()) + " clients, " +
+          std::to_string(message.length()) + " bytes",
+      broadcastCounter, 60);
+}
+
+void WebSocketServer::broadcastState(OutgoingMessage::Kind kind,
+                                     const PayloadFunction &json,
+                                     const PayloadFunction &msgPack) {
+  static int broadcastCounter = 0;
+  SharedMessage jsonMessage, msgPackMessage;
+
+  auto clients = getConnections();
+  for (const auto &client : *clients) {
+    if (client.encoding == StateEncoding::MsgPack) {
+      if (!msgPackMessage)
+        msgPackMessage = OutgoingMessage::make(kind, true, msgPack());
+      pushTo(client, msgPackMessage);
+    } else {
+      if (!jsonMessage)
+        jsonMessage = OutgoingMessage::make(kind, false, json());
+      pushTo(client, jsonMessage);
+    }
+  }
+
   flowzone::FileLogger::instance().logSampled(
       flowzone::FileLogger::Category::WebSocket,
-      "BROADCAST to " + std::to_string(connections.size()) +
-          " clients, " + std::to_string(message.length()) + " bytes",
+      "STATE to " + std::to_string(clients->size()) + " clients, json " +
+          std::to_string(jsonMessage ? jsonMessage->payload.size() : 0) +
+          " bytes, msgpack " +
+          std::to_string(msgPackMessage ? msgPackMessage->payload.size() : 0) +
+          " bytes",
       broadcastCounter, 60);
-  for (auto *conn : connections) {
-    mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, message.c_str(),
-                       message.length());
+}
+
+void WebSocketServer::broadcastBinary(const void *data, size_t size) {
+  auto clients = getConnections();
+  if (clients->empty())
+    return;
+
+  auto shared = OutgoingMessage::make(
+      OutgoingMessage::Kind::Visual, true,
+      std::string(static_cast<const char *>(data), size));
+  for (const auto &client : *clients)
+    pushTo(client, shared);
+}
+
+void WebSocketServer::setClientLimits(const ClientSendQueue::Limits &limits) {
+  std::lock_guard<std::mutex> lock(connectionsMutex);
+  clientLimits = limits;
+}
+
+std::shared_ptr<const WebSocketServer::ConnectionList>
+WebSocketServer::getConnections() {
+  std::lock_guard<std::mutex> lock(connectionsMutex);
+  return connectionList;
+}
+
+// Caller holds connectionsMutex
+void WebSocketServer::updateConnectionList() {
+  auto list = std::make_shared<ConnectionList>();
+  list->reserve(connections.size());
+  for (const auto &[conn, client] : connections)
+    list->push_back(client);
+  connectionList = std::move(list);
+}
+
+void WebSocketServer::pushTo(const Connection &client,
+                             const SharedMessage &message) {
+  if (!client.queue->push(message) && client.queue->isDisconnecting()) {
+    // Over its queue limit for too long: the sender thread closes it and
+    // onClose cleans up
+    static int laggardCounter = 0;
+    flowzone::FileLogger::instance().logSampled(
+        flowzone::FileLogger::Category::WebSocket,
+        "CLIENT LAGGING, disconnecting (queued " +
+            std::to_string(client.queue->getStats().queuedBytes) + " bytes)",
+        laggardCounter, 60);
   }
 }
 
 void WebSocketServer::setDocumentRoot(const std::string &path) {
   documentRoot = path;
+  int files = staticAssets.load(juce::File(path));
+  flowzone::FileLogger::instance().log(
+      flowzone::FileLogger::Category::WebSocket,
+      "Static assets: " + std::to_string(files) + " files, " +
+          std::to_string(staticAssets.getTotalBytes()) + " bytes from " +
+          path);
+}
+
+void WebSocketServer::setVersion(const std::string &versionString) {
+  version = versionString;
 }
 
 void WebSocketServer::setInitialStateCallback(
@@ -64,8 +178,20 @@ void WebSocketServer::setInitialStateCallback(
   getInitialState = callback;
 }
 
-void WebSocketServer::setOnMessageCallback(
-    std::function<void(const std::string &)> callback) {
+void WebSocketServer::setReconnectCallback(ReconnectCallback callback) {
+  onReconnect = callback;
+}
+
+void WebSocketServer::setQueryCallback(QueryCallback callback) {
+  onQuery = callback;
+}
+
+void WebSocketServer::setConnectionCountCallback(
+    std::function<void(int)> callback) {
+  onConnectionCount = callback;
+}
+
+void WebSocketServer::setOnMessageCallback(MessageCallback callback) {
   onMessage = callback;
 }
 
@@ -95,6 +221,113 @@ void WebSocketServer::websocket_close_handler(const struct mg_connection *conn,
   server->onClose(conn);
 }
 
+void WebSocketServer::command_ready_handler(struct mg_connection *conn,
+                                            void *cbdata) {
+  juce::ignoreUnused(conn);
+  auto *server = static_cast<WebSocketServer *>(cbdata);
+  int total = ++server->commandConnections;
+  flowzone::Metrics::instance().set(
+      flowzone::Metrics::Gauge::WsCommandClients, total);
+  flowzone::FileLogger::instance().log(
+      flowzone::FileLogger::Category::WebSocket,
+      "COMMAND SOCKET CONNECTED, total=" + std::to_string(total));
+}
+
+int WebSocketServer::command_data_handler(struct mg_connection *conn,
+                                          int bits, char *data, size_t len,
+                                          void *cbdata) {
+  auto *server = static_cast<WebSocketServer *>(cbdata);
+  return server->onCommandData(conn, bits, data, len);
+}
+
+void WebSocketServer::command_close_handler(const struct mg_connection *conn,
+                                            void *cbdata) {
+  juce::ignoreUnused(conn);
+  auto *server = static_cast<WebSocketServer *>(cbdata);
+  int remaining = --server->commandConnections;
+  flowzone::Metrics::instance().set(
+      flowzone::Metrics::Gauge::WsCommandClients, remaining);
+  flowzone::FileLogger::instance().log(
+      flowzone::FileLogger::Category::WebSocket,
+      "COMMAND SOCKET DISCONNECTED, remaining=" + std::to_string(remaining));
+}
+
+int WebSocketServer::health_handler(struct mg_connection *conn,
+                                    void *cbdata) {
+  auto *server = static_cast<WebSocketServer *>(cbdata);
+  return sendText(conn, "application/json",
+                  flowzone::Metrics::instance().toHealthJson(
+                      server->version, kProtocolVersion));
+}
+
+int WebSocketServer::metrics_handler(struct mg_connection *conn,
+                                     void *cbdata) {
+  juce::ignoreUnused(cbdata);
+  return sendText(conn, "text/plain; version=0.0.4",
+                  flowzone::Metrics::instance().toPrometheus());
+}
+
+int WebSocketServer::sendText(struct mg_connection *conn,
+                              const char *contentType,
+                              const std::string &body) {
+  const struct mg_request_info *info = mg_get_request_info(conn);
+  bool head = std::strcmp(info->request_method, "HEAD") == 0;
+  if (!head && std::strcmp(info->request_method, "GET") != 0) {
+    mg_send_http_error(conn, 405, "Method not allowed");
+    return 405;
+  }
+
+  auto length = std::to_string(body.size());
+  mg_response_header_start(conn, 200);
+  mg_response_header_add(conn, "Content-Type", contentType, -1);
+  mg_response_header_add(conn, "Content-Length", length.c_str(), -1);
+  mg_response_header_add(conn, "Cache-Control", "no-store", -1);
+  mg_response_header_send(conn);
+  if (!head)
+    mg_write(conn, body.data(), body.size());
+  return 200;
+}
+
+int WebSocketServer::static_handler(struct mg_connection *conn,
+                                    void *cbdata) {
+  auto *server = static_cast<WebSocketServer *>(cbdata);
+  const struct mg_request_info *info = mg_get_request_info(conn);
+  bool head = std::strcmp(info->request_method, "HEAD") == 0;
+  if (!head && std::strcmp(info->request_method, "GET") != 0) {
+    mg_send_http_error(conn, 405, "Method not allowed");
+    return 405;
+  }
+
+  auto response = server->staticAssets.respond(
+      info->local_uri, mg_get_header(conn, "Accept-Encoding"),
+      mg_get_header(conn, "If-None-Match"));
+  if (response.status == 404) {
+    mg_send_http_error(conn, 404, "Not found");
+    return 404;
+  }
+
+  const auto &asset = *response.asset;
+  mg_response_header_start(conn, response.status);
+  mg_response_header_add(conn, "ETag", response.etag.c_str(), -1);
+  mg_response_header_add(conn, "Cache-Control", asset.cacheControl.c_str(),
+                         -1);
+  mg_response_header_add(conn, "Vary", "Accept-Encoding", -1);
+  if (response.status == 200) {
+    auto length = std::to_string(response.body->size());
+    mg_response_header_add(conn, "Content-Type", asset.contentType.c_str(),
+                           -1);
+    mg_response_header_add(conn, "Content-Length", length.c_str(), -1);
+    if (response.encoding != StaticAssets::Encoding::Identity)
+      mg_response_header_add(
+          conn, "Content-Encoding",
+          StaticAssets::getEncodingName(response.encoding), -1);
+  }
+  mg_response_header_send(conn);
+  if (response.status == 200 && !head)
+    mg_write(conn, response.body->data(), response.body->size());
+  return response.status;
+}
+
 // Instance Handlers
 int WebSocketServer::onConnect(const struct mg_connection *conn) {
   juce::ignoreUnused(conn);
@@ -102,48 +335,289 @@ int WebSocketServer::onConnect(const struct mg_connection *conn) {
 }
 
 void WebSocketServer::onReady(struct mg_connection *conn) {
+  ClientSendQueue::Limits limits;
   {
     std::lock_guard<std::mutex> lock(connectionsMutex);
-    connections.insert(conn);
+    limits = clientLimits;
   }
 
-  flowzone::FileLogger::instance().log(
-      flowzone::FileLogger::Category::WebSocket,
-      "CLIENT CONNECTED, total=" + std::to_string(connections.size()));
+  auto client = std::make_unique<ClientSendQueue>(
+      [conn](const OutgoingMessage &message) {
+        int opcode = message.binary ? MG_WEBSOCKET_OPCODE_BINARY
+                                    : MG_WEBSOCKET_OPCODE_TEXT;
+        return mg_websocket_write(conn, opcode, message.payload.data(),
+                                  message.payload.size()) > 0;
+      },
+      [conn]() {
+        mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE, "", 0);
+      },
+      limits);
 
-  if (getInitialState) {
-    std::string stateJson = getInitialState();
-    flowzone::FileLogger::instance().log(
-        flowzone::FileLogger::Category::WebSocket,
-        "SENDING INITIAL STATE, " + std::to_string(stateJson.length()) + " bytes");
-    mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, stateJson.c_str(),
-                       stateJson.length());
-  } else {
-    flowzone::FileLogger::instance().log(
-        flowzone::FileLogger::Category::WebSocket,
-        "WARNING: No initial state callback set!");
-    const char *msg = "{\"error\": \"No state callback set\"}";
-    mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, msg, strlen(msg));
+  // Capabilities come in the URL: ?encoding=msgpack for compact state, and
+  // a reconnecting client's last epoch and revision (?epoch=E&revisionId=N)
+  // so it can be caught up without a snapshot
+  int64_t lastRevisionId = -1;
+  char lastEpoch[64] = {};
+  StateEncoding encoding = StateEncoding::Json;
+  const struct mg_request_info *info = mg_get_request_info(conn);
+  if (info != nullptr && info->query_string != nullptr) {
+    const char *query = info->query_string;
+    char value[32];
+    if (mg_get_var(query, strlen(query), "revisionId", value, sizeof(value)) >
+        0)
+      lastRevisionId = std::atoll(value);
+    if (mg_get_var(query, strlen(query), "epoch", lastEpoch,
+                   sizeof(lastEpoch)) < 0)
+      lastEpoch[0] = '\0';
+    if (mg_get_var(query, strlen(query), "encoding", value, sizeof(value)) >
+            0 &&
+        std::strcmp(value, "msgpack") == 0)
+      encoding = StateEncoding::MsgPack;
   }
+
+  size_t total = 0;
+  bool added = false;
+  auto addClient = [&] {
+    client->start();
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    connections[conn] = Connection{std::move(client), encoding};
+    updateConnectionList();
+    total = connections.size();
+    added = true;
+    auto &metrics = flowzone::Metrics::instance();
+    metrics.add(flowzone::Metrics::Counter::WsConnections);
+    metrics.set(flowzone::Metrics::Gauge::WsClients, (double)total);
+    if (onConnectionCount)
+      onConnectionCount((int)total);
+  };
+
+  // The state message goes first in the client's queue. The connection is
+  // registered inside deliver, i.e. while the broadcaster holds its lock,
+  // so no broadcast can fall between the catch-up and the live stream.
+  if (onReconnect) {
+    onReconnect(
+        lastEpoch, lastRevisionId, encoding, [&](const std::string &message) {
+          flowzone::FileLogger::instance().log(
+              flowzone::FileLogger::Category::WebSocket,
+              "SENDING CATCH-UP from revision " +
+                  std::to_string(lastRevisionId) + ", " +
+                  std::to_string(message.length()) + " bytes" +
+                  (encoding == StateEncoding::MsgPack ? " (msgpack)" : ""));
+          client->push(OutgoingMessage::make(
+              OutgoingMessage::Kind::StateSnapshot,
+              encoding == StateEncoding::MsgPack, message));
+          addClient();
+        });
+  }
+
+  if (!added) {
+    if (getInitialState) {
+      std::string stateJson = getInitialState();
+      flowzone::FileLogger::instance().log(
+          flowzone::FileLogger::Category::WebSocket,
+          "SENDING INITIAL STATE, " + std::to_string(stateJson.length()) +
+              " bytes");
+      client->push(OutgoingMessage::make(
+          OutgoingMessage::Kind::StateSnapshot, false, std::move(stateJson)));
+    } else {
+      flowzone::FileLogger::instance().log(
+          flowzone::FileLogger::Category::WebSocket,
+          "WARNING: No initial state callback set!");
+      client->push(OutgoingMessage::make(
+          OutgoingMessage::Kind::Event, false,
+          "{\"error\": \"No state callback set\"}"));
+    }
+    addClient();
+  }
+
+  flowzone::FileLogger::instance().log(
+      flowzone::FileLogger::Category::WebSocket,
+      "CLIENT CONNECTED, total=" + std::to_string(total));
 }
 
 int WebSocketServer::onData(struct mg_connection *conn, int bits, char *data,
                             size_t len) {
-  juce::ignoreUnused(conn, bits);
+  // Binary messages from clients are 4-byte frame ACKs (uint32 FrameId, LE)
+  if ((bits & 0x0f) == MG_WEBSOCKET_OPCODE_BINARY) {
+    if (len == 4) {
+      std::lock_guard<std::mutex> lock(connectionsMutex);
+      auto it = connections.find(conn);
+      if (it != connections.end())
+        it->second.queue->onFrameAck();
+    }
+    return 1;
+  }
+
+  // Handed on in place, as on the command socket
+  std::string_view msg(data, len);
+  if (handleReconnectCommand(conn, msg) || handleQuery(conn, msg))
+    return 1;
+
   if (onMessage) {
-    std::string msg(data, len);
-    flowzone::FileLogger::instance().log(
-        flowzone::FileLogger::Category::WebSocket,
-        "RECEIVED CMD: " + msg.substr(0, 120));
+    // Sampled, and only formatted when it is written
+    static int receiveCounter = 0;
+    if (++receiveCounter >= 60) {
+      receiveCounter = 0;
+      flowzone::FileLogger::instance().log(
+          flowzone::FileLogger::Category::WebSocket,
+          "RECEIVED CMD: " + std::string(msg.substr(0, 120)));
+    }
     onMessage(msg);
   }
   return 1; // Keep open
 }
 
+namespace {
+// The requestId of a command, found without parsing the rest of it. For a
+// batch frame that is the first command's, and the ack covers the frame.
+bool findRequestId(std::string_view msg, long long &requestId) {
+  auto at = msg.find("\"requestId\"");
+  if (at == std::string_view::npos)
+    return false;
+
+  at = msg.find_first_not_of(" \t\r\n", at + 11);
+  if (at == std::string_view::npos || msg[at] != ':')
+    return false;
+
+  // Digits only, so strtoll can't run past the frame
+  at = msg.find_first_not_of(" \t\r\n", at + 1);
+  if (at == std::string_view::npos)
+    return false;
+  auto digits = msg.find_first_not_of("-0123456789", at);
+  if (digits == std::string_view::npos || digits == at || digits - at > 20)
+    return false;
+
+  char number[24] = {};
+  msg.copy(number, digits - at, at);
+  requestId = std::strtoll(number, nullptr, 10);
+  return true;
+}
+} // namespace
+
+// Runs on the command socket's own civetweb thread. Nothing but acks is
+// ever sent on it, so they are written straight away rather than queued.
+int WebSocketServer::onCommandData(struct mg_connection *conn, int bits,
+                                   char *data, size_t len) {
+  if ((bits & 0x0f) != MG_WEBSOCKET_OPCODE_TEXT)
+    return 1;
+
+  // Handed on in place: the engine's queue takes the only copy
+  std::string_view msg(data, len);
+  bool queued = onMessage && onMessage(msg);
+
+  static int commandCounter = 0;
+  if (++commandCounter >= 60) {
+    commandCounter = 0;
+    flowzone::FileLogger::instance().log(
+        flowzone::FileLogger::Category::WebSocket,
+        "RECEIVED CMD (cmd socket): " + std::string(msg.substr(0, 120)));
+  }
+
+  long long requestId;
+  if (findRequestId(msg, requestId)) {
+    char ack[96];
+    int length = std::snprintf(ack, sizeof(ack),
+                               "{\"type\":\"ACK\",\"requestId\":%lld,"
+                               "\"queued\":%s}",
+                               requestId, queued ? "true" : "false");
+    mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, ack, (size_t)length);
+  }
+  return 1;
+}
+
 void WebSocketServer::onClose(const struct mg_connection *conn) {
+  std::shared_ptr<ClientSendQueue> client;
+  size_t remaining;
+  {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    auto it = connections.find(const_cast<struct mg_connection *>(conn));
+    if (it != connections.end()) {
+      client = std::move(it->second.queue);
+      connections.erase(it);
+      updateConnectionList();
+    }
+    remaining = connections.size();
+    flowzone::Metrics::instance().set(flowzone::Metrics::Gauge::WsClients,
+                                      (double)remaining);
+    if (client && onConnectionCount)
+      onConnectionCount((int)remaining);
+  }
+
+  // Joins the sender thread; done outside the lock so a write that is still
+  // timing out on this client cannot stall broadcasts to the others
+  if (client) {
+    auto stats = client->getStats();
+    client->stop();
+    flowzone::FileLogger::instance().log(
+        flowzone::FileLogger::Category::WebSocket,
+        "CLIENT DISCONNECTED, remaining=" + std::to_string(remaining) +
+            " sent=" + std::to_string(stats.sentMessages) +
+            " superseded=" + std::to_string(stats.supersededMessages) +
+            " skippedFrames=" + std::to_string(stats.skippedFrames));
+  }
+}
+
+// civetweb delivers a connection's data and close on the same thread, so
+// from a data handler the returned queue outlives the call. The lock is
+// released before returning: connectionsMutex must not be held while
+// calling out, as broadcasts take the broadcaster lock first.
+ClientSendQueue *WebSocketServer::findClient(struct mg_connection *conn,
+                                             StateEncoding &encoding) {
   std::lock_guard<std::mutex> lock(connectionsMutex);
-  connections.erase(const_cast<struct mg_connection *>(conn));
+  auto it = connections.find(conn);
+  if (it == connections.end())
+    return nullptr;
+  encoding = it->second.encoding;
+  return it->second.queue.get();
+}
+
+// WS_RECONNECT is answered here rather than by the engine: the reply goes
+// to this one client, not to everyone
+bool WebSocketServer::handleReconnectCommand(struct mg_connection *conn,
+                                             std::string_view msg) {
+  if (!onReconnect || msg.find("\"WS_RECONNECT\"") == std::string_view::npos)
+    return false;
+
+  juce::var parsed = juce::JSON::parse(
+      juce::String::fromUTF8(msg.data(), (int)msg.size()));
+  if (parsed["cmd"].toString() != "WS_RECONNECT")
+    return false;
+
+  int64_t lastRevisionId = parsed.hasProperty("revisionId")
+                               ? (juce::int64)parsed["revisionId"]
+                               : -1;
+  std::string lastEpoch = parsed["epoch"].toString().toStdString();
+
+  StateEncoding encoding = StateEncoding::Json;
+  ClientSendQueue *client = findClient(conn, encoding);
+  if (client == nullptr)
+    return true;
+
   flowzone::FileLogger::instance().log(
       flowzone::FileLogger::Category::WebSocket,
-      "CLIENT DISCONNECTED, remaining=" + std::to_string(connections.size()));
+      "WS_RECONNECT from revision " + std::to_string(lastRevisionId));
+  onReconnect(lastEpoch, lastRevisionId, encoding,
+              [client, encoding](const std::string &message) {
+                client->push(OutgoingMessage::make(
+                    OutgoingMessage::Kind::StateSnapshot,
+                    encoding == StateEncoding::MsgPack, message));
+              });
+  return true;
+}
+
+// Queries are answered on the connection's thread and never reach the
+// engine's command queue, so paging through history doesn't wake the
+// audio thread or cause a state broadcast
+bool WebSocketServer::handleQuery(struct mg_connection *conn,
+                                  std::string_view msg) {
+  if (!onQuery)
+    return false;
+
+  // Replies are always JSON text, whatever the state encoding
+  return onQuery(msg, [this, conn](const std::string &reply) {
+    StateEncoding encoding;
+    if (auto *client = findClient(conn, encoding))
+      client->push(OutgoingMessage::make(OutgoingMessage::Kind::Event, false,
+                                         reply));
+  });
 }
@@ -1,45 +1,146 @@
 #pragma once
 
 #define NO_SSL
+#include "ClientSendQueue.h"
+#include "StaticAssets.h"
 #include "civetweb.h"
 #include <JuceHeader.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include <atomic>
 #include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
-#include <set>
+
+// Encoding of STATE_FULL / STATE_PATCH, negotiated per connection with
+// ws://host/?encoding=msgpack. MessagePack state goes out as binary frames;
+// visualization frames are told apart by their "FZV1" magic. Clients that
+// ask for nothing (or anything unknown) get JSON text.
+enum class StateEncoding { Json, MsgPack };
 
 class WebSocketServer {
 public:
+  // Reported by /api/health; bump with breaking protocol changes
+  static constexpr int kProtocolVersion = 1;
+
+  // civetweb parks a worker thread on each open WebSocket for its whole
+  // life, so this bounds the number of clients. Sized for 64 clients, each
+  // with a state and a command socket, with room left for static files and
+  // /api requests (civetweb's default is 50).
+  static constexpr int kWorkerThreads = 160;
+
   WebSocketServer(int port);
   ~WebSocketServer();
 
   void start();
   void stop();
 
-  // Send a message to all connected clients
-  void broadcast(const std::string &message);
+  // Send a message to all connected clients. The message is encoded once
+  // and queued per client; nothing here waits on the network.
+  void broadcast(const std::string &message,
+                 OutgoingMessage::Kind kind = OutgoingMessage::Kind::Event);
+
+  // Send a state message. Each encoding is produced (by calling json or
+  // msgPack) at most once, and only if a connected client uses it.
+  using PayloadFunction = std::function<std::string()>;
+  void broadcastState(OutgoingMessage::Kind kind, const PayloadFunction &json,
+                      const PayloadFunction &msgPack);
 
-  // Set the directory to serve files from
+  // Send a binary visualization frame (Spec §3.7). Clients with too many
+  // unacknowledged frames are skipped for this frame.
+  void broadcastBinary(const void *data, size_t size);
+
+  // Per-client queue limits, applied to connections opened afterwards
+  void setClientLimits(const ClientSendQueue::Limits &limits);
+
+  // Set the directory to serve files from. Its contents are loaded into
+  // memory here and served from there; civetweb only serves the directory
+  // itself if nothing could be loaded. Call before start().
   void setDocumentRoot(const std::string &path);
 
+  // Application version reported by GET /api/health (Spec §5.4). The
+  // health document and GET /metrics (Prometheus text) are rendered from
+  // flowzone::Metrics alone, so scrapes never touch the engine.
+  void setVersion(const std::string &versionString);
+
   // Set callback for providing initial state to new connections
   void setInitialStateCallback(std::function<std::string()> callback);
 
-  // Set callback for handling incoming messages from clients
-  void setOnMessageCallback(std::function<void(const std::string &)> callback);
+  // Set callback that brings a (re)connecting client up to date (Spec §3.5).
+  // Called with the epoch and revisionId the client last saw ("" and -1 if
+  // it has none), its negotiated encoding and a deliver function that
+  // queues one state message, in that encoding, for that client only.
+  // Returns false if it can't answer; the initial state callback is then
+  // used instead.
+  using DeliverFunction = std::function<void(const std::string &)>;
+  using ReconnectCallback =
+      std::function<bool(std::string_view lastEpoch, int64_t lastRevisionId,
+                         StateEncoding encoding, const DeliverFunction &)>;
+  void setReconnectCallback(ReconnectCallback callback);
+
+  // Set callback that answers read-only queries (e.g. LIST_RIFFS) from a
+  // single client. Called with the raw command text, in place, on the
+  // connection's thread; returns true if it was a query, after queuing its
+  // reply for that client with reply(). Other commands go to the message
+  // callback, so it should turn them down without copying them.
+  using QueryCallback = std::function<bool(std::string_view message,
+                                           const DeliverFunction &reply)>;
+  void setQueryCallback(QueryCallback callback);
+
+  // Set callback told the number of open connections whenever it changes.
+  // Called with the connection lock held, so it must not call back into
+  // the server.
+  void setConnectionCountCallback(std::function<void(int)> callback);
+
+  // Set callback for handling incoming commands from clients, whether
+  // they come on "/" or on the command socket. Returns false if the
+  // command was dropped (e.g. the engine's queue was full).
+  //
+  // ws://host/cmd carries nothing but commands and their acks, so a pad
+  // hit never waits behind a snapshot or visual frames on a congested link
+  // (Spec §3.7). A command with a requestId is acked on that socket with
+  // {"type":"ACK","requestId":N,"queued":true|false}. Queries and
+  // WS_RECONNECT stay on "/", where their replies go.
+  using MessageCallback = std::function<bool(std::string_view)>;
+  void setOnMessageCallback(MessageCallback callback);
 
 private:
   int port;
   std::string documentRoot;
+  StaticAssets staticAssets;
+  std::string version = "0.0.0";
   struct mg_context *ctx = nullptr;
 
+  struct Connection {
+    std::shared_ptr<ClientSendQueue> queue;
+    StateEncoding encoding = StateEncoding::Json;
+  };
+  using ConnectionList = std::vector<Connection>;
+
   std::mutex connectionsMutex;
-  std::set<struct mg_connection *> connections;
+  std::map<struct mg_connection *, Connection> connections;
+  ClientSendQueue::Limits clientLimits;
+
+  // Copy of the connections, replaced whenever a client joins or leaves.
+  // Broadcasts hold connectionsMutex only to take a reference and push to
+  // each queue without it, so fan-out to many clients doesn't hold up
+  // connects, disconnects or frame acks. A queue stopped by onClose while
+  // a broadcast still holds it just refuses the push.
+  std::shared_ptr<const ConnectionList> connectionList =
+      std::make_shared<const ConnectionList>();
+  std::shared_ptr<const ConnectionList> getConnections();
+  void updateConnectionList();
+
+  void pushTo(const Connection &client, const SharedMessage &message);
 
   std::function<std::string()> getInitialState;
-  std::function<void(const std::string &)> onMessage;
+  ReconnectCallback onReconnect;
+  QueryCallback onQuery;
+  std::function<void(int)> onConnectionCount;
+  MessageCallback onMessage;
 
   // Static handlers that forward to instance methods
   static int websocket_connect_handler(const struct mg_connection *conn,
@@ -49,10 +150,30 @@ private:
                                     char *data, size_t len, void *cbdata);
   static void websocket_close_handler(const struct mg_connection *conn,
                                       void *cbdata);
+  static void command_ready_handler(struct mg_connection *conn, void *cbdata);
+  static int command_data_handler(struct mg_connection *conn, int bits,
+                                  char *data, size_t len, void *cbdata);
+  static void command_close_handler(const struct mg_connection *conn,
+                                    void *cbdata);
+  static int health_handler(struct mg_connection *conn, void *cbdata);
+  static int metrics_handler(struct mg_connection *conn, void *cbdata);
+  static int sendText(struct mg_connection *conn, const char *contentType,
+                      const std::string &body);
+  static int static_handler(struct mg_connection *conn, void *cbdata);
 
   // Instance handlers
   int onConnect(const struct mg_connection *conn);
   void onReady(struct mg_connection *conn);
   int onData(struct mg_connection *conn, int bits, char *data, size_t len);
   void onClose(const struct mg_connection *conn);
+  int onCommandData(struct mg_connection *conn, int bits, char *data,
+                    size_t len);
+
+  std::atomic<int> commandConnections{0};
+
+  ClientSendQueue *findClient(struct mg_connection *conn,
+                              StateEncoding &encoding);
+  bool handleReconnectCommand(struct mg_connection *conn,
+                              std::string_view msg);
+  bool handleQuery(struct mg_connection *conn, std::string_view msg);
 };
@@ -0,0 +1,133 @@
+#include "HistoryStore.h"
+
+namespace flowzone {
+
+template <typename Entry>
+void HistoryStore::IndexedList<Entry>::add(const Entry &entry) {
+  if (auto it = index.find(entry.id); it != index.end())
+    entries[it->second] = entry;
+  else {
+    index[entry.id] = entries.size();
+    entries.push_back(entry);
+  }
+  ++version;
+}
+
+template <typename Entry>
+bool HistoryStore::IndexedList<Entry>::remove(const juce::String &id) {
+  auto it = index.find(id);
+  if (it == index.end())
+    return false;
+
+  size_t position = it->second;
+  entries.erase(entries.begin() + (std::ptrdiff_t)position);
+  index.erase(it);
+  for (auto &[key, i] : index)
+    if (i > position)
+      --i;
+
+  ++version;
+  return true;
+}
+
+template <typename Entry>
+bool HistoryStore::IndexedList<Entry>::find(const juce::String &id,
+                                            Entry &out) const {
+  auto it = index.find(id);
+  if (it == index.end())
+    return false;
+  out = entries[it->second];
+  return true;
+}
+
+template <typename Entry>
+void HistoryStore::IndexedList<Entry>::assign(std::vector<Entry> newEntries) {
+  entries = std::move(newEntries);
+  index.clear();
+  for (size_t i = 0; i < entries.size(); ++i)
+    index[entries[i].id] = i;
+  ++version;
+}
+
+template <typename Entry>
+HistoryStore::Page<Entry>
+HistoryStore::IndexedList<Entry>::page(int offset, int limit) const {
+  Page<Entry> result;
+  result.total = (int)entries.size();
+  result.version = version;
+  result.offset = juce::jlimit(0, result.total, offset);
+
+  if (limit <= 0)
+    limit = kDefaultPageSize;
+  limit = std::min(limit, kMaxPageSize);
+
+  // Newest first: offset 0 is the last entry
+  int count = std::min(limit, result.total - result.offset);
+  result.items.reserve((size_t)count);
+  for (int i = 0; i < count; ++i)
+    result.items.push_back(
+        entries[(size_t)(result.total - 1 - result.offset - i)]);
+  return result;
+}
+
+void HistoryStore::addSession(const Session &session) {
+  juce::ScopedLock sl(lock);
+  sessions.add(session);
+}
+
+bool HistoryStore::removeSession(const juce::String &id) {
+  juce::ScopedLock sl(lock);
+  return sessions.remove(id);
+}
+
+bool HistoryStore::findSession(const juce::String &id, Session &out) const {
+  juce::ScopedLock sl(lock);
+  return sessions.find(id, out);
+}
+
+HistoryStore::Page<HistoryStore::Session>
+HistoryStore::getSessions(int offset, int limit) const {
+  juce::ScopedLock sl(lock);
+  return sessions.page(offset, limit);
+}
+
+void HistoryStore::addRiff(const RiffHistoryEntry &riff) {
+  juce::ScopedLock sl(lock);
+  riffs.add(riff);
+}
+
+bool HistoryStore::findRiff(const juce::String &id,
+                            RiffHistoryEntry &out) const {
+  juce::ScopedLock sl(lock);
+  return riffs.find(id, out);
+}
+
+HistoryStore::Page<RiffHistoryEntry> HistoryStore::getRiffs(int offset,
+                                                            int limit) const {
+  juce::ScopedLock sl(lock);
+  return riffs.page(offset, limit);
+}
+
+std::vector<RiffHistoryEntry> HistoryStore::getAllRiffs() const {
+  juce::ScopedLock sl(lock);
+  return riffs.entries;
+}
+
+void HistoryStore::setRiffs(std::vector<RiffHistoryEntry> newRiffs) {
+  juce::ScopedLock sl(lock);
+  riffs.assign(std::move(newRiffs));
+}
+
+AppState::Library HistoryStore::getLibrary() const {
+  juce::ScopedLock sl(lock);
+  AppState::Library library;
+  library.sessionCount = (int)sessions.entries.size();
+  library.sessionsVersion = sessions.version;
+  library.riffCount = (int)riffs.entries.size();
+  library.riffsVersion = riffs.version;
+  if (!riffs.entries.empty())
+    library.latestRiff = riffs.entries.back();
+  return library;
+}
+
+} // namespace flowzone
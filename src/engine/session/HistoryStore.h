@@ -0,0 +1,68 @@
+#pragma once
+#include "../state/AppState.h"
+#include <JuceHeader.h>
+#include <unordered_map>
+#include <vector>
+
+namespace flowzone {
+
+/**
+ * HistoryStore: the jam list and riff history, outside the broadcast state
+ *
+ * Both lists keep growing over a long session, so AppState only carries
+ * AppState::Library (counts, versions and the newest riff) and clients page
+ * through the lists with LIST_SESSIONS / LIST_RIFFS. Entries are kept in
+ * creation order with an id index; pages are returned newest first, so
+ * offset 0 is always the most recent entry.
+ *
+ * Every change bumps the list's version. Thread-safe.
+ */
+class HistoryStore {
+public:
+  using Session = AppState::Session;
+
+  static constexpr int kDefaultPageSize = 50;
+  static constexpr int kMaxPageSize = 200;
+
+  template <typename Entry> struct Page {
+    std::vector<Entry> items;
+    int offset = 0;
+    int total = 0;
+    int64_t version = 0;
+  };
+
+  // Sessions. addSession() replaces an entry with the same id.
+  void addSession(const Session &session);
+  bool removeSession(const juce::String &id);
+  bool findSession(const juce::String &id, Session &out) const;
+  Page<Session> getSessions(int offset, int limit) const;
+
+  // Riffs
+  void addRiff(const RiffHistoryEntry &riff);
+  bool findRiff(const juce::String &id, RiffHistoryEntry &out) const;
+  Page<RiffHistoryEntry> getRiffs(int offset, int limit) const;
+  std::vector<RiffHistoryEntry> getAllRiffs() const;
+  void setRiffs(std::vector<RiffHistoryEntry> riffs);
+
+  // Counts, versions and the newest riff, as broadcast in AppState
+  AppState::Library getLibrary() const;
+
+private:
+  template <typename Entry> struct IndexedList {
+    std::vector<Entry> entries;
+    std::unordered_map<juce::String, size_t> index;
+    int64_t version = 0;
+
+    void add(const Entry &entry);
+    bool remove(const juce::String &id);
+    bool find(const juce::String &id, Entry &out) const;
+    void assign(std::vector<Entry> newEntries);
+    Page<Entry> page(int offset, int limit) const;
+  };
+
+  IndexedList<Session> sessions;
+  IndexedList<RiffHistoryEntry> riffs;
+  juce::CriticalSection lock;
+};
+
+} // namespace flowzone
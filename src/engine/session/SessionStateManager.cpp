@@ -1,4 +1,5 @@
 #include "SessionStateManager.h"
+#include "../state/StateSchema.h"
 
 namespace flowzone {
 
@@ -10,10 +11,18 @@ SessionStateManager::~SessionStateManager() {
 
 juce::Result SessionStateManager::saveSession(const juce::File &file,
                                               const AppState &state) {
-  auto jsonVar = state.toVar();
-  auto jsonString = juce::JSON::toString(jsonVar);
+  std::string json;
+  json.reserve(8192);
 
-  if (file.replaceWithText(jsonString)) {
+  // The riff history is the store's, not part of AppState
+  JsonWriter writer(json);
+  writer.beginObject();
+  schema::writeFields(writer, state);
+  writer.key("riffHistory");
+  schema::write(writer, history.getAllRiffs());
+  writer.endObject();
+
+  if (file.replaceWithData(json.data(), json.size())) {
     logSessionEvent("SAVE_SESSION", file.getFullPathName());
     return juce::Result::ok();
   }
@@ -27,14 +36,31 @@ juce::Result SessionStateManager::loadSession(const juce::File &file,
     return juce::Result::fail("File does not exist: " + file.getFullPathName());
   }
 
-  auto jsonString = file.loadFileAsString();
-  auto var = juce::JSON::parse(jsonString);
+  juce::MemoryBlock data;
+  if (!file.loadFileAsData(data)) {
+    return juce::Result::fail("Could not read session file.");
+  }
+
+  AppState loaded;
+  std::vector<RiffHistoryEntry> riffs;
+  JsonReader reader(static_cast<const char *>(data.getData()), data.getSize());
+  bool ok = schema::readObject(reader, loaded, [&](std::string_view key) {
+    return key == "riffHistory" && schema::read(reader, riffs);
+  });
 
-  if (var.isVoid()) {
+  if (!ok || !reader.atEnd()) {
     return juce::Result::fail("Failed to parse JSON.");
   }
 
-  outState = AppState::fromVar(var);
+  history.setRiffs(std::move(riffs));
+  {
+    juce::ScopedLock lock(stateLock);
+    syncLibrary();
+  }
+  notifyChanged();
+
+  outState = std::move(loaded);
+  outState.library = history.getLibrary();
   logSessionEvent("LOAD_SESSION", file.getFullPathName());
   return juce::Result::ok();
 }
@@ -178,7 +204,9 @@ juce::Result SessionStateManager::commitRiff(const juce::String &name,
   entry.colors = colors;
   entry.userId = userId;
   
-  currentState.riffHistory.push_back(entry);
+  history.addRiff(entry);
+  syncLibrary();
+  notifyChanged();
   
   logSessionEvent("COMMIT_RIFF",
                   "id=" + entry.id + ", layers=" + juce::String(layers) +
@@ -190,15 +218,13 @@ juce::Result SessionStateManager::commitRiff(const juce::String &name,
 juce::Result SessionStateManager::loadRiff(const juce::String &riffId) {
   juce::ScopedLock lock(stateLock);
   
-  // Find riff in history
-  for (const auto &riff : currentState.riffHistory) {
-    if (riff.id == riffId) {
-      logSessionEvent("LOAD_RIFF", "id=" + riffId + ", name=" + riff.name);
-      
-      // In full implementation, would restore slot states from riff data
-      // For now, just log the event
-      return juce::Result::ok();
-    }
+  RiffHistoryEntry riff;
+  if (history.findRiff(riffId, riff)) {
+    logSessionEvent("LOAD_RIFF", "id=" + riffId + ", name=" + riff.name);
+
+    // In full implementation, would restore slot states from riff data
+    // For now, just log the event
+    return juce::Result::ok();
   }
   
   return juce::Result::fail("Riff not found: " + riffId);
@@ -213,7 +239,11 @@ juce::Result SessionStateManager::deleteJam(const juce::String &sessionId) {
       logSessionEvent("DELETE_JAM", "sessionId=" + sessionId);
       
       // Clear current state
+      history.removeSession(sessionId);
+      history.setRiffs({});
       currentState = AppState();
+      syncLibrary();
+      notifyChanged();
       
       return juce::Result::ok();
     }
@@ -224,9 +254,29 @@ juce::Result SessionStateManager::deleteJam(const juce::String &sessionId) {
   return juce::Result::fail("Session directory not found");
 }
 
+void SessionStateManager::startSession(const AppState &state) {
+  juce::ScopedLock lock(stateLock);
+  history.addSession(state.session);
+  history.setRiffs({});
+  currentState = state;
+  syncLibrary();
+  notifyChanged();
+}
+
 void SessionStateManager::updateState(std::function<void(AppState &)> modifier) {
   juce::ScopedLock lock(stateLock);
+  auto library = currentState.library;
   modifier(currentState);
+  currentState.library = library;
+  notifyChanged();
+}
+
+void SessionStateManager::setState(const AppState &state) {
+  juce::ScopedLock lock(stateLock);
+  auto library = currentState.library;
+  currentState = state;
+  currentState.library = library;
+  notifyChanged();
 }
 
 void SessionStateManager::logSessionEvent(const juce::String &event,
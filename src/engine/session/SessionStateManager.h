@@ -1,5 +1,6 @@
 #pragma once
 #include "../state/AppState.h"
+#include "HistoryStore.h"
 #include <JuceHeader.h>
 #include <atomic>
 
@@ -10,7 +11,9 @@ public:
   SessionStateManager();
   ~SessionStateManager();
 
-  // Session lifecycle
+  // Session lifecycle. Session files also carry the riff history, which
+  // lives in the history store rather than in AppState; loading a session
+  // replaces the store's riffs with the file's.
   juce::Result saveSession(const juce::File &file, const AppState &state);
   juce::Result loadSession(const juce::File &file, AppState &outState);
   juce::Result createNewSession(const juce::String &name,
@@ -33,13 +36,38 @@ public:
   juce::Result loadRiff(const juce::String &riffId);
   juce::Result deleteJam(const juce::String &sessionId);
 
-  // State access
+  // Makes state the current session: adds it to the jam list and starts an
+  // empty riff history
+  void startSession(const AppState &state);
+
+  // Jam list and riff history, for paged queries
+  const HistoryStore &getHistory() const { return history; }
+
+  // State access. AppState::library mirrors the history store and is
+  // maintained here; setState() and updateState() leave it alone.
   AppState getCurrentState() const { return currentState; }
   void updateState(std::function<void(AppState &)> modifier);
-  void setState(const AppState &state) { currentState = state; }
+  void setState(const AppState &state);
+
+  // Called after every change to the state, on the thread that made it
+  // (often the audio thread), so it must not block or allocate
+  void setChangeCallback(std::function<void()> callback) {
+    onChange = std::move(callback);
+  }
 
 private:
   AppState currentState;
+  HistoryStore history;
+  std::function<void()> onChange;
+
+  void notifyChanged() {
+    if (onChange)
+      onChange();
+  }
+
+  // Refreshes currentState.library after a history change; call with
+  // stateLock held
+  void syncLibrary() { currentState.library = history.getLibrary(); }
   juce::File autosaveDir;
   std::atomic<bool> autosaveEnabled{false};
   
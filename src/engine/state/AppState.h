@@ -6,6 +6,10 @@
 
 namespace flowzone {
 
+class JsonReader;
+class JsonWriter;
+class MsgPackWriter;
+
 struct PluginInstance {
   juce::String id;
   juce::String pluginId;
@@ -13,6 +17,8 @@ struct PluginInstance {
   juce::String name;
   bool bypass = false;
   juce::String state; // Base64
+
+  bool operator==(const PluginInstance &) const = default;
 };
 
 struct SlotState {
@@ -29,6 +35,8 @@ struct SlotState {
   int loopLengthBars = 4;
   double originalBpm = 120.0;
   int lastError = 0;
+
+  bool operator==(const SlotState &) const = default;
 };
 
 struct RiffHistoryEntry {
@@ -38,6 +46,8 @@ struct RiffHistoryEntry {
   int layers = 0;
   std::vector<juce::String> colors;
   juce::String userId = "local";
+
+  bool operator==(const RiffHistoryEntry &) const = default;
 };
 
 struct AppState {
@@ -46,20 +56,36 @@ struct AppState {
     juce::String name;
     juce::String emoji;
     int64_t createdAt = 0;
+
+    bool operator==(const Session &) const = default;
   };
 
-  std::vector<Session> sessions;
+  // The jam list and riff history grow without bound, so they live in
+  // HistoryStore and clients page through them (LIST_SESSIONS, LIST_RIFFS).
+  // The state only carries their sizes, a version that changes with each
+  // list, and the newest riff.
+  struct Library {
+    int sessionCount = 0;
+    int64_t sessionsVersion = 0;
+    int riffCount = 0;
+    int64_t riffsVersion = 0;
+    RiffHistoryEntry latestRiff; // id is empty until the first commit
+
+    bool operator==(const Library &) const = default;
+  } library;
+
   Session session;
 
   struct Transport {
     double bpm = 120.0;
     bool isPlaying = false;
-    double barPhase = 0.0;
     int loopLengthBars = 4;
     bool metronomeEnabled = false;
     bool quantiseEnabled = false;
     int rootNote = 0;
     juce::String scale = "chromatic";
+
+    bool operator==(const Transport &) const = default;
   } transport;
 
   struct ActiveMode {
@@ -68,16 +94,22 @@ struct AppState {
     juce::String presetName = "Synthetic";
     bool isFxMode = false;
     std::vector<int> selectedSourceSlots;
+
+    bool operator==(const ActiveMode &) const = default;
   } activeMode;
 
   struct ActiveFX {
     juce::String effectId;
     juce::String effectName;
-    struct {
+    struct XYPosition {
       float x = 0.5f;
       float y = 0.5f;
+
+      bool operator==(const XYPosition &) const = default;
     } xyPosition;
     bool isActive = false;
+
+    bool operator==(const ActiveFX &) const = default;
   } activeFX;
 
   struct Mic {
@@ -85,23 +117,28 @@ struct AppState {
     float inputLevel = 0.0f; // 0.0 to 1.0 peak level for metering
     bool monitorInput = false;
     bool monitorUntilLooped = false;
+
+    bool operator==(const Mic &) const = default;
   } mic;
 
+  // Bar phase and the waveform overview are not part of the JSON state; they
+  // are delivered on the binary visualization stream (VisualizationStream).
   struct Looper {
     float inputLevel =
         0.0f; // 0.0 to 1.0 peak level for retrospective buffer input
-    std::vector<float>
-        waveformData; // Downsampled waveform for UI visualization (256 samples)
+
+    bool operator==(const Looper &) const = default;
   } looper;
 
   std::vector<SlotState> slots;
-  std::vector<RiffHistoryEntry> riffHistory;
 
   struct Settings {
     juce::String riffSwapMode = "instant";
     int bufferSize = 512;
     double sampleRate = 44100.0;
     juce::String storageLocation;
+
+    bool operator==(const Settings &) const = default;
   } settings;
 
   struct System {
@@ -109,13 +146,18 @@ struct AppState {
     float diskBufferUsage = 0.0f;
     float memoryUsageMB = 0.0f;
     int activePluginHosts = 0;
+
+    bool operator==(const System &) const = default;
   } system;
 
-  // Convert to JUCE var (JSON-compatible object)
-  juce::var toVar() const;
+  // The wire format, as described in StateSchema.h, written straight to
+  // MessagePack or JSON
+  void writeMsgPack(MsgPackWriter &writer) const;
+  void writeJson(JsonWriter &writer) const;
 
-  // Create from JUCE var
-  static AppState fromVar(const juce::var &v);
+  // Fills state from the object at the reader's position. Returns false on
+  // malformed JSON.
+  static bool readJson(JsonReader &reader, AppState &state);
 };
 
 } // namespace flowzone
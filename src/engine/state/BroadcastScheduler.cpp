@@ -0,0 +1,76 @@
+#include "BroadcastScheduler.h"
+
+namespace flowzone {
+
+bool BroadcastScheduler::setConnectionCount(int count) noexcept {
+  int previous = connections.exchange(count);
+  if (count <= previous)
+    return false;
+
+  // The broadcaster's last state may be stale after an idle spell; make
+  // sure a newcomer's catch-up is followed by a fresh update
+  markDirty(State);
+  return true;
+}
+
+BroadcastScheduler::Decision BroadcastScheduler::onTick(double nowMs,
+                                                        bool animating) {
+  Decision decision;
+
+  // Flags stay pending while nobody is listening
+  if (connections.load() <= 0)
+    return decision;
+
+  // Timer ticks jitter around minIntervalMs; allow half a tick of slack so
+  // e.g. 30Hz isn't rounded down to every third 60Hz tick
+  const double slack = config.minIntervalMs * 0.5;
+  auto due = [&](double lastMs, double periodMs) {
+    return nowMs - lastMs >= periodMs - slack;
+  };
+
+  uint32_t changes = pending.exchange(0, std::memory_order_acquire);
+  uint32_t deferred = 0;
+
+  if (changes & State) {
+    if (due(lastStateMs, config.minIntervalMs)) {
+      decision.sendState = true;
+      lastStateMs = nowMs;
+    } else {
+      deferred |= State;
+    }
+  }
+
+  if (changes & Meters) {
+    lastActivityMs = nowMs;
+    lastMeterActivityMs = nowMs;
+    if (decision.sendState) {
+      lastMetersMs = nowMs; // Meters ride along with the state update
+    } else if (due(lastMetersMs, 1000.0 / config.meterRateHz)) {
+      decision.sendState = true;
+      lastMetersMs = nowMs;
+    } else {
+      deferred |= Meters;
+    }
+  }
+
+  if (changes & (State | Command))
+    lastActivityMs = nowMs;
+
+  if (deferred != 0)
+    pending.fetch_or(deferred, std::memory_order_release);
+
+  bool active = nowMs - lastActivityMs < config.idleAfterMs;
+  bool metersMoving = nowMs - lastMeterActivityMs < config.idleAfterMs;
+  if ((animating || metersMoving) &&
+      due(lastVisualMs, 1000.0 / config.visualRateHz)) {
+    decision.sendVisual = true;
+    lastVisualMs = nowMs;
+  }
+
+  decision.nextTickMs = (deferred != 0 || animating || active)
+                            ? config.minIntervalMs
+                            : config.idlePollMs;
+  return decision;
+}
+
+} // namespace flowzone
@@ -0,0 +1,83 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstdint>
+
+namespace flowzone {
+
+/**
+ * BroadcastScheduler: decides when the message thread broadcasts state
+ *
+ * Producers on any thread (including the audio thread) flag what changed
+ * with markDirty(), which is a single atomic OR. The owner's timer calls
+ * onTick() and re-arms itself with the returned interval:
+ *
+ * - No connections: nothing is sent and the timer stops (nextTickMs == 0).
+ *   A new connection flags a state change and restarts it.
+ * - State changes (commands, session edits) go out at most once per
+ *   minIntervalMs; everything flagged in between is coalesced into one
+ *   broadcast.
+ * - Meter-only changes are capped at meterRateHz.
+ * - Visual frames run at visualRateHz only while something is animating
+ *   (transport playing or meters moving).
+ * - After idleAfterMs without changes the timer drops to idlePollMs, so a
+ *   connected but quiet engine wakes only a few times a second. Queued
+ *   commands flag Command and restart the timer at the fast rate, so the
+ *   audio thread's response is picked up promptly.
+ */
+class BroadcastScheduler {
+public:
+  enum Change : uint32_t {
+    State = 1 << 0,  // Anything in AppState besides meters
+    Meters = 1 << 1, // mic/looper input levels
+    Command = 1 << 2 // A command was queued; its effects are imminent
+  };
+
+  struct Config {
+    int minIntervalMs = 16; // Max ~60 broadcasts/s
+    double meterRateHz = 20.0;
+    double visualRateHz = 30.0;
+    int idleAfterMs = 1000;
+    int idlePollMs = 250;
+  };
+
+  struct Decision {
+    bool sendState = false;
+    bool sendVisual = false;
+    int nextTickMs = 0; // 0 = stop the timer until the next connection
+  };
+
+  BroadcastScheduler() = default;
+  explicit BroadcastScheduler(const Config &c) : config(c) {}
+
+  // Any thread, lock-free
+  void markDirty(uint32_t changes) noexcept {
+    pending.fetch_or(changes, std::memory_order_release);
+  }
+
+  // Returns true when clients were added; the owner's timer should then
+  // run at the fast rate so they get a fresh update
+  bool setConnectionCount(int count) noexcept;
+  int getConnectionCount() const noexcept { return connections.load(); }
+
+  // Message thread. animating: the transport is running, so visual frames
+  // have something to show even without meter activity.
+  Decision onTick(double nowMs, bool animating);
+
+  // Message thread
+  void setConfig(const Config &c) { config = c; }
+  const Config &getConfig() const { return config; }
+
+private:
+  Config config;
+  std::atomic<uint32_t> pending{0};
+  std::atomic<int> connections{0};
+
+  double lastStateMs = -1.0e9;
+  double lastMetersMs = -1.0e9;
+  double lastVisualMs = -1.0e9;
+  double lastActivityMs = -1.0e9;
+  double lastMeterActivityMs = -1.0e9;
+};
+
+} // namespace flowzone
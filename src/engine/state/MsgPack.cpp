@@ -0,0 +1,270 @@
+#include "MsgPack.h"
+#include <cstring>
+
+namespace flowzone {
+
+void MsgPackWriter::writeBigEndian(uint64_t value, int numBytes) {
+  for (int i = numBytes - 1; i >= 0; --i)
+    writeByte(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+void MsgPackWriter::writeNil() { writeByte(0xc0); }
+
+void MsgPackWriter::writeBool(bool value) { writeByte(value ? 0xc3 : 0xc2); }
+
+void MsgPackWriter::writeInt(int64_t value) {
+  if (value >= 0) {
+    if (value < 128) {
+      writeByte(static_cast<uint8_t>(value)); // positive fixint
+    } else if (value <= 0xff) {
+      writeByte(0xcc);
+      writeBigEndian((uint64_t)value, 1);
+    } else if (value <= 0xffff) {
+      writeByte(0xcd);
+      writeBigEndian((uint64_t)value, 2);
+    } else if (value <= 0xffffffffLL) {
+      writeByte(0xce);
+      writeBigEndian((uint64_t)value, 4);
+    } else {
+      writeByte(0xcf);
+      writeBigEndian((uint64_t)value, 8);
+    }
+    return;
+  }
+
+  if (value >= -32) {
+    writeByte(static_cast<uint8_t>(value)); // negative fixint
+  } else if (value >= INT8_MIN) {
+    writeByte(0xd0);
+    writeBigEndian((uint64_t)value, 1);
+  } else if (value >= INT16_MIN) {
+    writeByte(0xd1);
+    writeBigEndian((uint64_t)value, 2);
+  } else if (value >= INT32_MIN) {
+    writeByte(0xd2);
+    writeBigEndian((uint64_t)value, 4);
+  } else {
+    writeByte(0xd3);
+    writeBigEndian((uint64_t)value, 8);
+  }
+}
+
+void MsgPackWriter::writeFloat(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeByte(0xca);
+  writeBigEndian(bits, 4);
+}
+
+void MsgPackWriter::writeDouble(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeByte(0xcb);
+  writeBigEndian(bits, 8);
+}
+
+void MsgPackWriter::writeString(const char *utf8, size_t numBytes) {
+  if (numBytes < 32) {
+    writeByte(static_cast<uint8_t>(0xa0 | numBytes));
+  } else if (numBytes <= 0xff) {
+    writeByte(0xd9);
+    writeBigEndian(numBytes, 1);
+  } else if (numBytes <= 0xffff) {
+    writeByte(0xda);
+    writeBigEndian(numBytes, 2);
+  } else {
+    writeByte(0xdb);
+    writeBigEndian(numBytes, 4);
+  }
+  out.append(utf8, numBytes);
+}
+
+void MsgPackWriter::writeString(const char *utf8) {
+  writeString(utf8, std::strlen(utf8));
+}
+
+void MsgPackWriter::writeString(const juce::String &value) {
+  writeString(value.toRawUTF8(), value.getNumBytesAsUTF8());
+}
+
+void MsgPackWriter::writeArrayHeader(uint32_t size) {
+  if (size < 16) {
+    writeByte(static_cast<uint8_t>(0x90 | size));
+  } else if (size <= 0xffff) {
+    writeByte(0xdc);
+    writeBigEndian(size, 2);
+  } else {
+    writeByte(0xdd);
+    writeBigEndian(size, 4);
+  }
+}
+
+void MsgPackWriter::writeMapHeader(uint32_t size) {
+  if (size < 16) {
+    writeByte(static_cast<uint8_t>(0x80 | size));
+  } else if (size <= 0xffff) {
+    writeByte(0xde);
+    writeBigEndian(size, 2);
+  } else {
+    writeByte(0xdf);
+    writeBigEndian(size, 4);
+  }
+}
+
+namespace {
+
+class Reader {
+public:
+  Reader(const uint8_t *d, size_t s) : data(d), size(s) {}
+
+  bool failed = false;
+
+  bool atEnd() const { return pos == size; }
+
+  juce::var readValue(int depth = 0) {
+    if (depth > 64 || !has(1))
+      return fail();
+
+    uint8_t b = data[pos++];
+
+    if (b <= 0x7f)
+      return (int)b;
+    if (b >= 0xe0)
+      return (int)(int8_t)b;
+    if ((b & 0xf0) == 0x80)
+      return readMap(b & 0x0f, depth);
+    if ((b & 0xf0) == 0x90)
+      return readArray(b & 0x0f, depth);
+    if ((b & 0xe0) == 0xa0)
+      return readString(b & 0x1f);
+
+    switch (b) {
+    case 0xc0:
+      return {};
+    case 0xc2:
+      return false;
+    case 0xc3:
+      return true;
+    case 0xca: {
+      uint32_t bits = (uint32_t)readBigEndian(4);
+      float f;
+      std::memcpy(&f, &bits, sizeof(f));
+      return failed ? fail() : juce::var(f);
+    }
+    case 0xcb: {
+      uint64_t bits = readBigEndian(8);
+      double d;
+      std::memcpy(&d, &bits, sizeof(d));
+      return failed ? fail() : juce::var(d);
+    }
+    case 0xcc:
+      return integer((int64_t)readBigEndian(1));
+    case 0xcd:
+      return integer((int64_t)readBigEndian(2));
+    case 0xce:
+      return integer((int64_t)readBigEndian(4));
+    case 0xcf:
+      return integer((int64_t)readBigEndian(8));
+    case 0xd0:
+      return integer((int8_t)readBigEndian(1));
+    case 0xd1:
+      return integer((int16_t)readBigEndian(2));
+    case 0xd2:
+      return integer((int32_t)readBigEndian(4));
+    case 0xd3:
+      return integer((int64_t)readBigEndian(8));
+    case 0xd9:
+      return readString(readBigEndian(1));
+    case 0xda:
+      return readString(readBigEndian(2));
+    case 0xdb:
+      return readString(readBigEndian(4));
+    case 0xdc:
+      return readArray(readBigEndian(2), depth);
+    case 0xdd:
+      return readArray(readBigEndian(4), depth);
+    case 0xde:
+      return readMap(readBigEndian(2), depth);
+    case 0xdf:
+      return readMap(readBigEndian(4), depth);
+    default:
+      return fail(); // bin, ext and reserved types are never sent
+    }
+  }
+
+private:
+  const uint8_t *data;
+  size_t size;
+  size_t pos = 0;
+
+  bool has(size_t n) const { return !failed && size - pos >= n; }
+
+  juce::var fail() {
+    failed = true;
+    return {};
+  }
+
+  // Matches JSON::parse: int when it fits, int64 otherwise
+  juce::var integer(int64_t value) {
+    if (failed)
+      return {};
+    if (value >= INT32_MIN && value <= INT32_MAX)
+      return (int)value;
+    return (juce::int64)value;
+  }
+
+  uint64_t readBigEndian(int numBytes) {
+    if (!has((size_t)numBytes)) {
+      failed = true;
+      return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < numBytes; ++i)
+      value = (value << 8) | data[pos++];
+    return value;
+  }
+
+  juce::var readString(uint64_t length) {
+    if (!has(length))
+      return fail();
+    auto *start = reinterpret_cast<const char *>(data + pos);
+    pos += length;
+    return juce::String::fromUTF8(start, (int)length);
+  }
+
+  juce::var readArray(uint64_t count, int depth) {
+    // Every element takes at least one byte
+    if (!has(count))
+      return fail();
+    juce::Array<juce::var> array;
+    array.ensureStorageAllocated((int)count);
+    for (uint64_t i = 0; i < count && !failed; ++i)
+      array.add(readValue(depth + 1));
+    return failed ? fail() : juce::var(array);
+  }
+
+  juce::var readMap(uint64_t count, int depth) {
+    if (!has(count * 2))
+      return fail();
+    auto *object = new juce::DynamicObject();
+    juce::var result(object);
+    for (uint64_t i = 0; i < count && !failed; ++i) {
+      auto key = readValue(depth + 1);
+      if (!key.isString())
+        return fail();
+      object->setProperty(key.toString(), readValue(depth + 1));
+    }
+    return failed ? fail() : result;
+  }
+};
+
+} // namespace
+
+juce::var MsgPack::decode(const void *data, size_t size, bool &ok) {
+  Reader reader(static_cast<const uint8_t *>(data), size);
+  auto value = reader.readValue();
+  ok = !reader.failed && reader.atEnd();
+  return ok ? value : juce::var();
+}
+
+} // namespace flowzone
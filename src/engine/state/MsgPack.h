@@ -0,0 +1,47 @@
+#pragma once
+#include <JuceHeader.h>
+#include <cstdint>
+#include <string>
+
+namespace flowzone {
+
+/**
+ * MsgPackWriter: minimal MessagePack encoder for the compact state encoding
+ *
+ * Appends to a caller-owned std::string so one buffer can be reserved and
+ * reused. Always picks the smallest representation for ints and lengths.
+ * Floats are written as float32, so AppState's float fields cost 5 bytes
+ * and decode to exactly the value the JSON path would have sent.
+ */
+class MsgPackWriter {
+public:
+  explicit MsgPackWriter(std::string &destination) : out(destination) {}
+
+  void writeNil();
+  void writeBool(bool value);
+  void writeInt(int64_t value);
+  void writeFloat(float value);
+  void writeDouble(double value);
+  void writeString(const char *utf8, size_t numBytes);
+  void writeString(const char *utf8);
+  void writeString(const juce::String &value);
+  void writeArrayHeader(uint32_t size);
+  void writeMapHeader(uint32_t size);
+
+private:
+  std::string &out;
+
+  void writeByte(uint8_t b) { out.push_back(static_cast<char>(b)); }
+  void writeBigEndian(uint64_t value, int numBytes);
+};
+
+namespace MsgPack {
+
+// Decodes one MessagePack value into the var JSON::parse would have built
+// for the equivalent JSON. Returns a void var (and sets ok = false) on
+// malformed or truncated input.
+juce::var decode(const void *data, size_t size, bool &ok);
+
+} // namespace MsgPack
+
+} // namespace flowzone
@@ -1,231 +1,418 @@
 #include "StateBroadcaster.h"
+#include "../Metrics.h"
+#include "StateSchema.h"
 
 namespace flowzone {
 
-StateBroadcaster::StateBroadcaster() {}
+namespace {
+
+/**
+ * Writes RFC 6902 ops as JSON and MessagePack at once, values going through
+ * StateSchema.h. Paths and values are only built for fields that actually
+ * changed; once the op budget is exceeded everything is a no-op.
+ */
+class PatchWriter {
+public:
+  PatchWriter(StateBroadcaster::PatchOps &o, int max)
+      : ops(o), json(o.json), msgPack(o.msgPack), encoder(msgPack),
+        maxOps(max) {
+    json.beginArray();
+  }
+
+  // Closes the JSON array
+  void finish() { json.endArray(); }
+
+  bool full() const { return (int)ops.numOps > maxOps; }
+
+  template <typename T> void replace(const std::string &path, const T &value) {
+    push("replace", path, &value);
+  }
+
+  template <typename T> void add(const std::string &path, const T &value) {
+    push("add", path, &value);
+  }
+
+  void remove(const std::string &path) { push<int>("remove", path, nullptr); }
+
+private:
+  StateBroadcaster::PatchOps &ops;
+  JsonWriter json;
+  MsgPackWriter msgPack;
+  schema::MsgPackEncoder encoder;
+  const int maxOps;
+
+  template <typename T>
+  void push(const char *op, const std::string &path, const T *value) {
+    if (full())
+      return;
+    ops.numOps++;
+
+    json.beginObject();
+    json.key("op");
+    json.writeString(op);
+    json.key("path");
+    json.writeString(std::string_view(path));
+    msgPack.writeMapHeader(value != nullptr ? 3 : 2);
+    msgPack.writeString("op");
+    msgPack.writeString(op);
+    msgPack.writeString("path");
+    msgPack.writeString(path.data(), path.size());
+
+    if (value != nullptr) {
+      json.key("value");
+      schema::write(json, *value);
+      msgPack.writeString("value");
+      schema::write(encoder, *value);
+    }
+    json.endObject();
+  }
+};
+
+template <typename T>
+void diffValue(PatchWriter &patch, const std::string &path, const T &from,
+               const T &to);
+
+// A struct whose id changed is a different entity (a newly committed riff,
+// another plugin), so it is replaced outright rather than field by field
+template <typename T> bool isSameEntity(const T &a, const T &b) {
+  if constexpr (requires { a.id; })
+    return a.id == b.id;
+  else
+    return true;
+}
+
+template <typename Member> const auto &valueOf(const Member &member) {
+  if constexpr (schema::IsOptional<Member>::value)
+    return *member;
+  else
+    return member;
+}
+
+// One schema field. Fields left out of the JSON (see optionalField) are
+// added and removed as they come and go.
+template <typename Owner, typename Member>
+void diffField(PatchWriter &patch, const std::string &prefix, const Owner &a,
+               const Owner &b, const schema::Field<Owner, Member> &f) {
+  const auto &from = a.*f.member;
+  const auto &to = b.*f.member;
+  if (patch.full() || from == to)
+    return;
+
+  auto path = prefix + "/" + f.name;
+  if (!schema::isPresent(b, f))
+    patch.remove(path);
+  else if (!schema::isPresent(a, f))
+    patch.add(path, valueOf(to));
+  else
+    diffValue(patch, path, valueOf(from), valueOf(to));
+}
+
+template <typename Owner>
+void diffField(PatchWriter &, const std::string &, const Owner &,
+               const Owner &, const schema::EmptyObject &) {}
+
+// Element-wise diff of a collection: changed entries are diffed field by
+// field, growth is appended ("/-") and shrinkage removed from the end.
+template <typename T>
+void diffCollection(PatchWriter &patch, const std::string &path,
+                    const std::vector<T> &from, const std::vector<T> &to) {
+  const size_t common = std::min(from.size(), to.size());
+
+  for (size_t i = 0; i < common && !patch.full(); ++i) {
+    if (!(from[i] == to[i]))
+      diffValue(patch, path + "/" + std::to_string(i), from[i], to[i]);
+  }
+
+  for (size_t i = common; i < to.size() && !patch.full(); ++i)
+    patch.add(path + "/-", to[i]);
+
+  for (size_t i = from.size(); i > to.size() && !patch.full(); --i)
+    patch.remove(path + "/" + std::to_string(i - 1));
+}
+
+// Walks Schema<T>::fields, so every field on the wire is compared. Values
+// arrive here already known to differ.
+template <typename T>
+void diffValue(PatchWriter &patch, const std::string &path, const T &from,
+               const T &to) {
+  if constexpr (schema::Described<T>) {
+    if (!isSameEntity(from, to)) {
+      patch.replace(path, to);
+      return;
+    }
+    std::apply(
+        [&](const auto &...f) { (diffField(patch, path, from, to, f), ...); },
+        schema::Schema<T>::fields);
+  } else if constexpr (schema::IsVector<T>::value) {
+    if constexpr (schema::Described<typename T::value_type>)
+      diffCollection(patch, path, from, to);
+    else
+      patch.replace(path, to); // Arrays of plain values go whole
+  } else {
+    patch.replace(path, to);
+  }
+}
+
+} // namespace
+
+const std::string &StateBroadcaster::StateMessage::toJsonUtf8() {
+  if (!jsonUtf8.empty())
+    return jsonUtf8;
+
+  JsonWriter writer(jsonUtf8);
+  writer.beginObject();
+  writer.key("type");
+  writer.writeString(type == MessageType::Snapshot ? "STATE_FULL"
+                                                   : "STATE_PATCH");
+  writer.key("epoch");
+  writer.writeString(std::string_view(epoch));
+  writer.key("revisionId");
+  writer.writeInt(revisionId);
+
+  if (type == MessageType::Snapshot) {
+    jsonUtf8.reserve(4096);
+    writer.key("data");
+    state->writeJson(writer);
+    writer.endObject();
+    return jsonUtf8;
+  }
+
+  if (fromRevisionId >= 0) {
+    writer.key("fromRevisionId");
+    writer.writeInt(fromRevisionId);
+  }
+  size_t opsBytes = 0;
+  for (const auto *entry : patches)
+    opsBytes += entry->ops.json.size();
+  jsonUtf8.reserve(jsonUtf8.size() + opsBytes + 16);
+
+  // Each entry is a non-empty "[...]" array; splice the elements
+  writer.key("ops");
+  writer.beginArray();
+  for (const auto *entry : patches)
+    writer.writeRaw(std::string_view(entry->ops.json)
+                        .substr(1, entry->ops.json.size() - 2));
+  writer.endArray();
+  writer.endObject();
+  return jsonUtf8;
+}
+
+const juce::String &StateBroadcaster::StateMessage::toJson() {
+  if (json.isEmpty()) {
+    const auto &utf8 = toJsonUtf8();
+    json = juce::String::fromUTF8(utf8.data(), (int)utf8.size());
+  }
+  return json;
+}
+
+const std::string &StateBroadcaster::StateMessage::toMsgPack() {
+  if (!msgPack.empty())
+    return msgPack;
+
+  MsgPackWriter writer(msgPack);
+  bool isPatch = type == MessageType::Patch;
+  writer.writeMapHeader(isPatch && fromRevisionId >= 0 ? 5 : 4);
+  writer.writeString("type");
+  writer.writeString(isPatch ? "STATE_PATCH" : "STATE_FULL");
+  writer.writeString("epoch");
+  writer.writeString(epoch.data(), epoch.size());
+  writer.writeString("revisionId");
+  writer.writeInt(revisionId);
+
+  if (!isPatch) {
+    msgPack.reserve(4096);
+    writer.writeString("data");
+    state->writeMsgPack(writer);
+    return msgPack;
+  }
+
+  if (fromRevisionId >= 0) {
+    writer.writeString("fromRevisionId");
+    writer.writeInt(fromRevisionId);
+  }
+
+  uint32_t numOps = 0;
+  for (const auto *entry : patches)
+    numOps += entry->ops.numOps;
+
+  writer.writeString("ops");
+  writer.writeArrayHeader(numOps);
+  for (const auto *entry : patches)
+    msgPack += entry->ops.msgPack;
+  return msgPack;
+}
+
+StateBroadcaster::StateBroadcaster()
+    : epoch(juce::Uuid().toDashedString().toStdString()) {}
 
 StateBroadcaster::~StateBroadcaster() {}
 
 void StateBroadcaster::setMessageCallback(MessageCallback callback) {
+  if (!callback) {
+    setTypedMessageCallback(nullptr);
+    return;
+  }
+
+  setTypedMessageCallback(
+      [callback](const juce::String &message, MessageType) {
+        callback(message);
+      });
+}
+
+void StateBroadcaster::setTypedMessageCallback(TypedMessageCallback callback) {
+  if (!callback) {
+    setStateMessageCallback(nullptr);
+    return;
+  }
+
+  setStateMessageCallback([callback](StateMessage &message) {
+    callback(message.toJson(), message.getType());
+  });
+}
+
+void StateBroadcaster::setStateMessageCallback(StateMessageCallback callback) {
   juce::ScopedLock sl(lock);
   sendMessage = callback;
 }
 
 void StateBroadcaster::broadcastFullState(const AppState &state) {
   juce::ScopedLock sl(lock);
-  revisionId++;
-
-  juce::var stateVar = state.toVar();
-  previousStateVar = stateVar;
-  hasPreviousState = true;
-
-  juce::DynamicObject *root = new juce::DynamicObject();
-  root->setProperty("type", "STATE_FULL");
-  root->setProperty("revisionId", revisionId);
-  root->setProperty("data", stateVar);
-
-  if (sendMessage) {
-    juce::String jsonString = juce::JSON::toString(juce::var(root));
-    sendMessage(jsonString);
-  }
+  sendSnapshot(state);
 }
 
 void StateBroadcaster::broadcastStateUpdate(const AppState &state) {
   juce::ScopedLock sl(lock);
-  
-  juce::var newStateVar = state.toVar();
 
   // If no previous state, send full snapshot
   if (!hasPreviousState) {
-    revisionId++;
-    previousStateVar = newStateVar;
-    hasPreviousState = true;
-
-    juce::DynamicObject *root = new juce::DynamicObject();
-    root->setProperty("type", "STATE_FULL");
-    root->setProperty("revisionId", revisionId);
-    root->setProperty("data", newStateVar);
-
-    if (sendMessage) {
-      juce::String jsonString = juce::JSON::toString(juce::var(root));
-      sendMessage(jsonString);
-    }
+    sendSnapshot(state);
     return;
   }
 
-  // Generate JSON Patch operations
-  juce::Array<juce::var> patchOps = generateJsonPatch(previousStateVar, newStateVar, "");
+  PatchOps patchOps;
+  bool withinOpBudget = diffStates(previousState, state, patchOps);
 
   // If no changes, don't send anything
-  if (patchOps.isEmpty()) {
+  if (withinOpBudget && patchOps.numOps == 0)
     return;
-  }
-
-  // Calculate patch size
-  size_t patchSize = calculatePatchSize(patchOps);
-  
-  // Decide: patch or snapshot?
-  // Spec: >20 ops or >4KB → send snapshot
-  const int MAX_PATCH_OPS = 20;
-  const size_t MAX_PATCH_BYTES = 4096;
 
-  if (patchOps.size() > MAX_PATCH_OPS || patchSize > MAX_PATCH_BYTES) {
-    // Send full snapshot
-    revisionId++;
-    previousStateVar = newStateVar;
+  // The ops come out encoded; their JSON size decides patch vs snapshot
+  if (!withinOpBudget || patchOps.json.size() > MAX_PATCH_BYTES) {
+    sendSnapshot(state);
+    return;
+  }
 
-    juce::DynamicObject *root = new juce::DynamicObject();
-    root->setProperty("type", "STATE_FULL");
-    root->setProperty("revisionId", revisionId);
-    root->setProperty("data", newStateVar);
+  revisionId++;
+  previousState = state;
+  currentSnapshot.reset();
+  remember(revisionId, std::move(patchOps));
+  Metrics::instance().add(Metrics::Counter::StatePatches);
 
-    if (sendMessage) {
-      juce::String jsonString = juce::JSON::toString(juce::var(root));
-      sendMessage(jsonString);
-    }
-  } else {
-    // Send patch
-    revisionId++;
-    previousStateVar = newStateVar;
-
-    juce::DynamicObject *root = new juce::DynamicObject();
-    root->setProperty("type", "STATE_PATCH");
-    root->setProperty("revisionId", revisionId);
-    root->setProperty("ops", patchOps);
-
-    if (sendMessage) {
-      juce::String jsonString = juce::JSON::toString(juce::var(root));
-      sendMessage(jsonString);
-    }
+  if (sendMessage) {
+    StateMessage message(MessageType::Patch, epoch, revisionId);
+    message.patches.push_back(&history.back());
+    sendMessage(message);
   }
 }
 
 int64_t StateBroadcaster::getRevisionId() const { return revisionId; }
 
-juce::Array<juce::var> StateBroadcaster::generateJsonPatch(
-    const juce::var &oldVal, const juce::var &newVal,
-    const juce::String &path) {
-  juce::Array<juce::var> ops;
-
-  // Both are objects - recurse into properties
-  if (oldVal.isObject() && newVal.isObject()) {
-    auto *oldObj = oldVal.getDynamicObject();
-    auto *newObj = newVal.getDynamicObject();
-
-    if (!oldObj || !newObj)
-      return ops;
-
-    // Check all properties in new object
-    auto newProps = newObj->getProperties();
-    for (int i = 0; i < newProps.size(); ++i) {
-      juce::String propName = newProps.getName(i).toString();
-      juce::var newPropVal = newProps.getValueAt(i);
-      juce::String propPath = path + "/" + propName;
-
-      if (oldObj->hasProperty(propName)) {
-        juce::var oldPropVal = oldObj->getProperty(propName);
-        // Recurse to compare property values
-        auto propOps = generateJsonPatch(oldPropVal, newPropVal, propPath);
-        ops.addArray(propOps);
-      } else {
-        // Property added
-        juce::DynamicObject *op = new juce::DynamicObject();
-        op->setProperty("op", "add");
-        op->setProperty("path", propPath);
-        op->setProperty("value", newPropVal);
-        ops.add(juce::var(op));
+bool StateBroadcaster::replyToReconnect(std::string_view lastEpoch,
+                                        int64_t lastRevisionId,
+                                        const MessageCallback &deliver) {
+  return replyToReconnect(lastEpoch, lastRevisionId,
+                          [&](StateMessage &message) {
+                            deliver(message.toJson());
+                          });
+}
+
+bool StateBroadcaster::replyToReconnect(std::string_view lastEpoch,
+                                        int64_t lastRevisionId,
+                                        const StateMessageCallback &deliver) {
+  juce::ScopedLock sl(lock);
+  if (!hasPreviousState)
+    return false;
+
+  // The history holds revisions [front, revisionId]; a client of this
+  // epoch at front - 1 or later can be patched forward. Revision numbers
+  // from another engine say nothing about this one's state.
+  bool reachable = lastEpoch == epoch && lastRevisionId >= 0 &&
+                   lastRevisionId <= revisionId &&
+                   (lastRevisionId == revisionId ||
+                    (!history.empty() &&
+                     history.front().revisionId <= lastRevisionId + 1));
+
+  if (reachable) {
+    StateMessage message(MessageType::Patch, epoch, revisionId);
+    message.fromRevisionId = lastRevisionId;
+
+    size_t bytes = 0;
+    for (const auto &entry : history) {
+      if (entry.revisionId <= lastRevisionId)
+        continue;
+      bytes += entry.ops.json.size();
+      if (bytes > MAX_CATCH_UP_BYTES) {
+        reachable = false;
+        break;
       }
+      message.patches.push_back(&entry);
     }
 
-    // Check for removed properties
-    auto oldProps = oldObj->getProperties();
-    for (int i = 0; i < oldProps.size(); ++i) {
-      juce::String propName = oldProps.getName(i).toString();
-      if (!newObj->hasProperty(propName)) {
-        juce::String propPath = path + "/" + propName;
-        juce::DynamicObject *op = new juce::DynamicObject();
-        op->setProperty("op", "remove");
-        op->setProperty("path", propPath);
-        ops.add(juce::var(op));
-      }
+    if (reachable) {
+      deliver(message);
+      return true;
     }
   }
-  // Both are arrays - compare elements
-  else if (oldVal.isArray() && newVal.isArray()) {
-    auto *oldArr = oldVal.getArray();
-    auto *newArr = newVal.getArray();
-
-    if (!oldArr || !newArr)
-      return ops;
 
-    int oldSize = oldArr->size();
-    int newSize = newArr->size();
-    int minSize = juce::jmin(oldSize, newSize);
+  deliver(getCurrentSnapshot());
+  return true;
+}
 
-    // Compare existing elements
-    for (int i = 0; i < minSize; ++i) {
-      juce::String elemPath = path + "/" + juce::String(i);
-      auto elemOps = generateJsonPatch(oldArr->getUnchecked(i),
-                                       newArr->getUnchecked(i), elemPath);
-      ops.addArray(elemOps);
-    }
+StateBroadcaster::StateMessage &StateBroadcaster::getCurrentSnapshot() {
+  if (currentSnapshot == nullptr) {
+    currentSnapshot.reset(
+        new StateMessage(MessageType::Snapshot, epoch, revisionId));
+    currentSnapshot->state = &previousState;
+  }
+  return *currentSnapshot;
+}
 
-    // Handle added elements
-    for (int i = minSize; i < newSize; ++i) {
-      juce::String elemPath = path + "/-"; // RFC 6902: "-" means append
-      juce::DynamicObject *op = new juce::DynamicObject();
-      op->setProperty("op", "add");
-      op->setProperty("path", elemPath);
-      op->setProperty("value", newArr->getUnchecked(i));
-      ops.add(juce::var(op));
-    }
+void StateBroadcaster::remember(int64_t revision, PatchOps &&ops) {
+  historyBytes += ops.json.size() + ops.msgPack.size();
+  history.push_back({revision, std::move(ops)});
 
-    // Handle removed elements (remove from end to maintain indices)
-    for (int i = oldSize - 1; i >= newSize; --i) {
-      juce::String elemPath = path + "/" + juce::String(i);
-      juce::DynamicObject *op = new juce::DynamicObject();
-      op->setProperty("op", "remove");
-      op->setProperty("path", elemPath);
-      ops.add(juce::var(op));
-    }
+  while (history.size() > HISTORY_MAX_PATCHES ||
+         historyBytes > HISTORY_MAX_BYTES) {
+    historyBytes -= history.front().ops.json.size() +
+                    history.front().ops.msgPack.size();
+    history.pop_front();
   }
-  // Primitive values - check if different
-  else {
-    // Compare values
-    bool isDifferent = false;
-
-    if (oldVal.isString() && newVal.isString()) {
-      isDifferent = (oldVal.toString() != newVal.toString());
-    } else if (oldVal.isDouble() && newVal.isDouble()) {
-      isDifferent = (static_cast<double>(oldVal) != static_cast<double>(newVal));
-    } else if (oldVal.isInt() && newVal.isInt()) {
-      isDifferent = (static_cast<int>(oldVal) != static_cast<int>(newVal));
-    } else if (oldVal.isInt64() && newVal.isInt64()) {
-      isDifferent = (static_cast<int64_t>(oldVal) != static_cast<int64_t>(newVal));
-    } else if (oldVal.isBool() && newVal.isBool()) {
-      isDifferent = (static_cast<bool>(oldVal) != static_cast<bool>(newVal));
-    } else {
-      // Type mismatch or other types
-      isDifferent = true;
-    }
+}
 
-    if (isDifferent && !path.isEmpty()) {
-      juce::DynamicObject *op = new juce::DynamicObject();
-      op->setProperty("op", "replace");
-      op->setProperty("path", path);
-      op->setProperty("value", newVal);
-      ops.add(juce::var(op));
-    }
-  }
+void StateBroadcaster::sendSnapshot(const AppState &state) {
+  revisionId++;
+  previousState = state;
+  hasPreviousState = true;
+
+  // Patches from before a snapshot can't be chained across it
+  history.clear();
+  historyBytes = 0;
+  Metrics::instance().add(Metrics::Counter::StateSnapshots);
 
-  return ops;
+  // Encoded at most once per encoding, for this broadcast and any client
+  // that joins before the state next changes
+  currentSnapshot.reset();
+  if (sendMessage)
+    sendMessage(getCurrentSnapshot());
 }
 
-size_t StateBroadcaster::calculatePatchSize(
-    const juce::Array<juce::var> &ops) const {
-  // Serialize the ops array to JSON and measure byte length
-  juce::String jsonStr = juce::JSON::toString(juce::var(ops));
-  return jsonStr.toUTF8().sizeInBytes() - 1; // -1 for null terminator
+bool StateBroadcaster::diffStates(const AppState &from, const AppState &to,
+                                  PatchOps &ops, int maxOps) {
+  ops = {};
+  PatchWriter patch(ops, maxOps);
+  diffValue(patch, {}, from, to);
+  patch.finish();
+  return !patch.full();
 }
 
 } // namespace flowzone
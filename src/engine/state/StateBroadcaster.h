@@ -1,20 +1,105 @@
 #pragma once
 #include "AppState.h"
 #include <JuceHeader.h>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace flowzone {
 
+/**
+ * StateBroadcaster: AppState → STATE_FULL / STATE_PATCH messages
+ *
+ * The last broadcast state is kept as a typed AppState. Each update walks
+ * the schema in StateSchema.h, comparing field by field against the new
+ * state, and emits RFC 6902 ops straight from the fields that changed, so
+ * nothing is allocated or serialised when a tick changes nothing.
+ *
+ * Sent patches are also kept in a bounded history keyed by revision, so a
+ * reconnecting client (Spec §3.5 WS_RECONNECT) can be caught up with the
+ * patches it missed instead of a fresh snapshot. Revisions start again from
+ * 1 with every engine, so each message also carries the broadcaster's epoch
+ * and only a client from the same epoch is patched forward.
+ *
+ * Messages can be encoded as JSON or, for clients that negotiated it, as
+ * MessagePack with the same structure. Encoding is lazy: a snapshot is only
+ * serialised into the encodings some client actually uses. Both encodings
+ * stream the typed state through StateSchema.h without building a var tree;
+ * patch ops are small, so each is written in both encodings as it is found
+ * and kept as bytes in the history.
+ */
 class StateBroadcaster {
+private:
+  struct HistoryEntry;
+
 public:
   using MessageCallback = std::function<void(const juce::String &)>;
 
+  enum class MessageType { Snapshot, Patch };
+  using TypedMessageCallback =
+      std::function<void(const juce::String &, MessageType)>;
+
+  /**
+   * One STATE_FULL / STATE_PATCH. Only valid inside the callback it is
+   * passed to; each encoding is built on first use and then cached.
+   */
+  class StateMessage {
+  public:
+    MessageType getType() const { return type; }
+    int64_t getRevisionId() const { return revisionId; }
+    const std::string &getEpoch() const { return epoch; }
+
+    // JSON as UTF-8 bytes, ready for the socket; toJson() is the same text
+    // as a juce::String for callbacks that want one
+    const std::string &toJsonUtf8();
+    const juce::String &toJson();
+    const std::string &toMsgPack();
+
+  private:
+    friend class StateBroadcaster;
+    StateMessage(MessageType t, const std::string &e, int64_t revision)
+        : type(t), epoch(e), revisionId(revision) {}
+
+    MessageType type;
+    const std::string &epoch;
+    int64_t revisionId;
+    int64_t fromRevisionId = -1;                 // Catch-up patches only
+    const AppState *state = nullptr;             // Snapshots
+    std::vector<const HistoryEntry *> patches;   // Patches, oldest first
+
+    std::string jsonUtf8;
+    juce::String json;
+    std::string msgPack;
+  };
+  using StateMessageCallback = std::function<void(StateMessage &)>;
+
+  // Spec: >20 ops or >4KB → send snapshot
+  static constexpr int MAX_PATCH_OPS = 20;
+  static constexpr size_t MAX_PATCH_BYTES = 4096;
+
+  // Reconnect history bounds. A catch-up larger than MAX_CATCH_UP_BYTES is
+  // sent as a snapshot instead.
+  static constexpr size_t HISTORY_MAX_PATCHES = 256;
+  static constexpr size_t HISTORY_MAX_BYTES = 256 * 1024;
+  static constexpr size_t MAX_CATCH_UP_BYTES = 64 * 1024;
+
   StateBroadcaster();
   ~StateBroadcaster();
 
   // Setup the callback for sending messages to clients
   void setMessageCallback(MessageCallback callback);
 
+  // Same, but also tells the transport whether the message is a snapshot
+  // (which supersedes anything still queued) or a patch
+  void setTypedMessageCallback(TypedMessageCallback callback);
+
+  // Same, with lazily encoded messages for transports that serve several
+  // encodings
+  void setStateMessageCallback(StateMessageCallback callback);
+
   // Broadcast the full state (snapshot)
   void broadcastFullState(const AppState &state);
 
@@ -24,22 +109,60 @@ public:
   // Get current revision ID
   int64_t getRevisionId() const;
 
+  // Identifies this broadcaster's run of revisions; a new one is made for
+  // every engine, so revision N of one engine is never taken for another's
+  const std::string &getEpoch() const { return epoch; }
+
+  // Answer a (re)connecting client that last saw lastRevisionId of
+  // lastEpoch (-1 and "" for a fresh client). deliver is called once, under
+  // the broadcast lock, with either a STATE_PATCH carrying "fromRevisionId"
+  // and every op since that revision, or a STATE_FULL of the last broadcast
+  // state when the epoch differs or the history no longer reaches back that
+  // far. Anything broadcast after deliver returns follows on from that
+  // message. Returns false (without calling deliver) if nothing has been
+  // broadcast yet.
+  bool replyToReconnect(std::string_view lastEpoch, int64_t lastRevisionId,
+                        const MessageCallback &deliver);
+  bool replyToReconnect(std::string_view lastEpoch, int64_t lastRevisionId,
+                        const StateMessageCallback &deliver);
+
+  // A patch's RFC 6902 ops, already encoded
+  struct PatchOps {
+    std::string json;    // The op array
+    std::string msgPack; // The ops one after another, without array header
+    uint32_t numOps = 0;
+  };
+
+  // RFC 6902 ops turning `from` into `to`. Stops early (returning false)
+  // once more than maxOps ops would be needed.
+  static bool diffStates(const AppState &from, const AppState &to,
+                         PatchOps &ops, int maxOps = MAX_PATCH_OPS);
+
 private:
-  MessageCallback sendMessage;
+  StateMessageCallback sendMessage;
+  const std::string epoch;
   int64_t revisionId = 0;
-  juce::var previousStateVar; // Store previous state for diff generation
+  AppState previousState; // Last broadcast state, for diffing
   bool hasPreviousState = false;
 
+  // STATE_FULL of previousState, kept with its encodings until the state
+  // changes so clients joining at the same revision share one encode
+  // rather than each re-serialising the state under the lock
+  std::unique_ptr<StateMessage> currentSnapshot;
+
+  struct HistoryEntry {
+    int64_t revisionId;
+    PatchOps ops; // That revision's ops
+  };
+  std::deque<HistoryEntry> history; // Contiguous revisions, oldest first
+  size_t historyBytes = 0;
+
   // Thread safety
   juce::CriticalSection lock;
 
-  // Generate RFC 6902 JSON Patch operations
-  juce::Array<juce::var> generateJsonPatch(const juce::var &oldVal,
-                                           const juce::var &newVal,
-                                           const juce::String &path);
-
-  // Calculate size of patch operations in bytes (UTF-8)
-  size_t calculatePatchSize(const juce::Array<juce::var> &ops) const;
+  void sendSnapshot(const AppState &state);
+  StateMessage &getCurrentSnapshot();
+  void remember(int64_t revision, PatchOps &&ops);
 };
 
 } // namespace flowzone
@@ -0,0 +1,391 @@
+#pragma once
+#include "AppState.h"
+#include "MsgPack.h"
+#include "StreamingJson.h"
+#include <JuceHeader.h>
+#include <concepts>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace flowzone {
+namespace schema {
+
+/**
+ * Compile-time description of the JSON shape of AppState and friends
+ *
+ * Schema<T>::fields is a tuple of (name, pointer-to-member) pairs in wire
+ * order. write() and read() walk it with JsonWriter / JsonReader (and
+ * write() with MsgPackWriter too), so the encoders need no var tree and a
+ * struct's wire format is spelled out exactly once, here.
+ *
+ * Supported member types: bool, integers, float, double, juce::String,
+ * std::vector and std::optional of those, and other described structs.
+ * Unknown keys are skipped when reading; values of the wrong type leave
+ * the member untouched.
+ */
+template <typename T> struct Schema;
+
+template <typename Owner, typename Member> struct Field {
+  const char *name;
+  Member Owner::*member;
+  bool omitWhenDefault;
+};
+
+// Always written
+template <typename Owner, typename Member>
+constexpr Field<Owner, Member> field(const char *name, Member Owner::*member) {
+  return {name, member, false};
+}
+
+// Left out when equal to a value-initialised Member (e.g. lastError == 0)
+template <typename Owner, typename Member>
+constexpr Field<Owner, Member> optionalField(const char *name,
+                                             Member Owner::*member) {
+  return {name, member, true};
+}
+
+// A key whose value is always {} (AppState's "ui")
+struct EmptyObject {
+  const char *name;
+};
+
+template <typename T>
+concept Described = requires { Schema<T>::fields; };
+
+template <typename T> struct IsVector : std::false_type {};
+template <typename T> struct IsVector<std::vector<T>> : std::true_type {};
+
+template <typename T> struct IsOptional : std::false_type {};
+template <typename T> struct IsOptional<std::optional<T>> : std::true_type {};
+
+//==============================================================================
+// MessagePack behind the same interface as JsonWriter
+class MsgPackEncoder {
+public:
+  explicit MsgPackEncoder(MsgPackWriter &w) : writer(w) {}
+
+  void beginObject(uint32_t size) { writer.writeMapHeader(size); }
+  void endObject() {}
+  void beginArray(uint32_t size) { writer.writeArrayHeader(size); }
+  void endArray() {}
+  void key(const char *name) { writer.writeString(name); }
+
+  void writeBool(bool value) { writer.writeBool(value); }
+  void writeInt(int64_t value) { writer.writeInt(value); }
+  void writeFloat(float value) { writer.writeFloat(value); }
+  void writeDouble(double value) { writer.writeDouble(value); }
+  void writeString(const juce::String &value) { writer.writeString(value); }
+
+private:
+  MsgPackWriter &writer;
+};
+
+//==============================================================================
+template <typename Encoder, typename T>
+void write(Encoder &encoder, const T &value);
+
+template <typename Owner, typename Member>
+bool isPresent(const Owner &object, const Field<Owner, Member> &f) {
+  if constexpr (IsOptional<Member>::value)
+    return (object.*f.member).has_value();
+  else if constexpr (std::equality_comparable<Member>)
+    return !f.omitWhenDefault || !(object.*f.member == Member{});
+  else
+    return true;
+}
+
+template <typename Owner> bool isPresent(const Owner &, const EmptyObject &) {
+  return true;
+}
+
+template <typename T> uint32_t countFields(const T &object) {
+  return std::apply(
+      [&](const auto &...f) { return (0u + ... + (isPresent(object, f) ? 1u : 0u)); },
+      Schema<T>::fields);
+}
+
+template <typename Encoder, typename Owner, typename Member>
+void writeField(Encoder &encoder, const Owner &object,
+                const Field<Owner, Member> &f) {
+  if (!isPresent(object, f))
+    return;
+  encoder.key(f.name);
+  if constexpr (IsOptional<Member>::value)
+    write(encoder, *(object.*f.member));
+  else
+    write(encoder, object.*f.member);
+}
+
+template <typename Encoder, typename Owner>
+void writeField(Encoder &encoder, const Owner &, const EmptyObject &f) {
+  encoder.key(f.name);
+  encoder.beginObject(0);
+  encoder.endObject();
+}
+
+// The members of object without the enclosing braces, so callers can add
+// keys of their own (see SessionStateManager::saveSession)
+template <typename Encoder, typename T>
+void writeFields(Encoder &encoder, const T &object) {
+  std::apply([&](const auto &...f) { (writeField(encoder, object, f), ...); },
+             Schema<T>::fields);
+}
+
+template <typename Encoder, typename T>
+void write(Encoder &encoder, const T &value) {
+  if constexpr (Described<T>) {
+    encoder.beginObject(countFields(value));
+    writeFields(encoder, value);
+    encoder.endObject();
+  } else if constexpr (IsVector<T>::value) {
+    encoder.beginArray((uint32_t)value.size());
+    for (const auto &element : value)
+      write(encoder, element);
+    encoder.endArray();
+  } else if constexpr (std::is_same_v<T, bool>) {
+    encoder.writeBool(value);
+  } else if constexpr (std::is_integral_v<T>) {
+    encoder.writeInt((int64_t)value);
+  } else if constexpr (std::is_same_v<T, float>) {
+    encoder.writeFloat(value);
+  } else if constexpr (std::is_same_v<T, double>) {
+    encoder.writeDouble(value);
+  } else {
+    static_assert(std::is_same_v<T, juce::String>, "No schema for this type");
+    encoder.writeString(value);
+  }
+}
+
+//==============================================================================
+template <typename T> bool read(JsonReader &reader, T &value);
+
+template <typename Owner, typename Member>
+bool readField(JsonReader &reader, std::string_view key, Owner &object,
+               const Field<Owner, Member> &f, bool &ok) {
+  if (key != f.name)
+    return false;
+  if constexpr (IsOptional<Member>::value) {
+    typename Member::value_type value{};
+    ok = read(reader, value);
+    object.*f.member = value;
+  } else {
+    ok = read(reader, object.*f.member);
+  }
+  return true;
+}
+
+template <typename Owner>
+bool readField(JsonReader &reader, std::string_view key, Owner &,
+               const EmptyObject &f, bool &ok) {
+  if (key != f.name)
+    return false;
+  ok = reader.skipValue();
+  return true;
+}
+
+// Reads an object into a described struct. onOtherKey(key) is offered
+// every key the schema doesn't know; it returns true after consuming the
+// value, false to have it skipped.
+template <typename T, typename OtherKey>
+bool readObject(JsonReader &reader, T &object, OtherKey &&onOtherKey) {
+  if (!reader.beginObject())
+    return false;
+
+  std::string_view key;
+  while (reader.nextKey(key)) {
+    bool ok = true;
+    bool known = std::apply(
+        [&](const auto &...f) {
+          return (readField(reader, key, object, f, ok) || ...);
+        },
+        Schema<T>::fields);
+
+    if (!known && !onOtherKey(key))
+      ok = reader.skipValue();
+    if (!ok)
+      return false;
+  }
+  return !reader.failed();
+}
+
+template <typename T> bool read(JsonReader &reader, T &value) {
+  using Token = JsonReader::Token;
+  auto token = reader.peek();
+
+  if constexpr (Described<T>) {
+    if (token == Token::Object)
+      return readObject(reader, value, [](std::string_view) { return false; });
+  } else if constexpr (IsVector<T>::value) {
+    if (token == Token::Array) {
+      if (!reader.beginArray())
+        return false;
+      value.clear();
+      while (reader.nextElement()) {
+        typename T::value_type element{};
+        if (!read(reader, element))
+          return false;
+        value.push_back(std::move(element));
+      }
+      return !reader.failed();
+    }
+  } else if constexpr (std::is_same_v<T, bool>) {
+    if (token == Token::Bool)
+      return reader.readBool(value);
+  } else if constexpr (std::is_integral_v<T>) {
+    if (token == Token::Number) {
+      int64_t number = 0;
+      if (!reader.readInt(number))
+        return false;
+      value = (T)number;
+      return true;
+    }
+  } else if constexpr (std::is_floating_point_v<T>) {
+    if (token == Token::Number) {
+      double number = 0.0;
+      if (!reader.readNumber(number))
+        return false;
+      value = (T)number;
+      return true;
+    }
+  } else {
+    static_assert(std::is_same_v<T, juce::String>, "No schema for this type");
+    if (token == Token::String)
+      return reader.readString(value);
+  }
+
+  // Wrong type (or null): keep the current value
+  return reader.skipValue();
+}
+
+//==============================================================================
+// AppState
+
+template <> struct Schema<PluginInstance> {
+  // manufacturer and state are not part of the wire format
+  static constexpr auto fields = std::make_tuple(
+      field("id", &PluginInstance::id),
+      field("pluginId", &PluginInstance::pluginId),
+      field("name", &PluginInstance::name),
+      field("bypass", &PluginInstance::bypass));
+};
+
+template <> struct Schema<SlotState> {
+  static constexpr auto fields = std::make_tuple(
+      field("id", &SlotState::id), field("state", &SlotState::state),
+      field("volume", &SlotState::volume), field("muted", &SlotState::muted),
+      field("riffId", &SlotState::riffId), field("name", &SlotState::name),
+      field("instrumentCategory", &SlotState::instrumentCategory),
+      field("presetId", &SlotState::presetId),
+      field("userId", &SlotState::userId),
+      field("loopLengthBars", &SlotState::loopLengthBars),
+      field("originalBpm", &SlotState::originalBpm),
+      optionalField("lastError", &SlotState::lastError),
+      field("pluginChain", &SlotState::pluginChain));
+};
+
+template <> struct Schema<RiffHistoryEntry> {
+  static constexpr auto fields = std::make_tuple(
+      field("id", &RiffHistoryEntry::id),
+      field("timestamp", &RiffHistoryEntry::timestamp),
+      field("name", &RiffHistoryEntry::name),
+      field("layers", &RiffHistoryEntry::layers),
+      field("userId", &RiffHistoryEntry::userId),
+      field("colors", &RiffHistoryEntry::colors));
+};
+
+template <> struct Schema<AppState::Session> {
+  using S = AppState::Session;
+  static constexpr auto fields =
+      std::make_tuple(field("id", &S::id), field("name", &S::name),
+                      field("emoji", &S::emoji),
+                      field("createdAt", &S::createdAt));
+};
+
+template <> struct Schema<AppState::Library> {
+  using L = AppState::Library;
+  static constexpr auto fields = std::make_tuple(
+      field("sessionCount", &L::sessionCount),
+      field("sessionsVersion", &L::sessionsVersion),
+      field("riffCount", &L::riffCount),
+      field("riffsVersion", &L::riffsVersion),
+      field("latestRiff", &L::latestRiff));
+};
+
+template <> struct Schema<AppState::Transport> {
+  using T = AppState::Transport;
+  static constexpr auto fields = std::make_tuple(
+      field("bpm", &T::bpm), field("isPlaying", &T::isPlaying),
+      field("loopLengthBars", &T::loopLengthBars),
+      field("metronomeEnabled", &T::metronomeEnabled),
+      field("quantiseEnabled", &T::quantiseEnabled),
+      field("rootNote", &T::rootNote), field("scale", &T::scale));
+};
+
+template <> struct Schema<AppState::ActiveMode> {
+  using M = AppState::ActiveMode;
+  static constexpr auto fields = std::make_tuple(
+      field("category", &M::category), field("presetId", &M::presetId),
+      field("presetName", &M::presetName), field("isFxMode", &M::isFxMode),
+      field("selectedSourceSlots", &M::selectedSourceSlots));
+};
+
+template <> struct Schema<AppState::ActiveFX::XYPosition> {
+  using P = AppState::ActiveFX::XYPosition;
+  static constexpr auto fields =
+      std::make_tuple(field("x", &P::x), field("y", &P::y));
+};
+
+template <> struct Schema<AppState::ActiveFX> {
+  using F = AppState::ActiveFX;
+  static constexpr auto fields = std::make_tuple(
+      field("effectId", &F::effectId), field("effectName", &F::effectName),
+      field("xyPosition", &F::xyPosition), field("isActive", &F::isActive));
+};
+
+template <> struct Schema<AppState::Mic> {
+  using M = AppState::Mic;
+  static constexpr auto fields = std::make_tuple(
+      field("inputGain", &M::inputGain), field("inputLevel", &M::inputLevel),
+      field("monitorInput", &M::monitorInput),
+      field("monitorUntilLooped", &M::monitorUntilLooped));
+};
+
+template <> struct Schema<AppState::Looper> {
+  static constexpr auto fields =
+      std::make_tuple(field("inputLevel", &AppState::Looper::inputLevel));
+};
+
+template <> struct Schema<AppState::Settings> {
+  using S = AppState::Settings;
+  static constexpr auto fields = std::make_tuple(
+      field("riffSwapMode", &S::riffSwapMode),
+      field("bufferSize", &S::bufferSize),
+      field("sampleRate", &S::sampleRate),
+      field("storageLocation", &S::storageLocation));
+};
+
+template <> struct Schema<AppState::System> {
+  using S = AppState::System;
+  static constexpr auto fields = std::make_tuple(
+      field("cpuLoad", &S::cpuLoad),
+      field("diskBufferUsage", &S::diskBufferUsage),
+      field("memoryUsageMB", &S::memoryUsageMB),
+      field("activePluginHosts", &S::activePluginHosts));
+};
+
+template <> struct Schema<AppState> {
+  static constexpr auto fields = std::make_tuple(
+      field("library", &AppState::library),
+      field("session", &AppState::session),
+      field("transport", &AppState::transport),
+      field("activeMode", &AppState::activeMode),
+      field("activeFX", &AppState::activeFX), field("mic", &AppState::mic),
+      field("looper", &AppState::looper), field("slots", &AppState::slots),
+      field("settings", &AppState::settings),
+      field("system", &AppState::system), EmptyObject{"ui"});
+};
+
+} // namespace schema
+} // namespace flowzone
@@ -0,0 +1,524 @@
+#include "StreamingJson.h"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace flowzone {
+
+namespace {
+
+const char kHexDigits[] = "0123456789abcdef";
+
+void appendEscaped(std::string &out, const char *s, size_t length) {
+  size_t runStart = 0;
+  for (size_t i = 0; i < length; ++i) {
+    auto c = static_cast<unsigned char>(s[i]);
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    out.append(s + runStart, i - runStart);
+    runStart = i + 1;
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      out += "\\u00";
+      out += kHexDigits[c >> 4];
+      out += kHexDigits[c & 0x0f];
+      break;
+    }
+  }
+  out.append(s + runStart, length - runStart);
+}
+
+void appendUtf8(std::string &out, uint32_t codePoint) {
+  if (codePoint < 0x80) {
+    out += static_cast<char>(codePoint);
+  } else if (codePoint < 0x800) {
+    out += static_cast<char>(0xc0 | (codePoint >> 6));
+    out += static_cast<char>(0x80 | (codePoint & 0x3f));
+  } else if (codePoint < 0x10000) {
+    out += static_cast<char>(0xe0 | (codePoint >> 12));
+    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (codePoint & 0x3f));
+  } else {
+    out += static_cast<char>(0xf0 | (codePoint >> 18));
+    out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (codePoint & 0x3f));
+  }
+}
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Plain integers (the common case) are parsed without strtod
+bool parseInteger(std::string_view token, int64_t &value) {
+  if (token.empty() || token.size() > 18)
+    return false;
+  size_t i = token[0] == '-' ? 1 : 0;
+  if (i == token.size())
+    return false;
+  int64_t result = 0;
+  for (; i < token.size(); ++i) {
+    if (token[i] < '0' || token[i] > '9')
+      return false;
+    result = result * 10 + (token[i] - '0');
+  }
+  value = token[0] == '-' ? -result : result;
+  return true;
+}
+
+bool parseDouble(std::string_view token, double &value) {
+  char buffer[64];
+  if (token.size() >= sizeof(buffer))
+    return false;
+  std::memcpy(buffer, token.data(), token.size());
+  buffer[token.size()] = '\0';
+  value = std::strtod(buffer, nullptr);
+  return true;
+}
+
+// Keeps whole numbers typed as reals ("2.0", like juce::JSON), so a
+// float field reads back as a double rather than an int
+void appendReal(std::string &out, const char *text, size_t length) {
+  out.append(text, length);
+  if (std::memchr(text, '.', length) == nullptr &&
+      std::memchr(text, 'e', length) == nullptr)
+    out += ".0";
+}
+
+} // namespace
+
+//==============================================================================
+void JsonWriter::separate() {
+  if (afterKey) {
+    afterKey = false;
+    return;
+  }
+  if (hasElements[depth])
+    out += ',';
+  hasElements[depth] = true;
+}
+
+void JsonWriter::open(char bracket) {
+  separate();
+  out += bracket;
+  jassert(depth + 1 < kMaxDepth);
+  hasElements[++depth] = false;
+}
+
+void JsonWriter::close(char bracket) {
+  jassert(depth > 0 && !afterKey);
+  --depth;
+  out += bracket;
+}
+
+void JsonWriter::beginObject(uint32_t) { open('{'); }
+void JsonWriter::endObject() { close('}'); }
+void JsonWriter::beginArray(uint32_t) { open('['); }
+void JsonWriter::endArray() { close(']'); }
+
+void JsonWriter::key(std::string_view name) {
+  separate();
+  out += '"';
+  appendEscaped(out, name.data(), name.size());
+  out += "\":";
+  afterKey = true;
+}
+
+void JsonWriter::writeNull() {
+  separate();
+  out += "null";
+}
+
+void JsonWriter::writeRaw(std::string_view json) {
+  separate();
+  out.append(json.data(), json.size());
+}
+
+void JsonWriter::writeBool(bool value) {
+  separate();
+  out += value ? "true" : "false";
+}
+
+void JsonWriter::writeInt(int64_t value) {
+  separate();
+  char buffer[24];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer),
+                              static_cast<long long>(value));
+  out.append(buffer, result.ptr);
+}
+
+void JsonWriter::writeFloat(float value) {
+  if (!std::isfinite(value)) {
+    writeNull();
+    return;
+  }
+  separate();
+  char buffer[32];
+#if defined(__cpp_lib_to_chars)
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  appendReal(out, buffer, (size_t)(result.ptr - buffer));
+#else
+  int length = std::snprintf(buffer, sizeof(buffer), "%.6g", (double)value);
+  if (std::strtof(buffer, nullptr) != value)
+    length = std::snprintf(buffer, sizeof(buffer), "%.9g", (double)value);
+  appendReal(out, buffer, (size_t)length);
+#endif
+}
+
+void JsonWriter::writeDouble(double value) {
+  if (!std::isfinite(value)) {
+    writeNull();
+    return;
+  }
+  separate();
+  char buffer[32];
+#if defined(__cpp_lib_to_chars)
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  appendReal(out, buffer, (size_t)(result.ptr - buffer));
+#else
+  int length = std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+  if (std::strtod(buffer, nullptr) != value)
+    length = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  appendReal(out, buffer, (size_t)length);
+#endif
+}
+
+void JsonWriter::writeString(std::string_view utf8) {
+  separate();
+  out += '"';
+  appendEscaped(out, utf8.data(), utf8.size());
+  out += '"';
+}
+
+void JsonWriter::writeString(const juce::String &value) {
+  writeString(std::string_view(value.toRawUTF8(), value.getNumBytesAsUTF8()));
+}
+
+//==============================================================================
+bool JsonReader::fail() {
+  error = true;
+  return false;
+}
+
+void JsonReader::skipWhitespace() {
+  while (pos < end &&
+         (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t'))
+    ++pos;
+}
+
+bool JsonReader::expect(char c) {
+  skipWhitespace();
+  if (pos == end || *pos != c)
+    return fail();
+  ++pos;
+  return true;
+}
+
+bool JsonReader::literal(const char *text, size_t length) {
+  skipWhitespace();
+  if ((size_t)(end - pos) < length || std::memcmp(pos, text, length) != 0)
+    return fail();
+  pos += length;
+  return true;
+}
+
+JsonReader::Token JsonReader::peek() {
+  if (error)
+    return Token::Error;
+  skipWhitespace();
+  if (pos == end)
+    return Token::End;
+
+  switch (*pos) {
+  case '{':
+    return Token::Object;
+  case '[':
+    return Token::Array;
+  case '"':
+    return Token::String;
+  case 't':
+  case 'f':
+    return Token::Bool;
+  case 'n':
+    return Token::Null;
+  default:
+    return (*pos == '-' || (*pos >= '0' && *pos <= '9')) ? Token::Number
+                                                         : Token::Error;
+  }
+}
+
+bool JsonReader::enter(char bracket) {
+  if (error || !expect(bracket))
+    return false;
+  if (depth == kMaxDepth)
+    return fail();
+  needComma[depth++] = false;
+  return true;
+}
+
+bool JsonReader::nextInContainer(char closing) {
+  if (error || depth == 0)
+    return false;
+
+  skipWhitespace();
+  if (pos < end && *pos == closing) {
+    ++pos;
+    --depth;
+    return false;
+  }
+
+  if (needComma[depth - 1]) {
+    if (!expect(','))
+      return false;
+    skipWhitespace();
+    if (pos < end && *pos == closing) // Trailing comma
+      return fail();
+  }
+  needComma[depth - 1] = true;
+  return pos < end || fail();
+}
+
+bool JsonReader::beginObject() { return enter('{'); }
+
+bool JsonReader::nextKey(std::string_view &key) {
+  return nextInContainer('}') && scanString(key) && expect(':');
+}
+
+bool JsonReader::beginArray() { return enter('['); }
+
+bool JsonReader::nextElement() { return nextInContainer(']'); }
+
+bool JsonReader::scanString(std::string_view &value) {
+  if (error || !expect('"'))
+    return false;
+
+  const char *start = pos;
+  while (pos < end && *pos != '"' && *pos != '\\')
+    ++pos;
+  if (pos == end)
+    return fail();
+
+  if (*pos == '"') {
+    value = std::string_view(start, (size_t)(pos - start));
+    ++pos;
+    return true;
+  }
+
+  // Escapes: decode into the scratch buffer
+  scratch.assign(start, (size_t)(pos - start));
+  while (pos < end && *pos != '"') {
+    if (*pos != '\\') {
+      scratch += *pos++;
+      continue;
+    }
+    if (++pos == end)
+      return fail();
+
+    switch (char c = *pos++) {
+    case '"':
+    case '\\':
+    case '/':
+      scratch += c;
+      break;
+    case 'b':
+      scratch += '\b';
+      break;
+    case 'f':
+      scratch += '\f';
+      break;
+    case 'n':
+      scratch += '\n';
+      break;
+    case 'r':
+      scratch += '\r';
+      break;
+    case 't':
+      scratch += '\t';
+      break;
+    case 'u': {
+      auto readHex4 = [&](uint32_t &unit) {
+        if (end - pos < 4)
+          return false;
+        unit = 0;
+        for (int i = 0; i < 4; ++i) {
+          int digit = hexValue(*pos++);
+          if (digit < 0)
+            return false;
+          unit = (unit << 4) | (uint32_t)digit;
+        }
+        return true;
+      };
+
+      uint32_t codePoint = 0;
+      if (!readHex4(codePoint))
+        return fail();
+
+      // Surrogate pair
+      if (codePoint >= 0xd800 && codePoint < 0xdc00 && end - pos >= 6 &&
+          pos[0] == '\\' && pos[1] == 'u') {
+        pos += 2;
+        uint32_t low = 0;
+        if (!readHex4(low))
+          return fail();
+        if (low >= 0xdc00 && low < 0xe000)
+          codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+        else
+          codePoint = 0xfffd;
+      } else if (codePoint >= 0xd800 && codePoint < 0xe000) {
+        codePoint = 0xfffd;
+      }
+      appendUtf8(scratch, codePoint);
+      break;
+    }
+    default:
+      return fail();
+    }
+  }
+  if (pos == end)
+    return fail();
+
+  ++pos;
+  value = scratch;
+  return true;
+}
+
+bool JsonReader::scanNumber(std::string_view &token) {
+  if (peek() != Token::Number)
+    return fail();
+
+  const char *start = pos;
+  auto digits = [&] {
+    const char *first = pos;
+    while (pos < end && *pos >= '0' && *pos <= '9')
+      ++pos;
+    return pos > first;
+  };
+
+  if (*pos == '-')
+    ++pos;
+  if (!digits())
+    return fail();
+  if (pos < end && *pos == '.') {
+    ++pos;
+    if (!digits())
+      return fail();
+  }
+  if (pos < end && (*pos == 'e' || *pos == 'E')) {
+    ++pos;
+    if (pos < end && (*pos == '+' || *pos == '-'))
+      ++pos;
+    if (!digits())
+      return fail();
+  }
+
+  token = std::string_view(start, (size_t)(pos - start));
+  return true;
+}
+
+bool JsonReader::readBool(bool &value) {
+  if (peek() != Token::Bool)
+    return fail();
+  value = *pos == 't';
+  return value ? literal("true", 4) : literal("false", 5);
+}
+
+bool JsonReader::readNumber(double &value) {
+  std::string_view token;
+  if (!scanNumber(token))
+    return false;
+
+  int64_t integer = 0;
+  if (parseInteger(token, integer)) {
+    value = (double)integer;
+    return true;
+  }
+  return parseDouble(token, value) || fail();
+}
+
+bool JsonReader::readInt(int64_t &value) {
+  std::string_view token;
+  if (!scanNumber(token))
+    return false;
+  if (parseInteger(token, value))
+    return true;
+
+  double number = 0.0;
+  if (!parseDouble(token, number))
+    return fail();
+  value = (int64_t)juce::jlimit(-9.0e18, 9.0e18, number);
+  return true;
+}
+
+bool JsonReader::readString(juce::String &value) {
+  std::string_view utf8;
+  if (!scanString(utf8))
+    return false;
+  value = juce::String::fromUTF8(utf8.data(), (int)utf8.size());
+  return true;
+}
+
+bool JsonReader::readNull() { return literal("null", 4); }
+
+bool JsonReader::skipValue() {
+  std::string_view ignored;
+  switch (peek()) {
+  case Token::Object:
+    if (!beginObject())
+      return false;
+    while (nextKey(ignored))
+      if (!skipValue())
+        return false;
+    return !error;
+  case Token::Array:
+    if (!beginArray())
+      return false;
+    while (nextElement())
+      if (!skipValue())
+        return false;
+    return !error;
+  case Token::String:
+    return scanString(ignored);
+  case Token::Number:
+    return scanNumber(ignored);
+  case Token::Bool: {
+    bool b;
+    return readBool(b);
+  }
+  case Token::Null:
+    return readNull();
+  default:
+    return fail();
+  }
+}
+
+bool JsonReader::atEnd() {
+  skipWhitespace();
+  return !error && pos == end;
+}
+
+} // namespace flowzone
@@ -0,0 +1,123 @@
+#pragma once
+#include <JuceHeader.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace flowzone {
+
+/**
+ * JsonWriter: streaming JSON encoder for state messages and session files
+ *
+ * Appends compact JSON to a caller-owned std::string, like MsgPackWriter,
+ * so nothing is built in between: no var tree, no DynamicObject per
+ * property. Commas are tracked per nesting level; callers just open,
+ * write and close. Floats use the shortest text that reads back as the
+ * same float, doubles the shortest that reads back as the same double,
+ * and non-finite numbers are written as null (as juce::JSON does).
+ *
+ * The size arguments of beginObject/beginArray are ignored; they let the
+ * schema code drive this and MsgPackWriter the same way.
+ */
+class JsonWriter {
+public:
+  explicit JsonWriter(std::string &destination) : out(destination) {}
+
+  void beginObject(uint32_t size = 0);
+  void endObject();
+  void beginArray(uint32_t size = 0);
+  void endArray();
+  void key(std::string_view name);
+
+  void writeNull();
+  void writeBool(bool value);
+  void writeInt(int64_t value);
+  void writeFloat(float value);
+  void writeDouble(double value);
+  void writeString(std::string_view utf8);
+  void writeString(const char *utf8) { writeString(std::string_view(utf8)); }
+  void writeString(const juce::String &value);
+
+  // Already-encoded JSON, inserted as is: one value, or several
+  // comma-separated array elements
+  void writeRaw(std::string_view json);
+
+private:
+  static constexpr int kMaxDepth = 32;
+
+  std::string &out;
+  int depth = 0;
+  bool hasElements[kMaxDepth] = {};
+  bool afterKey = false;
+
+  void separate();
+  void open(char bracket);
+  void close(char bracket);
+};
+
+/**
+ * JsonReader: streaming pull parser over a UTF-8 buffer
+ *
+ * The SAX-style counterpart of JsonWriter: the caller walks the document
+ * with beginObject()/nextKey() and beginArray()/nextElement() and reads
+ * or skips each value, so nothing is materialised that the caller doesn't
+ * keep. Keys are views into the input (or into a scratch buffer when they
+ * contain escapes) and are valid until the next call.
+ *
+ * Errors are sticky: after malformed input every call returns false and
+ * failed() is true. The buffer must outlive the reader.
+ */
+class JsonReader {
+public:
+  enum class Token { Object, Array, String, Number, Bool, Null, End, Error };
+
+  JsonReader(const char *data, size_t size) : pos(data), end(data + size) {}
+  explicit JsonReader(const juce::String &text)
+      : JsonReader(text.toRawUTF8(), text.getNumBytesAsUTF8()) {}
+
+  // Type of the next value, without consuming it
+  Token peek();
+
+  // Objects: beginObject(), then nextKey() until it returns false (which
+  // consumes the closing brace); read or skip one value after each key
+  bool beginObject();
+  bool nextKey(std::string_view &key);
+
+  // Arrays: beginArray(), then read or skip one value per nextElement()
+  bool beginArray();
+  bool nextElement();
+
+  bool readBool(bool &value);
+  bool readNumber(double &value);
+  bool readInt(int64_t &value); // Accepts any number; truncates fractions
+  bool readString(juce::String &value);
+  bool readNull();
+  bool skipValue();
+
+  // After the top-level value: only whitespace remains
+  bool atEnd();
+
+  bool failed() const { return error; }
+
+private:
+  const char *pos;
+  const char *end;
+  bool error = false;
+  std::string scratch;
+
+  // Per nesting level: the next element/key needs a comma first
+  static constexpr int kMaxDepth = 64;
+  int depth = 0;
+  bool needComma[kMaxDepth] = {};
+
+  bool fail();
+  void skipWhitespace();
+  bool expect(char c);
+  bool literal(const char *text, size_t length);
+  bool scanString(std::string_view &value);
+  bool scanNumber(std::string_view &token);
+  bool enter(char bracket);
+  bool nextInContainer(char closing);
+};
+
+} // namespace flowzone
@@ -47,23 +47,40 @@ export interface RiffHistoryEntry {
     userId: string;
 }
 
+export interface SessionEntry {
+    id: string;
+    name: string;
+    emoji: string;
+    createdAt: number;
+}
+
+// The jam list and riff history are not part of the state: they are paged
+// in with LIST_SESSIONS / LIST_RIFFS { offset, limit, requestId }, newest
+// first. A version change means the list changed and pages should be
+// refetched.
+export interface Library {
+    sessionCount: number;
+    sessionsVersion: number;
+    riffCount: number;
+    riffsVersion: number;
+    latestRiff: RiffHistoryEntry; // id is empty until the first commit
+}
+
+export interface HistoryPage<T> {
+    type: 'RIFF_PAGE' | 'SESSION_PAGE';
+    offset: number;
+    total: number;
+    version: number;
+    items: T[];
+    requestId?: number;
+}
+
 export interface AppState {
-    sessions: Array<{
-        id: string;
-        name: string;
-        emoji: string;
-        createdAt: number;
-    }>;
-    session: {
-        id: string;
-        name: string;
-        emoji: string;
-        createdAt: number;
-    };
+    library: Library;
+    session: SessionEntry;
     transport: {
         bpm: number;
         isPlaying: boolean;
-        barPhase: number;
         loopLengthBars: number;
         metronomeEnabled: boolean;
         quantiseEnabled: boolean;
@@ -94,10 +111,8 @@ export interface AppState {
     };
     looper: {
         inputLevel: number;
-        waveformData: number[]; // Downsampled waveform for visualization (256 samples)
     };
     slots: SlotState[];
-    riffHistory: RiffHistoryEntry[];
     settings: {
         riffSwapMode: string;
         bufferSize: number;
@@ -112,3 +127,43 @@ export interface AppState {
     };
     ui: any; // Empty object per spec
 }
+
+// Binary visualization stream (Spec §3.7). Sent as WebSocket binary frames
+// alongside the JSON state; barPhase and the waveform live only here.
+// Layout (little endian): [Magic u32][FrameId u32][Timestamp f64] followed by
+// Float32 [BarPhase][MasterRMS_L][MasterRMS_R][SlotRMS x12][Spectrum x16][Waveform x256]
+export const VISUAL_FRAME_MAGIC = 0x31565A46; // "FZV1"
+export const VISUAL_FRAME_HEADER_BYTES = 16;
+export const VISUAL_FRAME_SLOTS = 12;
+export const VISUAL_FRAME_BANDS = 16;
+export const VISUAL_FRAME_WAVEFORM_POINTS = 256;
+
+export interface VisualFrame {
+    frameId: number;
+    timestamp: number; // ms since epoch, engine clock
+    barPhase: number; // 0.0 - 1.0
+    masterRms: [number, number];
+    slotRms: Float32Array;
+    spectrum: Float32Array; // 0..1 per band, log-spaced 40 Hz - 16 kHz
+    waveform: Float32Array; // Retrospective buffer overview
+}
+
+// Continuous controls sent as GESTURE commands. points is flat:
+// [dtMs, value, ...] pairs (volume 0..1, input gain in dB) or
+// [dtMs, x, y, ...] triples for the XY pad, dtMs relative to t0 in the
+// client's performance.now() clock. The engine ramps slot volume and input
+// gain between points per sample.
+export type GestureTarget = 'XY' | 'SLOT_VOLUME' | 'INPUT_GAIN';
+
+export interface GestureCommand {
+    cmd: 'GESTURE';
+    target: GestureTarget;
+    slot?: number; // SLOT_VOLUME only
+    t0: number;
+    points: number[];
+}
+
+// How often a gesture's points are sent; the engine plays them 50 ms
+// behind (GestureStream::kLatencyMs), which covers this plus jitter
+export const GESTURE_FLUSH_MS = 30;
+export const GESTURE_MAX_VALUES = 192; // GesturePoints::kCapacity
@@ -0,0 +1,35 @@
+// Writes .br and .gz siblings next to each compressible file in dist/. The
+// engine loads dist/ into memory at startup and serves these variants to
+// browsers that accept them; it has no brotli encoder of its own.
+import { brotliCompressSync, constants, gzipSync } from 'node:zlib'
+import { readdirSync, readFileSync, statSync, writeFileSync } from 'node:fs'
+import { join } from 'node:path'
+
+const root = new URL('../dist/', import.meta.url).pathname
+const compressible = /\.(html|js|mjs|css|json|map|svg|txt|wasm|ico|ttf|webmanifest)$/
+
+function* walk(dir) {
+    for (const name of readdirSync(dir)) {
+        const path = join(dir, name)
+        if (statSync(path).isDirectory()) yield* walk(path)
+        else yield path
+    }
+}
+
+let files = 0
+for (const path of walk(root)) {
+    if (!compressible.test(path)) continue
+    const data = readFileSync(path)
+    const brotli = brotliCompressSync(data, {
+        params: {
+            [constants.BROTLI_PARAM_QUALITY]: constants.BROTLI_MAX_QUALITY,
+            [constants.BROTLI_PARAM_SIZE_HINT]: data.length
+        }
+    })
+    const gzip = gzipSync(data, { level: 9 })
+    // Not worth serving if it doesn't save anything
+    if (brotli.length < data.length) writeFileSync(path + '.br', brotli)
+    if (gzip.length < data.length) writeFileSync(path + '.gz', gzip)
+    files++
+}
+console.log(`precompress: ${files} files in ${root}`)
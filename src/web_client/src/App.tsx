@@ -1,7 +1,7 @@
 import React, { useState, useEffect, useCallback } from 'react'
 import { WebSocketClient } from './api/WebSocketClient'
 import { flowLogger } from './api/FlowLogger'
-import { AppState } from '../../shared/protocol/schema'
+import { AppState, RiffHistoryEntry, SessionEntry, VisualFrame } from '../../shared/protocol/schema'
 import { MainLayout } from './components/layout/MainLayout'
 import { TabId } from './components/layout/Navigation'
 import { JamManagerView } from './views/JamManagerView'
@@ -14,6 +14,7 @@ import { Knob } from './components/shared/Knob'
 
 function App() {
     const [state, setState] = useState<AppState | null>(null)
+    const [visualFrame, setVisualFrame] = useState<VisualFrame | null>(null)
     const [connected, setConnected] = useState(false)
     const [showJamManager, setShowJamManager] = useState(true) // Start at home screen
     const [showSettings, setShowSettings] = useState(false);
@@ -78,7 +79,7 @@ function App() {
                     const nextState = applyPatch(prevState, message.ops);
                     // Sampled logging for state patches
                     flowLogger.logSampled('AUDIO', 'state_patch',
-                        `mic.inputLevel=${nextState.mic?.inputLevel?.toFixed(4)} looper.inputLevel=${nextState.looper?.inputLevel?.toFixed(4)} waveformNonZero=${nextState.looper?.waveformData?.some((v: number) => v > 0.001) ? 'YES' : 'NO'}`,
+                        `mic.inputLevel=${nextState.mic?.inputLevel?.toFixed(4)} looper.inputLevel=${nextState.looper?.inputLevel?.toFixed(4)}`,
                         60);
                     return nextState;
                 });
@@ -89,12 +90,33 @@ function App() {
                 setState(message);
                 setConnected(true);
             }
-        })
+        }, setVisualFrame)
         return () => {
             // wsClient.disconnect()
         }
     }, [wsClient])
 
+    // The riff history and jam list are paged in separately; the state only
+    // says how many there are and bumps a version when they change
+    const [riffHistory, setRiffHistory] = useState<RiffHistoryEntry[]>([])
+    const [sessions, setSessions] = useState<SessionEntry[]>([])
+    const riffsVersion = state?.library?.riffsVersion
+    const sessionsVersion = state?.library?.sessionsVersion
+
+    useEffect(() => {
+        if (riffsVersion === undefined) return;
+        wsClient.listRiffs(0, 50)
+            .then((page) => setRiffHistory(page.items))
+            .catch((err) => flowLogger.log('STATE', `LIST_RIFFS failed: ${err}`));
+    }, [wsClient, riffsVersion])
+
+    useEffect(() => {
+        if (sessionsVersion === undefined) return;
+        wsClient.listSessions(0, 50)
+            .then((page) => setSessions(page.items))
+            .catch((err) => flowLogger.log('STATE', `LIST_SESSIONS failed: ${err}`));
+    }, [wsClient, sessionsVersion])
+
     // Track active pads for visual feedback
     const [activePads, setActivePads] = useState<Set<number>>(new Set());
     const [performanceMode, setPerformanceMode] = useState<'PADS' | 'XY'>('PADS');
@@ -271,7 +293,7 @@ function App() {
     }
 
     const handleXYChange = (x: number, y: number) => {
-        wsClient.send({ cmd: "XY_CHANGE", x, y });
+        wsClient.gesture('XY', [x, y]);
     };
 
     const handleSelectPreset = (category: string, preset: string) => {
@@ -289,7 +311,7 @@ function App() {
 
     const handleSlotVolumeChange = (slotId: number, volume: number) => {
         setIsMixDirty(true);
-        wsClient.send({ cmd: "SET_SLOT_VOLUME", slot: slotId, volume });
+        wsClient.gesture('SLOT_VOLUME', [volume], slotId);
     };
 
     const handleSelectSlot = (slotId: number) => {
@@ -423,7 +445,7 @@ function App() {
                         value={state?.mic?.inputGain ?? 0.7}
                         onChange={(val) => {
                             const dbValue = (val * 100) - 60;
-                            wsClient.send({ cmd: "SET_INPUT_GAIN", val: dbValue });
+                            wsClient.gesture('INPUT_GAIN', [dbValue]);
                         }}
                         size={150}
                         color="var(--neon-cyan)"
@@ -449,7 +471,7 @@ function App() {
 
     if (showJamManager) {
         return <JamManagerView
-            sessions={state?.sessions || []}
+            sessions={sessions}
             onCreateJam={handleCreateJam}
             onOpenJam={handleOpenJam}
             onRenameJam={handleRenameJam}
@@ -477,10 +499,10 @@ function App() {
             activePads={activePads}
             bottomContent={bottomContent}
             onHomeClick={handleHomeClick}
-            riffHistory={state?.riffHistory || []}
+            riffHistory={riffHistory}
             onLoadRiff={handleLoadRiff}
             looperInputLevel={state?.looper?.inputLevel ?? 0}
-            waveformData={state?.looper?.waveformData ? new Float32Array(state.looper.waveformData) : undefined}
+            waveformData={visualFrame?.waveform}
             onCommit={handleCommit}
         >
             {activeTab === 'mode' && <ModeView onSelectMode={handleSelectMode} />}
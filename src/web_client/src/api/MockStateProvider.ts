@@ -1,7 +1,13 @@
 import { AppState } from '../../../shared/protocol/schema';
 
 export const initialMockState: AppState = {
-    sessions: [],
+    library: {
+        sessionCount: 0,
+        sessionsVersion: 0,
+        riffCount: 0,
+        riffsVersion: 0,
+        latestRiff: { id: "", timestamp: 0, name: "", layers: 0, colors: [], userId: "" }
+    },
     session: {
         id: "mock-session-id",
         name: "Mock Session",
@@ -9,13 +15,11 @@ export const initialMockState: AppState = {
         createdAt: Date.now()
     },
     looper: {
-        inputLevel: 0,
-        waveformData: new Array(256).fill(0)
+        inputLevel: 0
     },
     transport: {
         bpm: 120.0,
         isPlaying: false,
-        barPhase: 0.0,
         loopLengthBars: 4,
         metronomeEnabled: false,
         quantiseEnabled: true,
@@ -69,7 +73,6 @@ export const initialMockState: AppState = {
             lastError: 0
         }
     ],
-    riffHistory: [],
     settings: {
         riffSwapMode: "instant",
         bufferSize: 512,
@@ -91,13 +94,7 @@ export class MockStateProvider {
 
     constructor() {
         this.state = JSON.parse(JSON.stringify(initialMockState));
-        // Simulate transport update
-        setInterval(() => {
-            if (this.state.transport.isPlaying) {
-                this.state.transport.barPhase = (this.state.transport.barPhase + 0.01) % 1.0;
-                this.notify();
-            }
-        }, 50);
+        // Bar phase is not part of AppState; it arrives on the binary stream
     }
 
     getState(): AppState {
@@ -0,0 +1,78 @@
+// api/MsgPack.ts
+
+// Minimal MessagePack decoder for the compact state encoding
+// (ws://host/?encoding=msgpack). Produces the same objects JSON.parse would
+// for the equivalent JSON message; bin/ext types are never sent.
+export function decodeMsgPack(buffer: ArrayBuffer): any {
+    const view = new DataView(buffer);
+    const bytes = new Uint8Array(buffer);
+    const text = new TextDecoder();
+    let pos = 0;
+
+    const need = (n: number) => {
+        if (pos + n > bytes.length) throw new Error('MsgPack: truncated');
+    };
+    const str = (length: number) => {
+        need(length);
+        const s = text.decode(bytes.subarray(pos, pos + length));
+        pos += length;
+        return s;
+    };
+    const array = (count: number): any[] => {
+        const out = new Array(count);
+        for (let i = 0; i < count; i++) out[i] = value();
+        return out;
+    };
+    const map = (count: number): Record<string, any> => {
+        const out: Record<string, any> = {};
+        for (let i = 0; i < count; i++) {
+            const key = value();
+            out[key] = value();
+        }
+        return out;
+    };
+    const read = (size: number, get: (offset: number) => number) => {
+        need(size);
+        const v = get(pos);
+        pos += size;
+        return v;
+    };
+
+    const value = (): any => {
+        need(1);
+        const b = bytes[pos++];
+        if (b <= 0x7f) return b;
+        if (b >= 0xe0) return b - 0x100;
+        if ((b & 0xf0) === 0x80) return map(b & 0x0f);
+        if ((b & 0xf0) === 0x90) return array(b & 0x0f);
+        if ((b & 0xe0) === 0xa0) return str(b & 0x1f);
+
+        switch (b) {
+            case 0xc0: return null;
+            case 0xc2: return false;
+            case 0xc3: return true;
+            case 0xca: return read(4, (o) => view.getFloat32(o));
+            case 0xcb: return read(8, (o) => view.getFloat64(o));
+            case 0xcc: return read(1, (o) => view.getUint8(o));
+            case 0xcd: return read(2, (o) => view.getUint16(o));
+            case 0xce: return read(4, (o) => view.getUint32(o));
+            case 0xcf: return read(8, (o) => Number(view.getBigUint64(o)));
+            case 0xd0: return read(1, (o) => view.getInt8(o));
+            case 0xd1: return read(2, (o) => view.getInt16(o));
+            case 0xd2: return read(4, (o) => view.getInt32(o));
+            case 0xd3: return read(8, (o) => Number(view.getBigInt64(o)));
+            case 0xd9: return str(read(1, (o) => view.getUint8(o)));
+            case 0xda: return str(read(2, (o) => view.getUint16(o)));
+            case 0xdb: return str(read(4, (o) => view.getUint32(o)));
+            case 0xdc: return array(read(2, (o) => view.getUint16(o)));
+            case 0xdd: return array(read(4, (o) => view.getUint32(o)));
+            case 0xde: return map(read(2, (o) => view.getUint16(o)));
+            case 0xdf: return map(read(4, (o) => view.getUint32(o)));
+            default: throw new Error(`MsgPack: unsupported type 0x${b.toString(16)}`);
+        }
+    };
+
+    const result = value();
+    if (pos !== bytes.length) throw new Error('MsgPack: trailing bytes');
+    return result;
+}
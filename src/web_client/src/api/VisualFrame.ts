@@ -0,0 +1,53 @@
+// api/VisualFrame.ts
+
+import {
+    VisualFrame,
+    VISUAL_FRAME_MAGIC,
+    VISUAL_FRAME_HEADER_BYTES,
+    VISUAL_FRAME_SLOTS,
+    VISUAL_FRAME_BANDS,
+    VISUAL_FRAME_WAVEFORM_POINTS
+} from '../../../shared/protocol/schema';
+
+const PAYLOAD_FLOATS = 3 + VISUAL_FRAME_SLOTS + VISUAL_FRAME_BANDS + VISUAL_FRAME_WAVEFORM_POINTS;
+const FRAME_BYTES = VISUAL_FRAME_HEADER_BYTES + PAYLOAD_FLOATS * 4;
+
+// Decode one binary visualization frame; returns null for anything malformed
+export function parseVisualFrame(buffer: ArrayBuffer): VisualFrame | null {
+    if (buffer.byteLength < FRAME_BYTES) return null;
+
+    const view = new DataView(buffer);
+    if (view.getUint32(0, true) !== VISUAL_FRAME_MAGIC) return null;
+
+    const readFloats = (firstIndex: number, count: number) => {
+        const out = new Float32Array(count);
+        for (let i = 0; i < count; i++) {
+            out[i] = view.getFloat32(VISUAL_FRAME_HEADER_BYTES + (firstIndex + i) * 4, true);
+        }
+        return out;
+    };
+
+    const slotsStart = 3;
+    const bandsStart = slotsStart + VISUAL_FRAME_SLOTS;
+    const waveformStart = bandsStart + VISUAL_FRAME_BANDS;
+
+    return {
+        frameId: view.getUint32(4, true),
+        timestamp: view.getFloat64(8, true),
+        barPhase: view.getFloat32(VISUAL_FRAME_HEADER_BYTES, true),
+        masterRms: [
+            view.getFloat32(VISUAL_FRAME_HEADER_BYTES + 4, true),
+            view.getFloat32(VISUAL_FRAME_HEADER_BYTES + 8, true)
+        ],
+        slotRms: readFloats(slotsStart, VISUAL_FRAME_SLOTS),
+        spectrum: readFloats(bandsStart, VISUAL_FRAME_BANDS),
+        waveform: readFloats(waveformStart, VISUAL_FRAME_WAVEFORM_POINTS)
+    };
+}
+
+// 4-byte ACK the server counts against its per-client pendingFrameCount
+export function makeVisualFrameAck(frameId: number): ArrayBuffer {
+    const ack = new ArrayBuffer(4);
+    new DataView(ack).setUint32(0, frameId, true);
+    return ack;
+}
@@ -1,42 +1,136 @@
 // api/WebSocketClient.ts
 
 import { flowLogger } from './FlowLogger';
+import { parseVisualFrame, makeVisualFrameAck } from './VisualFrame';
+import { decodeMsgPack } from './MsgPack';
+import { GESTURE_FLUSH_MS, GESTURE_MAX_VALUES, GestureCommand, GestureTarget, HistoryPage, RiffHistoryEntry, SessionEntry, VisualFrame, VISUAL_FRAME_MAGIC } from '../../../shared/protocol/schema';
+
+type PageRequest = { resolve: (page: HistoryPage<any>) => void; reject: (err: Error) => void };
+
+const round = (value: number, scale: number) => Math.round(value * scale) / scale;
 
 export class WebSocketClient {
     private ws: WebSocket | null = null;
     private url: string;
     private onStateChange?: (state: any) => void;
+    private onVisualFrame?: (frame: VisualFrame) => void;
+
+    // Last state revision applied, and the epoch of the engine that sent
+    // it; sent on reconnect so the engine can answer with the missed
+    // patches instead of a full snapshot (Spec §3.5). Revisions restart
+    // with every engine, so they only mean something within one epoch.
+    private lastEpoch = '';
+    private lastRevisionId = -1;
+    private resyncPending = false;
+    private clientId = Math.random().toString(36).slice(2);
+
+    // Outstanding LIST_RIFFS / LIST_SESSIONS queries, by requestId
+    private nextRequestId = 1;
+    private pendingPages = new Map<number, PageRequest>();
 
     private reconnectDelay = 1000;
     private maxReconnectDelay = 30000;
+
+    // Commands go on their own socket (ws://host/cmd) so they never queue
+    // behind snapshots or visual frames; the engine ACKs each one that has
+    // a requestId. Until it is open, commands use the state socket.
+    private cmdWs: WebSocket | null = null;
+    private cmdReconnectDelay = 1000;
+    private nextCommandId = 1;
+    private commandSentAt = new Map<number, number>();
+    lastCommandRttMs = 0;
+
+    // Commands sent in the same task (a chord, a multi-touch move) go out
+    // as one batch frame: a JSON array, acked once for its first requestId
+    private outbox: any[] = [];
+
+    // Points of the controls being moved since the last flush, by control
+    private gestures = new Map<string, GestureCommand>();
+    private gestureTimer: ReturnType<typeof setTimeout> | null = null;
     // private isConnected = false; // Unused for now
 
     constructor(url: string = "ws://localhost:50001") {
         this.url = url;
     }
 
-    connect(onStateChange?: (state: any) => void) {
+    connect(onStateChange?: (state: any) => void, onVisualFrame?: (frame: VisualFrame) => void) {
         this.onStateChange = onStateChange;
+        this.onVisualFrame = onVisualFrame;
         this.initSocket();
+        this.initCommandSocket();
+    }
+
+    private commandUrl(): string {
+        const url = new URL(this.url);
+        url.pathname = '/cmd';
+        url.search = '';
+        return url.toString();
+    }
+
+    private initCommandSocket() {
+        this.cmdWs = new WebSocket(this.commandUrl());
+
+        this.cmdWs.onopen = () => {
+            flowLogger.log('WS', 'COMMAND SOCKET CONNECTED');
+            this.cmdReconnectDelay = 1000;
+        };
+
+        this.cmdWs.onclose = () => {
+            this.commandSentAt.clear();
+            setTimeout(() => {
+                this.cmdReconnectDelay = Math.min(this.cmdReconnectDelay * 2, this.maxReconnectDelay);
+                this.initCommandSocket();
+            }, this.cmdReconnectDelay);
+        };
+
+        this.cmdWs.onmessage = (event) => {
+            if (typeof event.data !== 'string') {
+                return;
+            }
+            try {
+                const ack = JSON.parse(event.data);
+                if (ack.type !== 'ACK') {
+                    return;
+                }
+                const sentAt = this.commandSentAt.get(ack.requestId);
+                this.commandSentAt.delete(ack.requestId);
+                if (sentAt !== undefined) {
+                    this.lastCommandRttMs = performance.now() - sentAt;
+                }
+                if (!ack.queued) {
+                    flowLogger.log('WS', `COMMAND DROPPED requestId=${ack.requestId}`);
+                }
+            } catch (err) {
+                flowLogger.log('WS', `COMMAND SOCKET PARSE ERROR: ${err}`);
+            }
+        };
     }
 
     private initSocket() {
-        this.ws = new WebSocket(this.url);
+        this.resyncPending = false;
+        // Capabilities: compact MessagePack state, and where we left off.
+        // An engine that doesn't know them sends JSON text and a snapshot.
+        const params = ['encoding=msgpack'];
+        if (this.lastRevisionId >= 0) {
+            params.push(`epoch=${encodeURIComponent(this.lastEpoch)}`, `revisionId=${this.lastRevisionId}`);
+        }
+        const url = `${this.url}${this.url.includes('?') ? '&' : '?'}${params.join('&')}`;
+        this.ws = new WebSocket(url);
+        this.ws.binaryType = 'arraybuffer';
 
         this.ws.onopen = () => {
             console.log("[WebSocket] ✅ Connected to FlowZone Engine at", this.url);
             flowLogger.log('WS', `CONNECTED to ${this.url}`);
             // this.isConnected = true;
             this.reconnectDelay = 1000; // Reset delay
-
-            // Send reconnection info if implemented
-            // this.send({ cmd: 'WS_RECONNECT', ... });
         };
 
         this.ws.onclose = () => {
             console.warn("[WebSocket] ⚠️ Disconnected. Reconnecting in " + this.reconnectDelay + "ms");
             flowLogger.log('WS', `DISCONNECTED, reconnecting in ${this.reconnectDelay}ms`);
             // this.isConnected = false;
+            this.pendingPages.forEach((request) => request.reject(new Error('Disconnected')));
+            this.pendingPages.clear();
             setTimeout(() => {
                 this.reconnectDelay = Math.min(this.reconnectDelay * 2, this.maxReconnectDelay);
                 this.initSocket();
@@ -44,14 +138,33 @@ export class WebSocketClient {
         };
 
         this.ws.onmessage = (event) => {
+            // Binary = visualization frame (Spec §3.7, ACK every frame) or
+            // MessagePack-encoded state
+            if (event.data instanceof ArrayBuffer) {
+                const isVisualFrame = event.data.byteLength >= 4 &&
+                    new DataView(event.data).getUint32(0, true) === VISUAL_FRAME_MAGIC;
+                if (!isVisualFrame) {
+                    try {
+                        this.handleStateMessage(decodeMsgPack(event.data), event.data.byteLength);
+                    } catch (err) {
+                        flowLogger.log('WS', `MSGPACK ERROR: ${err}`);
+                    }
+                    return;
+                }
+
+                const frame = parseVisualFrame(event.data);
+                if (frame) {
+                    this.ws?.send(makeVisualFrameAck(frame.frameId));
+                    this.onVisualFrame?.(frame);
+                } else {
+                    flowLogger.log('WS', `BAD VISUAL FRAME size=${event.data.byteLength}`);
+                }
+                return;
+            }
+
             console.log("[WebSocket] 📥 Message received:", event.data.substring(0, 200) + (event.data.length > 200 ? '...' : ''));
             try {
-                const data = JSON.parse(event.data);
-                flowLogger.log('WS', `RECEIVED type=${data.type || 'unknown'} keys=${Object.keys(data).join(',')} size=${event.data.length}`);
-                console.log("[WebSocket] Parsed state keys:", Object.keys(data));
-                if (this.onStateChange) {
-                    this.onStateChange(data);
-                }
+                this.handleStateMessage(JSON.parse(event.data), event.data.length);
             } catch (err) {
                 flowLogger.log('WS', `PARSE ERROR: ${err}`);
                 console.error("[WebSocket] Failed to parse message:", err);
@@ -64,7 +177,136 @@ export class WebSocketClient {
         };
     }
 
+    private handleStateMessage(data: any, size: number) {
+        flowLogger.log('WS', `RECEIVED type=${data.type || 'unknown'} keys=${Object.keys(data).join(',')} size=${size}`);
+        if (data.type === 'RIFF_PAGE' || data.type === 'SESSION_PAGE') {
+            const request = this.pendingPages.get(data.requestId);
+            this.pendingPages.delete(data.requestId);
+            request?.resolve(data);
+            return;
+        }
+        if (!this.acceptRevision(data)) {
+            return;
+        }
+        if (this.onStateChange) {
+            this.onStateChange(data);
+        }
+    }
+
+    // Drops state messages that don't follow on from the last applied
+    // revision; a gap asks the engine to catch us up (WS_RECONNECT)
+    private acceptRevision(data: any): boolean {
+        if (data.type === 'STATE_FULL') {
+            this.lastEpoch = data.epoch ?? '';
+            this.lastRevisionId = data.revisionId;
+            this.resyncPending = false;
+            return true;
+        }
+        if (data.type !== 'STATE_PATCH' || this.lastRevisionId < 0) {
+            return true;
+        }
+
+        // A patch from another engine doesn't apply to our state, whatever
+        // its revision numbers say
+        const sameEngine = (data.epoch ?? '') === this.lastEpoch;
+        const base = data.fromRevisionId ?? data.revisionId - 1;
+        if (sameEngine && base === this.lastRevisionId) {
+            this.lastRevisionId = data.revisionId;
+            this.resyncPending = false;
+            return true;
+        }
+        if ((!sameEngine || data.revisionId > this.lastRevisionId) && !this.resyncPending) {
+            flowLogger.log('WS', `REVISION GAP have=${this.lastEpoch}/${this.lastRevisionId} got=${data.epoch}/${base}->${data.revisionId}, resyncing`);
+            this.resyncPending = true;
+            this.sendOnStateSocket({ cmd: 'WS_RECONNECT', epoch: this.lastEpoch, revisionId: this.lastRevisionId, clientId: this.clientId });
+        }
+        return false;
+    }
+
+    // Riff history and jam list, newest first. Answered by the engine to
+    // this client only; AppState.library says when to ask again.
+    listRiffs(offset = 0, limit = 50): Promise<HistoryPage<RiffHistoryEntry>> {
+        return this.requestPage('LIST_RIFFS', offset, limit);
+    }
+
+    listSessions(offset = 0, limit = 50): Promise<HistoryPage<SessionEntry>> {
+        return this.requestPage('LIST_SESSIONS', offset, limit);
+    }
+
+    private requestPage<T>(cmd: string, offset: number, limit: number): Promise<HistoryPage<T>> {
+        if (!this.ws || this.ws.readyState !== WebSocket.OPEN) {
+            return Promise.reject(new Error('Not connected'));
+        }
+        const requestId = this.nextRequestId++;
+        return new Promise((resolve, reject) => {
+            this.pendingPages.set(requestId, { resolve, reject });
+            this.sendOnStateSocket({ cmd, offset, limit, requestId });
+        });
+    }
+
     send(command: any) {
+        if (!this.cmdWs || this.cmdWs.readyState !== WebSocket.OPEN) {
+            this.sendOnStateSocket(command);
+            return;
+        }
+        if (this.outbox.push(command) === 1) {
+            queueMicrotask(() => this.flushCommands());
+        }
+    }
+
+    private flushCommands() {
+        const commands = this.outbox;
+        this.outbox = [];
+        if (!this.cmdWs || this.cmdWs.readyState !== WebSocket.OPEN) {
+            commands.forEach((command) => this.sendOnStateSocket(command));
+            return;
+        }
+        const requestId = this.nextCommandId++;
+        // Bounded even if the engine stops answering
+        if (this.commandSentAt.size > 256) {
+            this.commandSentAt.clear();
+        }
+        this.commandSentAt.set(requestId, performance.now());
+        commands[0] = { ...commands[0], requestId };
+        this.cmdWs.send(JSON.stringify(commands.length === 1 ? commands[0] : commands));
+    }
+
+    // One position of a continuous control: the XY pad ([x, y]), a slot
+    // fader ([volume], with its slot) or the input gain knob ([dB]). Points
+    // are timestamped here and sent every GESTURE_FLUSH_MS; the engine
+    // ramps between them, so fewer messages still move smoothly.
+    gesture(target: GestureTarget, values: number[], slot?: number) {
+        const key = slot === undefined ? target : `${target}:${slot}`;
+        const now = performance.now();
+        let pending = this.gestures.get(key);
+        if (!pending) {
+            pending = { cmd: 'GESTURE', target, t0: round(now, 10), points: [] };
+            if (slot !== undefined) {
+                pending.slot = slot;
+            }
+            this.gestures.set(key, pending);
+        }
+        pending.points.push(round(now - pending.t0, 10), ...values.map((value) => round(value, 10000)));
+
+        if (pending.points.length + values.length + 1 > GESTURE_MAX_VALUES) {
+            this.flushGestures();
+        } else if (this.gestureTimer === null) {
+            this.gestureTimer = setTimeout(() => this.flushGestures(), GESTURE_FLUSH_MS);
+        }
+    }
+
+    private flushGestures() {
+        if (this.gestureTimer !== null) {
+            clearTimeout(this.gestureTimer);
+            this.gestureTimer = null;
+        }
+        // Sent in one task, so every moving control shares a frame
+        this.gestures.forEach((gesture) => this.send(gesture));
+        this.gestures.clear();
+    }
+
+    // Queries and WS_RECONNECT are answered on the state socket
+    private sendOnStateSocket(command: any) {
         if (this.ws && this.ws.readyState === WebSocket.OPEN) {
             console.log("[WebSocket] 📤 Sending command:", command);
             this.ws.send(JSON.stringify(command));
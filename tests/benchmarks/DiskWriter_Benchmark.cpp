@@ -0,0 +1,188 @@
+/*
+  DiskWriter throughput benchmark
+
+  Records hours of simulated audio through DiskWriter into a SimulatedDisk
+  with a configurable bandwidth cap, latency spikes and capacity, then
+  reports the numbers needed to size the FIFO and overflow budgets:
+
+    diskwriter_benchmark --hours 2 --speed 120 --bandwidth 0.5 \
+                         --spike-ms 800 --spike-every 32 --fifo-seconds 10
+
+  Times are in simulated seconds unless noted. Audio-thread cost is the
+  wall-clock time spent inside writeBlock().
+*/
+
+#include "../../src/engine/DiskWriter.h"
+#include "../../src/engine/SimulatedDisk.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace flowzone;
+
+namespace {
+double optionOr(const juce::ArgumentList &args, const juce::String &name,
+                double fallback) {
+  auto index = args.indexOfOption(name);
+  if (index < 0)
+    return fallback;
+
+  // Accept both --name=value and --name value
+  auto value = args.getValueForOption(name);
+  if (value.isEmpty() && index + 1 < args.size())
+    value = args[index + 1].text;
+
+  return value.getDoubleValue();
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  juce::ArgumentList args(argc, argv);
+
+  if (args.containsOption("--help|-h")) {
+    std::printf(
+        "Usage: diskwriter_benchmark [options]\n"
+        "  --hours N          Simulated audio to record (default 1)\n"
+        "  --speed N          Simulated seconds per real second (default 60)\n"
+        "  --sample-rate N    (default 48000)\n"
+        "  --block N          Audio block size (default 256)\n"
+        "  --bandwidth MB/s   Disk bandwidth cap, 0 = unlimited (default 0)\n"
+        "  --spike-ms N       Latency spike length (default 0)\n"
+        "  --spike-every MB   Bytes between spikes (default 0 = none)\n"
+        "  --capacity MB      Disk capacity, 0 = unlimited (default 0)\n"
+        "  --fifo-seconds N   Ring buffer size (default 10)\n"
+        "  --overflow-mb N    Tier 3 RAM budget (default 1024)\n");
+    return 0;
+  }
+
+  const double hours = optionOr(args, "--hours", 1.0);
+  const double speed = juce::jmax(1.0, optionOr(args, "--speed", 60.0));
+  const double sampleRate = optionOr(args, "--sample-rate", 48000.0);
+  const int blockSize = (int)optionOr(args, "--block", 256.0);
+  const double mb = 1024.0 * 1024.0;
+
+  SimulatedDisk::Profile profile;
+  profile.bytesPerSecond = optionOr(args, "--bandwidth", 0.0) * mb;
+  profile.spikeMs = optionOr(args, "--spike-ms", 0.0);
+  profile.spikeIntervalBytes =
+      (juce::int64)(optionOr(args, "--spike-every", 0.0) * mb);
+  profile.capacityBytes = (juce::int64)(optionOr(args, "--capacity", 0.0) * mb);
+  profile.timeScale = speed;
+
+  SimulatedDisk disk(profile);
+
+  DiskWriter writer;
+  writer.setBudgets(
+      (int)(optionOr(args, "--fifo-seconds", 10.0) * sampleRate),
+      (size_t)(optionOr(args, "--overflow-mb", 1024.0) * mb));
+  writer.prepareToPlay(sampleRate, blockSize);
+  writer.setStreamFactory(
+      [&disk](const juce::File &file) { return disk.createStream(file); });
+
+  auto scratchDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                        .getChildFile("FlowZoneDiskBench");
+  scratchDir.deleteRecursively();
+  scratchDir.createDirectory();
+
+  if (!writer.startRecording(scratchDir.getChildFile("bench.wav"))) {
+    std::printf("Failed to start recording\n");
+    return 1;
+  }
+
+  juce::AudioBuffer<float> buffer(2, blockSize);
+  buffer.clear();
+
+  const auto totalBlocks =
+      (juce::int64)(hours * 3600.0 * sampleRate / blockSize);
+  const double realMsPerBlock = blockSize / sampleRate * 1000.0 / speed;
+  const auto blocksPerReport = (juce::int64)(600.0 * sampleRate / blockSize);
+
+  std::vector<float> writeMicros;
+  writeMicros.reserve((size_t)totalBlocks);
+
+  const auto startMs = juce::Time::getMillisecondCounterHiRes();
+  juce::int64 block = 0;
+
+  for (; block < totalBlocks && writer.isRecording(); ++block) {
+    auto t0 = juce::Time::getHighResolutionTicks();
+    writer.writeBlock(buffer);
+    auto t1 = juce::Time::getHighResolutionTicks();
+    writeMicros.push_back(
+        (float)(juce::Time::highResolutionTicksToSeconds(t1 - t0) * 1.0e6));
+
+    // Hold the simulated audio clock at `speed` x real time
+    auto dueMs = startMs + (double)(block + 1) * realMsPerBlock;
+    auto aheadMs = dueMs - juce::Time::getMillisecondCounterHiRes();
+    if (aheadMs >= 1.0)
+      juce::Thread::sleep((int)aheadMs);
+
+    if ((block + 1) % blocksPerReport == 0) {
+      auto status = writer.getTierStatus();
+      std::printf("  %6.1f min | tier %d | fill %5.1f%% | overflow %7.2f MB\n",
+                  (block + 1) * blockSize / sampleRate / 60.0,
+                  (int)status.currentTier, status.bufferFillPercent,
+                  status.overflowBytesUsed / mb);
+      std::fflush(stdout);
+    }
+  }
+
+  const bool stoppedEarly = !writer.isRecording();
+
+  // Let the disk thread catch up (counts towards the last recovery time)
+  const auto drainStartMs = juce::Time::getMillisecondCounterHiRes();
+  while (!stoppedEarly &&
+         writer.getTierStatus().currentTier != DiskWriter::Tier::Normal &&
+         juce::Time::getMillisecondCounterHiRes() - drainStartMs < 60000.0) {
+    writer.writeBlock(buffer); // Keep the clock running while we wait
+    juce::Thread::sleep(juce::jmax(1, (int)realMsPerBlock));
+  }
+
+  writer.stopRecording();
+
+  // A Tier 4 stop hands the emergency flush to the disk thread; let it finish
+  while (stoppedEarly && writer.getTierStatus().overflowBytesUsed > 0)
+    juce::Thread::sleep(10);
+  juce::Thread::sleep(200);
+
+  auto stats = writer.getStats();
+  auto diskStats = disk.getStats();
+
+  std::sort(writeMicros.begin(), writeMicros.end());
+  auto percentile = [&writeMicros](double p) {
+    if (writeMicros.empty())
+      return 0.0f;
+    auto index = (size_t)(p * (double)(writeMicros.size() - 1));
+    return writeMicros[index];
+  };
+  double sumMicros = 0.0;
+  for (auto v : writeMicros)
+    sumMicros += v;
+
+  const double blockBudgetMicros = blockSize / sampleRate * 1.0e6;
+
+  std::printf("\nDiskWriter benchmark\n");
+  std::printf("  Simulated audio      : %.2f h (%lld blocks of %d @ %.0f Hz)\n",
+              block * blockSize / sampleRate / 3600.0, (long long)block,
+              blockSize, sampleRate);
+  std::printf("  Stopped early        : %s\n", stoppedEarly ? "YES" : "no");
+  std::printf("  Max FIFO fill        : %.1f %%\n", stats.maxFillPercent);
+  std::printf("  Peak overflow        : %.2f MB\n",
+              stats.peakOverflowBytes / mb);
+  std::printf("  Tier excursions      : %d\n", stats.excursions);
+  std::printf("  Recovery to Tier 1   : last %.2f s, max %.2f s\n",
+              stats.lastRecoveryMs * speed / 1000.0,
+              stats.maxRecoveryMs * speed / 1000.0);
+  std::printf("  Write failures       : %lld (disk: %lld)\n",
+              (long long)stats.writeFailures,
+              (long long)diskStats.failedWrites);
+  std::printf("  Bytes to disk        : %.2f MB in %d streams\n",
+              diskStats.bytesWritten / mb, diskStats.streamsOpened);
+  std::printf("  writeBlock (wall us) : mean %.2f, p99 %.2f, p99.9 %.2f, "
+              "max %.2f (block budget %.0f)\n",
+              writeMicros.empty() ? 0.0 : sumMicros / writeMicros.size(),
+              percentile(0.99), percentile(0.999), percentile(1.0),
+              blockBudgetMicros);
+
+  scratchDir.deleteRecursively();
+  return stoppedEarly ? 2 : 0;
+}
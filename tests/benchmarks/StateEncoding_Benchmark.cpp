@@ -0,0 +1,186 @@
+/*
+  State encoding benchmark
+
+  Compares the JSON and MessagePack encodings of STATE_FULL and STATE_PATCH
+  for a populated session: bytes on the wire and encode time per message.
+  Also times the streaming JSON writer and reader against juce::JSON
+  (JSON::toString of the state as a var tree, JSON::parse back to one) on
+  the same state. The var route is timed without converting between the
+  tree and AppState, so it flatters juce::JSON.
+
+    state_encoding_benchmark --slots 8 --riffs 50 --iterations 2000
+
+  Encode times are wall-clock microseconds per message, best of 5 runs.
+*/
+
+#include "../../src/engine/state/MsgPack.h"
+#include "../../src/engine/state/StateBroadcaster.h"
+#include "../../src/engine/state/StreamingJson.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace flowzone;
+
+namespace {
+int optionOr(const juce::ArgumentList &args, const juce::String &name,
+             int fallback) {
+  auto index = args.indexOfOption(name);
+  if (index < 0)
+    return fallback;
+
+  // Accept both --name=value and --name value
+  auto value = args.getValueForOption(name);
+  if (value.isEmpty() && index + 1 < args.size())
+    value = args[index + 1].text;
+
+  return value.getIntValue();
+}
+
+AppState makeState(int numSlots, int numRiffs) {
+  AppState state;
+  state.session = {"session-1", "Late night jam", "", 1700000000000};
+  state.library.sessionCount = 12;
+  state.library.sessionsVersion = 12;
+
+  for (int i = 0; i < numSlots; ++i) {
+    SlotState slot;
+    slot.id = "slot-" + juce::String(i);
+    slot.state = "PLAYING";
+    slot.volume = 0.8f - 0.05f * (float)i;
+    slot.riffId = "riff-" + juce::String(i);
+    slot.name = "Layer " + juce::String(i + 1);
+    slot.pluginChain.push_back({"fx-" + juce::String(i), "reverb", "FlowZone",
+                                "Reverb", false, ""});
+    state.slots.push_back(slot);
+  }
+
+  // Only the newest riff is part of the state; the rest are paged in from
+  // HistoryStore, so the riff count doesn't change the message sizes
+  state.library.riffCount = numRiffs;
+  state.library.riffsVersion = numRiffs;
+  if (numRiffs > 0)
+    state.library.latestRiff = {"riff-" + juce::String(numRiffs - 1),
+                                1700000000000 + (numRiffs - 1) * 60000,
+                                "Riff " + juce::String(numRiffs - 1),
+                                1 + (numRiffs - 1) % 8,
+                                {"#ff5500", "#00aaff", "#44ff88"},
+                                "local"};
+
+  state.mic.inputLevel = 0.4213f;
+  state.looper.inputLevel = 0.3377f;
+  state.system.cpuLoad = 0.1834f;
+  return state;
+}
+
+template <typename Fn> double bestMicrosPerCall(int iterations, Fn &&fn) {
+  double best = 1.0e12;
+  for (int run = 0; run < 5; ++run) {
+    auto start = juce::Time::getHighResolutionTicks();
+    for (int i = 0; i < iterations; ++i)
+      fn();
+    auto elapsed = juce::Time::highResolutionTicksToSeconds(
+        juce::Time::getHighResolutionTicks() - start);
+    best = std::min(best, elapsed * 1.0e6 / iterations);
+  }
+  return best;
+}
+
+void report(const char *name, size_t jsonBytes, size_t msgPackBytes,
+            double jsonMicros, double msgPackMicros) {
+  std::printf("%-10s %8zu B %8zu B  (%5.1f%%)   %8.2f us %8.2f us  (%5.1fx)\n",
+              name, jsonBytes, msgPackBytes,
+              100.0 * (double)msgPackBytes / (double)jsonBytes, jsonMicros,
+              msgPackMicros, jsonMicros / msgPackMicros);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  juce::ArgumentList args(argc, argv);
+
+  if (args.containsOption("--help|-h")) {
+    std::printf("Usage: state_encoding_benchmark [options]\n"
+                "  --slots N        Slots in the session (default 8)\n"
+                "  --riffs N        Riffs committed so far (default 50)\n"
+                "  --iterations N   Encodes per timing run (default 2000)\n");
+    return 0;
+  }
+
+  const int numSlots = std::max(1, optionOr(args, "--slots", 8));
+  const int numRiffs = std::max(0, optionOr(args, "--riffs", 50));
+  const int iterations = std::max(1, optionOr(args, "--iterations", 2000));
+
+  AppState state = makeState(numSlots, numRiffs);
+
+  // Meter-only tick: the patch sent most often while playing
+  AppState metered = state;
+  metered.mic.inputLevel = 0.3871f;
+  metered.looper.inputLevel = 0.2954f;
+  metered.system.cpuLoad = 0.1902f;
+
+  std::printf("State encoding: %d slots, %d riffs, %d iterations\n\n",
+              numSlots, numRiffs, iterations);
+  std::printf("%-10s %10s %10s %9s   %11s %11s\n", "message", "json",
+              "msgpack", "", "json", "msgpack");
+
+  // Each measured call encodes a fresh message, as a broadcast would
+  auto measure = [&](const char *name, const std::function<void(
+                                            StateBroadcaster &)> &send) {
+    size_t jsonBytes = 0, msgPackBytes = 0;
+    bool encodeJson = true;
+    StateBroadcaster broadcaster;
+    broadcaster.setStateMessageCallback(
+        [&](StateBroadcaster::StateMessage &message) {
+          if (encodeJson)
+            jsonBytes = message.toJsonUtf8().size();
+          else
+            msgPackBytes = message.toMsgPack().size();
+        });
+
+    auto run = [&] { send(broadcaster); };
+    encodeJson = true;
+    double jsonMicros = bestMicrosPerCall(iterations, run);
+    encodeJson = false;
+    double msgPackMicros = bestMicrosPerCall(iterations, run);
+    report(name, jsonBytes, msgPackBytes, jsonMicros, msgPackMicros);
+  };
+
+  measure("snapshot",
+          [&](StateBroadcaster &b) { b.broadcastFullState(state); });
+
+  // Alternate between the two states so every call produces a patch. The
+  // diff itself is shared by both encodings and included in both timings.
+  bool flip = false;
+  measure("patch", [&](StateBroadcaster &b) {
+    if (b.getRevisionId() == 0)
+      b.broadcastFullState(state);
+    flip = !flip;
+    b.broadcastStateUpdate(flip ? metered : state);
+  });
+
+  std::printf("\n%-10s %11s %11s\n", "state", "juce::var", "streaming");
+
+  std::string streamed;
+  double writeStreamMicros = bestMicrosPerCall(iterations, [&] {
+    streamed.clear();
+    JsonWriter writer(streamed);
+    state.writeJson(writer);
+  });
+  auto text = juce::String::fromUTF8(streamed.data(), (int)streamed.size());
+  auto tree = juce::JSON::parse(text);
+  double writeVarMicros = bestMicrosPerCall(
+      iterations, [&] { juce::JSON::toString(tree, true); });
+  std::printf("%-10s %8.2f us %8.2f us  (%5.1fx)\n", "write", writeVarMicros,
+              writeStreamMicros, writeVarMicros / writeStreamMicros);
+
+  double readVarMicros =
+      bestMicrosPerCall(iterations, [&] { juce::JSON::parse(text); });
+  double readStreamMicros = bestMicrosPerCall(iterations, [&] {
+    AppState read;
+    JsonReader reader(streamed.data(), streamed.size());
+    AppState::readJson(reader, read);
+  });
+  std::printf("%-10s %8.2f us %8.2f us  (%5.1fx)\n", "read", readVarMicros,
+              readStreamMicros, readVarMicros / readStreamMicros);
+
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+  Synth benchmark
+
+  Holds a chord on every voice of SynthEngine and times the render, per
+  oscillator shape. Reports the cost of one voice and how many voices one
+  core could render in real time at that rate.
+
+    synth_benchmark --rate 48000 --block 512 --seconds 10 --interval 32
+
+  A big pad, as the voice packs are meant for:
+
+    synth_benchmark --voices 64 --rate 96000
+
+  Times are wall-clock, best of 5 runs, after two seconds of warm-up so
+  slow attacks have reached sustain.
+*/
+
+#include "../../src/engine/SynthEngine.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace flowzone::engine;
+
+namespace {
+int optionOr(const juce::ArgumentList &args, const juce::String &name,
+             int fallback) {
+  auto index = args.indexOfOption(name);
+  if (index < 0)
+    return fallback;
+
+  // Accept both --name=value and --name value
+  auto value = args.getValueForOption(name);
+  if (value.isEmpty() && index + 1 < args.size())
+    value = args[index + 1].text;
+
+  return value.getIntValue();
+}
+
+struct Shape {
+  const char *name;
+  const char *category;
+  const char *preset;
+};
+} // namespace
+
+int main(int argc, char *argv[]) {
+  juce::ArgumentList args(argc, argv);
+
+  if (args.containsOption("--help|-h")) {
+    std::printf("Usage: synth_benchmark [options]\n"
+                "  --rate N      Sample rate (default 48000)\n"
+                "  --block N     Samples per block (default 512)\n"
+                "  --seconds N   Audio rendered per timing run (default 10)\n"
+                "  --interval N  Samples between modulation updates "
+                "(default 32)\n"
+                "  --voices N    Notes held, up to 64 (default 16)\n");
+    return 0;
+  }
+
+  const int sampleRate = std::max(8000, optionOr(args, "--rate", 48000));
+  const int blockSize = std::max(1, optionOr(args, "--block", 512));
+  const int seconds = std::max(1, optionOr(args, "--seconds", 10));
+  const int interval = juce::jlimit(1, 64, optionOr(args, "--interval", 32));
+  const int numVoices = juce::jlimit(1, 64, optionOr(args, "--voices", 16));
+
+  // The last four also run the modulation matrix and filter; supersaw is
+  // 16 unison oscillators a voice
+  const Shape shapes[] = {{"sine", "notes", "pad"},
+                          {"saw", "bass", "reese"},
+                          {"square", "notes", "square-bass"},
+                          {"triangle", "notes", "triangle-pad"},
+                          {"wavetable", "notes", "organ"},
+                          {"wt-morph", "notes", "soft-keys"},
+                          {"wobble", "bass", "wobble"},
+                          {"acid", "bass", "acid"},
+                          {"supersaw", "notes", "supersaw"}};
+
+  std::printf("Synth: %d voices, %d Hz, %d-sample blocks, %d s per run, "
+              "modulation every %d samples\n\n",
+              numVoices, sampleRate, blockSize, seconds, interval);
+  std::printf("%-10s %14s %16s\n", "shape", "ns/voice/smp", "voices per core");
+
+  juce::AudioBuffer<float> buffer(2, blockSize);
+  juce::MidiBuffer none;
+  const int blocksPerRun = seconds * sampleRate / blockSize;
+
+  for (const auto &shape : shapes) {
+    SynthEngine engine;
+    engine.prepare(sampleRate, blockSize);
+    engine.setControlInterval(interval);
+    engine.setPreset(shape.category, shape.preset);
+
+    // Spread over the keyboard so high notes (and their aliasing fixes)
+    // are part of the cost: major thirds from C2, then again a semitone up
+    // every 16 voices
+    juce::MidiBuffer chord;
+    for (int v = 0; v < numVoices; ++v)
+      chord.addEvent(
+          juce::MidiMessage::noteOn(1, 36 + (v % 16) * 4 + v / 16, 0.8f), 0);
+    buffer.clear();
+    engine.process(buffer, chord);
+
+    for (int b = 0; b < 2 * sampleRate / blockSize; ++b) {
+      buffer.clear();
+      engine.process(buffer, none);
+    }
+
+    double best = 1.0e12;
+    for (int run = 0; run < 5; ++run) {
+      auto start = juce::Time::getHighResolutionTicks();
+      for (int b = 0; b < blocksPerRun; ++b) {
+        buffer.clear();
+        engine.process(buffer, none);
+      }
+      best = std::min(best, juce::Time::highResolutionTicksToSeconds(
+                                juce::Time::getHighResolutionTicks() - start));
+    }
+
+    double samples = (double)blocksPerRun * blockSize;
+    double perVoiceSample = best / (samples * numVoices);
+    std::printf("%-10s %14.2f %16.0f\n", shape.name, perVoiceSample * 1.0e9,
+                1.0 / (perVoiceSample * sampleRate));
+  }
+
+  return 0;
+}
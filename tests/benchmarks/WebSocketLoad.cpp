@@ -0,0 +1,569 @@
+/*
+  WebSocket load harness
+
+  Runs a WebSocketServer in-process, wired to a StateBroadcaster the way
+  Main.cpp wires the engine's, and connects N protocol clients to it over
+  real sockets. Each client sends a mix of commands like a phone in a jam
+  (fader drags, XY pad moves, the odd tempo change and history page) while
+  a 30 Hz visualization stream runs, and measures:
+
+    ack      command sent -> the sender receives the state revision that
+             includes it (FlowZone has no explicit command ack)
+    bcast    state broadcast -> message received, over every client
+    query    LIST_RIFFS sent -> its reply received
+
+    flowzone_wsload --clients 1,8,16,32,64 --seconds 5 --rate 20
+
+  With --cmd-socket each client also opens ws://host/cmd and sends its
+  commands there, as the web client does; queries stay on "/".
+
+  The stand-in engine applies each command and broadcasts straight away
+  rather than on the engine's tick, so the latencies are the server's own.
+  Percentiles are in milliseconds.
+*/
+
+#include "../../src/engine/CommandDispatcher.h"
+#include "../../src/engine/server/WebSocketServer.h"
+#include "../../src/engine/state/StateBroadcaster.h"
+#include "../../src/engine/state/StreamingJson.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#if JUCE_LINUX || JUCE_MAC
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+using namespace flowzone;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+int optionOr(const juce::ArgumentList &args, const juce::String &name,
+             int fallback) {
+  auto index = args.indexOfOption(name);
+  if (index < 0)
+    return fallback;
+
+  // Accept both --name=value and --name value
+  auto value = args.getValueForOption(name);
+  if (value.isEmpty() && index + 1 < args.size())
+    value = args[index + 1].text;
+
+  return value.getIntValue();
+}
+
+juce::String stringOption(const juce::ArgumentList &args,
+                          const juce::String &name,
+                          const juce::String &fallback) {
+  auto index = args.indexOfOption(name);
+  if (index < 0)
+    return fallback;
+
+  auto value = args.getValueForOption(name);
+  if (value.isEmpty() && index + 1 < args.size())
+    value = args[index + 1].text;
+  return value;
+}
+
+int64_t nowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+// Finds "key": <integer> in a JSON message without parsing all of it
+bool findInt(const char *data, size_t len, const char *key, int64_t &value) {
+  std::string_view text(data, len);
+  auto at = text.find(key);
+  if (at == std::string_view::npos)
+    return false;
+
+  at += std::strlen(key);
+  while (at < text.size() && (text[at] == ':' || text[at] == ' '))
+    ++at;
+  if (at >= text.size())
+    return false;
+
+  value = std::strtoll(text.data() + at, nullptr, 10);
+  return true;
+}
+
+// Browsers disable Nagle's algorithm on WebSockets; civetweb's client
+// doesn't and sends each frame's header and payload separately, so without
+// this every command would wait out a delayed ACK. Finds the client ends
+// by their peer port, as civetweb doesn't expose its sockets.
+void disableNagleOnClients(int port) {
+#if JUCE_LINUX || JUCE_MAC
+  for (int fd = 3; fd < 4096; ++fd) {
+    sockaddr_in peer{};
+    socklen_t length = sizeof(peer);
+    if (getpeername(fd, (sockaddr *)&peer, &length) == 0 &&
+        peer.sin_family == AF_INET && ntohs(peer.sin_port) == port) {
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+  }
+#else
+  juce::ignoreUnused(port);
+#endif
+}
+
+/**
+ * Lock-free table of microsecond timestamps keyed by a sequence number.
+ * Big enough that a slow client can still look up everything it was sent
+ * during a run.
+ */
+class TimeTable {
+public:
+  void set(int64_t key, int64_t micros) {
+    slots[(size_t)key & (kSize - 1)].store(micros, std::memory_order_release);
+  }
+  int64_t get(int64_t key) const {
+    return slots[(size_t)key & (kSize - 1)].load(std::memory_order_acquire);
+  }
+
+private:
+  static constexpr size_t kSize = 1 << 16;
+  std::array<std::atomic<int64_t>, kSize> slots{};
+};
+
+/**
+ * Stand-in for FlowEngine: applies commands to an AppState and broadcasts
+ * the result through a StateBroadcaster, recording when each revision went
+ * out and which revision first carried each command.
+ */
+class FakeEngine {
+public:
+  explicit FakeEngine(WebSocketServer &s) : server(s) {
+    state.slots.resize(8);
+    for (int i = 0; i < 8; ++i) {
+      state.slots[(size_t)i].id = "slot-" + juce::String(i);
+      state.slots[(size_t)i].state = "PLAYING";
+      state.slots[(size_t)i].name = "Layer " + juce::String(i + 1);
+    }
+    state.library.riffCount = 200;
+
+    broadcaster.setStateMessageCallback(
+        [this](StateBroadcaster::StateMessage &message) {
+          sentAt.set(message.getRevisionId(), nowMicros());
+          auto kind = message.getType() ==
+                              StateBroadcaster::MessageType::Snapshot
+                          ? OutgoingMessage::Kind::StateSnapshot
+                          : OutgoingMessage::Kind::StatePatch;
+          server.broadcastState(
+              kind, [&] { return message.toJsonUtf8(); },
+              [&] { return message.toMsgPack(); });
+        });
+    broadcaster.broadcastFullState(state);
+  }
+
+  bool onCommand(std::string_view text) {
+    Command command;
+    if (!CommandDispatcher::parse(
+            juce::String::fromUTF8(text.data(), (int)text.size()), command))
+      return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (command.cmd == "SET_SLOT_VOLUME" && command.slot >= 0 &&
+        command.slot < (int)state.slots.size())
+      state.slots[(size_t)command.slot].volume = command.volume;
+    else if (command.cmd == "XY_CHANGE")
+      state.activeFX.xyPosition = {command.x, command.y};
+    else if (command.cmd == "SET_TEMPO" && command.bpm)
+      state.transport.bpm = *command.bpm;
+
+    // Recorded before broadcasting: the sender may see the patch before
+    // broadcastStateUpdate returns
+    auto expected = broadcaster.getRevisionId() + 1;
+    if (command.requestId)
+      ackRevision.set(*command.requestId, expected);
+    broadcaster.broadcastStateUpdate(state);
+    if (command.requestId && broadcaster.getRevisionId() != expected)
+      ackRevision.set(*command.requestId, broadcaster.getRevisionId());
+    return true;
+  }
+
+  bool onQuery(std::string_view text,
+               const WebSocketServer::DeliverFunction &reply) {
+    if (text.find("\"LIST_RIFFS\"") == std::string_view::npos)
+      return false;
+
+    Command command;
+    if (!CommandDispatcher::parse(text.data(), text.size(), command))
+      return false;
+
+    std::string json;
+    JsonWriter writer(json);
+    writer.beginObject();
+    writer.key("type");
+    writer.writeString("RIFF_PAGE");
+    writer.key("requestId");
+    writer.writeInt(command.requestId.value_or(-1));
+    writer.key("riffs");
+    writer.beginArray();
+    for (int i = 0; i < command.limit; ++i) {
+      writer.beginObject();
+      writer.key("id");
+      writer.writeString(juce::String("riff-") +
+                         juce::String(command.offset + i));
+      writer.key("layers");
+      writer.writeInt(1 + i % 8);
+      writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    reply(json);
+    return true;
+  }
+
+  // New clients are brought up to date the way Main.cpp does it
+  bool catchUp(std::string_view lastEpoch, int64_t lastRevisionId,
+               StateEncoding encoding,
+               const WebSocketServer::DeliverFunction &deliver) {
+    return broadcaster.replyToReconnect(
+        lastEpoch, lastRevisionId,
+        [&](StateBroadcaster::StateMessage &message) {
+          deliver(encoding == StateEncoding::MsgPack ? message.toMsgPack()
+                                                     : message.toJsonUtf8());
+        });
+  }
+
+  TimeTable sentAt;      // Revision -> broadcast time
+  TimeTable ackRevision; // requestId -> first revision carrying it
+
+private:
+  WebSocketServer &server;
+  std::mutex mutex;
+  AppState state;
+  StateBroadcaster broadcaster;
+};
+
+/** One connected client: sends commands, timestamps what comes back. */
+struct LoadClient {
+  FakeEngine *engine = nullptr;
+  struct mg_connection *conn = nullptr;
+  struct mg_connection *commandConn = nullptr; // With --cmd-socket
+  int index = 0;
+
+  std::mutex mutex; // Guards everything below
+  struct Pending {
+    int64_t requestId;
+    int64_t sentMicros;
+  };
+  std::vector<Pending> pendingCommands;
+  std::vector<Pending> pendingQueries;
+  std::vector<double> ackMs, broadcastMs, queryMs;
+  int64_t lastRevision = 0;
+  uint64_t frames = 0;
+  std::atomic<bool> closed{false};
+
+  static int onData(struct mg_connection *c, int bits, char *data,
+                    size_t len, void *user) {
+    static_cast<LoadClient *>(user)->receive(c, bits, data, len);
+    return 1;
+  }
+
+  static void onClose(const struct mg_connection *, void *user) {
+    static_cast<LoadClient *>(user)->closed = true;
+  }
+
+  // The command socket only carries ACKs back; commands are timed by the
+  // state they produce, like those sent on "/"
+  static int onCommandData(struct mg_connection *, int, char *, size_t,
+                           void *) {
+    return 1;
+  }
+
+  void receive(struct mg_connection *c, int bits, char *data, size_t len) {
+    int64_t now = nowMicros();
+
+    // Visualization frames are acked like the web client does
+    if ((bits & 0x0f) == MG_WEBSOCKET_OPCODE_BINARY) {
+      uint32_t frameId = 0;
+      if (len >= 8)
+        std::memcpy(&frameId, data + 4, 4);
+      mg_websocket_client_write(c, MG_WEBSOCKET_OPCODE_BINARY,
+                                (const char *)&frameId, 4);
+      std::lock_guard<std::mutex> lock(mutex);
+      ++frames;
+      return;
+    }
+    if ((bits & 0x0f) != MG_WEBSOCKET_OPCODE_TEXT)
+      return;
+
+    int64_t value = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (len > 20 && std::strncmp(data, "{\"type\":\"RIFF_PAGE\"", 19) == 0) {
+      if (findInt(data, len, "\"requestId\"", value))
+        settle(pendingQueries, queryMs, now,
+               [&](const Pending &p) { return p.requestId == value; });
+      return;
+    }
+
+    if (!findInt(data, len, "\"revisionId\"", value))
+      return;
+
+    int64_t revision = value;
+    int64_t sent = engine->sentAt.get(revision);
+    if (sent > 0)
+      broadcastMs.push_back((double)(now - sent) / 1000.0);
+    lastRevision = std::max(lastRevision, revision);
+
+    settle(pendingCommands, ackMs, now, [&](const Pending &p) {
+      int64_t needed = engine->ackRevision.get(p.requestId);
+      return needed > 0 && needed <= lastRevision;
+    });
+  }
+
+  template <typename Predicate>
+  static void settle(std::vector<Pending> &pending, std::vector<double> &out,
+                     int64_t now, Predicate done) {
+    for (auto it = pending.begin(); it != pending.end();) {
+      if (done(*it)) {
+        out.push_back((double)(now - it->sentMicros) / 1000.0);
+        it = pending.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void send(const std::string &text, int64_t requestId, bool query) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      (query ? pendingQueries : pendingCommands)
+          .push_back({requestId, nowMicros()});
+    }
+    auto *target = query || commandConn == nullptr ? conn : commandConn;
+    mg_websocket_client_write(target, MG_WEBSOCKET_OPCODE_TEXT, text.data(),
+                              text.size());
+  }
+};
+
+std::string makeCommand(std::mt19937 &random, int client, int64_t requestId,
+                        bool &query) {
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  float pick = unit(random);
+  query = false;
+
+  std::string json;
+  JsonWriter writer(json);
+  writer.beginObject();
+  writer.key("cmd");
+  if (pick < 0.70f) {
+    writer.writeString("SET_SLOT_VOLUME");
+    writer.key("slot");
+    writer.writeInt(client % 8);
+    writer.key("volume");
+    // Never the value already there, so every command changes the state
+    writer.writeFloat((float)(requestId % 1000) / 1000.0f);
+  } else if (pick < 0.90f) {
+    writer.writeString("XY_CHANGE");
+    writer.key("x");
+    writer.writeFloat(unit(random));
+    writer.key("y");
+    writer.writeFloat(unit(random));
+  } else if (pick < 0.95f) {
+    writer.writeString("SET_TEMPO");
+    writer.key("bpm");
+    writer.writeDouble(90.0 + (double)(requestId % 600) / 10.0);
+  } else {
+    query = true;
+    writer.writeString("LIST_RIFFS");
+    writer.key("offset");
+    writer.writeInt((int)(requestId % 150));
+    writer.key("limit");
+    writer.writeInt(25);
+  }
+  writer.key("requestId");
+  writer.writeInt(requestId);
+  writer.endObject();
+  return json;
+}
+
+struct Percentiles {
+  double p50 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+Percentiles percentiles(std::vector<double> samples) {
+  Percentiles p;
+  if (samples.empty())
+    return p;
+  std::sort(samples.begin(), samples.end());
+  auto at = [&](double q) {
+    return samples[std::min(samples.size() - 1,
+                            (size_t)(q * (double)samples.size()))];
+  };
+  p.p50 = at(0.50);
+  p.p95 = at(0.95);
+  p.p99 = at(0.99);
+  p.max = samples.back();
+  return p;
+}
+
+void runLoad(int numClients, int port, int seconds, int rate,
+             bool commandSocket) {
+  WebSocketServer server(port);
+  FakeEngine engine(server);
+  server.setReconnectCallback(
+      [&engine](std::string_view lastEpoch, int64_t lastRevisionId,
+                StateEncoding encoding,
+                const WebSocketServer::DeliverFunction &deliver) {
+        return engine.catchUp(lastEpoch, lastRevisionId, encoding, deliver);
+      });
+  server.setOnMessageCallback(
+      [&engine](std::string_view msg) { return engine.onCommand(msg); });
+  server.setQueryCallback(
+      [&engine](std::string_view msg,
+                const WebSocketServer::DeliverFunction &reply) {
+        return engine.onQuery(msg, reply);
+      });
+  server.start();
+
+  std::vector<std::unique_ptr<LoadClient>> clients;
+  for (int i = 0; i < numClients; ++i) {
+    auto client = std::make_unique<LoadClient>();
+    client->engine = &engine;
+    client->index = i;
+    char error[256] = {};
+    client->conn = mg_connect_websocket_client(
+        "127.0.0.1", port, 0, error, sizeof(error), "/", nullptr,
+        LoadClient::onData, LoadClient::onClose, client.get());
+    if (client->conn != nullptr && commandSocket)
+      client->commandConn = mg_connect_websocket_client(
+          "127.0.0.1", port, 0, error, sizeof(error), "/cmd", nullptr,
+          LoadClient::onCommandData, nullptr, client.get());
+    if (client->conn == nullptr ||
+        (commandSocket && client->commandConn == nullptr)) {
+      std::printf("%4d clients: connect %d failed: %s\n", numClients, i,
+                  error);
+      if (client->conn != nullptr)
+        mg_close_connection(client->conn);
+      break;
+    }
+    clients.push_back(std::move(client));
+  }
+
+  disableNagleOnClients(port);
+
+  std::atomic<bool> running{true};
+  std::atomic<int64_t> nextRequestId{1};
+
+  // 30 Hz visualization frames, as VisualizationStream sends them
+  std::thread frames([&] {
+    std::vector<char> frame(1024, 0);
+    std::memcpy(frame.data(), "FZV1", 4);
+    for (uint32_t id = 1; running; ++id) {
+      std::memcpy(frame.data() + 4, &id, 4);
+      server.broadcastBinary(frame.data(), frame.size());
+      std::this_thread::sleep_for(std::chrono::milliseconds(33));
+    }
+  });
+
+  std::vector<std::thread> senders;
+  for (auto &client : clients)
+    senders.emplace_back([&, c = client.get()] {
+      std::mt19937 random((unsigned)c->index + 1);
+      std::exponential_distribution<double> gap((double)rate);
+      auto next = Clock::now();
+      while (running && !c->closed) {
+        next += std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(gap(random)));
+        std::this_thread::sleep_until(next);
+        bool query = false;
+        int64_t requestId = nextRequestId++;
+        auto text = makeCommand(random, c->index, requestId, query);
+        c->send(text, requestId, query);
+      }
+    });
+
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  running = false;
+  for (auto &sender : senders)
+    sender.join();
+  frames.join();
+
+  // Let the last replies arrive before closing
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+  std::vector<double> ackMs, broadcastMs, queryMs;
+  size_t unanswered = 0;
+  uint64_t frameCount = 0;
+  for (auto &client : clients) {
+    std::lock_guard<std::mutex> lock(client->mutex);
+    ackMs.insert(ackMs.end(), client->ackMs.begin(), client->ackMs.end());
+    broadcastMs.insert(broadcastMs.end(), client->broadcastMs.begin(),
+                       client->broadcastMs.end());
+    queryMs.insert(queryMs.end(), client->queryMs.begin(),
+                   client->queryMs.end());
+    unanswered += client->pendingCommands.size() + client->pendingQueries.size();
+    frameCount += client->frames;
+  }
+
+  // Server first: closing a client connection that is still open at the
+  // other end waits out the client's read timeout
+  server.stop();
+  for (auto &client : clients) {
+    mg_close_connection(client->conn);
+    if (client->commandConn != nullptr)
+      mg_close_connection(client->commandConn);
+  }
+
+  auto ack = percentiles(ackMs);
+  auto bcast = percentiles(broadcastMs);
+  auto query = percentiles(queryMs);
+  std::printf("%7d %8zu %7.2f %7.2f %7.2f %7.2f  %7.2f %7.2f %7.2f %7.2f  "
+              "%7.2f %7.2f %7zu %7.1f\n",
+              (int)clients.size(), ackMs.size() + queryMs.size(), ack.p50,
+              ack.p95, ack.p99, ack.max, bcast.p50, bcast.p95, bcast.p99,
+              bcast.max, query.p50, query.p99, unanswered,
+              clients.empty() ? 0.0
+                              : (double)frameCount / (double)clients.size() /
+                                    (double)seconds);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  juce::ArgumentList args(argc, argv);
+
+  if (args.containsOption("--help|-h")) {
+    std::printf(
+        "Usage: flowzone_wsload [options]\n"
+        "  --clients LIST   Client counts to run, comma separated\n"
+        "                   (default 1,8,16,32,64)\n"
+        "  --seconds N      Length of each run (default 5)\n"
+        "  --rate N         Commands per second per client (default 20)\n"
+        "  --port N         Port for the in-process server (default 50991)\n"
+        "  --cmd-socket     Send commands on the /cmd socket\n");
+    return 0;
+  }
+
+  auto counts = juce::StringArray::fromTokens(
+      stringOption(args, "--clients", "1,8,16,32,64"), ",", "");
+  const int seconds = std::max(1, optionOr(args, "--seconds", 5));
+  const int rate = std::max(1, optionOr(args, "--rate", 20));
+  const int port = optionOr(args, "--port", 50991);
+  const bool commandSocket = args.containsOption("--cmd-socket");
+
+  mg_init_library(0);
+  std::printf("WebSocket load: %d s per run, %d commands/s per client%s\n\n",
+              seconds, rate, commandSocket ? ", commands on /cmd" : "");
+  std::printf("%7s %8s %31s  %31s  %15s %7s %7s\n", "", "", "ack (ms)",
+              "bcast (ms)", "query (ms)", "", "frames");
+  std::printf("%7s %8s %7s %7s %7s %7s  %7s %7s %7s %7s  %7s %7s %7s %7s\n",
+              "clients", "sent", "p50", "p95", "p99", "max", "p50", "p95",
+              "p99", "max", "p50", "p99", "lost", "/s");
+
+  for (auto &count : counts)
+    if (count.getIntValue() > 0)
+      runLoad(count.getIntValue(), port, seconds, rate, commandSocket);
+
+  mg_exit_library();
+  return 0;
+}
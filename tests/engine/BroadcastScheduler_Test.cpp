@@ -0,0 +1,114 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/state/BroadcastScheduler.h"
+
+using namespace flowzone;
+
+namespace {
+struct Run {
+  int stateSends = 0;
+  int visualSends = 0;
+  int ticks = 0;
+};
+
+// Drives the scheduler like FlowEngine's timer would, for durationMs,
+// calling produce(nowMs) before each tick
+template <typename Produce>
+Run simulate(BroadcastScheduler &scheduler, double startMs, double durationMs,
+             bool animating, Produce &&produce) {
+  Run run;
+  double now = startMs;
+  while (now < startMs + durationMs) {
+    produce(now);
+    auto decision = scheduler.onTick(now, animating);
+    ++run.ticks;
+    run.stateSends += decision.sendState ? 1 : 0;
+    run.visualSends += decision.sendVisual ? 1 : 0;
+    if (decision.nextTickMs == 0)
+      break;
+    now += decision.nextTickMs;
+  }
+  return run;
+}
+} // namespace
+
+TEST_CASE("BroadcastScheduler stops with no connections",
+          "[BroadcastScheduler]") {
+  BroadcastScheduler scheduler;
+  scheduler.markDirty(BroadcastScheduler::State | BroadcastScheduler::Meters);
+
+  auto decision = scheduler.onTick(0.0, true);
+  REQUIRE_FALSE(decision.sendState);
+  REQUIRE_FALSE(decision.sendVisual);
+  REQUIRE(decision.nextTickMs == 0);
+
+  // Flags survive until someone connects
+  REQUIRE(scheduler.setConnectionCount(1));
+  decision = scheduler.onTick(10.0, false);
+  REQUIRE(decision.sendState);
+  REQUIRE(decision.nextTickMs == scheduler.getConfig().minIntervalMs);
+
+  REQUIRE_FALSE(scheduler.setConnectionCount(0));
+  REQUIRE(scheduler.onTick(20.0, false).nextTickMs == 0);
+}
+
+TEST_CASE("BroadcastScheduler coalesces bursts and caps the rate",
+          "[BroadcastScheduler]") {
+  BroadcastScheduler scheduler;
+  scheduler.setConnectionCount(1);
+
+  SECTION("A burst of changes is one broadcast") {
+    for (int i = 0; i < 100; ++i)
+      scheduler.markDirty(BroadcastScheduler::State);
+    auto run = simulate(scheduler, 0.0, 200.0, false, [](double) {});
+    REQUIRE(run.stateSends == 1);
+  }
+
+  SECTION("Continuous state changes are capped at ~60Hz") {
+    auto run = simulate(scheduler, 0.0, 1000.0, false, [&](double) {
+      scheduler.markDirty(BroadcastScheduler::State);
+    });
+    REQUIRE(run.stateSends <= 64);
+    REQUIRE(run.stateSends >= 55);
+  }
+
+  SECTION("Meter-only changes are capped at the meter rate") {
+    auto run = simulate(scheduler, 0.0, 1000.0, false, [&](double) {
+      scheduler.markDirty(BroadcastScheduler::Meters);
+    });
+    // The connect itself flagged one state update
+    REQUIRE(run.stateSends <= 23);
+    REQUIRE(run.stateSends >= 18);
+
+    // Meter activity animates the visual stream at ~30Hz
+    REQUIRE(run.visualSends >= 28);
+    REQUIRE(run.visualSends <= 34);
+  }
+}
+
+TEST_CASE("BroadcastScheduler slows down when quiet", "[BroadcastScheduler]") {
+  BroadcastScheduler scheduler;
+  scheduler.setConnectionCount(1);
+  const auto &config = scheduler.getConfig();
+
+  auto first = scheduler.onTick(0.0, false);
+  REQUIRE(first.sendState); // Connect flags an update
+
+  // Nothing changes and nothing animates: drop to the idle poll rate
+  auto run = simulate(scheduler, config.minIntervalMs, 5000.0, false,
+                      [](double) {});
+  REQUIRE(run.stateSends == 0);
+  REQUIRE(run.visualSends == 0);
+  REQUIRE(run.ticks < 100); // ~312 at a fixed 60Hz
+
+  auto idle = scheduler.onTick(6000.0, false);
+  REQUIRE(idle.nextTickMs == config.idlePollMs);
+
+  // A queued command brings it back to the fast rate
+  scheduler.markDirty(BroadcastScheduler::Command);
+  REQUIRE(scheduler.onTick(6100.0, false).nextTickMs == config.minIntervalMs);
+
+  // A playing transport keeps visual frames going without state changes
+  auto playing = simulate(scheduler, 10000.0, 1000.0, true, [](double) {});
+  REQUIRE(playing.stateSends == 0);
+  REQUIRE(playing.visualSends >= 28);
+}
@@ -0,0 +1,212 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/server/ClientSendQueue.h"
+#include <atomic>
+#include <future>
+#include <vector>
+
+namespace {
+using Kind = OutgoingMessage::Kind;
+
+/** Records what the sender thread writes; can hold the first write open. */
+struct FakeConnection {
+  std::mutex mutex;
+  std::vector<std::string> written;
+  std::promise<void> firstWriteStarted;
+  std::shared_future<void> release;
+  std::atomic<bool> fail{false};
+  std::atomic<int> closes{0};
+  bool first = true;
+
+  explicit FakeConnection(std::shared_future<void> gate = {})
+      : release(gate) {}
+
+  ClientSendQueue::WriteFunction writer() {
+    return [this](const OutgoingMessage &m) {
+      bool isFirst;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        isFirst = first;
+        first = false;
+      }
+      if (isFirst) {
+        firstWriteStarted.set_value();
+        if (release.valid())
+          release.wait();
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      written.push_back(m.payload);
+      return !fail.load();
+    };
+  }
+
+  ClientSendQueue::CloseFunction closer() {
+    return [this] { ++closes; };
+  }
+
+  std::vector<std::string> snapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+  }
+};
+
+bool waitFor(const std::function<bool()> &condition, int timeoutMs = 2000) {
+  for (int waited = 0; waited < timeoutMs; waited += 5) {
+    if (condition())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return condition();
+}
+
+SharedMessage msg(Kind kind, const std::string &payload) {
+  return OutgoingMessage::make(kind, kind == Kind::Visual, payload);
+}
+} // namespace
+
+TEST_CASE("ClientSendQueue: A stalled client never blocks the producer",
+          "[ClientSendQueue]") {
+  std::promise<void> gate;
+  FakeConnection conn(gate.get_future().share());
+  ClientSendQueue queue(conn.writer(), conn.closer());
+  queue.start();
+
+  queue.push(msg(Kind::Event, "first"));
+  conn.firstWriteStarted.get_future().wait();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 100; ++i)
+    REQUIRE(queue.push(msg(Kind::Event, "e" + std::to_string(i))));
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  REQUIRE(elapsed < std::chrono::milliseconds(100));
+  REQUIRE(queue.getStats().queuedMessages == 100);
+
+  gate.set_value();
+  REQUIRE(waitFor([&] { return conn.snapshot().size() == 101; }));
+  REQUIRE(conn.snapshot().back() == "e99");
+}
+
+TEST_CASE("ClientSendQueue: Snapshots supersede queued state, events stay",
+          "[ClientSendQueue]") {
+  std::promise<void> gate;
+  FakeConnection conn(gate.get_future().share());
+  ClientSendQueue queue(conn.writer(), conn.closer());
+  queue.start();
+
+  queue.push(msg(Kind::StateSnapshot, "full1"));
+  conn.firstWriteStarted.get_future().wait();
+
+  queue.push(msg(Kind::StatePatch, "patch2"));
+  queue.push(msg(Kind::Event, "event"));
+  queue.push(msg(Kind::StatePatch, "patch3"));
+  queue.push(msg(Kind::StateSnapshot, "full4"));
+  queue.push(msg(Kind::StatePatch, "patch5"));
+
+  REQUIRE(queue.getStats().supersededMessages == 2);
+
+  gate.set_value();
+  REQUIRE(waitFor([&] { return conn.snapshot().size() == 4; }));
+  REQUIRE(conn.snapshot() ==
+          std::vector<std::string>{"full1", "event", "full4", "patch5"});
+}
+
+TEST_CASE("ClientSendQueue: Visual frames follow ACK backpressure",
+          "[ClientSendQueue]") {
+  FakeConnection conn;
+  ClientSendQueue::Limits limits;
+  limits.maxPendingFrames = 3;
+  ClientSendQueue queue(conn.writer(), conn.closer(), limits);
+  queue.start();
+
+  // 4 frames go out unacknowledged, the 5th is skipped
+  for (int i = 0; i < 4; ++i) {
+    queue.push(msg(Kind::Visual, "f" + std::to_string(i)));
+    REQUIRE(waitFor([&] { return queue.getStats().pendingFrames == i + 1; }));
+  }
+  queue.push(msg(Kind::Visual, "f4"));
+  REQUIRE(queue.getStats().skippedFrames == 1);
+
+  queue.onFrameAck();
+  queue.onFrameAck();
+  queue.push(msg(Kind::Visual, "f5"));
+  REQUIRE(waitFor([&] { return conn.snapshot().size() == 5; }));
+  REQUIRE(conn.snapshot().back() == "f5");
+}
+
+TEST_CASE("ClientSendQueue: A newer visual frame replaces a queued one",
+          "[ClientSendQueue]") {
+  std::promise<void> gate;
+  FakeConnection conn(gate.get_future().share());
+  ClientSendQueue queue(conn.writer(), conn.closer());
+  queue.start();
+
+  queue.push(msg(Kind::Event, "hold"));
+  conn.firstWriteStarted.get_future().wait();
+
+  queue.push(msg(Kind::Visual, "old"));
+  queue.push(msg(Kind::Visual, "new"));
+
+  gate.set_value();
+  REQUIRE(waitFor([&] { return conn.snapshot().size() == 2; }));
+  REQUIRE(conn.snapshot() == std::vector<std::string>{"hold", "new"});
+}
+
+TEST_CASE("ClientSendQueue: Laggards and broken connections are closed",
+          "[ClientSendQueue]") {
+  SECTION("Queue stays over its limit") {
+    std::promise<void> gate;
+    FakeConnection conn(gate.get_future().share());
+    ClientSendQueue::Limits limits;
+    limits.maxQueuedBytes = 1024;
+    limits.maxOverLimitMs = 50;
+    ClientSendQueue queue(conn.writer(), conn.closer(), limits);
+    queue.start();
+
+    queue.push(msg(Kind::Event, "hold"));
+    conn.firstWriteStarted.get_future().wait();
+
+    std::string chunk(512, 'x');
+    bool accepted = true;
+    auto start = std::chrono::steady_clock::now();
+    while (accepted &&
+           std::chrono::steady_clock::now() - start < std::chrono::seconds(2)) {
+      accepted = queue.push(msg(Kind::StatePatch, chunk));
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    REQUIRE_FALSE(accepted);
+    REQUIRE(queue.isDisconnecting());
+
+    gate.set_value();
+    REQUIRE(waitFor([&] { return conn.closes.load() == 1; }));
+    REQUIRE(conn.snapshot().size() == 1); // Backlog was discarded
+  }
+
+  SECTION("Hard limit disconnects immediately") {
+    std::promise<void> gate;
+    FakeConnection conn(gate.get_future().share());
+    ClientSendQueue::Limits limits;
+    limits.hardLimitBytes = 4096;
+    ClientSendQueue queue(conn.writer(), conn.closer(), limits);
+    queue.start();
+
+    queue.push(msg(Kind::Event, "hold"));
+    conn.firstWriteStarted.get_future().wait();
+
+    REQUIRE(queue.push(msg(Kind::Event, std::string(4000, 'x'))));
+    REQUIRE_FALSE(queue.push(msg(Kind::Event, std::string(200, 'x'))));
+    gate.set_value();
+    REQUIRE(waitFor([&] { return conn.closes.load() == 1; }));
+  }
+
+  SECTION("Write failure") {
+    FakeConnection conn;
+    conn.fail = true;
+    ClientSendQueue queue(conn.writer(), conn.closer());
+    queue.start();
+
+    queue.push(msg(Kind::Event, "boom"));
+    REQUIRE(waitFor([&] { return conn.closes.load() == 1; }));
+    REQUIRE_FALSE(queue.push(msg(Kind::Event, "after")));
+  }
+}
@@ -0,0 +1,132 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/CommandQueue.h"
+#include "../../src/engine/FlowEngine.h"
+#include <JuceHeader.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace flowzone;
+
+TEST_CASE("Command queue keeps whole records of any size", "[CommandQueue]") {
+  CommandQueue queue;
+  std::vector<char> out((size_t)CommandQueue::kMaxCommandBytes);
+
+  // Long enough to wrap around the ring many times
+  for (int i = 0; i < 2000; ++i) {
+    std::string command((size_t)(1 + (i * 37) % 1500), (char)('a' + i % 26));
+    REQUIRE(queue.push(std::string_view(command)));
+    REQUIRE(queue.getNumReady() == 1);
+    REQUIRE(queue.pop(out.data()) == (int)command.size());
+    REQUIRE(std::string(out.data(), command.size()) == command);
+  }
+  REQUIRE(queue.pop(out.data()) == -1);
+
+  std::string tooBig((size_t)CommandQueue::kMaxCommandBytes + 1, 'x');
+  REQUIRE_FALSE(queue.push(std::string_view(tooBig)));
+
+  // Full: pushes fail until the consumer catches up
+  std::string chunk(4000, 'y');
+  int pushed = 0;
+  while (queue.push(std::string_view(chunk)))
+    ++pushed;
+  REQUIRE(pushed == (CommandQueue::kCapacityBytes - 1) / 4004);
+  REQUIRE(queue.pop(out.data()) == 4000);
+  REQUIRE(queue.push(std::string_view(chunk)));
+}
+
+TEST_CASE("Command queue takes pushes from many threads", "[CommandQueue]") {
+  CommandQueue queue;
+  std::vector<std::thread> producers;
+  for (int t = 0; t < 4; ++t)
+    producers.emplace_back([&queue, t] {
+      for (int i = 0; i < 500; ++i) {
+        auto command = "{\"t\":" + std::to_string(t) + ",\"i\":" +
+                       std::to_string(i) + "}";
+        while (!queue.push(std::string_view(command)))
+          std::this_thread::yield();
+      }
+    });
+
+  // Each producer's commands come out whole and in its order
+  std::vector<int> next(4, 0);
+  std::vector<char> out((size_t)CommandQueue::kMaxCommandBytes);
+  int popped = 0;
+  while (popped < 2000) {
+    int size = queue.pop(out.data());
+    if (size < 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto command = juce::JSON::parse(juce::String::fromUTF8(out.data(), size));
+    int t = command["t"];
+    REQUIRE((int)command["i"] == next[(size_t)t]++);
+    ++popped;
+  }
+  for (auto &producer : producers)
+    producer.join();
+}
+
+TEST_CASE("A batch frame runs its commands in order", "[CommandQueue]") {
+  FlowEngine engine;
+  engine.prepareToPlay(44100.0, 512);
+  juce::AudioBuffer<float> buffer(2, 512);
+  juce::MidiBuffer midi;
+  bool metronome = engine.getTransport().isMetronomeEnabled();
+
+  REQUIRE(engine.submitCommand(R"([{"cmd":"SET_TEMPO","bpm":90,"requestId":1},
+      {"cmd":"TOGGLE_METRONOME"}, {"cmd":"SET_TEMPO","bpm":132}])"));
+  REQUIRE(engine.getCommandQueue().getNumReady() == 1);
+  engine.processBlock(buffer, midi);
+  REQUIRE(engine.getTransport().getBpm() == 132.0);
+  REQUIRE(engine.getTransport().isMetronomeEnabled() != metronome);
+
+  // A malformed element stops the batch there
+  REQUIRE(engine.submitCommand(
+      R"([{"cmd":"SET_TEMPO","bpm":100}, 7, {"cmd":"SET_TEMPO","bpm":140}])"));
+  engine.processBlock(buffer, midi);
+  REQUIRE(engine.getTransport().getBpm() == 100.0);
+}
+
+TEST_CASE("Volume gestures reach the session state", "[CommandQueue]") {
+  FlowEngine engine;
+  engine.prepareToPlay(44100.0, 512);
+  juce::AudioBuffer<float> buffer(2, 512);
+  juce::MidiBuffer midi;
+
+  REQUIRE(engine.submitCommand(
+      R"({"cmd":"GESTURE","target":"SLOT_VOLUME","slot":1,"t0":500,
+          "points":[0,0.9,16,0.6,33,0.3]})"));
+  REQUIRE(engine.submitCommand(
+      R"({"cmd":"GESTURE","target":"XY","t0":500,"points":[0,0.1,0.2,16,0.7,0.8]})"));
+  engine.processBlock(buffer, midi);
+
+  auto state = engine.getSessionManager().getCurrentState();
+  REQUIRE(state.slots[1].volume == 0.3f);
+  REQUIRE(state.activeFX.xyPosition.x == 0.7f);
+  REQUIRE(state.activeFX.xyPosition.y == 0.8f);
+}
+
+TEST_CASE("XY gestures ramp on the gesture clock", "[CommandQueue]") {
+  FlowEngine engine;
+  engine.prepareToPlay(44100.0, 512);
+  juce::AudioBuffer<float> buffer(2, 512);
+  juce::MidiBuffer midi;
+
+  REQUIRE(engine.submitCommand(
+      R"({"cmd":"GESTURE","target":"XY","t0":500,"points":[0,1.0,0.0]})"));
+  engine.processBlock(buffer, midi);
+
+  // Part way from the centre after one block, like any other gesture
+  // playing GestureStream::kLatencyMs behind
+  const auto &xy = engine.getSynthEngine().getXY();
+  REQUIRE(xy.x > 0.5f);
+  REQUIRE(xy.x < 0.7f);
+  REQUIRE(xy.y < 0.5f);
+  REQUIRE(xy.y > 0.3f);
+
+  for (int i = 0; i < 5; ++i)
+    engine.processBlock(buffer, midi);
+  REQUIRE(xy.x == 1.0f);
+  REQUIRE(xy.y == 0.0f);
+}
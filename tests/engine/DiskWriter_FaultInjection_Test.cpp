@@ -0,0 +1,149 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/DiskWriter.h"
+#include "../../src/engine/SimulatedDisk.h"
+#include <chrono>
+#include <thread>
+
+using namespace flowzone;
+
+namespace {
+juce::File makeTestDir(const juce::String &name) {
+  auto dir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                 .getChildFile("FlowZoneFaultTests")
+                 .getChildFile(name);
+  dir.deleteRecursively();
+  dir.createDirectory();
+  return dir;
+}
+
+void attach(DiskWriter &writer, SimulatedDisk &disk) {
+  writer.setStreamFactory(
+      [&disk](const juce::File &file) { return disk.createStream(file); });
+}
+
+bool waitForTier(DiskWriter &writer, DiskWriter::Tier tier, int timeoutMs) {
+  for (int waited = 0; waited < timeoutMs; waited += 10) {
+    if (writer.getTierStatus().currentTier == tier)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+} // namespace
+
+TEST_CASE("DiskWriter: Stalled disk overflows then recovers to Tier 1",
+          "[DiskWriter][FaultInjection]") {
+  auto dir = makeTestDir("stall");
+  SimulatedDisk disk;
+
+  DiskWriter writer;
+  writer.setBudgets(22050, 64 * 1024 * 1024); // 0.5s ring buffer
+  writer.prepareToPlay(44100.0, 512);
+  attach(writer, disk);
+
+  REQUIRE(writer.startRecording(dir.getChildFile("stall.wav")));
+
+  disk.setStalled(true);
+
+  juce::AudioBuffer<float> buffer(2, 512);
+  buffer.clear();
+
+  // ~1.2s of audio against a hung disk: ring fills, RAM blocks take over
+  for (int i = 0; i < 100; ++i)
+    writer.writeBlock(buffer);
+
+  REQUIRE(writer.getTierStatus().currentTier == DiskWriter::Tier::Overflow);
+
+  disk.setStalled(false);
+  writer.writeBlock(buffer); // Wake the disk thread
+
+  REQUIRE(waitForTier(writer, DiskWriter::Tier::Normal, 2000));
+
+  auto stats = writer.getStats();
+  REQUIRE(stats.maxFillPercent > 80.0f);
+  REQUIRE(stats.peakOverflowBytes > 0);
+  REQUIRE(stats.excursions >= 1);
+  REQUIRE(stats.lastRecoveryMs > 0.0);
+  REQUIRE(stats.writeFailures == 0);
+
+  writer.stopRecording();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+  // 101 blocks of 2ch 24-bit made it through the simulated device
+  REQUIRE(disk.getStats().bytesWritten >= 101 * 512 * 2 * 3);
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("DiskWriter: Bandwidth cap below the audio rate escalates tiers",
+          "[DiskWriter][FaultInjection]") {
+  auto dir = makeTestDir("slow");
+
+  // Stereo 24-bit at 44.1kHz needs ~265KB/s; give it a quarter of that
+  SimulatedDisk::Profile profile;
+  profile.bytesPerSecond = 64.0 * 1024.0;
+  profile.timeScale = 10.0; // 1s of simulated disk time per 100ms
+  SimulatedDisk disk(profile);
+
+  DiskWriter writer;
+  writer.setBudgets(22050, 64 * 1024 * 1024);
+  writer.prepareToPlay(44100.0, 512);
+  attach(writer, disk);
+
+  REQUIRE(writer.startRecording(dir.getChildFile("slow.wav")));
+
+  juce::AudioBuffer<float> buffer(2, 512);
+  buffer.clear();
+
+  // Feed at 10x real time to match the disk's time scale
+  for (int i = 0; i < 400; ++i) {
+    writer.writeBlock(buffer);
+    if (i % 8 == 7)
+      std::this_thread::sleep_for(std::chrono::milliseconds(9));
+  }
+
+  auto stats = writer.getStats();
+  REQUIRE(stats.maxFillPercent > 80.0f);
+  REQUIRE(stats.excursions >= 1);
+
+  writer.stopRecording();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  dir.deleteRecursively();
+}
+
+TEST_CASE("DiskWriter: ENOSPC goes critical and stops recording",
+          "[DiskWriter][FaultInjection]") {
+  auto dir = makeTestDir("enospc");
+
+  SimulatedDisk::Profile profile;
+  profile.capacityBytes = 64 * 1024;
+  SimulatedDisk disk(profile);
+
+  DiskWriter writer;
+  writer.prepareToPlay(44100.0, 512);
+  attach(writer, disk);
+
+  bool criticalSeen = false;
+  REQUIRE(writer.startRecording(dir.getChildFile("full.wav")));
+
+  juce::AudioBuffer<float> buffer(2, 512);
+  buffer.clear();
+
+  for (int i = 0; i < 200 && writer.isRecording(); ++i) {
+    writer.writeBlock(buffer);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    criticalSeen |= writer.getTierStatus().currentTier ==
+                    DiskWriter::Tier::Critical;
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  criticalSeen |=
+      writer.getTierStatus().currentTier == DiskWriter::Tier::Critical;
+
+  REQUIRE(criticalSeen);
+  REQUIRE_FALSE(writer.isRecording());
+  REQUIRE(writer.getStats().writeFailures >= 1);
+  REQUIRE(disk.getStats().failedWrites >= 1);
+
+  dir.deleteRecursively();
+}
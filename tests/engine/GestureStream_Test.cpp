@@ -0,0 +1,102 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/GestureStream.h"
+#include <vector>
+
+using flowzone::GestureStream;
+
+namespace {
+constexpr double kRate = 48000.0;
+constexpr int64_t kLatency =
+    (int64_t)(GestureStream::kLatencyMs * kRate / 1000.0); // 2400 samples
+} // namespace
+
+TEST_CASE("Gestures ramp between points per sample", "[GestureStream]") {
+  GestureStream gesture;
+  gesture.prepare(kRate);
+  REQUIRE_FALSE(gesture.isActive());
+
+  // Client clock: 1000 ms, then 10 ms later. Engine block starts at 0.
+  gesture.add(0, 1000.0, 1.0f, 0.0f);
+  gesture.add(0, 1010.0, 0.0f, 0.0f);
+  REQUIRE(gesture.isActive());
+
+  std::vector<float> out((size_t)kLatency + 480 + 64);
+  REQUIRE(gesture.render(0, (int)out.size(), out.data()));
+
+  // From the current value (0) up to the first point over the latency...
+  REQUIRE(out[0] == 0.0f);
+  REQUIRE(out[(size_t)kLatency / 2] == Approx(0.5f).margin(1e-3));
+  REQUIRE(out[(size_t)kLatency] == 1.0f);
+  // ...then down to the second 10 ms (480 samples) later, and held there
+  REQUIRE(out[(size_t)kLatency + 240] == Approx(0.5f).margin(1e-3));
+  REQUIRE(out[(size_t)kLatency + 480] == 0.0f);
+  REQUIRE(out.back() == 0.0f);
+
+  for (size_t i = 1; i <= (size_t)kLatency; ++i)
+    REQUIRE(out[i] >= out[i - 1]);
+
+  REQUIRE_FALSE(gesture.isActive());
+  REQUIRE(gesture.getValue() == 0.0f);
+  REQUIRE_FALSE(gesture.render((int64_t)out.size(), 64, out.data()));
+}
+
+TEST_CASE("Gestures continue across blocks and messages", "[GestureStream]") {
+  GestureStream gesture;
+  gesture.prepare(kRate);
+
+  gesture.add(0, 0.0, 0.2f, 0.2f);
+  gesture.add(0, 20.0, 0.4f, 0.2f);
+
+  // Rendering block by block matches one long render
+  std::vector<float> blocks(4096), whole(4096);
+  for (int start = 0; start < 4096; start += 256) {
+    if (start == 2048) // Next message arrives mid-gesture
+      gesture.add(start, 40.0, 0.8f, 0.0f);
+    gesture.render(start, 256, blocks.data() + start);
+  }
+
+  GestureStream reference;
+  reference.prepare(kRate);
+  reference.add(0, 0.0, 0.2f, 0.2f);
+  reference.add(0, 20.0, 0.4f, 0.2f);
+  reference.add(0, 40.0, 0.8f, 0.0f);
+  reference.render(0, 4096, whole.data());
+
+  for (size_t i = 0; i < whole.size(); ++i)
+    REQUIRE(blocks[i] == Approx(whole[i]).margin(1e-5));
+  REQUIRE(gesture.isActive()); // 40 ms + latency is past 4096 samples
+}
+
+TEST_CASE("Late messages start a new ramp", "[GestureStream]") {
+  GestureStream gesture;
+  gesture.prepare(kRate);
+  std::vector<float> out(4096);
+
+  gesture.add(0, 0.0, 1.0f, 0.0f);
+  gesture.render(0, 4096, out.data());
+  REQUIRE_FALSE(gesture.isActive()); // Ran out of points: holds 1.0
+  REQUIRE(gesture.getValue() == 1.0f);
+
+  // The next message is long overdue: it ramps from where the control is
+  gesture.add(4096, 500.0, 0.5f, gesture.getValue());
+  gesture.render(4096, (int)kLatency + 1, out.data());
+  REQUIRE(out[0] == 1.0f);
+  REQUIRE(out[(size_t)kLatency] == 0.5f);
+
+  // Out of order points don't go back in time
+  gesture.add(8192, 0.0, 0.0f, 0.5f);
+  gesture.add(8192, -10.0, 1.0f, 0.5f);
+  gesture.render(8192, (int)kLatency + 1, out.data());
+  REQUIRE(out[(size_t)kLatency] == 1.0f);
+
+  gesture.add(16384, 0.0, 1.0f, 0.5f);
+  gesture.cancel();
+  REQUIRE_FALSE(gesture.render(16384, 512, out.data()));
+
+  // A stream that isn't rendered for a while keeps its newest points
+  for (int i = 0; i < GestureStream::kMaxPoints + 10; ++i)
+    gesture.add(20480, (double)i, (float)i, 0.0f);
+  std::vector<float> tail(9216);
+  gesture.render(20480, (int)tail.size(), tail.data());
+  REQUIRE(tail.back() == (float)(GestureStream::kMaxPoints + 9));
+}
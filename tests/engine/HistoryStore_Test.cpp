@@ -0,0 +1,125 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/session/HistoryStore.h"
+#include "../../src/engine/session/SessionStateManager.h"
+#include "../../src/engine/state/StreamingJson.h"
+#include <JuceHeader.h>
+
+using namespace flowzone;
+
+namespace {
+RiffHistoryEntry makeRiff(int i) {
+  return {"riff-" + juce::String(i), 1700000000000 + i,
+          "Riff " + juce::String(i), 1 + i % 8, {"#ff0000"}, "local"};
+}
+} // namespace
+
+TEST_CASE("HistoryStore pages newest first", "[HistoryStore]") {
+  HistoryStore store;
+  for (int i = 0; i < 120; ++i)
+    store.addRiff(makeRiff(i));
+
+  auto first = store.getRiffs(0, 50);
+  REQUIRE(first.total == 120);
+  REQUIRE(first.version == 120);
+  REQUIRE(first.items.size() == 50);
+  REQUIRE(first.items.front().id == "riff-119");
+  REQUIRE(first.items.back().id == "riff-70");
+
+  auto last = store.getRiffs(100, 50);
+  REQUIRE(last.offset == 100);
+  REQUIRE(last.items.size() == 20);
+  REQUIRE(last.items.back().id == "riff-0");
+
+  SECTION("Out of range requests are clamped") {
+    REQUIRE(store.getRiffs(500, 10).items.empty());
+    REQUIRE(store.getRiffs(-5, 1).items.front().id == "riff-119");
+    REQUIRE(store.getRiffs(0, 0).items.size() ==
+            (size_t)HistoryStore::kDefaultPageSize);
+    REQUIRE(store.getRiffs(0, 100000).items.size() == 120);
+  }
+
+  SECTION("Lookup by id") {
+    RiffHistoryEntry found;
+    REQUIRE(store.findRiff("riff-42", found));
+    REQUIRE(found.name == "Riff 42");
+    REQUIRE_FALSE(store.findRiff("riff-missing", found));
+  }
+
+  SECTION("Library summary") {
+    auto library = store.getLibrary();
+    REQUIRE(library.riffCount == 120);
+    REQUIRE(library.riffsVersion == 120);
+    REQUIRE(library.latestRiff.id == "riff-119");
+    REQUIRE(library.sessionCount == 0);
+  }
+}
+
+TEST_CASE("HistoryStore sessions", "[HistoryStore]") {
+  HistoryStore store;
+  store.addSession({"a", "Jam A", "", 1});
+  store.addSession({"b", "Jam B", "", 2});
+  store.addSession({"c", "Jam C", "", 3});
+
+  // Same id replaces the entry in place
+  store.addSession({"b", "Renamed", "", 2});
+  auto page = store.getSessions(0, 10);
+  REQUIRE(page.total == 3);
+  REQUIRE(page.version == 4);
+  REQUIRE(page.items[1].name == "Renamed");
+
+  REQUIRE(store.removeSession("a"));
+  REQUIRE_FALSE(store.removeSession("a"));
+
+  HistoryStore::Session found;
+  REQUIRE(store.findSession("c", found));
+  REQUIRE(found.name == "Jam C");
+  REQUIRE(store.getSessions(0, 10).items.back().id == "b");
+}
+
+TEST_CASE("Broadcast state stays the same size as riffs accumulate",
+          "[HistoryStore][SessionStateManager]") {
+  SessionStateManager manager;
+  AppState state;
+  state.session = {"s1", "Long Jam", "", 1700000000000};
+  state.slots.resize(8);
+  manager.startSession(state);
+
+  auto snapshotBytes = [&] {
+    std::string json;
+    JsonWriter writer(json);
+    manager.getCurrentState().writeJson(writer);
+    return json.size();
+  };
+
+  manager.commitRiff("Riff", 4, {"#ff0000", "#00ff00"}, "local");
+  auto afterOne = snapshotBytes();
+
+  for (int i = 0; i < 999; ++i)
+    manager.commitRiff("Riff", 4, {"#ff0000", "#00ff00"}, "local");
+  auto afterThousand = snapshotBytes();
+
+  REQUIRE(manager.getCurrentState().library.riffCount == 1000);
+  REQUIRE(manager.getCurrentState().library.sessionCount == 1);
+
+  // Only the digits of the counters grow
+  REQUIRE(afterThousand <= afterOne + 8);
+
+  SECTION("Starting a new jam keeps the jam list and clears the riffs") {
+    AppState next;
+    next.session = {"s2", "Next Jam", "", 1700000001000};
+    manager.startSession(next);
+
+    auto library = manager.getCurrentState().library;
+    REQUIRE(library.sessionCount == 2);
+    REQUIRE(library.riffCount == 0);
+    REQUIRE(library.latestRiff.id.isEmpty());
+    REQUIRE(manager.getHistory().getSessions(0, 1).items[0].id == "s2");
+  }
+
+  SECTION("setState() doesn't overwrite the library") {
+    AppState stale;
+    stale.session = state.session;
+    manager.setState(stale);
+    REQUIRE(manager.getCurrentState().library.riffCount == 1000);
+  }
+}
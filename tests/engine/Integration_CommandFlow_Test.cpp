@@ -286,3 +286,30 @@ TEST_CASE("End-to-End Command Flow Integration", "[Integration][CommandFlow]") {
     REQUIRE(popCount.load() == 200);
   }
 }
+
+TEST_CASE("Drum kit changes from the command path",
+          "[Integration][CommandFlow]") {
+  FlowEngine engine;
+  engine.prepareToPlay(44100.0, 512);
+
+  // setKit() runs inside processBlock, i.e. on the audio thread, most
+  // likely while the kit prepareToPlay asked for is still rendering
+  juce::AudioBuffer<float> buffer(2, 512);
+  juce::MidiBuffer midi;
+  for (int i = 0; i < 20; ++i) {
+    engine.getCommandQueue().push(
+        i % 2 == 0 ? juce::String(R"({"cmd":"SET_MODE","category":"drums"})")
+                   : juce::String(R"({"cmd":"SET_PRESET","category":"drums",)"
+                                  R"("preset":"Synthetic"})"));
+    buffer.clear();
+    engine.processBlock(buffer, midi);
+  }
+  REQUIRE(engine.getSessionManager().getCurrentState().activeMode.category ==
+          "drums");
+
+  auto deadline = juce::Time::getMillisecondCounter() + 5000;
+  while (!engine.getDrumEngine().isKitCached() &&
+         juce::Time::getMillisecondCounter() < deadline)
+    juce::Thread::sleep(5);
+  REQUIRE(engine.getDrumEngine().isKitCached());
+}
@@ -0,0 +1,88 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/Metrics.h"
+#include "../../src/engine/server/ClientSendQueue.h"
+#include <JuceHeader.h>
+#include <thread>
+#include <vector>
+
+using flowzone::Metrics;
+
+TEST_CASE("Counters and gauges update atomically", "[Metrics]") {
+  auto &metrics = Metrics::instance();
+  metrics.reset();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&metrics] {
+      for (int i = 0; i < 10000; ++i) {
+        metrics.add(Metrics::Counter::WsMessagesSent);
+        metrics.adjust(Metrics::Gauge::WsQueuedBytes, 2.0);
+        metrics.adjust(Metrics::Gauge::WsQueuedBytes, -1.0);
+      }
+    });
+  for (auto &thread : threads)
+    thread.join();
+
+  REQUIRE(metrics.get(Metrics::Counter::WsMessagesSent) == 40000);
+  REQUIRE(metrics.get(Metrics::Gauge::WsQueuedBytes) == 40000.0);
+
+  metrics.setTotal(Metrics::Counter::AudioXruns, 7);
+  metrics.set(Metrics::Gauge::DiskTier, 2.0);
+  REQUIRE(metrics.get(Metrics::Counter::AudioXruns) == 7);
+  REQUIRE(metrics.get(Metrics::Gauge::DiskTier) == 2.0);
+}
+
+TEST_CASE("Prometheus exposition lists every metric", "[Metrics]") {
+  auto &metrics = Metrics::instance();
+  metrics.reset();
+  metrics.setTotal(Metrics::Counter::AudioXruns, 3);
+  metrics.set(Metrics::Gauge::WsClients, 2.0);
+
+  std::string text = metrics.toPrometheus();
+  REQUIRE(text.find("# TYPE flowzone_audio_xruns_total counter\n"
+                    "flowzone_audio_xruns_total 3\n") != std::string::npos);
+  REQUIRE(text.find("# TYPE flowzone_ws_clients gauge\n"
+                    "flowzone_ws_clients 2\n") != std::string::npos);
+  REQUIRE(text.find("flowzone_uptime_seconds ") != std::string::npos);
+  REQUIRE(text.back() == '\n');
+}
+
+TEST_CASE("Health document has the Spec 5.4 fields", "[Metrics]") {
+  auto &metrics = Metrics::instance();
+  metrics.reset();
+  metrics.set(Metrics::Gauge::AudioCallbackLoad, 0.25);
+  metrics.set(Metrics::Gauge::DiskBufferFill, 0.5);
+  metrics.set(Metrics::Gauge::ActivePluginHosts, 3.0);
+  metrics.set(Metrics::Gauge::SafeMode, 1.0);
+
+  auto health =
+      juce::JSON::parse(juce::String(metrics.toHealthJson("1.6.0", 1)));
+  REQUIRE(health["status"].toString() == "ok");
+  REQUIRE(health.hasProperty("uptime_s"));
+  REQUIRE((double)health["cpu_load"] == 0.25);
+  REQUIRE((double)health["disk_buffer_pct"] == 0.5);
+  REQUIRE((int)health["active_plugin_hosts"] == 3);
+  REQUIRE((bool)health["safe_mode"]);
+  REQUIRE(health["version"].toString() == "1.6.0");
+  REQUIRE((int)health["protocol_version"] == 1);
+}
+
+TEST_CASE("Send queues return their queued gauges to zero", "[Metrics]") {
+  auto &metrics = Metrics::instance();
+  metrics.reset();
+
+  {
+    // Never started, so everything pushed stays queued until stop()
+    ClientSendQueue queue([](const OutgoingMessage &) { return true; },
+                          nullptr);
+    queue.push(
+        OutgoingMessage::make(OutgoingMessage::Kind::Event, false, "abc"));
+    queue.push(
+        OutgoingMessage::make(OutgoingMessage::Kind::Event, false, "de"));
+    REQUIRE(metrics.get(Metrics::Gauge::WsQueuedMessages) == 2.0);
+    REQUIRE(metrics.get(Metrics::Gauge::WsQueuedBytes) == 5.0);
+  }
+
+  REQUIRE(metrics.get(Metrics::Gauge::WsQueuedMessages) == 0.0);
+  REQUIRE(metrics.get(Metrics::Gauge::WsQueuedBytes) == 0.0);
+}
@@ -0,0 +1,246 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/DiskWriter.h"
+#include "../../src/engine/RecordingJournal.h"
+#include <chrono>
+#include <thread>
+
+using namespace flowzone;
+
+namespace {
+juce::File makeTestDir(const juce::String &name) {
+  auto dir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                 .getChildFile("FlowZoneJournalTests")
+                 .getChildFile(name);
+  dir.deleteRecursively();
+  dir.createDirectory();
+  return dir;
+}
+
+juce::int64 lengthOf(const juce::File &file) {
+  juce::WavAudioFormat wav;
+  std::unique_ptr<juce::AudioFormatReader> reader(
+      wav.createReaderFor(new juce::FileInputStream(file), true));
+  return reader ? reader->lengthInSamples : -1;
+}
+
+void writeSegment(RecordingJournal &journal, int index, int numSamples) {
+  juce::AudioBuffer<float> buffer(2, numSamples);
+  for (int i = 0; i < numSamples; ++i) {
+    buffer.setSample(0, i, 0.25f);
+    buffer.setSample(1, i, -0.25f);
+  }
+
+  auto writer = journal.createSegmentWriter(index);
+  REQUIRE(writer != nullptr);
+  writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+  writer.reset();
+  REQUIRE(journal.commitSegment(index, numSamples));
+}
+} // namespace
+
+TEST_CASE("RecordingJournal: Clean finalise stitches segments",
+          "[DiskWriter][Journal]") {
+  auto dir = makeTestDir("clean");
+  auto target = dir.getChildFile("take.wav");
+
+  RecordingJournal journal;
+  REQUIRE(journal.begin(target, 44100.0, 2, 24));
+
+  writeSegment(journal, 0, 4410);
+  writeSegment(journal, 1, 4410);
+  writeSegment(journal, 2, 1000);
+
+  REQUIRE(journal.finalise().wasOk());
+  REQUIRE(target.existsAsFile());
+  REQUIRE(lengthOf(target) == 4410 + 4410 + 1000);
+  REQUIRE_FALSE(RecordingJournal::getSegmentDirectoryFor(target).exists());
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("RecordingJournal: Crash recovery loses only the open segment",
+          "[DiskWriter][Journal]") {
+  auto dir = makeTestDir("crash");
+  auto target = dir.getChildFile("session_1").getChildFile("take.wav");
+  target.getParentDirectory().createDirectory();
+
+  {
+    RecordingJournal journal;
+    REQUIRE(journal.begin(target, 48000.0, 2, 24));
+    writeSegment(journal, 0, 48000);
+    writeSegment(journal, 1, 48000);
+
+    // Segment 2 is open when the process dies: header never fixed up and
+    // no journal entry
+    auto openSegment = journal.getSegmentFile(2);
+    openSegment.replaceWithText("RIFF garbage");
+    // Journal goes out of scope without finalise()
+  }
+
+  REQUIRE_FALSE(target.existsAsFile());
+
+  auto recovered = RecordingJournal::recoverInterrupted(dir);
+  REQUIRE(recovered.size() == 1);
+  REQUIRE(recovered[0] == target);
+  REQUIRE(lengthOf(target) == 96000);
+  REQUIRE_FALSE(RecordingJournal::getSegmentDirectoryFor(target).exists());
+
+  // Second pass finds nothing left to do
+  REQUIRE(RecordingJournal::recoverInterrupted(dir).isEmpty());
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("RecordingJournal: Recovery replaces a take cut off mid-stitch",
+          "[DiskWriter][Journal]") {
+  auto dir = makeTestDir("midstitch");
+  auto target = dir.getChildFile("take.wav");
+
+  {
+    RecordingJournal journal;
+    REQUIRE(journal.begin(target, 48000.0, 2, 24));
+    writeSegment(journal, 0, 48000);
+    writeSegment(journal, 1, 2000);
+  }
+
+  // What a crash while stitching leaves: a partial temp file, and whatever
+  // was at the target before
+  target.getSiblingFile("take.wav.stitching").replaceWithText("RIFF");
+  target.replaceWithText("RIFF truncated");
+
+  auto recovered = RecordingJournal::recoverInterrupted(dir);
+  REQUIRE(recovered.size() == 1);
+  REQUIRE(recovered[0] == target);
+  REQUIRE(lengthOf(target) == 50000);
+  REQUIRE_FALSE(target.getSiblingFile("take.wav.stitching").exists());
+  REQUIRE(dir.getNumberOfChildFiles(juce::File::findFiles) == 1);
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("RecordingJournal: Stitching goes through the stream factory",
+          "[DiskWriter][Journal]") {
+  auto dir = makeTestDir("factory");
+  auto target = dir.getChildFile("take.wav");
+
+  juce::StringArray opened;
+  RecordingJournal journal;
+  journal.setStreamFactory([&opened](const juce::File &file) {
+    opened.add(file.getFileName());
+    return std::unique_ptr<juce::OutputStream>(
+        std::make_unique<juce::FileOutputStream>(file));
+  });
+  REQUIRE(journal.begin(target, 44100.0, 2, 24));
+  writeSegment(journal, 0, 1000);
+
+  REQUIRE(journal.finalise().wasOk());
+  REQUIRE(opened.contains("take.wav.stitching"));
+  REQUIRE(lengthOf(target) == 1000);
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("DiskWriter: Stop produces a single stitched file",
+          "[DiskWriter][Journal]") {
+  auto dir = makeTestDir("diskwriter");
+  auto target = dir.getChildFile("recording.wav");
+
+  DiskWriter writer;
+  writer.prepareToPlay(44100.0, 512);
+  REQUIRE(writer.startRecording(target));
+
+  juce::AudioBuffer<float> buffer(2, 512);
+  buffer.clear();
+
+  // ~2.4s of audio, written with some pacing so the ring buffer drains
+  for (int i = 0; i < 200; ++i) {
+    writer.writeBlock(buffer);
+    if (i % 20 == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  writer.stopRecording();
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  REQUIRE(target.existsAsFile());
+  REQUIRE(lengthOf(target) == 200 * 512);
+  REQUIRE_FALSE(RecordingJournal::getSegmentDirectoryFor(target).exists());
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("DiskWriter: A new take starts while the last one stitches",
+          "[DiskWriter][Journal]") {
+  auto dir = makeTestDir("overlap");
+  auto first = dir.getChildFile("first.wav");
+  auto second = dir.getChildFile("second.wav");
+
+  // Holds the first take's stitch until released
+  juce::WaitableEvent release;
+  DiskWriter writer;
+  writer.setStreamFactory([&](const juce::File &file) {
+    if (file.getFileName() == "first.wav.stitching")
+      release.wait(5000);
+    return std::unique_ptr<juce::OutputStream>(
+        std::make_unique<juce::FileOutputStream>(file));
+  });
+  writer.prepareToPlay(44100.0, 512);
+
+  juce::AudioBuffer<float> buffer(2, 512);
+  buffer.clear();
+
+  REQUIRE(writer.startRecording(first));
+  for (int i = 0; i < 20; ++i)
+    writer.writeBlock(buffer);
+
+  auto started = juce::Time::getMillisecondCounterHiRes();
+  REQUIRE(writer.startRecording(second));
+  CHECK(juce::Time::getMillisecondCounterHiRes() - started < 1000.0);
+  CHECK_FALSE(first.existsAsFile());
+
+  release.signal();
+  writer.stopRecording();
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  REQUIRE(lengthOf(first) == 20 * 512);
+  REQUIRE(second.existsAsFile());
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("DiskWriter: Quitting mid-take keeps the tail for recovery",
+          "[DiskWriter][Journal]") {
+  auto dir = makeTestDir("quit");
+  auto target = dir.getChildFile("take.wav");
+
+  juce::AudioBuffer<float> buffer(2, 512);
+  buffer.clear();
+
+  auto started = juce::Time::getMillisecondCounterHiRes();
+  {
+    // A stitch slower than the writer waits for on quit
+    juce::WaitableEvent neverSignalled;
+    DiskWriter writer;
+    writer.setStreamFactory([&](const juce::File &file) {
+      if (file.getFileName() == "take.wav.stitching")
+        neverSignalled.wait(2500);
+      return std::unique_ptr<juce::OutputStream>(
+          std::make_unique<juce::FileOutputStream>(file));
+    });
+    writer.prepareToPlay(44100.0, 512);
+    REQUIRE(writer.startRecording(target));
+
+    // Still buffered when the writer goes away
+    for (int i = 0; i < 20; ++i)
+      writer.writeBlock(buffer);
+  }
+  CHECK(juce::Time::getMillisecondCounterHiRes() - started < 4000.0);
+
+  // The stitch was abandoned, not finished; the journal has every block
+  REQUIRE_FALSE(target.existsAsFile());
+  REQUIRE(RecordingJournal::getSegmentDirectoryFor(target).isDirectory());
+  REQUIRE(RecordingJournal::recoverInterrupted(dir).size() == 1);
+  REQUIRE(lengthOf(target) == 20 * 512);
+
+  dir.deleteRecursively();
+}
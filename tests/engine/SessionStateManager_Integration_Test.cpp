@@ -102,9 +102,12 @@ TEST_CASE("SessionStateManager Integration", "[SessionStateManager][Integration]
     REQUIRE(result.wasOk());
     
     auto currentState = manager.getCurrentState();
-    REQUIRE(currentState.riffHistory.size() == 1);
+    REQUIRE(currentState.library.riffCount == 1);
     
-    auto &riff = currentState.riffHistory[0];
+    auto page = manager.getHistory().getRiffs(0, 10);
+    REQUIRE(page.items.size() == 1);
+    auto &riff = page.items[0];
+    REQUIRE(currentState.library.latestRiff == riff);
     REQUIRE(riff.name == "My First Riff");
     REQUIRE(riff.layers == 3);
     REQUIRE(riff.colors.size() == 3);
@@ -124,9 +127,14 @@ TEST_CASE("SessionStateManager Integration", "[SessionStateManager][Integration]
     manager.commitRiff("Riff 2", 2, colors2, "user_2");
     
     auto state = manager.getCurrentState();
-    REQUIRE(state.riffHistory.size() == 2);
-    REQUIRE(state.riffHistory[0].name == "Riff 1");
-    REQUIRE(state.riffHistory[1].name == "Riff 2");
+    REQUIRE(state.library.riffCount == 2);
+    REQUIRE(state.library.latestRiff.name == "Riff 2");
+
+    // Pages are newest first
+    auto page = manager.getHistory().getRiffs(0, 10);
+    REQUIRE(page.items.size() == 2);
+    REQUIRE(page.items[0].name == "Riff 2");
+    REQUIRE(page.items[1].name == "Riff 1");
   }
   
   SECTION("LOAD_RIFF finds riff in history") {
@@ -136,7 +144,7 @@ TEST_CASE("SessionStateManager Integration", "[SessionStateManager][Integration]
     manager.commitRiff("Test Riff", 1, colors, "user_1");
     
     auto state = manager.getCurrentState();
-    juce::String riffId = state.riffHistory[0].id;
+    juce::String riffId = state.library.latestRiff.id;
     
     auto result = manager.loadRiff(riffId);
     REQUIRE(result.wasOk());
@@ -221,6 +229,9 @@ TEST_CASE("SessionStateManager Integration", "[SessionStateManager][Integration]
     slot.volume = 0.8f;
     slot.state = "PLAYING";
     original.slots.push_back(slot);
+
+    // The riff history is saved alongside, from the history store
+    manager.commitRiff("Saved Riff", 2, {"#FF0000"}, "user_1");
     
     auto sessionFile = tempDir.getChildFile("roundtrip.flow");
     
@@ -240,6 +251,13 @@ TEST_CASE("SessionStateManager Integration", "[SessionStateManager][Integration]
     REQUIRE(loaded.slots.size() == 1);
     REQUIRE(loaded.slots[0].id == "slot_0");
     REQUIRE(loaded.slots[0].volume == 0.8f);
+
+    SessionStateManager fresh;
+    AppState reloaded;
+    REQUIRE(fresh.loadSession(sessionFile, reloaded).wasOk());
+    REQUIRE(reloaded.library.riffCount == 1);
+    REQUIRE(reloaded.library.latestRiff.name == "Saved Riff");
+    REQUIRE(fresh.getHistory().getRiffs(0, 10).items.size() == 1);
     
     sessionFile.deleteFile();
   }
@@ -19,6 +19,18 @@
 
 using namespace flowzone;
 
+namespace {
+// diffStates() writes its ops out already encoded; parse the JSON back
+juce::var diff(const AppState &from, const AppState &to, bool &withinBudget) {
+  StateBroadcaster::PatchOps patch;
+  withinBudget = StateBroadcaster::diffStates(from, to, patch);
+  auto ops = juce::JSON::parse(
+      juce::String::fromUTF8(patch.json.data(), (int)patch.json.size()));
+  REQUIRE(ops.size() == (int)patch.numOps);
+  return ops;
+}
+} // namespace
+
 TEST_CASE("StateBroadcaster RFC 6902 Patches", "[StateBroadcaster][Protocol]") {
   
   SECTION("Sends full snapshot on first broadcast") {
@@ -164,18 +176,13 @@ TEST_CASE("StateBroadcaster RFC 6902 Patches", "[StateBroadcaster][Protocol]") {
     });
     
     AppState state1;
-    RiffHistoryEntry riff1;
-    riff1.id = "riff_1";
-    riff1.name = "First Riff";
-    state1.riffHistory.push_back(riff1);
+    state1.slots.resize(1);
     broadcaster.broadcastFullState(state1);
     
-    // Add another riff
+    // Add another slot
     AppState state2 = state1;
-    RiffHistoryEntry riff2;
-    riff2.id = "riff_2";
-    riff2.name = "Second Riff";
-    state2.riffHistory.push_back(riff2);
+    state2.slots.push_back({});
+    state2.slots.back().id = "slot_2";
     broadcaster.broadcastStateUpdate(state2);
     
     auto msgVar = juce::JSON::parse(lastMessage);
@@ -183,11 +190,11 @@ TEST_CASE("StateBroadcaster RFC 6902 Patches", "[StateBroadcaster][Protocol]") {
     
     auto ops = msgVar["ops"];
     REQUIRE(ops.isArray());
-    // Should have add operation for the new riff
+    // Should have add operation for the new slot
     bool hasAddOp = false;
     for (int i = 0; i < ops.size(); ++i) {
       if (ops[i]["op"].toString() == "add" && 
-          ops[i]["path"].toString().contains("riffHistory")) {
+          ops[i]["path"].toString() == "/slots/-") {
         hasAddOp = true;
         break;
       }
@@ -278,3 +285,220 @@ TEST_CASE("StateBroadcaster RFC 6902 Patches", "[StateBroadcaster][Protocol]") {
     }
   }
 }
+
+TEST_CASE("StateBroadcaster typed diff", "[StateBroadcaster][Protocol]") {
+
+  SECTION("Primitive array update is a single array replace") {
+    AppState state1;
+    state1.activeMode.selectedSourceSlots = {0, 1};
+
+    AppState state2 = state1;
+    state2.activeMode.selectedSourceSlots = {0, 2, 3};
+
+    bool withinBudget = false;
+    auto ops = diff(state1, state2, withinBudget);
+    REQUIRE(withinBudget);
+    REQUIRE(ops.size() == 1);
+    REQUIRE(ops[0]["op"].toString() == "replace");
+    REQUIRE(ops[0]["path"].toString() == "/activeMode/selectedSourceSlots");
+    REQUIRE(ops[0]["value"].size() == 3);
+  }
+
+  SECTION("Collection growth, shrinkage and optional fields") {
+    AppState state1;
+    state1.slots.resize(3);
+
+    AppState state2 = state1;
+    state2.slots[1].lastError = 3;
+    state2.slots.pop_back();
+
+    bool withinBudget = false;
+    auto ops = diff(state1, state2, withinBudget);
+    REQUIRE(withinBudget);
+    REQUIRE(ops.size() == 2);
+    REQUIRE(ops[0]["op"].toString() == "add");
+    REQUIRE(ops[0]["path"].toString() == "/slots/1/lastError");
+    REQUIRE(ops[1]["op"].toString() == "remove");
+    REQUIRE(ops[1]["path"].toString() == "/slots/2");
+
+    AppState state3 = state2;
+    state3.slots[1].lastError = 0;
+    ops = diff(state2, state3, withinBudget);
+    REQUIRE(withinBudget);
+    REQUIRE(ops.size() == 1);
+    REQUIRE(ops[0]["op"].toString() == "remove");
+    REQUIRE(ops[0]["path"].toString() == "/slots/1/lastError");
+  }
+
+  SECTION("A committed riff is a few library ops") {
+    AppState state1;
+    state1.library.riffCount = 500;
+    state1.library.riffsVersion = 500;
+    state1.library.latestRiff.id = "riff_500";
+
+    AppState state2 = state1;
+    state2.library.riffCount = 501;
+    state2.library.riffsVersion = 501;
+    state2.library.latestRiff.id = "riff_501";
+    state2.library.latestRiff.name = "Newest";
+
+    bool withinBudget = false;
+    auto ops = diff(state1, state2, withinBudget);
+    REQUIRE(withinBudget);
+    REQUIRE(ops.size() == 3);
+    REQUIRE(ops[0]["path"].toString() == "/library/riffCount");
+    REQUIRE(ops[1]["path"].toString() == "/library/riffsVersion");
+    REQUIRE(ops[2]["path"].toString() == "/library/latestRiff");
+    REQUIRE(ops[2]["value"]["name"].toString() == "Newest");
+  }
+
+  SECTION("Plugin chains are diffed like any other collection") {
+    AppState state1;
+    state1.slots.resize(2);
+    state1.slots[1].pluginChain = {{"p1", "reverb", "", "Reverb", false, ""},
+                                   {"p2", "delay", "", "Delay", false, ""}};
+
+    AppState state2 = state1;
+    state2.slots[1].pluginChain[1].bypass = true;
+    state2.slots[1].pluginChain.push_back(
+        {"p3", "filter", "", "Filter", false, ""});
+
+    bool withinBudget = false;
+    auto ops = diff(state1, state2, withinBudget);
+    REQUIRE(withinBudget);
+    REQUIRE(ops.size() == 2);
+    REQUIRE(ops[0]["path"].toString() == "/slots/1/pluginChain/1/bypass");
+    REQUIRE(static_cast<bool>(ops[0]["value"]));
+    REQUIRE(ops[1]["op"].toString() == "add");
+    REQUIRE(ops[1]["path"].toString() == "/slots/1/pluginChain/-");
+    REQUIRE(ops[1]["value"]["pluginId"].toString() == "filter");
+
+    // A different plugin in the same place is a new entry
+    AppState state3 = state2;
+    state3.slots[1].pluginChain[0] = {"p4", "chorus", "", "Chorus", false, ""};
+    ops = diff(state2, state3, withinBudget);
+    REQUIRE(ops.size() == 1);
+    REQUIRE(ops[0]["path"].toString() == "/slots/1/pluginChain/0");
+    REQUIRE(ops[0]["value"]["name"].toString() == "Chorus");
+  }
+
+  SECTION("Stops early once the op budget is exceeded") {
+    AppState state1;
+    state1.slots.resize(8);
+
+    AppState state2 = state1;
+    for (auto &slot : state2.slots) {
+      slot.volume = 0.5f;
+      slot.muted = true;
+      slot.state = "PLAYING";
+    }
+
+    bool withinBudget = true;
+    auto ops = diff(state1, state2, withinBudget);
+    REQUIRE_FALSE(withinBudget);
+    REQUIRE(ops.size() == StateBroadcaster::MAX_PATCH_OPS + 1);
+  }
+}
+
+TEST_CASE("StateBroadcaster reconnect catch-up",
+          "[StateBroadcaster][Protocol]") {
+  StateBroadcaster broadcaster;
+  broadcaster.setMessageCallback([](const juce::String &) {});
+
+  juce::String reply;
+  auto deliver = [&](const juce::String &msg) { reply = msg; };
+
+  REQUIRE_FALSE(broadcaster.replyToReconnect("", -1, deliver));
+
+  AppState state;
+  state.transport.bpm = 100.0;
+  broadcaster.broadcastStateUpdate(state); // Revision 1: snapshot
+  for (int i = 1; i <= 3; ++i) {          // Revisions 2-4: one op each
+    state.transport.bpm = 100.0 + i;
+    broadcaster.broadcastStateUpdate(state);
+  }
+  REQUIRE(broadcaster.getRevisionId() == 4);
+  const std::string epoch = broadcaster.getEpoch();
+
+  SECTION("Recent revision gets the missed ops as one patch") {
+    REQUIRE(broadcaster.replyToReconnect(epoch, 1, deliver));
+    auto msgVar = juce::JSON::parse(reply);
+    REQUIRE(msgVar["type"].toString() == "STATE_PATCH");
+    REQUIRE(msgVar["epoch"].toString().toStdString() == epoch);
+    REQUIRE(static_cast<juce::int64>(msgVar["revisionId"]) == 4);
+    REQUIRE(static_cast<juce::int64>(msgVar["fromRevisionId"]) == 1);
+    REQUIRE(msgVar["ops"].size() == 3);
+    REQUIRE(static_cast<double>(msgVar["ops"][2]["value"]) == 103.0);
+
+    REQUIRE(broadcaster.replyToReconnect(epoch, 3, deliver));
+    REQUIRE(juce::JSON::parse(reply)["ops"].size() == 1);
+  }
+
+  SECTION("Up-to-date client gets an empty patch") {
+    REQUIRE(broadcaster.replyToReconnect(epoch, 4, deliver));
+    auto msgVar = juce::JSON::parse(reply);
+    REQUIRE(msgVar["type"].toString() == "STATE_PATCH");
+    REQUIRE(msgVar["ops"].size() == 0);
+  }
+
+  SECTION("Fresh, unknown or pre-snapshot revisions get a snapshot") {
+    for (juce::int64 revision : {-1, 0, 99}) {
+      REQUIRE(broadcaster.replyToReconnect(epoch, revision, deliver));
+      auto msgVar = juce::JSON::parse(reply);
+      REQUIRE(msgVar["type"].toString() == "STATE_FULL");
+      REQUIRE(static_cast<juce::int64>(msgVar["revisionId"]) == 4);
+      REQUIRE(static_cast<double>(msgVar["data"]["transport"]["bpm"]) ==
+              103.0);
+    }
+
+    broadcaster.broadcastFullState(state); // Revision 5
+    state.transport.bpm = 120.0;
+    broadcaster.broadcastStateUpdate(state); // Revision 6
+    REQUIRE(broadcaster.replyToReconnect(epoch, 3, deliver));
+    REQUIRE(juce::JSON::parse(reply)["type"].toString() == "STATE_FULL");
+    REQUIRE(broadcaster.replyToReconnect(epoch, 5, deliver));
+    REQUIRE(juce::JSON::parse(reply)["type"].toString() == "STATE_PATCH");
+
+    // The snapshot handed to joining clients follows patches too
+    REQUIRE(broadcaster.replyToReconnect("", -1, deliver));
+    auto msgVar = juce::JSON::parse(reply);
+    REQUIRE(static_cast<juce::int64>(msgVar["revisionId"]) == 6);
+    REQUIRE(static_cast<double>(msgVar["data"]["transport"]["bpm"]) == 120.0);
+  }
+
+  SECTION("A restarted engine's revisions never patch the old state") {
+    // The page still holds revision 2 of the engine above when a new one
+    // starts, and the new one has since passed that number
+    StateBroadcaster restarted;
+    restarted.setMessageCallback([](const juce::String &) {});
+    REQUIRE(restarted.getEpoch() != epoch);
+
+    AppState fresh;
+    for (int i = 0; i < 4; ++i) {
+      fresh.slots.emplace_back();
+      restarted.broadcastStateUpdate(fresh);
+    }
+    REQUIRE(restarted.getRevisionId() == 4);
+
+    REQUIRE(restarted.replyToReconnect(epoch, 2, deliver));
+    auto msgVar = juce::JSON::parse(reply);
+    REQUIRE(msgVar["type"].toString() == "STATE_FULL");
+    REQUIRE(msgVar["epoch"].toString().toStdString() == restarted.getEpoch());
+    REQUIRE(msgVar["data"]["slots"].size() == 4);
+
+    // Its own clients are still caught up
+    REQUIRE(restarted.replyToReconnect(restarted.getEpoch(), 2, deliver));
+    REQUIRE(juce::JSON::parse(reply)["type"].toString() == "STATE_PATCH");
+  }
+
+  SECTION("History is bounded") {
+    for (size_t i = 0; i < StateBroadcaster::HISTORY_MAX_PATCHES; ++i) {
+      state.transport.bpm += 1.0;
+      broadcaster.broadcastStateUpdate(state);
+    }
+    REQUIRE(broadcaster.replyToReconnect(epoch, 1, deliver));
+    REQUIRE(juce::JSON::parse(reply)["type"].toString() == "STATE_FULL");
+    REQUIRE(broadcaster.replyToReconnect(epoch, 4, deliver));
+    REQUIRE(juce::JSON::parse(reply)["type"].toString() == "STATE_PATCH");
+  }
+}
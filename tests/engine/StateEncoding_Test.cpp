@@ -0,0 +1,143 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/state/MsgPack.h"
+#include "../../src/engine/state/StateBroadcaster.h"
+#include "../../src/engine/state/StreamingJson.h"
+#include <JuceHeader.h>
+
+using namespace flowzone;
+
+namespace {
+AppState makeBusyState() {
+  AppState state;
+  state.transport.bpm = 97.5;
+  state.mic.inputLevel = 0.123f;
+  state.activeMode.selectedSourceSlots = {1, 3};
+  state.session = {"s1", "Jam",
+                   juce::String(juce::CharPointer_UTF8("\xf0\x9f\x8e\xb8")),
+                   1700000000000};
+  state.library.sessionCount = 1;
+  state.library.sessionsVersion = 1;
+
+  state.slots.resize(8);
+  for (int i = 0; i < 8; ++i) {
+    state.slots[i].id = "slot-" + juce::String(i);
+    state.slots[i].volume = 0.1f * (float)i;
+    state.slots[i].pluginChain.push_back(
+        {"p" + juce::String(i), "reverb", "FlowZone", "Reverb", i % 2 == 0});
+  }
+  state.slots[2].lastError = 1002;
+
+  state.library.riffCount = 10;
+  state.library.riffsVersion = 10;
+  state.library.latestRiff = {"riff-9", 1700000000009, "Riff 9", 9,
+                              {"#ff0000", "#00ff00"}, "local"};
+  return state;
+}
+
+juce::var decode(const std::string &bytes) {
+  bool ok = false;
+  auto value = MsgPack::decode(bytes.data(), bytes.size(), ok);
+  REQUIRE(ok);
+  return value;
+}
+
+// Property order and number types match, so equal trees print identically.
+// Floats travel as float32 in MessagePack and as their shortest text in
+// JSON, so compare at float precision.
+juce::String canonical(const juce::var &v) {
+  return juce::JSON::toString(v, true, 6);
+}
+} // namespace
+
+TEST_CASE("MsgPack round trips JSON-compatible values", "[MsgPack]") {
+  auto parsed = juce::JSON::parse(
+      R"({"a": [1, -1, -33, 200, 70000, 5000000000, -5000000000],
+          "b": {"nested": true, "off": false, "none": null},
+          "s": "hello", "long": "0123456789012345678901234567890123",
+          "d": 0.25})");
+
+  std::string bytes;
+  MsgPackWriter writer(bytes);
+  writer.writeMapHeader(5);
+  writer.writeString("a");
+  writer.writeArrayHeader(7);
+  for (int64_t value : {int64_t{1}, int64_t{-1}, int64_t{-33}, int64_t{200},
+                        int64_t{70000}, int64_t{5000000000},
+                        int64_t{-5000000000}})
+    writer.writeInt(value);
+  writer.writeString("b");
+  writer.writeMapHeader(3);
+  writer.writeString("nested");
+  writer.writeBool(true);
+  writer.writeString("off");
+  writer.writeBool(false);
+  writer.writeString("none");
+  writer.writeNil();
+  writer.writeString("s");
+  writer.writeString("hello");
+  writer.writeString("long");
+  writer.writeString("0123456789012345678901234567890123");
+  writer.writeString("d");
+  writer.writeDouble(0.25);
+
+  REQUIRE(canonical(decode(bytes)) == canonical(parsed));
+
+  SECTION("Truncated input is rejected") {
+    for (size_t size = 0; size < bytes.size(); ++size) {
+      bool ok = true;
+      MsgPack::decode(bytes.data(), size, ok);
+      REQUIRE_FALSE(ok);
+    }
+  }
+}
+
+TEST_CASE("AppState::writeMsgPack matches writeJson", "[MsgPack]") {
+  auto state = makeBusyState();
+
+  std::string bytes;
+  MsgPackWriter writer(bytes);
+  state.writeMsgPack(writer);
+
+  std::string json;
+  JsonWriter jsonWriter(json);
+  state.writeJson(jsonWriter);
+
+  REQUIRE(canonical(decode(bytes)) ==
+          canonical(juce::JSON::parse(juce::String::fromUTF8(
+              json.data(), (int)json.size()))));
+  REQUIRE(bytes.size() < json.size());
+}
+
+TEST_CASE("StateMessage encodes the same message both ways",
+          "[MsgPack][StateBroadcaster]") {
+  StateBroadcaster broadcaster;
+  std::vector<std::pair<juce::String, std::string>> sent;
+  broadcaster.setStateMessageCallback(
+      [&](StateBroadcaster::StateMessage &message) {
+        sent.emplace_back(message.toJson(), message.toMsgPack());
+      });
+
+  auto state = makeBusyState();
+  broadcaster.broadcastStateUpdate(state);
+  state.transport.bpm = 120.0;
+  state.slots[4].muted = true;
+  broadcaster.broadcastStateUpdate(state);
+  state.slots[2].lastError = 0;
+  broadcaster.broadcastStateUpdate(state);
+
+  REQUIRE(sent.size() == 3);
+  for (const auto &[json, msgPack] : sent)
+    REQUIRE(canonical(decode(msgPack)) == canonical(juce::JSON::parse(json)));
+
+  SECTION("Catch-up patches") {
+    broadcaster.replyToReconnect(
+        broadcaster.getEpoch(), 1, [&](StateBroadcaster::StateMessage &message) {
+          auto fromMsgPack = decode(message.toMsgPack());
+          REQUIRE(canonical(fromMsgPack) ==
+                  canonical(juce::JSON::parse(message.toJson())));
+          REQUIRE(static_cast<juce::int64>(fromMsgPack["fromRevisionId"]) ==
+                  1);
+          REQUIRE(fromMsgPack["ops"].size() == 3);
+        });
+  }
+}
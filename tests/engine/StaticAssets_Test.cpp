@@ -0,0 +1,110 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/server/StaticAssets.h"
+#include <JuceHeader.h>
+
+namespace {
+juce::File makeDist() {
+  auto dist = juce::File::createTempFile("dist");
+  dist.createDirectory();
+  juce::String html;
+  for (int i = 0; i < 50; ++i)
+    html << "<div class=\"pad\">FlowZone</div>\n";
+  dist.getChildFile("index.html").replaceWithText(html);
+  dist.getChildFile("assets").createDirectory();
+  dist.getChildFile("assets/index-abc123.js")
+      .replaceWithText(juce::String::repeatedString("console.log(1);\n", 64));
+  // Already compressed: no variants worth keeping
+  juce::MemoryBlock noise(256);
+  juce::Random random(42);
+  for (size_t i = 0; i < noise.getSize(); ++i)
+    noise[i] = (char)random.nextInt(256);
+  dist.getChildFile("assets/logo-def456.png").replaceWithData(noise.getData(),
+                                                              noise.getSize());
+  return dist;
+}
+
+std::string gunzip(const std::string &data) {
+  juce::MemoryInputStream source(data.data(), data.size(), false);
+  juce::GZIPDecompressorInputStream gzip(
+      &source, false, juce::GZIPDecompressorInputStream::gzipFormat);
+  return gzip.readEntireStreamAsString().toStdString();
+}
+} // namespace
+
+TEST_CASE("Static assets load into memory", "[StaticAssets]") {
+  auto dist = makeDist();
+  StaticAssets assets;
+  REQUIRE(assets.load(dist) == 3);
+  REQUIRE(assets.getTotalBytes() > 0);
+
+  // "/" is index.html; nothing is read from disk after load()
+  dist.deleteRecursively();
+  auto response = assets.respond("/", nullptr, nullptr);
+  REQUIRE(response.status == 200);
+  REQUIRE(response.asset->contentType == "text/html; charset=utf-8");
+  REQUIRE(response.asset->cacheControl == "no-cache");
+  REQUIRE(response.body->find("FlowZone") != std::string::npos);
+
+  REQUIRE(assets.respond("/missing.js", nullptr, nullptr).status == 404);
+  REQUIRE(assets.respond("/../index.html", nullptr, nullptr).status == 404);
+
+  auto script = assets.respond("/assets/index-abc123.js", nullptr, nullptr);
+  REQUIRE(script.asset->cacheControl == "public, max-age=31536000, immutable");
+  REQUIRE(script.asset->contentType == "text/javascript; charset=utf-8");
+}
+
+TEST_CASE("Static assets negotiate the encoding", "[StaticAssets]") {
+  auto dist = makeDist();
+  StaticAssets assets;
+  assets.load(dist);
+
+  auto identity = assets.respond("/index.html", nullptr, nullptr);
+  auto gzip = assets.respond("/index.html", "gzip, deflate, br", nullptr);
+  REQUIRE(gzip.encoding == StaticAssets::Encoding::Gzip); // No .br file
+  REQUIRE(gzip.body->size() < identity.body->size());
+  REQUIRE(gunzip(*gzip.body) == *identity.body);
+  REQUIRE(gzip.etag != identity.etag);
+
+  REQUIRE(assets.respond("/index.html", "gzip;q=0", nullptr).encoding ==
+          StaticAssets::Encoding::Identity);
+  REQUIRE(assets.respond("/index.html", "*", nullptr).encoding ==
+          StaticAssets::Encoding::Gzip);
+
+  // Incompressible content is only ever sent as is
+  REQUIRE(assets.respond("/assets/logo-def456.png", "gzip, br", nullptr)
+              .encoding == StaticAssets::Encoding::Identity);
+
+  // The build's brotli file is preferred when accepted
+  dist.getChildFile("index.html.br").replaceWithText("tiny");
+  assets.load(dist);
+  auto brotli = assets.respond("/index.html", "gzip, br", nullptr);
+  REQUIRE(brotli.encoding == StaticAssets::Encoding::Brotli);
+  REQUIRE(*brotli.body == "tiny");
+  REQUIRE(assets.respond("/index.html", "gzip", nullptr).encoding ==
+          StaticAssets::Encoding::Gzip);
+
+  dist.deleteRecursively();
+}
+
+TEST_CASE("Static assets answer revalidation with 304", "[StaticAssets]") {
+  auto dist = makeDist();
+  StaticAssets assets;
+  assets.load(dist);
+  dist.deleteRecursively();
+
+  auto first = assets.respond("/index.html", "gzip", nullptr);
+  REQUIRE(first.etag.front() == '"');
+  REQUIRE(first.etag.back() == '"');
+
+  auto again = assets.respond("/index.html", "gzip", first.etag.c_str());
+  REQUIRE(again.status == 304);
+  REQUIRE(again.body == nullptr);
+
+  auto weak = "\"other\", W/" + first.etag;
+  REQUIRE(assets.respond("/index.html", "gzip", weak.c_str()).status == 304);
+  REQUIRE(assets.respond("/index.html", "gzip", "*").status == 304);
+
+  // A different encoding is a different representation
+  REQUIRE(assets.respond("/index.html", nullptr, first.etag.c_str()).status ==
+          200);
+}
@@ -0,0 +1,150 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/StorageCompactor.h"
+#include <atomic>
+
+using namespace flowzone;
+
+namespace {
+juce::File makeTestDir(const juce::String &name) {
+  auto dir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                 .getChildFile("FlowZoneCompactorTests")
+                 .getChildFile(name);
+  dir.deleteRecursively();
+  dir.createDirectory();
+  return dir;
+}
+
+// 2s of a decaying sine: compresses well, so level 8 beats level 0 / WAV
+void writeTake(juce::AudioFormat &format, const juce::File &file,
+               int qualityIndex) {
+  const int numSamples = 88200;
+  juce::AudioBuffer<float> buffer(2, numSamples);
+  for (int i = 0; i < numSamples; ++i) {
+    float v = 0.5f * std::sin(0.05f * (float)i) *
+              std::exp(-(float)i / (float)numSamples);
+    buffer.setSample(0, i, v);
+    buffer.setSample(1, i, v * 0.5f);
+  }
+
+  std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(
+      new juce::FileOutputStream(file), 44100.0, 2, 24, {}, qualityIndex));
+  REQUIRE(writer != nullptr);
+  writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+}
+
+juce::int64 lengthOf(const juce::File &file) {
+  juce::AudioFormatManager manager;
+  manager.registerBasicFormats();
+  std::unique_ptr<juce::AudioFormatReader> reader(
+      manager.createReaderFor(file));
+  return reader ? reader->lengthInSamples : -1;
+}
+
+StorageCompactor::Options testOptions() {
+  StorageCompactor::Options options;
+  options.minFileAgeMs = 0;
+  return options;
+}
+} // namespace
+
+TEST_CASE("StorageCompactor: Recompresses level-0 FLAC in place",
+          "[Storage]") {
+  auto dir = makeTestDir("flac");
+  auto take = dir.getChildFile("take.flac");
+
+  juce::FlacAudioFormat flac;
+  writeTake(flac, take, 0);
+  auto originalSize = take.getSize();
+
+  StorageCompactor compactor;
+  compactor.setRoot(dir);
+  compactor.setOptions(testOptions());
+
+  auto result = compactor.compactNow();
+  REQUIRE_FALSE(result.interrupted);
+  REQUIRE(take.existsAsFile());
+  REQUIRE(lengthOf(take) == 88200);
+  REQUIRE(take.getSize() <= originalSize);
+  REQUIRE(result.bytesSaved == originalSize - take.getSize());
+
+  // Manifest stops the same file being processed twice
+  REQUIRE(compactor.compactNow().filesCompacted == 0);
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("StorageCompactor: Transcodes WAV recordings to FLAC",
+          "[Storage]") {
+  auto dir = makeTestDir("wav");
+  auto take = dir.getChildFile("recording.wav");
+
+  juce::WavAudioFormat wav;
+  writeTake(wav, take, 0);
+  auto originalSize = take.getSize();
+
+  StorageCompactor compactor;
+  compactor.setRoot(dir);
+  compactor.setOptions(testOptions());
+
+  auto result = compactor.compactNow();
+  auto flacFile = dir.getChildFile("recording.flac");
+
+  REQUIRE(result.filesCompacted == 1);
+  REQUIRE_FALSE(take.existsAsFile());
+  REQUIRE(flacFile.existsAsFile());
+  REQUIRE(lengthOf(flacFile) == 88200);
+  REQUIRE(result.bytesSaved == originalSize - flacFile.getSize());
+  REQUIRE(compactor.getTotalBytesSaved() == result.bytesSaved);
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("StorageCompactor: Yields immediately when load rises",
+          "[Storage]") {
+  auto dir = makeTestDir("busy");
+  auto take = dir.getChildFile("recording.wav");
+
+  juce::WavAudioFormat wav;
+  writeTake(wav, take, 0);
+  auto originalSize = take.getSize();
+
+  // Idle for the first couple of chunks, then the audio thread gets busy
+  std::atomic<int> polls{0};
+
+  StorageCompactor compactor;
+  compactor.setRoot(dir);
+  auto options = testOptions();
+  options.chunkSamples = 4096;
+  compactor.setOptions(options);
+  compactor.setIdleProbe([&polls] { return ++polls < 3; });
+
+  auto result = compactor.compactNow();
+
+  REQUIRE(result.interrupted);
+  REQUIRE(result.filesCompacted == 0);
+  REQUIRE(take.getSize() == originalSize);
+  REQUIRE_FALSE(dir.getChildFile("recording.flac").exists());
+  REQUIRE(dir.findChildFiles(juce::File::findFiles, false, "*.tmp").isEmpty());
+
+  dir.deleteRecursively();
+}
+
+TEST_CASE("StorageCompactor: Leaves live segment directories alone",
+          "[Storage]") {
+  auto dir = makeTestDir("segments");
+  auto segmentDir = dir.getChildFile("take.wav.segments");
+  segmentDir.createDirectory();
+  auto segment = segmentDir.getChildFile("seg_00000.wav");
+
+  juce::WavAudioFormat wav;
+  writeTake(wav, segment, 0);
+
+  StorageCompactor compactor;
+  compactor.setRoot(dir);
+  compactor.setOptions(testOptions());
+
+  REQUIRE(compactor.compactNow().filesCompacted == 0);
+  REQUIRE(segment.existsAsFile());
+
+  dir.deleteRecursively();
+}
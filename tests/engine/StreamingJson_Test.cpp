@@ -0,0 +1,229 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/CommandDispatcher.h"
+#include "../../src/engine/state/StateSchema.h"
+#include "../../src/engine/state/StreamingJson.h"
+#include <JuceHeader.h>
+
+using namespace flowzone;
+
+namespace {
+AppState makeState() {
+  AppState state;
+  state.transport.bpm = 97.5;
+  state.mic.inputLevel = 0.123f;
+  state.activeFX.xyPosition = {0.1f, 0.9f};
+  state.activeMode.selectedSourceSlots = {1, 3};
+  state.session = {"s1", "Jam \"one\"\n",
+                   juce::String(juce::CharPointer_UTF8("\xf0\x9f\x8e\xb8")),
+                   1700000000000};
+  state.library.riffCount = 2;
+  state.library.latestRiff = {"riff-1", 1700000000001, "Riff", 3,
+                              {"#ff0000"}, "local"};
+
+  state.slots.resize(4);
+  for (int i = 0; i < 4; ++i) {
+    state.slots[i].id = "slot-" + juce::String(i);
+    state.slots[i].volume = 0.1f * (float)i;
+  }
+  state.slots[1].lastError = 1002;
+  state.slots[2].pluginChain.push_back(
+      {"p1", "reverb", "FlowZone", "Reverb", true, ""});
+  return state;
+}
+} // namespace
+
+TEST_CASE("JsonWriter output parses back with juce::JSON", "[StreamingJson]") {
+  std::string json;
+  JsonWriter writer(json);
+  writer.beginObject();
+  writer.key("s");
+  writer.writeString(juce::String(
+      juce::CharPointer_UTF8("tab\t quote\" slash\\ \x01 \xc3\xa9 \xf0\x9f\x8e\xb8")));
+  writer.key("n");
+  writer.beginArray();
+  writer.writeInt(-5000000000);
+  writer.writeFloat(0.1f);
+  writer.writeDouble(97.5);
+  writer.writeDouble(std::numeric_limits<double>::infinity());
+  writer.writeBool(false);
+  writer.writeNull();
+  writer.endArray();
+  writer.key("empty");
+  writer.beginObject();
+  writer.endObject();
+  writer.endObject();
+
+  REQUIRE(json.find("0.1,") != std::string::npos);
+
+  auto parsed = juce::JSON::parse(juce::String::fromUTF8(json.data()));
+  REQUIRE(parsed["s"].toString() ==
+          juce::String(juce::CharPointer_UTF8(
+              "tab\t quote\" slash\\ \x01 \xc3\xa9 \xf0\x9f\x8e\xb8")));
+  REQUIRE(static_cast<juce::int64>(parsed["n"][0]) == -5000000000);
+  REQUIRE((float)(double)parsed["n"][1] == 0.1f);
+  REQUIRE((double)parsed["n"][2] == 97.5);
+  REQUIRE(parsed["n"][3].isVoid());
+  REQUIRE(parsed["empty"].isObject());
+}
+
+TEST_CASE("JsonReader walks a document without a DOM", "[StreamingJson]") {
+  juce::String text = R"( {"a": [1, 2.5, -3e2], "b": {"c": null, "d": true},
+                            "e": "x\u00e9\ud83c\udfb8\n", "f": [] } )";
+  JsonReader reader(text);
+
+  std::string_view key;
+  REQUIRE(reader.beginObject());
+
+  REQUIRE(reader.nextKey(key));
+  REQUIRE(key == "a");
+  REQUIRE(reader.beginArray());
+  std::vector<double> numbers;
+  while (reader.nextElement()) {
+    double value = 0;
+    REQUIRE(reader.readNumber(value));
+    numbers.push_back(value);
+  }
+  REQUIRE(numbers == std::vector<double>{1.0, 2.5, -300.0});
+
+  REQUIRE(reader.nextKey(key));
+  REQUIRE(key == "b");
+  REQUIRE(reader.skipValue());
+
+  REQUIRE(reader.nextKey(key));
+  REQUIRE(key == "e");
+  juce::String value;
+  REQUIRE(reader.readString(value));
+  REQUIRE(value == juce::String(juce::CharPointer_UTF8(
+                       "x\xc3\xa9\xf0\x9f\x8e\xb8\n")));
+
+  REQUIRE(reader.nextKey(key));
+  REQUIRE(reader.peek() == JsonReader::Token::Array);
+  REQUIRE(reader.skipValue());
+
+  REQUIRE_FALSE(reader.nextKey(key));
+  REQUIRE(reader.atEnd());
+  REQUIRE_FALSE(reader.failed());
+}
+
+TEST_CASE("JsonReader rejects malformed input", "[StreamingJson]") {
+  for (auto text : {"", "{", "{\"a\" 1}", "{\"a\": 1,}", "[1 2]", "{\"a\": tru}",
+                    "\"unterminated", "{\"a\": \"\\q\"}", "{\"a\": 01x}",
+                    "[[[[", "{} trailing"}) {
+    INFO(text);
+    JsonReader reader(text, strlen(text));
+    bool ok = reader.skipValue() && reader.atEnd();
+    REQUIRE_FALSE(ok);
+  }
+}
+
+TEST_CASE("Schema JSON has the wire shape", "[StreamingJson][AppState]") {
+  auto state = makeState();
+
+  std::string json;
+  JsonWriter writer(json);
+  state.writeJson(writer);
+
+  auto parsed = juce::JSON::parse(juce::String::fromUTF8(json.data()));
+  REQUIRE(static_cast<double>(parsed["transport"]["bpm"]) == 97.5);
+  REQUIRE(parsed["session"]["name"].toString() == state.session.name);
+  REQUIRE(static_cast<juce::int64>(parsed["session"]["createdAt"]) ==
+          1700000000000);
+  REQUIRE(parsed["activeFX"]["xyPosition"].hasProperty("y"));
+  REQUIRE(parsed["library"]["latestRiff"]["colors"].size() == 1);
+  REQUIRE(parsed["ui"].isObject());
+
+  // lastError only when set; manufacturer and plugin state never
+  REQUIRE(parsed["slots"].size() == 4);
+  REQUIRE_FALSE(parsed["slots"][0].hasProperty("lastError"));
+  REQUIRE(static_cast<int>(parsed["slots"][1]["lastError"]) == 1002);
+  REQUIRE(parsed["slots"][2]["pluginChain"][0]["name"].toString() ==
+          "Reverb");
+  REQUIRE_FALSE(
+      parsed["slots"][2]["pluginChain"][0].hasProperty("manufacturer"));
+
+  SECTION("Round trip") {
+    JsonReader reader(json.data(), json.size());
+    AppState read;
+    REQUIRE(AppState::readJson(reader, read));
+    REQUIRE(reader.atEnd());
+
+    REQUIRE(read.session == state.session);
+    REQUIRE(read.library == state.library);
+    REQUIRE(read.transport.bpm == state.transport.bpm);
+    REQUIRE(read.mic.inputLevel == state.mic.inputLevel);
+    REQUIRE(read.activeFX.xyPosition.y == state.activeFX.xyPosition.y);
+    REQUIRE(read.activeMode.selectedSourceSlots ==
+            state.activeMode.selectedSourceSlots);
+
+    // Wire format only: manufacturer and plugin state aren't sent
+    state.slots[2].pluginChain[0].manufacturer = "";
+    REQUIRE(read.slots == state.slots);
+  }
+
+  SECTION("Unknown keys and mistyped values are ignored") {
+    juce::String text =
+        R"({"future": {"x": [1]}, "transport": {"bpm": "fast", "rootNote": 5}})";
+    JsonReader reader(text);
+    AppState read;
+    REQUIRE(AppState::readJson(reader, read));
+    REQUIRE(read.transport.bpm == 120.0);
+    REQUIRE(read.transport.rootNote == 5);
+  }
+}
+
+TEST_CASE("Commands parse in one pass", "[StreamingJson][CommandDispatcher]") {
+  Command command;
+  REQUIRE(CommandDispatcher::parse(
+      R"({"cmd": "SET_SLOT_VOLUME", "slot": 3, "volume": 0.5, "extra": [1]})",
+      command));
+  REQUIRE(command.cmd == "SET_SLOT_VOLUME");
+  REQUIRE(command.slot == 3);
+  REQUIRE(command.volume == 0.5f);
+  REQUIRE_FALSE(command.bpm.has_value());
+  REQUIRE_FALSE(command.requestId.has_value());
+
+  Command query;
+  REQUIRE(CommandDispatcher::parse(
+      R"({"cmd": "LIST_RIFFS", "offset": 50, "limit": 25, "requestId": 7})",
+      query));
+  REQUIRE(query.offset == 50);
+  REQUIRE(query.limit == 25);
+  REQUIRE(query.requestId == 7);
+
+  Command tempo;
+  REQUIRE(CommandDispatcher::parse(R"({"cmd": "SET_TEMPO", "bpm": 128})",
+                                   tempo));
+  REQUIRE(tempo.bpm == 128.0);
+
+  Command invalid;
+  REQUIRE_FALSE(CommandDispatcher::parse("not json", invalid));
+  REQUIRE_FALSE(CommandDispatcher::parse("[1, 2]", invalid));
+}
+
+TEST_CASE("Gesture points parse without allocating",
+          "[StreamingJson][CommandDispatcher]") {
+  Command gesture;
+  REQUIRE(CommandDispatcher::parse(
+      R"({"cmd": "GESTURE", "target": "SLOT_VOLUME", "slot": 2,
+          "t0": 1234.5, "points": [0, 0.5, 16.7, 0.25]})",
+      gesture));
+  REQUIRE(gesture.target == "SLOT_VOLUME");
+  REQUIRE(gesture.slot == 2);
+  REQUIRE(gesture.t0 == 1234.5);
+  REQUIRE(gesture.points.size == 4);
+  REQUIRE(gesture.points.values[2] == Approx(16.7f));
+  REQUIRE(gesture.points.values[3] == 0.25f);
+
+  // Past capacity the rest is dropped, not the command
+  juce::String many = R"({"cmd": "GESTURE", "points": [0)";
+  for (int i = 1; i < 300; ++i)
+    many << ", " << i;
+  many << "]}";
+  Command full;
+  REQUIRE(CommandDispatcher::parse(many, full));
+  REQUIRE(full.points.size == GesturePoints::kCapacity);
+
+  Command invalid;
+  REQUIRE_FALSE(CommandDispatcher::parse(
+      R"({"cmd": "GESTURE", "points": [0, "x"]})", invalid));
+}
@@ -0,0 +1,141 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/FeatureExtractor.h"
+#include "../../src/engine/VisualizationStream.h"
+#include <cmath>
+#include <cstring>
+
+using namespace flowzone;
+
+namespace {
+uint32_t readU32(const uint8_t *src) {
+  uint32_t value;
+  std::memcpy(&value, src, sizeof(value));
+  return juce::ByteOrder::swapIfBigEndian(value);
+}
+
+float readF32(const uint8_t *frame, int floatIndex) {
+  uint32_t bits = readU32(frame + VisualizationStream::HEADER_BYTES +
+                          floatIndex * (int)sizeof(float));
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+} // namespace
+
+TEST_CASE("VisualizationStream: Frame layout matches Spec 3.7",
+          "[VisualizationStream]") {
+  FeatureExtractor::Features features;
+  features.masterRms = {0.25f, 0.5f};
+  features.slotRms[0] = 0.1f;
+  features.slotRms[11] = 0.9f;
+  features.spectrum[0] = 0.3f;
+  features.spectrum[15] = 0.7f;
+
+  std::vector<float> waveform(VisualizationStream::WAVEFORM_POINTS, 0.0f);
+  waveform.front() = 0.2f;
+  waveform.back() = 0.8f;
+
+  std::vector<uint8_t> frame(VisualizationStream::FRAME_BYTES);
+  VisualizationStream::encodeFrame(frame.data(), 42, 1234567.5, 0.75f,
+                                   features, waveform);
+
+  const auto *f = frame.data();
+  REQUIRE(std::memcmp(f, "FZV1", 4) == 0);
+  REQUIRE(readU32(f) == VisualizationStream::MAGIC);
+  REQUIRE(readU32(f + 4) == 42);
+
+  uint64_t timeBits;
+  std::memcpy(&timeBits, f + 8, sizeof(timeBits));
+  timeBits = juce::ByteOrder::swapIfBigEndian(timeBits);
+  double timestamp;
+  std::memcpy(&timestamp, &timeBits, sizeof(timestamp));
+  REQUIRE(timestamp == 1234567.5);
+
+  const int slots = 3;
+  const int bands = slots + VisualizationStream::NUM_SLOTS;
+  const int wave = bands + VisualizationStream::NUM_BANDS;
+
+  REQUIRE(readF32(f, 0) == 0.75f);
+  REQUIRE(readF32(f, 1) == 0.25f);
+  REQUIRE(readF32(f, 2) == 0.5f);
+  REQUIRE(readF32(f, slots) == 0.1f);
+  REQUIRE(readF32(f, slots + 11) == 0.9f);
+  REQUIRE(readF32(f, bands) == 0.3f);
+  REQUIRE(readF32(f, bands + 15) == 0.7f);
+  REQUIRE(readF32(f, wave) == 0.2f);
+  REQUIRE(readF32(f, VisualizationStream::PAYLOAD_FLOATS - 1) == 0.8f);
+}
+
+TEST_CASE("VisualizationStream: Frames are numbered and reuse one buffer",
+          "[VisualizationStream]") {
+  VisualizationStream stream;
+  FeatureExtractor::Features features;
+
+  // No transport attached: nothing is encoded or numbered
+  stream.sendFrame(0.0f, features, {});
+  REQUIRE(stream.getLastFrameId() == 0);
+
+  std::vector<uint32_t> ids;
+  const void *lastData = nullptr;
+  bool sameBuffer = true;
+  stream.setFrameCallback([&](const void *data, size_t size) {
+    REQUIRE(size == VisualizationStream::FRAME_BYTES);
+    ids.push_back(readU32(static_cast<const uint8_t *>(data) + 4));
+    sameBuffer &= (lastData == nullptr || lastData == data);
+    lastData = data;
+  });
+
+  // A short waveform is zero-padded rather than read out of bounds
+  std::vector<float> shortWaveform(10, 1.0f);
+  for (int i = 0; i < 3; ++i)
+    stream.sendFrame(0.5f, features, shortWaveform);
+
+  REQUIRE(ids == std::vector<uint32_t>{1, 2, 3});
+  REQUIRE(stream.getLastFrameId() == 3);
+  REQUIRE(sameBuffer);
+}
+
+TEST_CASE("FeatureExtractor: Publishes RMS and spectrum snapshots",
+          "[VisualizationStream][FeatureExtractor]") {
+  const double sampleRate = 48000.0;
+  const int blockSize = 256;
+
+  FeatureExtractor extractor;
+  extractor.prepare(sampleRate, blockSize);
+
+  // 1 kHz sine at -6 dBFS on the left, silence on the right
+  juce::AudioBuffer<float> block(2, blockSize);
+  float slotRms[3] = {0.1f, 0.2f, 0.3f};
+  double phase = 0.0;
+  const double delta = juce::MathConstants<double>::twoPi * 1000.0 / sampleRate;
+
+  for (int b = 0; b < 16; ++b) {
+    block.clear();
+    for (int i = 0; i < blockSize; ++i, phase += delta)
+      block.setSample(0, i, 0.5f * (float)std::sin(phase));
+    extractor.pushMasterBlock(block, slotRms, 3);
+  }
+
+  auto features = extractor.getLatestFeatures();
+  REQUIRE(features.masterRms[0] == Approx(0.5f / std::sqrt(2.0f)).margin(0.01));
+  REQUIRE(features.masterRms[1] == 0.0f);
+  REQUIRE(features.slotRms[2] == 0.3f);
+  REQUIRE(features.slotRms[3] == 0.0f);
+
+  // The band holding 1 kHz dominates the low and high ends
+  int loudest = 0;
+  for (int b = 1; b < FeatureExtractor::kSpectrumBands; ++b)
+    if (features.spectrum[(size_t)b] > features.spectrum[(size_t)loudest])
+      loudest = b;
+
+  REQUIRE(loudest > 4);
+  REQUIRE(loudest < 11);
+  REQUIRE(features.spectrum[(size_t)loudest] > 0.6f);
+  REQUIRE(features.spectrum[0] < 0.3f);
+  REQUIRE(features.spectrum[15] < 0.3f);
+
+  // Reading again without a new block returns the same snapshot
+  auto again = extractor.getLatestFeatures();
+  REQUIRE(again.masterRms == features.masterRms);
+  REQUIRE(again.spectrum == features.spectrum);
+}
@@ -0,0 +1,114 @@
+#include "../../libs/catch2/catch.hpp"
+#include "../../src/engine/SynthOscillator.h"
+#include "../../src/engine/WavetableBank.h"
+#include <cmath>
+
+using namespace flowzone::engine;
+
+namespace {
+// Magnitude of harmonic k in one cycle of a mip
+float harmonicLevel(const float *cycle, int k) {
+  double re = 0.0, im = 0.0;
+  for (int i = 0; i < Wavetable::kSize; ++i) {
+    double angle = 2.0 * juce::MathConstants<double>::pi * k * i /
+                   Wavetable::kSize;
+    re += cycle[i] * std::cos(angle);
+    im += cycle[i] * std::sin(angle);
+  }
+  return (float)(2.0 * std::sqrt(re * re + im * im) / Wavetable::kSize);
+}
+} // namespace
+
+TEST_CASE("Wavetable mips are band-limited per octave", "[WavetableBank]") {
+  WavetableBank bank;
+  bank.build();
+  const auto *basic = bank.find("basic");
+  REQUIRE(basic != nullptr);
+  REQUIRE(bank.find("missing") == nullptr);
+
+  // Saw frame, mip 3: harmonics up to 1024 >> 3 = 128
+  const float *saw = basic->getMip(2, 3);
+  CHECK(harmonicLevel(saw, 1) > 0.3f);
+  CHECK(harmonicLevel(saw, 128) > 0.001f);
+  CHECK(harmonicLevel(saw, 129) < 1.0e-5f);
+  CHECK(harmonicLevel(saw, 300) < 1.0e-5f);
+  CHECK(saw[Wavetable::kSize] == saw[0]); // Wrap-around sample
+
+  // Every frame of every table peaks at 1 in its full-band mip
+  for (int t = 0; t < bank.getNumTables(); ++t) {
+    const auto &table = bank.getTable(t);
+    for (int frame = 0; frame < table.numFrames; ++frame) {
+      const float *mip0 = table.getMip(frame, 0);
+      float peak = 0.0f;
+      for (int i = 0; i < Wavetable::kSize; ++i)
+        peak = std::max(peak, std::abs(mip0[i]));
+      CHECK(peak == Approx(1.0f).margin(1.0e-4));
+    }
+  }
+
+  // The mip chosen for a note keeps its top harmonic below Nyquist, and is
+  // the fullest one that does
+  for (float hz : {30.0f, 261.6f, 440.0f, 3520.0f, 12000.0f}) {
+    float increment = hz / 48000.0f;
+    int mip = Wavetable::mipFor(increment);
+    CHECK((float)(Wavetable::kSize / 2 >> mip) * increment <= 0.5f);
+    if (mip > 0)
+      CHECK((float)(Wavetable::kSize / 2 >> (mip - 1)) * increment > 0.5f);
+  }
+}
+
+TEST_CASE("Wavetables are cached on disk", "[WavetableBank]") {
+  auto cacheFile = juce::File::createTempFile("wavetables.bin");
+
+  WavetableBank built;
+  REQUIRE_FALSE(built.loadOrBuild(cacheFile)); // Nothing there yet
+  REQUIRE(cacheFile.existsAsFile());
+
+  WavetableBank cached;
+  REQUIRE(cached.loadOrBuild(cacheFile));
+  REQUIRE(cached.getNumTables() == built.getNumTables());
+  for (int t = 0; t < built.getNumTables(); ++t) {
+    CHECK(cached.getTable(t).name == built.getTable(t).name);
+    CHECK(cached.getTable(t).samples == built.getTable(t).samples);
+  }
+
+  // A truncated or foreign file is rebuilt and rewritten
+  cacheFile.replaceWithText("FZWT but not really");
+  WavetableBank rebuilt;
+  REQUIRE_FALSE(rebuilt.loadOrBuild(cacheFile));
+  REQUIRE(WavetableBank().loadOrBuild(cacheFile));
+
+  cacheFile.deleteFile();
+}
+
+TEST_CASE("Oscillator reads and morphs wavetables", "[WavetableBank]") {
+  WavetableBank bank;
+  bank.build();
+  SynthOscillator osc;
+  osc.setShape(SynthOscillator::Shape::Wavetable);
+  osc.setWavetable(bank.find("basic"));
+  osc.setFrequency(440.0, 48000.0);
+
+  // Frame 0 is a sine
+  float block[64];
+  double phase = 0.0;
+  for (int b = 0; b < 20; ++b) {
+    osc.render(block, 64);
+    for (int i = 0; i < 64; ++i) {
+      double expected =
+          std::sin(2.0 * juce::MathConstants<double>::pi * phase);
+      REQUIRE(block[i] == Approx(expected).margin(1.0e-3));
+      phase = std::fmod(phase + 440.0 / 48000.0, 1.0);
+    }
+  }
+
+  // Halfway between sine and triangle is their average
+  const auto *basic = bank.find("basic");
+  int mip = Wavetable::mipFor(440.0f / 48000.0f);
+  osc.setPosition(1.0f / 6.0f);
+  osc.setPhase(0.125f);
+  osc.render(block, 1);
+  float expected =
+      0.5f * (basic->getMip(0, mip)[256] + basic->getMip(1, mip)[256]);
+  CHECK(block[0] == Approx(expected).margin(1.0e-5));
+}
@@ -41,4 +41,101 @@ TEST_CASE("Drum Engine Basics", "[engine][drums]") {
     }
     CHECK(foundSignal);
   }
+
+  SECTION("A re-triggered pad rings on under the new hit") {
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    buffer.clear();
+    juce::MidiBuffer midi;
+    midi.addEvent(juce::MidiMessage::noteOn(1, 36, 1.0f), 0);
+    midi.addEvent(juce::MidiMessage::noteOn(1, 36, 1.0f), 100);
+
+    engine.process(buffer, midi);
+    CHECK(engine.getNumActiveVoices() == 2);
+  }
+
+  SECTION("Hits land at their sample position") {
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    buffer.clear();
+    juce::MidiBuffer midi;
+    midi.addEvent(juce::MidiMessage::noteOn(1, 36, 1.0f), 200);
+
+    engine.process(buffer, midi);
+    for (int i = 0; i < 200; ++i)
+      REQUIRE(buffer.getSample(0, i) == 0.0f);
+
+    bool foundSignal = false;
+    for (int i = 200; i < blockSize; ++i)
+      foundSignal = foundSignal || std::abs(buffer.getSample(0, i)) > 0.01f;
+    CHECK(foundSignal);
+  }
+
+  SECTION("Closed hi-hat chokes the open one") {
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    buffer.clear();
+    juce::MidiBuffer midi;
+    midi.addEvent(juce::MidiMessage::noteOn(1, 39, 1.0f), 0); // Open
+    midi.addEvent(juce::MidiMessage::noteOn(1, 38, 1.0f), 100); // Closed
+
+    engine.process(buffer, midi);
+    CHECK(engine.getNumActiveVoices() == 1);
+
+    engine.reset();
+    engine.setChokeGroup(2, 0);
+    buffer.clear();
+    engine.process(buffer, midi);
+    CHECK(engine.getNumActiveVoices() == 2);
+  }
+
+  SECTION("A roll reuses the pad's voices") {
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    buffer.clear();
+    juce::MidiBuffer midi;
+    for (int hit = 0; hit < 20; ++hit)
+      midi.addEvent(juce::MidiMessage::noteOn(1, 37, 1.0f), hit * 20);
+
+    engine.process(buffer, midi);
+    CHECK(engine.getNumActiveVoices() == DrumEngine::kVoicesPerPad);
+
+    engine.reset();
+    CHECK(engine.getNumActiveVoices() == 0);
+  }
+
+  SECTION("Cached hits sound as synthesised ones do") {
+    for (int wait = 0; wait < 500 && !engine.isKitCached(); ++wait)
+      juce::Thread::sleep(10);
+    REQUIRE(engine.isKitCached());
+
+    auto renderKick = [&] {
+      juce::AudioBuffer<float> buffer(1, 20000);
+      buffer.clear();
+      juce::MidiBuffer midi;
+      midi.addEvent(juce::MidiMessage::noteOn(1, 36, 0.8f), 10);
+      engine.process(buffer, midi);
+      CHECK(engine.getNumActiveVoices() == 0); // 300 ms, all in the block
+      return buffer;
+    };
+
+    auto cached = renderKick();
+    engine.setPadLive(0, true);
+    auto live = renderKick();
+
+    for (int i = 0; i < cached.getNumSamples(); ++i)
+      REQUIRE(cached.getSample(0, i) ==
+              Approx(live.getSample(0, i)).margin(1e-5));
+  }
+
+  SECTION("Cached hits still choke") {
+    for (int wait = 0; wait < 500 && !engine.isKitCached(); ++wait)
+      juce::Thread::sleep(10);
+    REQUIRE(engine.isKitCached());
+
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    buffer.clear();
+    juce::MidiBuffer midi;
+    midi.addEvent(juce::MidiMessage::noteOn(1, 39, 1.0f), 0);
+    midi.addEvent(juce::MidiMessage::noteOn(1, 38, 1.0f), 100);
+
+    engine.process(buffer, midi);
+    CHECK(engine.getNumActiveVoices() == 1);
+  }
 }
@@ -1,5 +1,6 @@
 #include "../../src/engine/TuningManager.h"
 #include <catch2/catch_test_macros.hpp>
+#include <cmath>
 
 using namespace flowzone::engine;
 
@@ -40,4 +41,49 @@ TEST_CASE("Microtuning Basics", "[engine][tuning]") {
     double f70 = tm.getFrequencyForMidiNote(70);
     CHECK(f70 / f69 == Approx(1.125));
   }
+
+  SECTION("Keyboard mapping sets the reference pitch") {
+    tm.setTo12TET();
+    REQUIRE(tm.loadKbm("! middle C at 256 Hz\n"
+                       "0\n0\n127\n"
+                       "60\n"    // Degree 0
+                       "60\n"    // Reference note...
+                       "256.0\n" // ...and its frequency
+                       "12\n"));
+    CHECK(tm.getFrequencyForMidiNote(60) == Approx(256.0));
+    CHECK(tm.getFrequencyForMidiNote(72) == Approx(512.0));
+    CHECK(tm.getFrequencyForMidiNote(67) ==
+          Approx(256.0 * std::pow(2.0, 7.0 / 12.0)));
+  }
+
+  SECTION("Keyboard mapping leaves keys out and repeats per octave") {
+    // A 7-note scale on the white keys only, C4 = 261.63 Hz
+    tm.loadScl("! pyth7.scl\nPythagorean 7-note\n7\n9/8\n81/64\n4/3\n"
+               "3/2\n27/16\n243/128\n2/1\n");
+    REQUIRE(tm.loadKbm("! white keys\n"
+                       "12\n36\n96\n60\n60\n261.63\n7\n"
+                       "0\nx\n1\nx\n2\n3\nx\n4\nx\n5\nx\n6\n"));
+
+    CHECK(tm.getFrequencyForMidiNote(60) == Approx(261.63));
+    CHECK(tm.getFrequencyForMidiNote(62) == Approx(261.63 * 9.0 / 8.0));
+    CHECK(tm.getFrequencyForMidiNote(67) == Approx(261.63 * 3.0 / 2.0));
+    CHECK(tm.getFrequencyForMidiNote(72) == Approx(261.63 * 2.0));
+    CHECK(tm.getFrequencyForMidiNote(59) == Approx(261.63 * 243.0 / 256.0));
+
+    CHECK_FALSE(tm.isNoteMapped(61)); // Black keys are silent
+    CHECK_FALSE(tm.isNoteMapped(70));
+    CHECK_FALSE(tm.isNoteMapped(35)); // Outside the mapped range
+    CHECK_FALSE(tm.isNoteMapped(97));
+    CHECK(tm.isNoteMapped(96));
+  }
+
+  SECTION("A truncated mapping is rejected") {
+    tm.setTo12TET();
+    CHECK_FALSE(tm.loadKbm("12\n0\n127\n"));
+    CHECK(tm.getFrequencyForMidiNote(69) == Approx(440.0));
+
+    tm.loadKbm("0\n0\n127\n60\n60\n256.0\n12\n");
+    tm.resetKeyboardMapping();
+    CHECK(tm.getFrequencyForMidiNote(69) == Approx(440.0));
+  }
 }
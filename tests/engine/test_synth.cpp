@@ -1,4 +1,7 @@
 #include "../../src/engine/SynthEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 #include <catch2/catch_test_macros.hpp>
 
 using namespace flowzone::engine;
@@ -42,3 +45,503 @@ TEST_CASE("Synth Engine Basics", "[engine][synth]") {
     CHECK(foundSignal);
   }
 }
+
+TEST_CASE("Synth envelope follows juce::ADSR", "[engine][synth]") {
+  juce::ADSR::Parameters params(0.01f, 0.05f, 0.6f, 0.02f);
+  juce::ADSR reference;
+  reference.setSampleRate(48000.0);
+  reference.setParameters(params);
+  SynthEnvelope envelope;
+  envelope.setSampleRate(48000.0);
+  envelope.setParameters(params);
+
+  // Odd block sizes so stage changes land mid-block
+  float block[37];
+  auto renderAndCompare = [&] {
+    envelope.render(block, 37);
+    for (int i = 0; i < 37; ++i)
+      REQUIRE(std::abs(block[i] - reference.getNextSample()) < 1.0e-3f);
+  };
+
+  reference.noteOn();
+  envelope.noteOn();
+  for (int b = 0; b < 100; ++b) // Past attack and decay
+    renderAndCompare();
+  CHECK(envelope.isConstant());
+  CHECK(envelope.getValue() == 0.6f);
+
+  reference.noteOff();
+  envelope.noteOff();
+  while (reference.isActive())
+    renderAndCompare();
+  CHECK_FALSE(envelope.isActive());
+}
+
+TEST_CASE("Synth oscillator renders band-limited shapes", "[engine][synth]") {
+  SECTION("Sine matches std::sin") {
+    SynthOscillator osc;
+    osc.setShape(SynthOscillator::Shape::Sine);
+    osc.setFrequency(440.0, 44100.0);
+    float block[64];
+    double phase = 0.0;
+    for (int b = 0; b < 100; ++b) {
+      osc.render(block, 64);
+      for (int i = 0; i < 64; ++i) {
+        REQUIRE(std::abs(block[i] - std::sin(2.0 * juce::MathConstants<double>::pi *
+                                             phase)) < 1.0e-4);
+        phase = std::fmod(phase + 440.0 / 44100.0, 1.0);
+      }
+    }
+  }
+
+  SECTION("Block size doesn't change the output") {
+    for (auto shape :
+         {SynthOscillator::Shape::Saw, SynthOscillator::Shape::Square,
+          SynthOscillator::Shape::Triangle}) {
+      SynthOscillator whole, pieces;
+      whole.setShape(shape);
+      pieces.setShape(shape);
+      whole.setFrequency(3520.0, 44100.0);
+      pieces.setFrequency(3520.0, 44100.0);
+
+      float a[64], b[64];
+      whole.render(a, 64);
+      pieces.render(b, 13);
+      pieces.render(b + 13, 51);
+      for (int i = 0; i < 64; ++i) {
+        REQUIRE(std::abs(a[i] - b[i]) < 1.0e-4f);
+        REQUIRE(std::abs(a[i]) <= 1.1f);
+      }
+    }
+  }
+
+  SECTION("A high saw has less step than a naive one") {
+    // The naive saw drops by 2 at the wrap; polyBLEP spreads the drop over
+    // two samples
+    SynthOscillator osc;
+    osc.setShape(SynthOscillator::Shape::Saw);
+    osc.setFrequency(4000.0, 44100.0);
+    float block[64];
+    osc.render(block, 64);
+    float largestStep = 0.0f;
+    for (int i = 1; i < 64; ++i)
+      largestStep = std::max(largestStep, std::abs(block[i] - block[i - 1]));
+    CHECK(largestStep < 1.6f);
+  }
+}
+
+TEST_CASE("Synth oscillator glides per sample", "[engine][synth]") {
+  SECTION("The phase follows the rising increment") {
+    // Sine from 440 Hz to 880 Hz over 32 samples: sample i's phase is the
+    // sum of the increments before it
+    SynthOscillator osc;
+    osc.setShape(SynthOscillator::Shape::Sine);
+    osc.setFrequency(440.0, 44100.0);
+    osc.glide(880.0, 44100.0, 0.0f, 32);
+
+    float block[64];
+    osc.render(block, 64);
+    double phase = 0.0, increment = 440.0 / 44100.0;
+    const double step = (880.0 - 440.0) / 44100.0 / 32.0;
+    for (int i = 0; i < 64; ++i) {
+      double expected =
+          std::sin(2.0 * juce::MathConstants<double>::pi * phase);
+      REQUIRE(std::abs(block[i] - expected) < 1.0e-3);
+      if (i < 32)
+        increment += step;
+      phase += increment;
+    }
+  }
+
+  SECTION("Gliding edges stay band-limited") {
+    // A steep sweep, split across render calls, against a naive saw's
+    // step of 2
+    SynthOscillator whole, pieces;
+    whole.setShape(SynthOscillator::Shape::Saw);
+    pieces.setShape(SynthOscillator::Shape::Saw);
+    whole.setFrequency(2000.0, 44100.0);
+    pieces.setFrequency(2000.0, 44100.0);
+    whole.glide(8000.0, 44100.0, 0.0f, 32);
+    pieces.glide(8000.0, 44100.0, 0.0f, 32);
+
+    float a[64], b[64];
+    whole.render(a, 64);
+    pieces.render(b, 20);
+    pieces.render(b + 20, 44);
+    float largestStep = 0.0f;
+    for (int i = 0; i < 64; ++i) {
+      REQUIRE(std::abs(a[i] - b[i]) < 1.0e-3f);
+      if (i > 0)
+        largestStep = std::max(largestStep, std::abs(a[i] - a[i - 1]));
+    }
+    CHECK(largestStep < 1.6f);
+  }
+}
+
+TEST_CASE("Synth filter passes lows and cuts highs", "[engine][synth]") {
+  auto levelAfter = [](double hz, float cutoff) {
+    SynthFilter filter;
+    filter.setSampleRate(44100.0);
+    filter.setResonance(0.707f);
+    filter.setCutoff(cutoff);
+    float peak = 0.0f;
+    for (int i = 0; i < 44100; ++i) {
+      float x = (float)std::sin(2.0 * juce::MathConstants<double>::pi * hz *
+                                i / 44100.0);
+      filter.process(&x, 1);
+      if (i > 22050)
+        peak = std::max(peak, std::abs(x));
+    }
+    return peak;
+  };
+
+  CHECK(std::abs(levelAfter(100.0, 1000.0f) - 1.0f) < 0.02f);
+  CHECK(std::abs(levelAfter(1000.0, 1000.0f) - 0.707f) < 0.02f);
+  CHECK(levelAfter(10000.0, 1000.0f) < 0.015f); // 12 dB/octave
+
+  SECTION("A ramp ends exactly on its cutoff") {
+    SynthFilter ramped, fixed;
+    ramped.setSampleRate(44100.0);
+    fixed.setSampleRate(44100.0);
+    ramped.setCutoff(200.0f);
+    ramped.rampCutoff(2000.0f, 32);
+    fixed.setCutoff(2000.0f);
+
+    float a[64], b[64];
+    std::fill(a, a + 64, 0.0f);
+    ramped.process(a, 64); // Silence: the state stays zero
+    for (int i = 0; i < 64; ++i)
+      a[i] = b[i] = (float)(i % 7) - 3.0f;
+    ramped.process(a, 64);
+    fixed.process(b, 64);
+    for (int i = 0; i < 64; ++i)
+      REQUIRE(std::abs(a[i] - b[i]) < 1.0e-5f);
+  }
+}
+
+TEST_CASE("Synth modulation matrix", "[engine][synth]") {
+  using Source = SynthModMatrix::Source;
+  using Destination = SynthModMatrix::Destination;
+
+  SECTION("Routes sum at control rate") {
+    SynthModMatrix::Settings settings;
+    settings.controlInterval = 16;
+    settings.lfos[0] = {SynthModMatrix::Lfo::Shape::Saw, 1000.0f};
+    REQUIRE(settings.addRoute(Source::Lfo1, Destination::Pitch, 2.0f));
+    REQUIRE(settings.addRoute(Source::Velocity, Destination::Pitch, 1.0f));
+    REQUIRE(settings.addRoute(Source::X, Destination::Cutoff, 3.0f));
+    REQUIRE(settings.targets(Destination::Cutoff));
+    REQUIRE_FALSE(settings.targets(Destination::Amp));
+
+    SynthModMatrix matrix;
+    matrix.setSampleRate(16000.0); // 1000 ticks/s: the LFO's saw in 1 tick
+    matrix.setSettings(settings);
+    matrix.noteOn(0.5f);
+
+    SynthModMatrix::SharedInputs pad{1.0f, 0.5f};
+    float out[SynthModMatrix::kNumDestinations];
+    matrix.evaluate(0.0f, pad, out);
+    CHECK(std::abs(out[(int)Destination::Pitch] - (2.0f * -1.0f + 0.5f)) <
+          1.0e-6f);
+    CHECK(std::abs(out[(int)Destination::Cutoff] - 3.0f) < 1.0e-6f);
+    CHECK(out[(int)Destination::Amp] == 0.0f);
+
+    // The pad is bipolar around its centre
+    pad = {};
+    matrix.evaluate(0.0f, pad, out);
+    CHECK(out[(int)Destination::Cutoff] == 0.0f);
+  }
+
+  SECTION("The route table is bounded") {
+    SynthModMatrix::Settings settings;
+    for (int i = 0; i < SynthModMatrix::kMaxRoutes; ++i)
+      REQUIRE(settings.addRoute(Source::Lfo1, Destination::Amp, 0.1f));
+    CHECK_FALSE(settings.addRoute(Source::Lfo1, Destination::Amp, 0.1f));
+  }
+
+  SECTION("Modulated presets don't depend on the host's block size") {
+    for (auto preset : {"wobble", "acid", "growl"}) {
+      SynthEngine whole, pieces;
+      whole.prepare(44100.0, 512);
+      pieces.prepare(44100.0, 512);
+      whole.setPreset("bass", preset);
+      pieces.setPreset("bass", preset);
+      whole.setXY(0.8f, 0.3f);
+      pieces.setXY(0.8f, 0.3f);
+
+      juce::AudioBuffer<float> a(2, 4096), b(2, 4096);
+      a.clear();
+      b.clear();
+      juce::MidiBuffer on, none;
+      on.addEvent(juce::MidiMessage::noteOn(1, 40, 0.9f), 0);
+      whole.process(a, on);
+
+      for (int start = 0; start < 4096; start += 37) {
+        int n = std::min(37, 4096 - start);
+        juce::AudioBuffer<float> view(b.getArrayOfWritePointers(), 2, start,
+                                      n);
+        pieces.process(view, start == 0 ? on : none);
+      }
+
+      float energy = 0.0f;
+      for (int i = 0; i < 4096; ++i) {
+        REQUIRE(std::abs(a.getSample(0, i) - b.getSample(0, i)) < 1.0e-4f);
+        energy += a.getSample(0, i) * a.getSample(0, i);
+      }
+      CHECK(energy > 1.0f);
+    }
+  }
+}
+
+TEST_CASE("Synth voice allocator", "[engine][synth]") {
+  SynthVoiceAllocator allocator;
+  allocator.setSampleRate(48000.0);
+  allocator.forEachVoice([](SynthVoice &voice) {
+    voice.setADSR(0.001f, 0.1f, 0.8f, 0.5f);
+  });
+  juce::AudioBuffer<float> buffer(2, 256);
+  auto renderBlock = [&] {
+    buffer.clear();
+    allocator.render(buffer, 0, 256);
+  };
+
+  // Notes that are sounding and not on their way out
+  auto heldNotes = [&] {
+    std::vector<int> notes;
+    allocator.forEachVoice([&](SynthVoice &voice) {
+      if (voice.isActive() && !voice.isStolen())
+        notes.push_back(voice.getNote());
+    });
+    std::sort(notes.begin(), notes.end());
+    return notes;
+  };
+
+  SECTION("Finished voices go back to the pool") {
+    for (int note : {60, 64, 67})
+      allocator.noteOn(note, 0.8f);
+    renderBlock();
+    REQUIRE(allocator.getNumActive() == 3);
+
+    allocator.noteOff(64, true);
+    for (int b = 0; b < 150; ++b) // 0.8 s: past the release
+      renderBlock();
+    REQUIRE(allocator.getNumActive() == 2);
+    CHECK(heldNotes() == std::vector<int>{60, 67});
+
+    allocator.allNotesOff(false);
+    CHECK(allocator.getNumActive() == 0);
+  }
+
+  SECTION("Over the cap, released then oldest notes are stolen") {
+    allocator.setVoiceCap(SynthVoiceAllocator::kMinVoiceCap);
+    for (int note = 40; note < 48; ++note)
+      allocator.noteOn(note, 0.8f);
+    renderBlock();
+    allocator.noteOff(45, true); // Releasing, so first to go
+    renderBlock();
+
+    allocator.noteOn(50, 0.8f);
+    allocator.noteOn(51, 0.8f);
+    CHECK(heldNotes() ==
+          std::vector<int>{41, 42, 43, 44, 46, 47, 50, 51});
+
+    // The stolen two fade out within a block rather than stopping dead
+    CHECK(allocator.getNumActive() == 10);
+    renderBlock();
+    CHECK(allocator.getNumActive() == 8);
+  }
+
+  SECTION("Re-striking a note releases the voice already playing it") {
+    allocator.noteOn(60, 0.8f);
+    allocator.noteOn(60, 0.8f);
+    CHECK(heldNotes() == std::vector<int>{60, 60});
+    allocator.noteOff(60, true);
+    CHECK(heldNotes() == std::vector<int>{60, 60}); // Both releasing
+    for (int b = 0; b < 150; ++b)
+      renderBlock();
+    CHECK(allocator.getNumActive() == 0);
+  }
+
+  SECTION("The sustain pedal holds released notes") {
+    allocator.setSustainPedal(true);
+    allocator.noteOn(60, 0.8f);
+    allocator.noteOff(60, true);
+    for (int b = 0; b < 150; ++b)
+      renderBlock();
+    REQUIRE(allocator.getNumActive() == 1);
+
+    allocator.setSustainPedal(false);
+    for (int b = 0; b < 150; ++b)
+      renderBlock();
+    CHECK(allocator.getNumActive() == 0);
+  }
+
+  SECTION("A full pool reuses its voices") {
+    for (int i = 0; i < SynthVoiceAllocator::kMaxVoices + 10; ++i)
+      allocator.noteOn(i % 128, 0.8f);
+    CHECK(allocator.getNumActive() == SynthVoiceAllocator::kMaxVoices);
+    renderBlock();
+  }
+
+  SECTION("The voice cap follows the callback load") {
+    for (int note = 20; note < 84; ++note)
+      allocator.noteOn(note, 0.8f);
+    renderBlock();
+    REQUIRE(allocator.getVoiceCap() == SynthVoiceAllocator::kMaxVoices);
+
+    // Overloaded: an eighth shed every 50 ms, down to the floor
+    for (int b = 0; b < 20; ++b) // Just over 0.1 s
+      allocator.updateLoad(0.95, 256);
+    CHECK(allocator.getVoiceCap() == 64 - 8 - 7);
+    CHECK((int)heldNotes().size() == 64 - 8 - 7);
+    for (int b = 0; b < 600; ++b)
+      allocator.updateLoad(0.95, 256);
+    CHECK(allocator.getVoiceCap() == SynthVoiceAllocator::kMinVoiceCap);
+    CHECK(heldNotes() == std::vector<int>{76, 77, 78, 79, 80, 81, 82, 83});
+
+    // Headroom again: the cap grows back, without restarting notes
+    for (int b = 0; b < 600; ++b)
+      allocator.updateLoad(0.3, 256);
+    CHECK(allocator.getVoiceCap() == SynthVoiceAllocator::kMaxVoices);
+    CHECK(heldNotes().size() == 8);
+  }
+}
+
+TEST_CASE("Synth voice pack matches voices rendered alone",
+          "[engine][synth]") {
+  using Source = SynthModMatrix::Source;
+  using Destination = SynthModMatrix::Destination;
+
+  SynthModMatrix::Settings modulation;
+  modulation.controlInterval = 16;
+  modulation.lfos[0] = {SynthModMatrix::Lfo::Shape::Triangle, 7.0f};
+  modulation.addRoute(Source::Lfo1, Destination::Cutoff, 2.0f);
+  modulation.addRoute(Source::Lfo1, Destination::Amp, -0.5f);
+  modulation.addRoute(Source::Lfo1, Destination::Pitch, 0.3f);
+
+  // One lane short of a full pack, so an empty lane rides along
+  const int numVoices = SynthVoicePack::kLanes - 1;
+  std::vector<SynthVoice> alone(SynthVoicePack::kLanes),
+      packed(SynthVoicePack::kLanes);
+  for (auto *voices : {&alone, &packed}) {
+    for (int v = 0; v < numVoices; ++v) {
+      auto &voice = (*voices)[(size_t)v];
+      voice.setSampleRate(44100.0);
+      voice.setADSR(0.005f, 0.02f, 0.5f, 0.01f);
+      voice.setFilter(1200.0f, 2.0f);
+      voice.setModulation(modulation);
+      voice.startNote(40 + v * 7, 0.6f + 0.1f * (float)v);
+    }
+  }
+
+  SynthVoicePack pack;
+  SynthVoice *group[SynthVoicePack::kLanes];
+  for (int v = 0; v < numVoices; ++v)
+    group[v] = &packed[(size_t)v];
+
+  const int length = 4096, block = 100;
+  juce::AudioBuffer<float> a(2, length), b(2, length);
+  a.clear();
+  b.clear();
+  for (int start = 0; start < length; start += block) {
+    // A release and a steal partway through
+    if (start == 1000) {
+      alone[1].stopNote(true);
+      packed[1].stopNote(true);
+    }
+    if (start == 1500) {
+      alone[0].steal();
+      packed[0].steal();
+    }
+    int n = std::min(block, length - start);
+    for (int v = 0; v < numVoices; ++v)
+      alone[(size_t)v].render(a, start, n);
+    pack.render(group, numVoices, b, start, n);
+  }
+
+  float energy = 0.0f;
+  for (int i = 0; i < length; ++i) {
+    REQUIRE(std::abs(a.getSample(0, i) - b.getSample(0, i)) < 1.0e-4f);
+    REQUIRE(b.getSample(1, i) == b.getSample(0, i));
+    energy += a.getSample(0, i) * a.getSample(0, i);
+  }
+  CHECK(energy > 1.0f);
+  CHECK_FALSE(packed[0].isActive()); // Stolen and faded out
+  CHECK_FALSE(packed[1].isActive()); // Released
+  CHECK(packed[2].isActive());
+}
+
+TEST_CASE("Synth voice unison", "[engine][synth]") {
+  auto makeVoice = [](SynthVoice &voice, int count, float detune,
+                      float spread) {
+    voice.setSampleRate(48000.0);
+    voice.setOscillatorType(0); // Sine
+    voice.setADSR(0.0f, 0.0f, 1.0f, 0.1f);
+    voice.setUnison(count, detune, spread);
+  };
+  auto crossings = [](const float *samples, int numSamples) {
+    int count = 0;
+    for (int i = 1; i < numSamples; ++i)
+      count += (samples[i - 1] < 0.0f) != (samples[i] < 0.0f) ? 1 : 0;
+    return count;
+  };
+
+  SECTION("Detune and spread put the outer oscillators on either side") {
+    // An octave down on the left, an octave up on the right
+    SynthVoice voice;
+    makeVoice(voice, 2, 1200.0f, 1.0f);
+    REQUIRE(voice.isStereo());
+    voice.startNote(69, 1.0f);
+
+    juce::AudioBuffer<float> buffer(2, 4800);
+    buffer.clear();
+    voice.render(buffer, 0, 4800);
+    int left = crossings(buffer.getReadPointer(0), 4800);
+    int right = crossings(buffer.getReadPointer(1), 4800);
+    CHECK(std::abs(left - 44) <= 1); // 220 Hz for 0.1 s, two per cycle
+    CHECK(std::abs(right - 176) <= 1);
+  }
+
+  SECTION("Without spread the voice stays mono and packs") {
+    SynthVoice voice;
+    makeVoice(voice, 8, 20.0f, 0.0f);
+    CHECK_FALSE(voice.isStereo());
+    voice.startNote(60, 1.0f);
+
+    juce::AudioBuffer<float> buffer(2, 512);
+    buffer.clear();
+    voice.render(buffer, 0, 512);
+    float peak = buffer.getMagnitude(0, 0, 512);
+    CHECK(peak > 0.1f);
+    CHECK(peak <= 0.5f * std::sqrt(8.0f) + 1.0e-3f); // Level 0.5, 1/sqrt(n)
+    for (int i = 0; i < 512; ++i)
+      REQUIRE(buffer.getSample(0, i) == buffer.getSample(1, i));
+  }
+
+  SECTION("Start phases are random but repeatable") {
+    SynthVoice a, b, c;
+    makeVoice(a, 4, 10.0f, 0.5f);
+    makeVoice(b, 4, 10.0f, 0.5f);
+    makeVoice(c, 4, 10.0f, 0.5f);
+    a.setRandomSeed(1);
+    b.setRandomSeed(1);
+    c.setRandomSeed(2);
+
+    juce::AudioBuffer<float> outA(2, 256), outB(2, 256), outC(2, 256);
+    for (auto *out : {&outA, &outB, &outC})
+      out->clear();
+    for (auto [voice, out] : {std::pair{&a, &outA}, std::pair{&b, &outB},
+                              std::pair{&c, &outC}}) {
+      voice->startNote(57, 1.0f);
+      voice->render(*out, 0, 256);
+    }
+
+    float differenceAB = 0.0f, differenceAC = 0.0f;
+    for (int i = 0; i < 256; ++i) {
+      differenceAB += std::abs(outA.getSample(0, i) - outB.getSample(0, i));
+      differenceAC += std::abs(outA.getSample(0, i) - outC.getSample(0, i));
+    }
+    CHECK(differenceAB == 0.0f);
+    CHECK(differenceAC > 1.0f);
+  }
+}